@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Compares two eztrt-bench JSON reports and flags regressions.
+
+Usage: compare.py baseline.json current.json [--threshold 0.1] [--metric median_ns]
+
+A case regresses if its time grew by more than the threshold (relative) over the baseline. Exits
+with status 1 if any case regressed, so it can gate CI jobs. Cases that only exist in one of the
+reports are listed but do not fail the comparison.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        report = json.load(f)
+    return report.get("context", {}), {b["name"]: b for b in report["benchmarks"]}
+
+
+def pretty_ns(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return f"{ns / scale:.2f} {unit}"
+    return f"{ns:.1f} ns"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline", help="stored report, e.g. from `eztrt-bench --out`")
+    parser.add_argument("current", help="report of the build to check")
+    parser.add_argument("--threshold", type=float, default=0.1,
+                        help="relative slowdown that counts as a regression (default 0.1 = 10%%)")
+    parser.add_argument("--metric", default="median_ns", choices=("median_ns", "min_ns"),
+                        help="time to compare, min_ns is less sensitive to noisy machines")
+    parser.add_argument("--all", action="store_true", help="also list unchanged cases")
+    args = parser.parse_args()
+
+    base_context, baseline = load(args.baseline)
+    context, current = load(args.current)
+    for key in sorted(set(base_context) | set(context)):
+        if key in ("isa", "threads", "opencv") and base_context.get(key) != context.get(key):
+            print(f"warning: {key} differs: baseline {base_context.get(key)}, "
+                  f"current {context.get(key)}")
+
+    regressions = 0
+    width = max([len("benchmark")] + [len(name) for name in current])
+    print(f"{'benchmark':<{width}} {'baseline':>12} {'current':>12} {'change':>8}")
+    for name, result in current.items():
+        if name not in baseline:
+            continue
+        before, after = baseline[name][args.metric], result[args.metric]
+        change = after / before - 1.0 if before > 0 else 0.0
+        if change > args.threshold:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            status = "improved"
+        elif args.all:
+            status = ""
+        else:
+            continue
+        line = f"{name:<{width}} {pretty_ns(before):>12} {pretty_ns(after):>12} "
+        print((line + f"{change * 100.0:>+7.1f}% {status}").rstrip())
+
+    for name in sorted(set(current) - set(baseline)):
+        print(f"new: {name}")
+    for name in sorted(set(baseline) - set(current)):
+        print(f"missing: {name}")
+
+    compared = len(set(current) & set(baseline))
+    print(f"{regressions} of {compared} cases regressed by more than {args.threshold * 100.0:.0f}%")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// One iteration of a benchmark, the data it works on is owned by the closure
+using bench_body = std::function<void()>;
+
+/**
+ * A parametrized benchmark case. `setup` allocates the inputs and returns the body to time, so
+ * cases that are filtered out never allocate their (possibly 4K-sized) buffers. An empty body
+ * skips the case.
+ */
+struct bench_case
+{
+    std::string                 name;     //!< "<function>/<parameters>", e.g. "softmax/1x1000"
+    double                      bytes{0}; //!< Bytes read plus written per iteration, 0 if n/a
+    std::function<bench_body()> setup;    //!< Prepares the inputs, returns the timed body
+};
+
+struct bench_options
+{
+    std::string filter;         //!< Comma-separated substrings, a case runs if its name has one
+    double      min_time{0.5};  //!< Seconds spent in the timed repetitions of each case
+    int         repetitions{5}; //!< Independent timings per case, the median is reported
+};
+
+struct bench_result
+{
+    std::string name;
+    uint64_t    iterations{0};       //!< Iterations per repetition
+    double      median_ns{0.};       //!< Median over the repetitions of the time per iteration
+    double      min_ns{0.};          //!< Fastest repetition
+    double      max_ns{0.};          //!< Slowest repetition
+    double      bytes_per_second{0}; //!< Throughput at the median time, 0 if the case has no size
+};
+
+/**
+ * Runs all cases that match `o.filter`. Every case is run once to warm up, then the number of
+ * iterations per repetition is calibrated so a repetition takes about `min_time / repetitions`
+ * (at least one iteration), and the repetitions are timed.
+ */
+std::vector<bench_result> run_benchmarks(const std::vector<bench_case>& cases,
+                                         const bench_options&           o);
+
+/// Human-readable table
+std::string format_table(const std::vector<bench_result>& results);
+
+/// One line per case with a header, for spreadsheets
+std::string format_csv(const std::vector<bench_result>& results);
+
+/**
+ * JSON report of the form `{"context": {...}, "benchmarks": [{...}, ...]}` as read by
+ * `bench/compare.py`. `context` is added as-is (ISA level, thread count, ...).
+ */
+std::string format_json(const std::vector<bench_result>&                         results,
+                        const std::vector<std::pair<std::string, std::string>>& context);
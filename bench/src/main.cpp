@@ -0,0 +1,381 @@
+#include "microbench.h"
+
+#include "eztrt/convert.h"
+#include "eztrt/half.h"
+#include "eztrt/kernels.h"
+#include "eztrt/util.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
+#include <spdlog/spdlog.h>
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// Frame sizes from MNIST digits up to 4K video
+struct frame_size
+{
+    const char* name;
+    int         width;
+    int         height;
+};
+constexpr frame_size kSizes[] = {{"28x28", 28, 28},
+                                 {"224x224", 224, 224},
+                                 {"640x480", 640, 480},
+                                 {"1920x1080", 1920, 1080},
+                                 {"3840x2160", 3840, 2160}};
+
+/// Cases that would touch more memory per iteration are left out, e.g. 4K logits of 21 classes
+constexpr double kMaxBytes = 512. * 1024 * 1024;
+
+size_t elements(const std::vector<int>& shape)
+{
+    return std::accumulate(shape.begin(), shape.end(), size_t(1), std::multiplies<size_t>());
+}
+
+/// "1x3x224x224"
+std::string shape_name(const std::vector<int>& shape)
+{
+    std::string name;
+    for (int d : shape)
+        name += (name.empty() ? "" : "x") + std::to_string(d);
+    return name;
+}
+
+cv::Mat random_mat(const std::vector<int>& shape, int type, double low, double high)
+{
+    cv::Mat m(int(shape.size()), shape.data(), type);
+    cv::randu(m, low, high);
+    return m;
+}
+
+/// An interleaved 8-bit image, i.e. what a camera or `cv::imread` delivers
+cv::Mat random_image(const frame_size& s, int channels)
+{
+    cv::Mat m(s.height, s.width, CV_8UC(channels));
+    cv::randu(m, 0, 256);
+    return m;
+}
+
+void add_softmax(std::vector<bench_case>& cases)
+{
+    // classifier outputs (MNIST, ImageNet, ImageNet-21k), then per-pixel segmentation logits
+    std::vector<std::vector<int>> shapes = {{1, 10}, {1, 1000}, {1, 21843}};
+    for (int classes : {2, 21})
+        for (const auto& s : kSizes)
+            shapes.push_back({1, classes, s.height, s.width});
+
+    for (const auto& shape : shapes)
+    {
+        const double bytes = 2. * elements(shape) * sizeof(float);
+        if (bytes > kMaxBytes) continue;
+        cases.push_back({"softmax/" + shape_name(shape), bytes, [shape] {
+                             const cv::Mat in = random_mat(shape, CV_32F, -8., 8.);
+                             return bench_body([in] { eztrt::softmax(in); });
+                         }});
+    }
+}
+
+void add_permute_dims(std::vector<bench_case>& cases)
+{
+    // HWC -> CHW as done for network inputs, and back
+    const std::pair<const char*, std::vector<int>> orders[] = {{"2,0,1", {2, 0, 1}},
+                                                               {"1,2,0", {1, 2, 0}}};
+    for (int channels : {1, 3, 4})
+        for (const auto& s : kSizes)
+            for (const auto& [order_name, order] : orders)
+            {
+                const std::vector<int> shape = {s.height, s.width, channels};
+                const double           bytes = 2. * elements(shape) * sizeof(float);
+                if (bytes > kMaxBytes) continue;
+                const std::string params = shape_name(shape) + "/" + order_name;
+                cases.push_back({"permute_dims/" + params, bytes, [shape, order = order] {
+                                     const cv::Mat m   = random_mat(shape, CV_32F, 0., 1.);
+                                     const cv::Mat dst = m.clone();
+                                     return bench_body([m, order, dst] {
+                                         eztrt::permute_dims(m, order, dst);
+                                     });
+                                 }});
+                if (channels != 3) continue;
+                // shuffles the data on every iteration, which does not matter for the timing
+                cases.push_back({"permute_dims_in_place/" + params, bytes, [shape, order = order] {
+                                     const cv::Mat m = random_mat(shape, CV_32F, 0., 1.);
+                                     return bench_body(
+                                         [m, order] { eztrt::permute_dims_in_place(m, order); });
+                                 }});
+            }
+}
+
+void add_reshape_channels(std::vector<bench_case>& cases)
+{
+    for (int channels : {1, 3, 4})
+        for (const auto& s : kSizes)
+            cases.push_back({fmt::format("reshape_channels/{}x{}", s.name, channels), 0.,
+                             [s, channels] {
+                                 const cv::Mat m = random_image(s, channels);
+                                 return bench_body([m] { eztrt::reshape_channels(m); });
+                             }});
+}
+
+void add_separate_channels(std::vector<bench_case>& cases)
+{
+    for (int channels : {3, 21})
+        for (const auto& s : kSizes)
+        {
+            const std::vector<int> shape = {1, channels, s.height, s.width};
+            if (elements(shape) * sizeof(float) > kMaxBytes) continue;
+            cases.push_back({"separate_channels/" + shape_name(shape), 0., [shape] {
+                                 const cv::Mat m = random_mat(shape, CV_32F, 0., 1.);
+                                 return bench_body([m] { eztrt::separate_channels(m); });
+                             }});
+        }
+}
+
+void add_argmax_channels(std::vector<bench_case>& cases)
+{
+    // the same segmentation logits as for softmax, which argmax_channels replaces
+    for (int classes : {2, 21})
+        for (const auto& s : kSizes)
+        {
+            const std::vector<int> shape = {1, classes, s.height, s.width};
+            const double           bytes = (classes * sizeof(float) + 1.) * s.height * s.width;
+            if (bytes > kMaxBytes) continue;
+            cases.push_back({"argmax_channels/" + shape_name(shape), bytes, [shape] {
+                                 const cv::Mat m = random_mat(shape, CV_32F, -8., 8.);
+                                 return bench_body([m] { eztrt::argmax_channels(m); });
+                             }});
+            cases.push_back({"argmax_channels/" + shape_name(shape) + "/confidence",
+                             bytes + sizeof(float) * s.height * s.width, [shape] {
+                                 const cv::Mat m = random_mat(shape, CV_32F, -8., 8.);
+                                 return bench_body([m, confidence = cv::Mat()]() mutable {
+                                     eztrt::argmax_channels(m, &confidence);
+                                 });
+                             }});
+        }
+}
+
+void add_try_adjust_input(std::vector<bench_case>& cases)
+{
+    struct variant
+    {
+        int  channels; //!< Of the input image
+        bool resize;   //!< To 224x224 instead of the input size
+        int  depth;    //!< Of the network input
+    };
+    const variant variants[] = {{3, false, CV_32F}, {1, false, CV_32F}, {3, false, CV_8S},
+                                {3, true, CV_32F}};
+    for (const auto& v : variants)
+        for (const auto& s : kSizes)
+        {
+            if (v.resize && s.width == 224 && s.height == 224) continue;
+            const std::vector<int> shape = {1, 3, v.resize ? 224 : s.height,
+                                            v.resize ? 224 : s.width};
+            const double bytes = double(s.width) * s.height * v.channels +
+                                 double(elements(shape)) * CV_ELEM_SIZE(v.depth);
+            cases.push_back(
+                {fmt::format("try_adjust_input/{}x{}/{}/{}", s.name, v.channels, shape_name(shape),
+                             v.depth == CV_32F ? "f32" : "s8"),
+                 bytes, [s, v, shape] {
+                     const cv::Mat in = random_image(s, v.channels);
+                     // written into a preallocated input like `m.acquire_input()` in trt-host
+                     const cv::Mat dst(int(shape.size()), shape.data(), v.depth);
+                     return bench_body([in, shape, v, dst] {
+                         eztrt::try_adjust_input(in, shape, v.depth, dst);
+                     });
+                 }});
+        }
+}
+
+void add_apply_preprocess_steps(std::vector<bench_case>& cases)
+{
+    // flip, transpose, flip + invert, to gray, to BGR
+    const std::pair<int, const char*> variants[] = {{3, "h"}, {3, "t"}, {3, "vI"}, {3, "G"},
+                                                    {1, "C"}};
+    for (const auto& [channels, steps] : variants)
+        for (const auto& s : kSizes)
+        {
+            const std::string step_list    = steps;
+            const int         out_channels = step_list == "G" ? 1 : step_list == "C" ? 3 : channels;
+            const double      bytes = double(s.width) * s.height * (channels + out_channels);
+            cases.push_back(
+                {fmt::format("apply_preprocess_steps/{}x{}/{}", s.name, channels, steps), bytes,
+                 [s, channels = channels, step_list] {
+                     const cv::Mat in = random_image(s, channels);
+                     return bench_body(
+                         [in, step_list] { eztrt::apply_preprocess_steps(in, step_list); });
+                 }});
+        }
+}
+
+void add_half_conversions(std::vector<bench_case>& cases)
+{
+    using half_float::half;
+    for (const auto& s : kSizes)
+    {
+        const size_t n = size_t(s.width) * s.height * 3;
+        cases.push_back({fmt::format("float_to_half/{}x3", s.name),
+                         double(n) * (sizeof(float) + sizeof(half)), [n] {
+                             const cv::Mat    src = random_mat({int(n)}, CV_32F, -4., 4.);
+                             std::vector<half> dst(n);
+                             return bench_body([src, dst]() mutable {
+                                 eztrt::convert_f32_to_f16(src.ptr<float>(), dst.data(),
+                                                           dst.size());
+                             });
+                         }});
+        cases.push_back({fmt::format("half_to_float/{}x3", s.name),
+                         double(n) * (sizeof(float) + sizeof(half)), [n] {
+                             const cv::Mat     values = random_mat({int(n)}, CV_32F, -4., 4.);
+                             std::vector<half> src(n);
+                             eztrt::convert_f32_to_f16(values.ptr<float>(), src.data(), n);
+                             std::vector<float> dst(n);
+                             return bench_body([src, dst]() mutable {
+                                 eztrt::convert_f16_to_f32(src.data(), dst.data(), dst.size());
+                             });
+                         }});
+    }
+}
+
+void add_bfloat16_conversions(std::vector<bench_case>& cases)
+{
+    using eztrt::bfloat16;
+    for (const auto& s : kSizes)
+    {
+        const size_t n = size_t(s.width) * s.height * 3;
+        cases.push_back({fmt::format("float_to_bfloat16/{}x3", s.name),
+                         double(n) * (sizeof(float) + sizeof(bfloat16)), [n] {
+                             const cv::Mat         src = random_mat({int(n)}, CV_32F, -4., 4.);
+                             std::vector<bfloat16> dst(n);
+                             return bench_body([src, dst]() mutable {
+                                 eztrt::convert_f32_to_bf16(src.ptr<float>(), dst.data(),
+                                                            dst.size());
+                             });
+                         }});
+        cases.push_back({fmt::format("bfloat16_to_float/{}x3", s.name),
+                         double(n) * (sizeof(float) + sizeof(bfloat16)), [n] {
+                             const cv::Mat values = random_mat({int(n)}, CV_32F, -4., 4.);
+                             std::vector<bfloat16> src(n);
+                             eztrt::convert_f32_to_bf16(values.ptr<float>(), src.data(), n);
+                             std::vector<float> dst(n);
+                             return bench_body([src, dst]() mutable {
+                                 eztrt::convert_bf16_to_f32(src.data(), dst.data(), dst.size());
+                             });
+                         }});
+    }
+}
+
+std::vector<bench_case> all_cases()
+{
+    std::vector<bench_case> cases;
+    add_softmax(cases);
+    add_permute_dims(cases);
+    add_reshape_channels(cases);
+    add_separate_channels(cases);
+    add_argmax_channels(cases);
+    add_try_adjust_input(cases);
+    add_apply_preprocess_steps(cases);
+    add_half_conversions(cases);
+    add_bfloat16_conversions(cases);
+    return cases;
+}
+
+} // namespace
+
+const char* keys =
+    "{help h usage ? |       | print this message   }"
+    "{filter         |       | comma-separated substrings, only run the cases that contain one}"
+    "{list           |       | print the names of the cases and exit}"
+    "{min_time       |  0.5  | seconds spent on the timed repetitions of each case}"
+    "{repetitions    |   5   | number of timed repetitions per case, the median is reported}"
+    "{format         | table | output format on stdout: table, csv or json}"
+    "{out            |       | file to write the JSON report to, e.g. as a baseline for "
+    "bench/compare.py}"
+    "{isa            |       | kernel level to use: scalar, sse4.1, avx2 or avx512}"
+    "{threads        |  -1   | number of OpenCV threads, -1 keeps the default}"
+    "{v              |       | verbose output}";
+
+int main(int argc, char* argv[])
+{
+    using namespace eztrt;
+    cv::CommandLineParser parser(argc, argv, keys);
+    parser.about("eztrt microbenchmarks");
+    if (parser.has("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    bench_options options;
+    options.filter      = parser.get<std::string>("filter");
+    options.min_time    = parser.get<double>("min_time");
+    options.repetitions = parser.get<int>("repetitions");
+    std::string format   = parser.get<std::string>("format");
+    std::string out_path = parser.get<std::string>("out");
+    std::string isa_name = parser.get<std::string>("isa");
+    int         threads  = parser.get<int>("threads");
+
+    if (!parser.check())
+    {
+        parser.printErrors();
+        return 1;
+    }
+    if (parser.has("v")) spdlog::set_level(spdlog::level::debug);
+
+    if (!isa_name.empty())
+    {
+        bool found = false;
+        for (auto level : {kernels::isa::scalar, kernels::isa::sse41, kernels::isa::avx2,
+                           kernels::isa::avx512})
+        {
+            if (isa_name != kernels::to_str(level)) continue;
+            found = true;
+            if (!kernels::select_isa(level))
+            {
+                spdlog::error("Kernel level {} is not available on this machine", isa_name);
+                return 1;
+            }
+        }
+        if (!found)
+        {
+            spdlog::error("Unknown kernel level {}", isa_name);
+            return 1;
+        }
+    }
+    if (threads >= 0) cv::setNumThreads(threads);
+
+    const auto cases = all_cases();
+    if (parser.has("list"))
+    {
+        for (const auto& c : cases)
+            std::cout << c.name << "\n";
+        return 0;
+    }
+
+    const auto results = run_benchmarks(cases, options);
+    if (results.empty())
+    {
+        spdlog::error("No benchmark matches '{}'", options.filter);
+        return 1;
+    }
+
+    const std::string report =
+        format_json(results, {{"isa", kernels::to_str(kernels::active().level)},
+                              {"threads", std::to_string(cv::getNumThreads())},
+                              {"opencv", CV_VERSION},
+                              {"min_time", std::to_string(options.min_time)},
+                              {"repetitions", std::to_string(options.repetitions)}});
+    if (format == "json")
+        std::cout << report << std::endl;
+    else if (format == "csv")
+        std::cout << format_csv(results);
+    else
+        std::cout << format_table(results);
+    if (!out_path.empty()) std::ofstream(out_path) << report << std::endl;
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "microbench.h"
+
+#include "json.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+
+/// Total time of `iterations` calls of `body` in nanoseconds
+double time_ns(const bench_body& body, uint64_t iterations)
+{
+    using clock      = std::chrono::steady_clock;
+    const auto start = clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+        body();
+    return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+}
+
+bool matches(const std::string& name, const std::string& filter)
+{
+    if (filter.empty()) return true;
+    std::istringstream parts(filter);
+    std::string        part;
+    while (std::getline(parts, part, ','))
+        if (!part.empty() && name.find(part) != std::string::npos) return true;
+    return false;
+}
+
+/// Human-readable time, e.g. "12.3 us"
+std::string pretty_ns(double ns)
+{
+    if (ns >= 1e9) return fmt::format("{:.2f} s", ns / 1e9);
+    if (ns >= 1e6) return fmt::format("{:.2f} ms", ns / 1e6);
+    if (ns >= 1e3) return fmt::format("{:.2f} us", ns / 1e3);
+    return fmt::format("{:.1f} ns", ns);
+}
+
+} // namespace
+
+std::vector<bench_result> run_benchmarks(const std::vector<bench_case>& cases,
+                                         const bench_options&           o)
+{
+    const int    repetitions = std::max(o.repetitions, 1);
+    const double target_ns   = std::max(o.min_time, 0.) * 1e9 / repetitions;
+
+    std::vector<bench_result> results;
+    for (const auto& c : cases)
+    {
+        if (!matches(c.name, o.filter)) continue;
+        const bench_body body = c.setup();
+        if (!body)
+        {
+            spdlog::warn("{}: setup failed, skipped", c.name);
+            continue;
+        }
+
+        // the warmup call doubles as the first estimate, then grow the batch until it is long
+        // enough to be timed reliably and extrapolate to the target
+        uint64_t iterations = 1;
+        double   ns         = time_ns(body, 1);
+        while (ns < target_ns / 10. && iterations < (uint64_t(1) << 40))
+        {
+            iterations *= 10;
+            ns = time_ns(body, iterations);
+        }
+        iterations = std::max<uint64_t>(1, uint64_t(std::ceil(target_ns / ns * iterations)));
+
+        std::vector<double> per_iteration(repetitions);
+        for (auto& t : per_iteration)
+            t = time_ns(body, iterations) / iterations;
+        std::sort(per_iteration.begin(), per_iteration.end());
+
+        bench_result r;
+        r.name       = c.name;
+        r.iterations = iterations;
+        r.median_ns  = repetitions % 2 ? per_iteration[repetitions / 2]
+                                       : 0.5 * (per_iteration[repetitions / 2 - 1] +
+                                               per_iteration[repetitions / 2]);
+        r.min_ns     = per_iteration.front();
+        r.max_ns     = per_iteration.back();
+        if (c.bytes > 0 && r.median_ns > 0) r.bytes_per_second = c.bytes / r.median_ns * 1e9;
+        spdlog::debug("{}: {} x {} iterations, median {}", r.name, repetitions, iterations,
+                      pretty_ns(r.median_ns));
+        results.push_back(r);
+    }
+    return results;
+}
+
+std::string format_table(const std::vector<bench_result>& results)
+{
+    size_t width = 9;
+    for (const auto& r : results)
+        width = std::max(width, r.name.size());
+
+    std::string out = fmt::format("{:<{}} {:>12} {:>12} {:>12} {:>10} {:>12}\n", "benchmark",
+                                  width, "median", "min", "max", "GB/s", "iterations");
+    for (const auto& r : results)
+    {
+        const std::string throughput =
+            r.bytes_per_second > 0 ? fmt::format("{:.2f}", r.bytes_per_second / 1e9) : "-";
+        out += fmt::format("{:<{}} {:>12} {:>12} {:>12} {:>10} {:>12}\n", r.name, width,
+                           pretty_ns(r.median_ns), pretty_ns(r.min_ns), pretty_ns(r.max_ns),
+                           throughput, r.iterations);
+    }
+    return out;
+}
+
+std::string format_csv(const std::vector<bench_result>& results)
+{
+    std::string out = "name,iterations,median_ns,min_ns,max_ns,bytes_per_second\n";
+    for (const auto& r : results)
+        out += fmt::format("{},{},{:.1f},{:.1f},{:.1f},{:.0f}\n", r.name, r.iterations,
+                           r.median_ns, r.min_ns, r.max_ns, r.bytes_per_second);
+    return out;
+}
+
+std::string format_json(const std::vector<bench_result>&                         results,
+                        const std::vector<std::pair<std::string, std::string>>& context)
+{
+    nlohmann::json report;
+    for (const auto& [key, value] : context)
+        report["context"][key] = value;
+    report["benchmarks"] = nlohmann::json::array();
+    for (const auto& r : results)
+    {
+        nlohmann::json j;
+        j["name"]             = r.name;
+        j["iterations"]       = r.iterations;
+        j["median_ns"]        = r.median_ns;
+        j["min_ns"]           = r.min_ns;
+        j["max_ns"]           = r.max_ns;
+        j["bytes_per_second"] = r.bytes_per_second;
+        report["benchmarks"].push_back(j);
+    }
+    return report.dump(2);
+}
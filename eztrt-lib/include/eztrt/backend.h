@@ -0,0 +1,46 @@
+#pragma once
+
+#include "eztrt/onnx_inspector.h"
+
+#include <opencv2/core.hpp>
+
+#include <string>
+
+namespace eztrt
+{
+
+/**
+ * Interface of an alternative inference implementation behind `model`, used when the model is not
+ * executed by TensorRT (see `model::params::backend`). Builds without TensorRT use the
+ * implementations directly.
+ *
+ * The semantics of all methods are the same as for the equally named methods of `model`, i.e.
+ * `predict()` is thread-safe, while `acquire_input()` and `run()` share one set of buffers.
+ */
+class execution_backend
+{
+public:
+    virtual ~execution_backend() = default;
+
+    /**
+     * Loads an ONNX model.
+     */
+    virtual bool load(const std::string& file) = 0;
+
+    virtual bool ready() const = 0;
+
+    /**
+     * Inputs, outputs and structure of the loaded model.
+     */
+    virtual const onnx_model_info& info() const = 0;
+
+    virtual cv::Mat predict(cv::Mat input) = 0;
+
+    virtual cv::Mat acquire_input(int index) = 0;
+
+    virtual cv::Mat run() = 0;
+
+    virtual std::string summarize(bool verbose) const = 0;
+};
+
+} // namespace eztrt
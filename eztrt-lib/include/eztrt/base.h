@@ -69,6 +69,9 @@ constexpr const char* to_str(nvinfer1::DataType dt)
     case nvinfer1::DataType::kHALF: return "half";
     case nvinfer1::DataType::kINT32: return "int32";
     case nvinfer1::DataType::kINT8: return "int8";
+#if NV_TENSORRT_MAJOR >= 9
+    case nvinfer1::DataType::kBF16: return "bfloat16";
+#endif
     default: return "unknown";
     }
 }
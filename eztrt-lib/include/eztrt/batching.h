@@ -0,0 +1,124 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace eztrt
+{
+class model;
+
+/**
+ * Collects single-sample inference requests from any number of threads and executes them as
+ * batches.
+ *
+ * A batch is started as soon as `max_batch` requests are queued, or when the oldest queued request
+ * has waited for `max_wait_us` microseconds. The samples are packed into one $[N,...]$ input
+ * tensor, executed with a single call and the $[N,...]$ output is scattered back to the callers as
+ * $[1,...]$ tensors.
+ */
+class batching_executor
+{
+public:
+    /**
+     * The execution backend. `acquire_input` returns the $[N,...]$ buffer the samples are packed
+     * into (it is asked for once per batch), `run` executes the first `n` samples of it and returns
+     * the $[N,...]$ output. Both are only ever called from the executor's worker thread. If
+     * either of them throws, the requests of the batch resolve to an empty matrix.
+     */
+    struct backend
+    {
+        std::function<cv::Mat()>      acquire_input;
+        std::function<cv::Mat(int n)> run;
+    };
+
+    struct options
+    {
+        int max_batch{8};      //!< Upper limit of samples per batch, capped by the backend's N
+        int max_wait_us{1000}; //!< Maximum time a request waits for the batch to fill up
+    };
+
+    struct stats
+    {
+        uint64_t batches{0};            //!< Number of executed batches
+        uint64_t samples{0};            //!< Number of executed samples
+        double   total_queue_us{0.0};   //!< Sum of the queueing delays of all samples
+        double   max_queue_us{0.0};     //!< Longest queueing delay of a sample
+        int      max_batch{0};          //!< Effective maximum batch size
+
+        /// Average fraction of the batch capacity that was used
+        double fill_rate() const
+        {
+            return batches ? double(samples) / (double(batches) * max_batch) : 0.0;
+        }
+        /// Average time between `submit()` and the start of the batch execution
+        double mean_queue_us() const { return samples ? total_queue_us / samples : 0.0; }
+    };
+
+    explicit batching_executor(backend be);
+    batching_executor(backend be, options opts);
+
+#ifdef EZTRT_WITH_TENSORRT
+    /**
+     * Executes the batches on `m`, writing the samples directly into its input buffer. The batch
+     * capacity is the first dimension of the model's input tensor, i.e. the engine needs to be
+     * built for an explicit batch size > 1 to batch anything.
+     * While the executor lives it must be the only user of `m`.
+     */
+    explicit batching_executor(model& m);
+    batching_executor(model& m, options opts);
+#endif
+
+    // Non-copyable, non-movable: the worker thread refers to this object
+    batching_executor(const batching_executor& rhs) = delete;
+    batching_executor& operator=(const batching_executor& rhs) = delete;
+
+    /**
+     * Executes all pending requests, then stops the worker thread.
+     */
+    ~batching_executor();
+
+    /**
+     * Queues a sample for execution. `sample` must have as many elements as one item of the batch,
+     * e.g. $[C,H,W]$ or $[1,C,H,W]$ for an $[N,C,H,W]$ input. Thread-safe.
+     * The future resolves to the $[1,...]$ output of the sample, or to an empty matrix if the
+     * sample could not be executed.
+     */
+    std::future<cv::Mat> submit(cv::Mat sample);
+
+    /**
+     * Returns a snapshot of the execution statistics. Thread-safe.
+     */
+    stats statistics() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct request
+    {
+        cv::Mat                 sample;
+        std::promise<cv::Mat>   result;
+        clock::time_point       enqueued;
+    };
+
+    void worker();
+    void execute(std::deque<request>& batch);
+
+    backend                 backend_;
+    options                 options_;
+    mutable std::mutex      mutex_;
+    std::condition_variable wakeup_;
+    std::deque<request>     queue_;
+    stats                   stats_;
+    bool                    stop_{false};
+    std::thread             thread_;
+};
+
+} // namespace eztrt
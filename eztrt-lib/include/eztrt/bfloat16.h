@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+namespace eztrt
+{
+
+/**
+ * Brain floating point number: the upper 16 bits of an IEEE float, i.e. 8 exponent and 7 mantissa
+ * bits. It covers the range of a float at half the size (with less than 3 significant digits),
+ * which is why models increasingly export their activations in it.
+ *
+ * Converting from float rounds to nearest, ties to even, so values too large for bfloat16 become
+ * infinity and subnormals are kept (not flushed to zero). NaNs stay NaNs of the same sign, made
+ * quiet. Converting to float is exact; arithmetic happens in float through that conversion.
+ */
+class bfloat16
+{
+public:
+    bfloat16() = default;
+
+    explicit bfloat16(float value) : bits_{round(value)} {}
+
+    operator float() const
+    {
+        const uint32_t u = uint32_t(bits_) << 16;
+        float          value;
+        std::memcpy(&value, &u, sizeof(value));
+        return value;
+    }
+
+    /// The bfloat16 with the given binary representation
+    static constexpr bfloat16 from_bits(uint16_t bits)
+    {
+        bfloat16 res;
+        res.bits_ = bits;
+        return res;
+    }
+
+    constexpr uint16_t bits() const { return bits_; }
+
+    /// A friend only found by ADL, so it does not hide the global `operator<<`s inside `eztrt`
+    friend std::ostream& operator<<(std::ostream& os, bfloat16 value) { return os << float(value); }
+
+    /// Bits of the bfloat16 closest to `value`, see the class description for the rounding
+    static uint16_t round(float value)
+    {
+        uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        if ((u & 0x7FFFFFFF) > 0x7F800000) return uint16_t((u >> 16) | 0x40);
+        return uint16_t((u + 0x7FFF + ((u >> 16) & 1)) >> 16);
+    }
+
+private:
+    uint16_t bits_{0};
+};
+
+static_assert(sizeof(bfloat16) == sizeof(uint16_t), "bfloat16 has to be 16 bits wide");
+
+} // namespace eztrt
@@ -18,7 +18,10 @@
 
 #include "NvInfer.h"
 #include "common.h"
+#include "convert.h"
 #include "half.h"
+#include "host_memory_pool.h"
+#include <algorithm>
 #include <cassert>
 #include <cuda_runtime_api.h>
 #include <iostream>
@@ -34,6 +37,42 @@ using namespace std;
 namespace samplesCommon
 {
 
+//!
+//! \brief How a GenericBuffer adapts its capacity to resize() requests.
+//!
+//! \details Growing geometrically means that a sequence of increasing sizes (e.g. variable input
+//!          resolutions) only reallocates a logarithmic number of times. The slack is capped so
+//!          that large tensors do not over-allocate by hundreds of MiB, and a buffer that is used
+//!          far below its capacity for a while gives the memory back.
+//!
+struct GrowthPolicy
+{
+    double factor{1.5};                     //!< Growing allocates at least this multiple of the old capacity
+    size_t maxSlackBytes{size_t(64) << 20}; //!< Max. capacity beyond the requested size when growing
+    int shrinkAfter{32};                    //!< Shrink after this many consecutive small resizes, 0 never shrinks
+    double shrinkRatio{0.25};               //!< A resize is small if it needs less than this part of the capacity
+};
+
+//!
+//! \brief Allocation counters of a GenericBuffer.
+//!
+struct BufferStats
+{
+    size_t resizes{0};       //!< Calls to resize()
+    size_t reallocations{0}; //!< Allocations after construction (grows, shrinks and reserve() calls)
+    size_t grows{0};         //!< Reallocations because a resize() exceeded the capacity
+    size_t shrinks{0};       //!< Reallocations because of the shrink policy
+
+    BufferStats& operator+=(const BufferStats& rhs)
+    {
+        resizes += rhs.resizes;
+        reallocations += rhs.reallocations;
+        grows += rhs.grows;
+        shrinks += rhs.shrinks;
+        return *this;
+    }
+};
+
 //!
 //! \brief  The GenericBuffer class is a templated class for buffers.
 //!
@@ -83,11 +122,16 @@ public:
         , mCapacity(buf.mCapacity)
         , mType(buf.mType)
         , mBuffer(buf.mBuffer)
+        , mPolicy(buf.mPolicy)
+        , mStats(buf.mStats)
+        , mSmallResizes(buf.mSmallResizes)
     {
         buf.mSize = 0;
         buf.mCapacity = 0;
         buf.mType = nvinfer1::DataType::kFLOAT;
         buf.mBuffer = nullptr;
+        buf.mStats = BufferStats{};
+        buf.mSmallResizes = 0;
     }
 
     GenericBuffer& operator=(GenericBuffer&& buf)
@@ -99,10 +143,15 @@ public:
             mCapacity = buf.mCapacity;
             mType = buf.mType;
             mBuffer = buf.mBuffer;
+            mPolicy = buf.mPolicy;
+            mStats = buf.mStats;
+            mSmallResizes = buf.mSmallResizes;
             // Reset buf.
             buf.mSize = 0;
             buf.mCapacity = 0;
             buf.mBuffer = nullptr;
+            buf.mStats = BufferStats{};
+            buf.mSmallResizes = 0;
         }
         return *this;
     }
@@ -140,20 +189,69 @@ public:
     }
 
     //!
-    //! \brief Resizes the buffer. This is a no-op if the new size is smaller than or equal to the current capacity.
+    //! \brief Returns the allocated size (in bytes) of the buffer.
+    //!
+    size_t capacityBytes() const
+    {
+        return mCapacity * samplesCommon::getElementSize(mType);
+    }
+
+    //!
+    //! \brief Resizes the buffer (in number of elements), reallocating according to the growth policy
+    //!        if it does not fit into the current capacity or if it stayed far below it for a while.
+    //!        The content is not preserved if the buffer is reallocated.
     //!
     void resize(size_t newSize)
     {
-        mSize = newSize;
-        if (mCapacity < newSize)
+        ++mStats.resizes;
+        if (newSize > mCapacity)
         {
-            freeFn(mBuffer);
-            if (!allocFn(&mBuffer, this->nbBytes()))
+            reallocate(grownCapacity(newSize));
+            ++mStats.grows;
+            mSmallResizes = 0;
+        }
+        else if (mPolicy.shrinkAfter > 0 && double(newSize) < double(mCapacity) * mPolicy.shrinkRatio)
+        {
+            if (++mSmallResizes >= mPolicy.shrinkAfter)
             {
-                throw std::bad_alloc{};
+                reallocate(newSize);
+                ++mStats.shrinks;
+                mSmallResizes = 0;
             }
-            mCapacity = newSize;
         }
+        else
+        {
+            mSmallResizes = 0;
+        }
+        mSize = newSize;
+    }
+
+    //!
+    //! \brief Makes sure that resizes up to `capacity` elements do not reallocate, without changing
+    //!        the size. The content is not preserved if the buffer is reallocated.
+    //!
+    void reserve(size_t capacity)
+    {
+        if (capacity > mCapacity)
+        {
+            reallocate(capacity);
+        }
+    }
+
+    void setGrowthPolicy(const GrowthPolicy& policy)
+    {
+        mPolicy = policy;
+        mSmallResizes = 0;
+    }
+
+    const GrowthPolicy& growthPolicy() const
+    {
+        return mPolicy;
+    }
+
+    const BufferStats& stats() const
+    {
+        return mStats;
     }
 
     //!
@@ -170,9 +268,41 @@ public:
     }
 
 private:
+    //!
+    //! \brief The capacity for a resize to newSize elements, see GrowthPolicy.
+    //!
+    size_t grownCapacity(size_t newSize) const
+    {
+        const size_t geometric = static_cast<size_t>(double(mCapacity) * mPolicy.factor);
+        const size_t maxSlack = mPolicy.maxSlackBytes / samplesCommon::getElementSize(mType);
+        return std::max(newSize, std::min(geometric, newSize + maxSlack));
+    }
+
+    //!
+    //! \brief Replaces the allocation by one of `capacity` elements. The old one is freed first to
+    //!        keep the peak memory down, so the buffer is empty if the allocation fails.
+    //!
+    void reallocate(size_t capacity)
+    {
+        freeFn(mBuffer);
+        mBuffer = nullptr;
+        mCapacity = 0;
+        ++mStats.reallocations;
+        if (!allocFn(&mBuffer, capacity * samplesCommon::getElementSize(mType)))
+        {
+            mBuffer = nullptr;
+            mSize = 0;
+            throw std::bad_alloc{};
+        }
+        mCapacity = capacity;
+    }
+
     size_t mSize{0}, mCapacity{0};
     nvinfer1::DataType mType;
     void* mBuffer;
+    GrowthPolicy mPolicy;
+    BufferStats mStats;
+    int mSmallResizes{0}; //!< Consecutive resizes below the shrink ratio
     AllocFunc allocFn;
     FreeFunc freeFn;
 };
@@ -214,8 +344,33 @@ public:
     }
 };
 
+//!
+//! \brief Allocates from eztrt::host_memory_pool::global(): 64-byte aligned, with freed blocks
+//!        reused by size class and large blocks on huge pages (see host_memory_pool.h).
+//!
+class PooledHostAllocator
+{
+public:
+    bool operator()(void** ptr, size_t size) const
+    {
+        *ptr = eztrt::host_memory_pool::global().allocate(size);
+        return *ptr != nullptr;
+    }
+};
+
+class PooledHostFree
+{
+public:
+    void operator()(void* ptr) const
+    {
+        eztrt::host_memory_pool::global().deallocate(ptr);
+    }
+};
+
 using DeviceBuffer = GenericBuffer<DeviceAllocator, DeviceFree>;
-using HostBuffer = GenericBuffer<HostAllocator, HostFree>;
+using HostBuffer = GenericBuffer<PooledHostAllocator, PooledHostFree>;
+//! Host buffer straight from malloc/free, without the pool
+using MallocHostBuffer = GenericBuffer<HostAllocator, HostFree>;
 
 //!
 //! \brief  The ManagedBuffer class groups together a pair of corresponding device and host buffers.
@@ -227,6 +382,92 @@ public:
     HostBuffer hostBuffer;
 };
 
+//!
+//! \brief  A binding of an engine, resolved once so that BufferManager can access its buffers
+//!         without looking up the tensor name on every call.
+//!
+//! \details Handles only depend on the engine, so a handle resolved at load time works with the
+//!          BufferManager of every execution context of that engine. dims() and dataType() are
+//!          those of the engine binding (without the implicit batch dimension, if there is one).
+//!
+class BindingHandle
+{
+public:
+    BindingHandle() = default;
+
+    //!
+    //! \brief Resolves tensorName on engine. The handle is invalid if there is no such binding.
+    //!
+    BindingHandle(const nvinfer1::ICudaEngine& engine, const std::string& tensorName)
+        : BindingHandle(engine, engine.getBindingIndex(tensorName.c_str()))
+    {
+    }
+
+    //!
+    //! \brief Resolves binding index of engine. The handle is invalid if there is no such binding.
+    //!
+    BindingHandle(const nvinfer1::ICudaEngine& engine, int index)
+    {
+        if (index < 0 || index >= engine.getNbBindings())
+            return;
+        mIndex = index;
+        mName = engine.getBindingName(index);
+        mDims = engine.getBindingDimensions(index);
+        mType = engine.getBindingDataType(index);
+        mIsInput = engine.bindingIsInput(index);
+    }
+
+    //!
+    //! \brief Describes a binding directly, e.g. of buffers that do not belong to an engine.
+    //!
+    BindingHandle(int index, std::string name, nvinfer1::Dims dims, nvinfer1::DataType type,
+                  bool isInput)
+        : mIndex(index)
+        , mName(std::move(name))
+        , mDims(dims)
+        , mType(type)
+        , mIsInput(isInput)
+    {
+    }
+
+    bool valid() const
+    {
+        return mIndex >= 0;
+    }
+
+    int index() const
+    {
+        return mIndex;
+    }
+
+    const std::string& name() const
+    {
+        return mName;
+    }
+
+    const nvinfer1::Dims& dims() const
+    {
+        return mDims;
+    }
+
+    nvinfer1::DataType dataType() const
+    {
+        return mType;
+    }
+
+    bool isInput() const
+    {
+        return mIsInput;
+    }
+
+private:
+    int mIndex{-1};
+    std::string mName;
+    nvinfer1::Dims mDims{};
+    nvinfer1::DataType mType{nvinfer1::DataType::kFLOAT};
+    bool mIsInput{false};
+};
+
 //!
 //! \brief  The BufferManager class handles host and device buffer allocation and deallocation.
 //!
@@ -267,6 +508,7 @@ public:
             manBuf->hostBuffer = HostBuffer(vol, type);
             mDeviceBindings.emplace_back(manBuf->deviceBuffer.data());
             mManagedBuffers.emplace_back(std::move(manBuf));
+            mBindings.emplace_back(*mEngine, i);
         }
     }
 
@@ -287,13 +529,130 @@ public:
         return mDeviceBindings;
     }
 
+    //!
+    //! \brief Returns the resolved handles of all bindings, in binding order.
+    //!
+    const std::vector<BindingHandle>& getBindings() const
+    {
+        return mBindings;
+    }
+
+    //!
+    //! \brief Resolves tensorName once, for the handle overloads below.
+    //!        Returns an invalid handle if no such tensor can be found.
+    //!
+    const BindingHandle& getBinding(const std::string& tensorName) const
+    {
+        static const BindingHandle invalid;
+        int index = mEngine->getBindingIndex(tensorName.c_str());
+        return index == -1 ? invalid : mBindings[index];
+    }
+
+    //!
+    //! \brief Returns the device buffer of binding, or nullptr if the handle is invalid.
+    //!
+    void* getDeviceBuffer(const BindingHandle& binding) const
+    {
+        return binding.valid() ? managed(binding).deviceBuffer.data() : nullptr;
+    }
+
+    //!
+    //! \brief Returns the host buffer of binding, or nullptr if the handle is invalid.
+    //!
+    void* getHostBuffer(const BindingHandle& binding) const
+    {
+        return binding.valid() ? managed(binding).hostBuffer.data() : nullptr;
+    }
+
+    //!
+    //! \brief Returns the size (in bytes) of the host and device buffers of binding.
+    //!        Returns kINVALID_SIZE_VALUE if the handle is invalid.
+    //!
+    size_t size(const BindingHandle& binding) const
+    {
+        return binding.valid() ? managed(binding).hostBuffer.nbBytes() : kINVALID_SIZE_VALUE;
+    }
+
+    //!
+    //! \brief Returns the number of bindings, i.e. of managed buffer pairs.
+    //!
+    int getNbBindings() const
+    {
+        return static_cast<int>(mManagedBuffers.size());
+    }
+
+    //!
+    //! \brief Returns the host and device buffer of binding index, e.g. for their statistics.
+    //!
+    const ManagedBuffer& getManagedBuffer(int index) const
+    {
+        assert(index >= 0 && index < getNbBindings());
+        return *mManagedBuffers[index];
+    }
+
+    //!
+    //! \brief Applies the growth policy to all host and device buffers.
+    //!
+    void setGrowthPolicy(const GrowthPolicy& policy)
+    {
+        for (auto& buffer : mManagedBuffers)
+        {
+            buffer->deviceBuffer.setGrowthPolicy(policy);
+            buffer->hostBuffer.setGrowthPolicy(policy);
+        }
+    }
+
+    //!
+    //! \brief Resizes the host and device buffer of tensorName to the volume of dims, e.g. after
+    //!        the binding dimensions of a dynamic input changed. Reallocations follow the growth
+    //!        policy and do not preserve the content; the device bindings are updated.
+    //!        Returns false if no such tensor can be found.
+    //!
+    bool resize(const BindingHandle& binding, const nvinfer1::Dims& dims)
+    {
+        if (!binding.valid())
+            return false;
+        ManagedBuffer& buffer = managed(binding);
+        buffer.deviceBuffer.resize(dims);
+        buffer.hostBuffer.resize(dims);
+        mDeviceBindings[binding.index()] = buffer.deviceBuffer.data();
+        return true;
+    }
+
+    bool resize(const std::string& tensorName, const nvinfer1::Dims& dims)
+    {
+        return resize(getBinding(tensorName), dims);
+    }
+
+    //!
+    //! \brief Reserves room for the volume of dims in the host and device buffer of tensorName, so
+    //!        that later resizes up to that volume do not reallocate (see GenericBuffer::reserve).
+    //!        Returns false if no such tensor can be found.
+    //!
+    bool reserve(const BindingHandle& binding, const nvinfer1::Dims& dims)
+    {
+        if (!binding.valid())
+            return false;
+        const auto count = static_cast<size_t>(samplesCommon::volume(dims));
+        ManagedBuffer& buffer = managed(binding);
+        buffer.deviceBuffer.reserve(count);
+        buffer.hostBuffer.reserve(count);
+        mDeviceBindings[binding.index()] = buffer.deviceBuffer.data();
+        return true;
+    }
+
+    bool reserve(const std::string& tensorName, const nvinfer1::Dims& dims)
+    {
+        return reserve(getBinding(tensorName), dims);
+    }
+
     //!
     //! \brief Returns the device buffer corresponding to tensorName.
     //!        Returns nullptr if no such tensor can be found.
     //!
     void* getDeviceBuffer(const std::string& tensorName) const
     {
-        return getBuffer(false, tensorName);
+        return getDeviceBuffer(getBinding(tensorName));
     }
 
     //!
@@ -302,7 +661,7 @@ public:
     //!
     void* getHostBuffer(const std::string& tensorName) const
     {
-        return getBuffer(true, tensorName);
+        return getHostBuffer(getBinding(tensorName));
     }
 
     //!
@@ -311,10 +670,7 @@ public:
     //!
     size_t size(const std::string& tensorName) const
     {
-        int index = mEngine->getBindingIndex(tensorName.c_str());
-        if (index == -1)
-            return kINVALID_SIZE_VALUE;
-        return mManagedBuffers[index]->hostBuffer.nbBytes();
+        return size(getBinding(tensorName));
     }
 
     //!
@@ -342,7 +698,23 @@ public:
         {
         case nvinfer1::DataType::kINT32: print<int32_t>(os, buf, bufSize, rowCount); break;
         case nvinfer1::DataType::kFLOAT: print<float>(os, buf, bufSize, rowCount); break;
-        case nvinfer1::DataType::kHALF: print<half_float::half>(os, buf, bufSize, rowCount); break;
+        case nvinfer1::DataType::kHALF:
+        {
+            // one bulk conversion instead of a table lookup per printed element
+            std::vector<float> values(bufSize / sizeof(half_float::half));
+            eztrt::convert_f16_to_f32(static_cast<const half_float::half*>(buf), values.data(), values.size());
+            print<float>(os, values.data(), values.size() * sizeof(float), rowCount);
+            break;
+        }
+#if NV_TENSORRT_MAJOR >= 9
+        case nvinfer1::DataType::kBF16:
+        {
+            std::vector<float> values(bufSize / sizeof(eztrt::bfloat16));
+            eztrt::convert_bf16_to_f32(static_cast<const eztrt::bfloat16*>(buf), values.data(), values.size());
+            print<float>(os, values.data(), values.size() * sizeof(float), rowCount);
+            break;
+        }
+#endif
         case nvinfer1::DataType::kINT8: assert(0 && "Int8 network-level input and output is not supported"); break;
         case nvinfer1::DataType::kBOOL: assert(0 && "Bool network-level input and output are not supported"); break;
         }
@@ -412,17 +784,15 @@ public:
     ~BufferManager() = default;
 
 private:
-    void* getBuffer(const bool isHost, const std::string& tensorName) const
+    ManagedBuffer& managed(const BindingHandle& binding) const
     {
-        int index = mEngine->getBindingIndex(tensorName.c_str());
-        if (index == -1)
-            return nullptr;
-        return (isHost ? mManagedBuffers[index]->hostBuffer.data() : mManagedBuffers[index]->deviceBuffer.data());
+        assert(binding.valid() && binding.index() < getNbBindings() && "binding of another engine");
+        return *mManagedBuffers[binding.index()];
     }
 
     void memcpyBuffers(const bool copyInput, const bool deviceToHost, const bool async, const cudaStream_t& stream = 0)
     {
-        for (int i = 0; i < mEngine->getNbBindings(); i++)
+        for (int i = 0; i < getNbBindings(); i++)
         {
             void* dstPtr
                 = deviceToHost ? mManagedBuffers[i]->hostBuffer.data() : mManagedBuffers[i]->deviceBuffer.data();
@@ -430,12 +800,12 @@ private:
                 = deviceToHost ? mManagedBuffers[i]->deviceBuffer.data() : mManagedBuffers[i]->hostBuffer.data();
             const size_t byteSize = mManagedBuffers[i]->hostBuffer.nbBytes();
             const cudaMemcpyKind memcpyType = deviceToHost ? cudaMemcpyDeviceToHost : cudaMemcpyHostToDevice;
-            if ((copyInput && mEngine->bindingIsInput(i)) || (!copyInput && !mEngine->bindingIsInput(i)))
+            if (copyInput == mBindings[i].isInput())
             {
                 if (async)
-                    CHECK(cudaMemcpyAsync(dstPtr, srcPtr, byteSize, memcpyType, stream));
+                    CHECK_CUDA(cudaMemcpyAsync(dstPtr, srcPtr, byteSize, memcpyType, stream));
                 else
-                    CHECK(cudaMemcpy(dstPtr, srcPtr, byteSize, memcpyType));
+                    CHECK_CUDA(cudaMemcpy(dstPtr, srcPtr, byteSize, memcpyType));
             }
         }
     }
@@ -444,6 +814,7 @@ private:
     int mBatchSize;                                              //!< The batch size
     std::vector<std::unique_ptr<ManagedBuffer>> mManagedBuffers; //!< The vector of pointers to managed buffers
     std::vector<void*> mDeviceBindings; //!< The vector of device buffers needed for engine execution
+    std::vector<BindingHandle> mBindings; //!< The bindings resolved at construction
 };
 
 } // namespace samplesCommon
@@ -65,7 +65,8 @@ using namespace plugin;
 #define ENABLE_DLA_API 1
 #endif
 
-#define CHECK(status)                                                                              \
+// not CHECK, which is taken by test frameworks like doctest
+#define CHECK_CUDA(status)                                                                         \
     do                                                                                             \
     {                                                                                              \
         auto ret = (status);                                                                       \
@@ -95,7 +96,7 @@ template<typename T, typename T_>
 OBJ_GUARD(T)
 makeObjGuard(T_* t)
 {
-    CHECK(!(std::is_base_of<T, T_>::value || std::is_same<T, T_>::value));
+    CHECK_CUDA(!(std::is_base_of<T, T_>::value || std::is_same<T, T_>::value));
     auto deleter = [](T* t) { t->destroy(); };
     return std::unique_ptr<T, decltype(deleter)>{static_cast<T*>(t), deleter};
 }
@@ -302,7 +303,7 @@ using ByteMemory  = TypedHostMemory<uint8_t, DataType::kINT8>;
 inline void* safeCudaMalloc(size_t memSize)
 {
     void* deviceMem;
-    CHECK(cudaMalloc(&deviceMem, memSize));
+    CHECK_CUDA(cudaMalloc(&deviceMem, memSize));
     if (deviceMem == nullptr)
     {
         std::cerr << "Out of memory" << std::endl;
@@ -381,12 +382,16 @@ inline std::vector<std::string> classify(const std::vector<std::string>& refVect
 
 // Returns top K indices, not values.
 template<typename T>
-inline std::vector<size_t> topK(const std::vector<T> inp, const size_t k)
+inline std::vector<size_t> topK(const std::vector<T>& inp, const size_t k)
 {
-    std::vector<size_t> result;
-    std::vector<size_t> inds = samplesCommon::argsort(inp.cbegin(), inp.cend(), true);
-    result.assign(inds.begin(), inds.begin() + k);
-    return result;
+    // only the first k indices have to be ordered
+    std::vector<size_t> inds(inp.size());
+    std::iota(inds.begin(), inds.end(), 0);
+    const size_t n = std::min(k, inds.size());
+    std::partial_sort(inds.begin(), inds.begin() + n, inds.end(),
+                      [&inp](size_t i1, size_t i2) { return inp[i2] < inp[i1]; });
+    inds.resize(n);
+    return inds;
 }
 
 template<typename T>
@@ -556,8 +561,12 @@ inline unsigned int getElementSize(nvinfer1::DataType t)
     case nvinfer1::DataType::kINT32: return 4;
     case nvinfer1::DataType::kFLOAT: return 4;
     case nvinfer1::DataType::kHALF: return 2;
+#if NV_TENSORRT_MAJOR >= 9
+    case nvinfer1::DataType::kBF16: return 2;
+#endif
     case nvinfer1::DataType::kBOOL:
     case nvinfer1::DataType::kINT8: return 1;
+    default: break;
     }
     throw std::runtime_error("Invalid DataType.");
 }
@@ -575,8 +584,12 @@ inline unsigned int elementSize(DataType t)
     case DataType::kINT32:
     case DataType::kFLOAT: return 4;
     case DataType::kHALF: return 2;
+#if NV_TENSORRT_MAJOR >= 9
+    case DataType::kBF16: return 2;
+#endif
     case DataType::kBOOL:
     case DataType::kINT8: return 1;
+    default: break;
     }
     return 0;
 }
@@ -732,21 +745,21 @@ class GpuTimer : public TimerBase
 public:
     GpuTimer(cudaStream_t stream) : mStream(stream)
     {
-        CHECK(cudaEventCreate(&mStart));
-        CHECK(cudaEventCreate(&mStop));
+        CHECK_CUDA(cudaEventCreate(&mStart));
+        CHECK_CUDA(cudaEventCreate(&mStop));
     }
     ~GpuTimer()
     {
-        CHECK(cudaEventDestroy(mStart));
-        CHECK(cudaEventDestroy(mStop));
+        CHECK_CUDA(cudaEventDestroy(mStart));
+        CHECK_CUDA(cudaEventDestroy(mStop));
     }
-    void start() { CHECK(cudaEventRecord(mStart, mStream)); }
+    void start() { CHECK_CUDA(cudaEventRecord(mStart, mStream)); }
     void stop()
     {
-        CHECK(cudaEventRecord(mStop, mStream));
+        CHECK_CUDA(cudaEventRecord(mStop, mStream));
         float ms{0.0f};
-        CHECK(cudaEventSynchronize(mStop));
-        CHECK(cudaEventElapsedTime(&ms, mStart, mStop));
+        CHECK_CUDA(cudaEventSynchronize(mStop));
+        CHECK_CUDA(cudaEventElapsedTime(&ms, mStart, mStop));
         mMs += ms;
     }
 
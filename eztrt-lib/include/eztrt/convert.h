@@ -0,0 +1,54 @@
+#pragma once
+
+#include "eztrt/bfloat16.h"
+#include "eztrt/half.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+
+namespace eztrt
+{
+
+/**
+ * Converts `n` floats to halves, rounded exactly like `half_float::half(float)` does (half.h's
+ * `HALF_ROUND_STYLE`, by default to nearest with ties away from zero). Runs on the SIMD kernels
+ * of the active instruction set level (see kernels.h), large buffers are split over threads.
+ */
+void convert_f32_to_f16(const float* src, half_float::half* dst, size_t n);
+
+/// Converts `n` halves to floats, which is exact. NaN payloads are kept.
+void convert_f16_to_f32(const half_float::half* src, float* dst, size_t n);
+
+/**
+ * Converts a `CV_32F` matrix (any shape and number of channels) to a `CV_16F` one of the same
+ * shape, with the rounding of `convert_f32_to_f16`.
+ *
+ * \param dst Optional continuous `CV_16F` destination with room for all elements of `m`, e.g. the
+ *            host buffer of an FP16 input. If empty, a new matrix is allocated.
+ * \return    The converted matrix, or an empty matrix if `m` is not `CV_32F` or `dst` does not fit
+ */
+cv::Mat convert_f32_to_f16(const cv::Mat& m, cv::Mat dst = {});
+
+/// The inverse of `convert_f32_to_f16(const cv::Mat&, cv::Mat)`, from `CV_16F` to `CV_32F`
+cv::Mat convert_f16_to_f32(const cv::Mat& m, cv::Mat dst = {});
+
+/**
+ * Converts `n` floats to bfloat16, rounded to nearest with ties to even like `bfloat16(float)`.
+ * Runs on the SIMD kernels like `convert_f32_to_f16`.
+ */
+void convert_f32_to_bf16(const float* src, bfloat16* dst, size_t n);
+
+/// Converts `n` bfloat16 values to floats, which is exact
+void convert_bf16_to_f32(const bfloat16* src, float* dst, size_t n);
+
+/**
+ * Same as `convert_f32_to_f16(const cv::Mat&, cv::Mat)` for bfloat16. OpenCV has no bfloat16
+ * depth, so the result (and `dst`) holds the raw bits as `CV_16U`.
+ */
+cv::Mat convert_f32_to_bf16(const cv::Mat& m, cv::Mat dst = {});
+
+/// Converts a `CV_16U` matrix of bfloat16 bits to `CV_32F`
+cv::Mat convert_bf16_to_f32(const cv::Mat& m, cv::Mat dst = {});
+
+} // namespace eztrt
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "eztrt/backend.h"
+
+#include <memory>
+#include <vector>
+
+namespace eztrt
+{
+
+/**
+ * Reference backend that executes ONNX graphs directly on the CPU, for machines without a GPU
+ * (CI, edge devices) and to cross-check TensorRT results.
+ *
+ * Only float tensors and a small set of operators are supported: Add, Sub, Mul, Div (with
+ * broadcasting), Conv, Constant, Dropout, Flatten, Gemm, Identity, MatMul, MaxPool, Relu, Reshape
+ * and Softmax. Loading fails with a list of the missing operators otherwise. Convolutions, matrix
+ * products and pooling are parallelized with `cv::parallel_for_`.
+ */
+class cpu_backend : public execution_backend
+{
+public:
+    cpu_backend();
+    ~cpu_backend() override;
+
+    // Non-copyable
+    cpu_backend(const cpu_backend& rhs) = delete;
+    cpu_backend& operator=(const cpu_backend& rhs) = delete;
+
+    bool                   load(const std::string& file) override;
+    bool                   ready() const override;
+    const onnx_model_info& info() const override { return info_; }
+    cv::Mat                predict(cv::Mat input) override;
+    cv::Mat                acquire_input(int index) override;
+    cv::Mat                run() override;
+    std::string            summarize(bool verbose) const override;
+
+private:
+    struct graph;
+
+    /// Executes the graph on `input_buffers_` into `output`, errors are logged for `caller`
+    bool execute_input_buffers(cv::Mat& output, const char* caller) const;
+
+    std::unique_ptr<graph> graph_;
+    onnx_model_info        info_;
+    std::vector<cv::Mat>   input_buffers_; //!< used by acquire_input() and run()
+    cv::Mat                output_;        //!< result of the last run()
+};
+
+} // namespace eztrt
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eztrt
+{
+
+/**
+ * CRC-32C (Castagnoli) of a byte range, as used by iSCSI, ext4 and others.
+ * Uses the SSE4.2 `crc32` instruction if the CPU supports it and a slice-by-8 table
+ * implementation otherwise. Pass the result of a previous call as `crc` to checksum data that is
+ * split into several parts.
+ */
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+} // namespace eztrt
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+namespace eztrt
+{
+
+/**
+ * A detected object. The box is in the coordinate system of the network output, i.e. input pixels
+ * for YOLO exports and normalized [0,1] image coordinates for SSD priors.
+ */
+struct detection
+{
+    cv::Rect2f box; //!< top-left corner and size
+    float      score{0.f};
+    int        class_id{0};
+};
+
+/**
+ * An SSD prior ("anchor box") in center/size form, in the same coordinates as the decoded boxes.
+ */
+struct anchor_box
+{
+    float cx, cy, w, h;
+};
+
+struct ssd_params
+{
+    float score_threshold{0.5f}; //!< Minimum class probability of a candidate
+    float center_variance{0.1f}; //!< Scale of the encoded center offsets
+    float size_variance{0.2f};   //!< Scale of the encoded log sizes
+    int   background_class{0};   //!< Class that is never reported, -1 if there is none
+};
+
+/**
+ * Memory layout of an exported YOLO output. The box is always (cx, cy, w, h), optionally followed
+ * by an objectness score and then the class scores.
+ */
+enum class yolo_layout
+{
+    boxes_first,      //!< $[N, 4 (+1) + C]$, one row per box (YOLOv5, YOLOv7)
+    attributes_first, //!< $[4 (+1) + C, N]$, one row per attribute (YOLOv8)
+};
+
+struct yolo_params
+{
+    yolo_layout layout{yolo_layout::boxes_first};
+    bool        objectness{true};       //!< Whether the box is followed by an objectness score
+    float       score_threshold{0.25f}; //!< Minimum objectness * class score of a candidate
+    bool        best_class_only{true};  //!< Only the highest scoring class of a box is a candidate
+};
+
+struct nms_params
+{
+    float iou_threshold{0.45f};  //!< Boxes overlapping a better box by more than this are dropped
+    int   max_detections{300};   //!< Upper limit of returned detections, 0 for no limit
+    bool  class_agnostic{false}; //!< Suppress across classes instead of within each class
+};
+
+/**
+ * Decodes the candidates of an SSD-style output: `locations` are the $[N,4]$ encoded offsets
+ * (dx, dy, dw, dh) relative to the `anchors`, `scores` the $[N,C]$ class probabilities (apply
+ * `softmax(scores, -1)` first for logits). A leading batch dimension of 1 is allowed.
+ *
+ * Every class of a box scoring above the threshold is a candidate. The thresholding runs on all
+ * scores at once with the SIMD kernels, only the surviving boxes are decoded. Returns an empty
+ * vector for mismatching shapes.
+ */
+std::vector<detection> decode_ssd(cv::Mat locations, cv::Mat scores,
+                                  const std::vector<anchor_box>& anchors, const ssd_params& params);
+
+/**
+ * Decodes the candidates of an exported YOLO output with the given layout, see `yolo_layout`. A
+ * leading batch dimension of 1 is allowed. Returns an empty vector for unsupported shapes.
+ */
+std::vector<detection> decode_yolo(cv::Mat output, const yolo_params& params);
+
+/**
+ * Greedy non-maximum suppression: goes through the candidates by descending score (ties by
+ * position in `candidates`) and drops every box that overlaps an already kept box of the same class
+ * with an IoU above the threshold. Boxes with non-finite coordinates are dropped.
+ *
+ * The result is identical to the textbook $O(n^2)$ algorithm, but kept boxes are entered into a
+ * uniform grid per class and only compared with boxes in the cells a candidate covers. Classes are
+ * processed in parallel for large inputs. The result is sorted by descending score.
+ */
+std::vector<detection> nms(std::vector<detection> candidates, const nms_params& params);
+
+/**
+ * `decode_ssd()` followed by `nms()` for every image of a batched $[B,N,4]$/$[B,N,C]$ output, in
+ * parallel. Returns one vector of detections per image.
+ */
+std::vector<std::vector<detection>> postprocess_ssd(cv::Mat locations, cv::Mat scores,
+                                                    const std::vector<anchor_box>& anchors,
+                                                    const ssd_params&              params,
+                                                    const nms_params&              suppression);
+
+/**
+ * `decode_yolo()` followed by `nms()` for every image of a batched $[B,...]$ output, in parallel.
+ * Returns one vector of detections per image.
+ */
+std::vector<std::vector<detection>> postprocess_yolo(cv::Mat output, const yolo_params& params,
+                                                     const nms_params& suppression);
+
+} // namespace eztrt
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "eztrt/model.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace eztrt
+{
+
+/**
+ * 64 bit non-cryptographic hash of a byte range (XXH64), fast enough to hash multi-hundred-MB
+ * models at memory bandwidth.
+ */
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+/**
+ * Hash of everything in `params` that influences the built engine. Runtime-only settings (number
+ * of execution contexts, cache location and size, buffer growth) and the sample data directories
+ * are left out.
+ */
+uint64_t params_fingerprint(const model::params& params);
+
+/**
+ * Identifies the GPU engines are built for by its name and compute capability, "unknown" if there
+ * is no CUDA device. Engines are not portable between devices.
+ */
+std::string device_signature();
+
+/**
+ * A directory of serialized engines, addressed by the content they were built from.
+ *
+ * The key of an engine combines the hash of the ONNX bytes, the builder parameters, the library
+ * and TensorRT versions and the GPU, so a changed model or setting never picks up a stale engine.
+ * Engines are written to a temporary file and renamed into place, so concurrent processes never
+ * see a partial file. If the total size exceeds `max_bytes`, the least recently used engines are
+ * removed.
+ */
+class engine_cache
+{
+public:
+    /**
+     * Uses `directory` (created if necessary) as the cache, `max_bytes` == 0 means unlimited.
+     */
+    explicit engine_cache(std::string directory, uint64_t max_bytes = 0);
+
+    /**
+     * Computes the cache key of an engine built from the ONNX model `onnx` with `params`.
+     */
+    static std::string make_key(const void* onnx, size_t size, const model::params& params);
+
+    /// Same as above for the GPU identified by `device` instead of the current one
+    static std::string make_key(const void* onnx, size_t size, const model::params& params,
+                                const std::string& device);
+
+    /**
+     * Returns the path of the cached engine for `key` and marks it as recently used, or an empty
+     * string if there is none.
+     */
+    std::string lookup(const std::string& key);
+
+    /**
+     * Atomically stores the serialized engine produced by `write` under `key` and evicts old
+     * entries if needed. Returns false if the engine could not be written.
+     */
+    bool store(const std::string& key, const std::function<bool(std::ostream&)>& write);
+
+    /**
+     * Removes the least recently used entries until the cache fits into `max_bytes`, except for
+     * `keep`.
+     */
+    void evict(const std::string& keep = {});
+
+    std::string path_for(const std::string& key) const;
+
+    const std::string& directory() const { return directory_; }
+
+private:
+    std::string directory_;
+    uint64_t    max_bytes_;
+};
+
+} // namespace eztrt
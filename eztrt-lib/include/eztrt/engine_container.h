@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace eztrt
+{
+
+/**
+ * Header written in front of a serialized engine.
+ * Allows to tell a truncated or corrupted file apart from an engine TensorRT cannot deserialize,
+ * and to notice that an engine was built with different parameters.
+ * In the file, the fields follow each other in this order without padding, the integers in little
+ * endian byte order regardless of the byte order of the machine (`kSize` bytes in total).
+ */
+struct engine_header
+{
+    static constexpr char     kMagic[8] = {'E', 'Z', 'T', 'R', 'T', 'E', 'N', 'G'};
+    static constexpr uint32_t kVersion  = 1;
+    static constexpr size_t   kSize     = 40; //!< Size of the encoded header
+
+    char     magic[8];           //!< "EZTRTENG"
+    uint32_t version;            //!< Version of the container format
+    uint32_t header_size;        //!< Size of this header, the payload starts right after it
+    uint64_t params_fingerprint; //!< `params_fingerprint()` of the model that built the engine
+    uint64_t payload_size;       //!< Size of the serialized engine in bytes
+    uint32_t payload_crc;        //!< CRC-32C of the serialized engine
+    uint32_t header_crc;         //!< CRC-32C of all preceding header bytes
+};
+
+/**
+ * Writes the header followed by the serialized engine `payload` to `out`.
+ */
+bool write_engine_container(std::ostream& out, const void* payload, size_t size,
+                            uint64_t params_fingerprint);
+
+/**
+ * The serialized engine inside a container, as returned by `open_engine_container`.
+ */
+struct engine_payload
+{
+    const uint8_t* data{nullptr};
+    size_t         size{0};
+    bool           legacy{false};          //!< A raw engine without a container header
+    bool           params_mismatch{false}; //!< Built with a different `params_fingerprint`
+    std::string    error;                  //!< Why the container is invalid
+
+    bool valid() const { return data != nullptr; }
+};
+
+/**
+ * Validates the container in `data` and returns the engine inside of it. Data without the magic
+ * number is accepted as a legacy raw engine. Truncation, a size mismatch or a checksum mismatch
+ * make the result invalid, with the reason in `error`.
+ */
+engine_payload open_engine_container(const void* data, size_t size, uint64_t params_fingerprint);
+
+} // namespace eztrt
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace eztrt
+{
+
+/**
+ * A read-only, private memory mapping of a whole file.
+ *
+ * The pages are only read from disk when they are touched, so handing `data()` to a consumer
+ * avoids the extra copy (and the doubled peak memory) of reading the file into a buffer first.
+ * The kernel is advised that the mapping will be read sequentially and soon.
+ */
+class mapped_file
+{
+public:
+    mapped_file() = default;
+
+    /**
+     * Maps `path`. Check `valid()` afterwards, `error()` tells why the mapping failed.
+     */
+    explicit mapped_file(const std::string& path);
+
+    // Non-copyable
+    mapped_file(const mapped_file& rhs) = delete;
+    mapped_file& operator=(const mapped_file& rhs) = delete;
+    // Movable
+    mapped_file(mapped_file&& rhs) noexcept;
+    mapped_file& operator=(mapped_file&& rhs) noexcept;
+
+    ~mapped_file();
+
+    /**
+     * Unmaps the file, `data()` must not be used afterwards.
+     */
+    void close();
+
+    bool               valid() const { return data_ != nullptr; }
+    const uint8_t*     data() const { return static_cast<const uint8_t*>(data_); }
+    size_t             size() const { return size_; }
+    const std::string& path() const { return path_; }
+    const std::string& error() const { return error_; }
+
+private:
+    void*       data_{nullptr};
+    size_t      size_{0};
+    std::string path_;
+    std::string error_;
+#ifdef _WIN32
+    void* mapping_{nullptr}; //!< handle of the file mapping object
+#endif
+};
+
+} // namespace eztrt
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace eztrt
+{
+
+/// Configuration of a `host_memory_pool`
+struct host_pool_params
+{
+    /// Blocks of at least this size are mapped directly from the OS (on Linux) and rounded up to
+    /// whole 2 MiB pages, smaller ones come from the aligned heap
+    size_t large_block_bytes{size_t(2) << 20};
+    /// Back large blocks with huge pages: MAP_HUGETLB if the system has reserved any, transparent
+    /// huge pages (madvise) otherwise. Only has an effect on Linux.
+    bool huge_pages{true};
+    /// Free blocks kept for reuse, blocks returned beyond this go back to the OS
+    size_t max_cached_bytes{size_t(512) << 20};
+};
+
+/// Counters of a `host_memory_pool`, sizes are rounded up to the size classes
+struct host_pool_stats
+{
+    size_t   bytes_live{0};       //!< Bytes currently handed out
+    size_t   bytes_peak{0};       //!< Maximum of `bytes_live`
+    size_t   bytes_cached{0};     //!< Bytes of freed blocks kept for reuse
+    size_t   bytes_huge_pages{0}; //!< Part of `bytes_live` on (or advised to use) huge pages
+    uint64_t allocations{0};      //!< Number of `allocate()` calls that succeeded
+    uint64_t hits{0};             //!< Allocations served from the cached blocks
+
+    double hit_rate() const { return allocations ? double(hits) / double(allocations) : 0.0; }
+};
+
+/**
+ * Size-class pool for host tensor buffers.
+ *
+ * Requests are rounded up to one of four classes per power of two, in steps of at least
+ * `alignment` bytes (so at most 25% or less than `alignment` bytes are wasted), and freed blocks
+ * are kept per class, so that re-creating the buffers of an execution context, e.g. for a new
+ * input shape, does not go back to the system allocator. Every block is aligned to
+ * `alignment` bytes, enough for any SIMD load. See `host_pool_params` for large blocks.
+ *
+ * All functions are thread-safe. `samplesCommon::HostBuffer` allocates from `global()`.
+ */
+class host_memory_pool
+{
+public:
+    static constexpr size_t alignment = 64;
+
+    explicit host_memory_pool(host_pool_params params = {});
+    ~host_memory_pool();
+
+    host_memory_pool(const host_memory_pool&) = delete;
+    host_memory_pool& operator=(const host_memory_pool&) = delete;
+
+    /**
+     * The pool used by the host buffers of all models. It is never destroyed, so buffers in
+     * static objects can be freed safely during shutdown.
+     */
+    static host_memory_pool& global();
+
+    /**
+     * Returns a block of at least `bytes` bytes (a size class for 0 bytes as well), aligned to
+     * `alignment`. Returns nullptr if the system is out of memory.
+     */
+    void* allocate(size_t bytes);
+
+    /// Returns a block from `allocate()` to the pool, nullptr is ignored
+    void deallocate(void* ptr);
+
+    /// Releases all cached blocks to the OS
+    void trim();
+
+    /// Applies new parameters to future allocations, cached blocks are released
+    void set_params(const host_pool_params& params);
+
+    host_pool_params params() const;
+    host_pool_stats  stats() const;
+
+    /// The number of bytes actually reserved for a request of `bytes`
+    size_t size_class(size_t bytes) const;
+
+private:
+    struct block
+    {
+        size_t size{0};       //!< Size class of the block
+        bool   mapped{false}; //!< Mapped from the OS instead of the heap
+        bool   huge{false};   //!< Backed by (or advised to use) huge pages
+    };
+
+    using block_list = std::vector<std::pair<void*, block>>;
+
+    void*      allocate_system(block& info);
+    void       release_system(void* ptr, const block& info);
+    block_list take_cached(); //!< Empties the cache, the caller has to hold the mutex
+
+    mutable std::mutex                     mutex_;
+    host_pool_params                       params_;
+    std::unordered_map<void*, block>       live_;
+    std::unordered_map<size_t, block_list> cached_;        //!< Free blocks per size class
+    host_pool_stats                        stats_;
+    std::atomic<bool>                      hugetlb_{true}; //!< MAP_HUGETLB did not fail yet
+};
+
+} // namespace eztrt
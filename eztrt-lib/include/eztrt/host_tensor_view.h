@@ -0,0 +1,64 @@
+#pragma once
+
+#include "eztrt/buffers.h"
+#include "eztrt/tensor_view.h"
+
+#include "NvInfer.h"
+
+#include <string>
+
+// The TensorRT side of tensor_view.h, separate so that the view itself does not depend on the
+// TensorRT sample headers (buffers.h, common.h)
+
+namespace eztrt
+{
+
+constexpr dtype to_dtype(nvinfer1::DataType t)
+{
+    switch (t)
+    {
+    case nvinfer1::DataType::kHALF: return dtype::float16;
+#if NV_TENSORRT_MAJOR >= 9
+    case nvinfer1::DataType::kBF16: return dtype::bfloat16;
+#endif
+    case nvinfer1::DataType::kINT32: return dtype::int32;
+    case nvinfer1::DataType::kINT8: return dtype::int8;
+    case nvinfer1::DataType::kBOOL: return dtype::boolean;
+    case nvinfer1::DataType::kFLOAT:
+    default: return dtype::float32;
+    }
+}
+
+/**
+ * Views the host buffer of `binding` as a row-major tensor of shape `dims` (the binding
+ * dimensions, including the batch dimension for explicit batch engines). Returns an empty view if
+ * the handle is invalid or the buffer size does not match `dims` and `T`.
+ */
+template<typename T>
+tensor_view<T> host_tensor_view(const samplesCommon::BufferManager& buffers,
+                                const samplesCommon::BindingHandle& binding,
+                                const nvinfer1::Dims& dims)
+{
+    void* data = buffers.getHostBuffer(binding);
+    if (!data || dims.nbDims > kMaxTensorDims) return {};
+
+    int64_t shape[kMaxTensorDims];
+    size_t  total = 1;
+    for (int d = 0; d < dims.nbDims; ++d)
+    {
+        shape[d] = dims.d[d];
+        total *= size_t(dims.d[d]);
+    }
+    if (buffers.size(binding) != total * sizeof(T)) return {};
+    return tensor_view<T>(static_cast<T*>(data), dims.nbDims, shape);
+}
+
+/// Same as above for the binding of tensor `name`
+template<typename T>
+tensor_view<T> host_tensor_view(const samplesCommon::BufferManager& buffers,
+                                const std::string& name, const nvinfer1::Dims& dims)
+{
+    return host_tensor_view<T>(buffers, buffers.getBinding(name), dims);
+}
+
+} // namespace eztrt
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eztrt
+{
+namespace kernels
+{
+
+/**
+ * Instruction set levels the kernels are available for. The levels are ordered, i.e. a CPU that
+ * supports `avx512` also supports all levels below it.
+ */
+enum class isa
+{
+    scalar,
+    sse41,
+    avx2,
+    avx512, //!< AVX-512 F + BW
+};
+
+constexpr const char* to_str(isa level)
+{
+    switch (level)
+    {
+    case isa::scalar: return "scalar";
+    case isa::sse41: return "sse4.1";
+    case isa::avx2: return "avx2";
+    case isa::avx512: return "avx512";
+    default: return "unknown";
+    }
+}
+
+/**
+ * CPU features as reported by CPUID, already masked with what the OS has enabled through XCR0.
+ */
+struct cpu_features
+{
+    bool sse41{false};
+    bool sse42{false};
+    bool avx2{false};
+    bool avx512f{false};
+    bool avx512bw{false};
+};
+
+/**
+ * Queries the features of the CPU we are running on. The result is computed once and cached.
+ */
+const cpu_features& cpu();
+
+/**
+ * Highest instruction set level that is both compiled into the library and supported by the CPU.
+ */
+isa detect_isa();
+
+/**
+ * Set of kernels for one instruction set level. All variants produce bit-identical results to the
+ * scalar implementation.
+ *
+ * Source pointers point to `n` interleaved pixels with `channels` 8-bit components each, `planes`
+ * point to the destination row of each output channel plane.
+ */
+struct kernel_table
+{
+    isa level;
+
+    /// planes[c][i] = src[i * channels + c] * mul + add
+    void (*u8_to_f32_planar)(const uint8_t* src, size_t n, int channels, float* const* planes,
+                             float mul, float add);
+
+    /// planes[c][i] = saturate(src[i * channels + c] - 127)
+    void (*u8_to_s8_planar)(const uint8_t* src, size_t n, int channels, int8_t* const* planes);
+
+    /// planes[p][i] = src[i] * mul + add for all p < n_planes (gray to BGR broadcast)
+    void (*u8_gray_to_f32_planar)(const uint8_t* src, size_t n, float* const* planes,
+                                  int n_planes, float mul, float add);
+
+    /// dst[i] = gray(src[i * channels + 0..2]) * mul + add, using the cv::COLOR_BGR2GRAY weights
+    void (*u8_bgr_to_gray_f32)(const uint8_t* src, size_t n, int channels, float* dst, float mul,
+                               float add);
+
+    /// dst[i] = exp((src[i] - shift) * scale), see `kernels::scalar::exp_f32` for the accuracy
+    void (*exp_f32)(const float* src, float* dst, size_t n, float shift, float scale);
+
+    /// dst[i] = exp((src[i] - shift[i]) * scale)
+    void (*exp_shifted_f32)(const float* src, const float* shift, float* dst, size_t n,
+                            float scale);
+
+    /// max[i] = src[i], arg[i] = index where src[i] > max[i]; NaNs are skipped
+    void (*argmax_update_f32)(const float* src, size_t n, int32_t index, float* max,
+                              int32_t* arg);
+    /// writes the indices i with src[i] > threshold in ascending order, returns their count
+    size_t (*select_above_f32)(const float* src, size_t n, float threshold, int32_t* indices);
+
+    /// dst[c * dst_stride + r] = src[r * src_stride + c] for all r < rows, c < cols
+    void (*transpose_32)(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride,
+                         size_t rows, size_t cols);
+
+    /// dst[i] = the bits of half_float::half(src[i]), rounded like half.h (`HALF_ROUND_STYLE`)
+    void (*f32_to_f16)(const float* src, uint16_t* dst, size_t n);
+
+    /// dst[i] = float of the half_float::half with bits src[i], NaN payloads are kept
+    void (*f16_to_f32)(const uint16_t* src, float* dst, size_t n);
+
+    /// dst[i] = the bits of eztrt::bfloat16(src[i]), i.e. rounded to nearest, ties to even
+    void (*f32_to_bf16)(const float* src, uint16_t* dst, size_t n);
+
+    /// dst[i] = float of the bfloat16 with bits src[i]
+    void (*bf16_to_f32)(const uint16_t* src, float* dst, size_t n);
+};
+
+/**
+ * Returns the kernels for the given level, or `nullptr` if that level is not compiled in or not
+ * supported by this CPU.
+ */
+const kernel_table* table_for(isa level);
+
+/**
+ * Returns the currently selected kernels. The selection happens once on first use and picks
+ * `detect_isa()`, unless the environment variable `EZTRT_ISA` requests a lower level (one of
+ * "scalar", "sse4.1", "avx2", "avx512").
+ */
+const kernel_table& active();
+
+/**
+ * Forces a specific kernel level, e.g. for debugging or benchmarking. Returns false (and keeps the
+ * current selection) if the level is not available.
+ */
+bool select_isa(isa level);
+
+} // namespace kernels
+} // namespace eztrt
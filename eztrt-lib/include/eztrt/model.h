@@ -1,31 +1,49 @@
 #pragma once
 
+#include "eztrt/backend.h"
 #include "eztrt/base.h"
 #include "eztrt/buffers.h"
 #include "eztrt/common.h"
+#include "eztrt/slot_pool.h"
 
 #include "NvInfer.h"
 #include "NvOnnxParser.h"
 
 #include <opencv2/opencv.hpp>
 
+#include <functional>
+
 namespace eztrt
 {
 class logger;
 
+/**
+ * What executes a model: TensorRT, or the CPU reference implementation (see `cpu_backend`).
+ */
+enum class backend_type
+{
+    tensorrt,
+    cpu,
+};
+
 class model
 {
 public:
     struct params
     {
-        int                      batchSize{1}; //!< Number of inputs in a batch
-        int                      dlaCore{-1};  //!< Specify the DLA core to run network on.
-        bool                     int8{false};  //!< Allow runnning the network in Int8 mode.
-        bool                     fp16{false};  //!< Allow running the network in FP16 mode.
-        uint64_t                 workspace_size{0};
-        std::vector<std::string> dataDirs; //!< Directory paths where sample data files are stored
-        std::vector<std::string> inputTensorNames;
-        std::vector<std::string> outputTensorNames;
+        int                         batchSize{1}; //!< Number of inputs in a batch
+        int                         dlaCore{-1};  //!< Specify the DLA core to run network on.
+        bool                        int8{false};  //!< Allow runnning the network in Int8 mode.
+        bool                        fp16{false};  //!< Allow running the network in FP16 mode.
+        uint64_t                    workspace_size{0};
+        std::vector<std::string>    dataDirs; //!< Directory paths where sample data files are stored
+        std::vector<std::string>    inputTensorNames;
+        std::vector<std::string>    outputTensorNames;
+        int                         execution_contexts{1}; //!< Max. concurrent `predict()` calls
+        std::string                 engine_cache_dir;      //!< Engine cache directory, off if empty
+        uint64_t                    engine_cache_max_bytes{0}; //!< Cache size limit, 0 = unlimited
+        backend_type                backend{backend_type::tensorrt}; //!< What executes the model
+        samplesCommon::GrowthPolicy buffer_growth; //!< How host/device buffers follow resizes
     };
 
     model(params params, logger& logger);
@@ -37,10 +55,44 @@ public:
     model(model&& rhs) = default;
     model& operator=(model&& rhs) = default;
 
-    ~model() = default;
+    virtual ~model() = default;
 
+    /**
+     * Runs inference on a single input and returns a copy of the (single) output.
+     * If `input` already is the view returned by `acquire_input(0)`, it is not copied again: the
+     * call then executes on the slot of the zero-copy API like `run()` does, and the same
+     * restriction applies (see `acquire_input`).
+     * FP16 and BF16 bindings are handled transparently: a `CV_32F` input is converted to half or
+     * bfloat16 on its way into the input buffer, and such outputs are returned as `CV_32F` (see
+     * `convert.h`).
+     *
+     * Thread-safe: every call checks out one of `params::execution_contexts` execution contexts
+     * (each with its own host/device buffers) that share the engine, and only blocks while all of
+     * them are in use.
+     */
     cv::Mat predict(cv::Mat input);
 
+    /**
+     * Returns a writable view onto the host buffer of input `index`, shaped like the input tensor.
+     * Preprocessing can write straight into it, e.g. `try_adjust_input(img, 0, m,
+     * m.acquire_input(0))`, followed by `run()`, which avoids any host-side copy of the input.
+     * The view stays valid as long as the model (and its engine) lives. FP16 inputs are views of
+     * depth `CV_16F`, which `try_adjust_input` fills as well. BF16 inputs hold the bits as
+     * `CV_16U`.
+     * `acquire_input()` and `run()` use a dedicated execution context and must not be called
+     * concurrently with each other or with a `predict()` on the view returned here.
+     */
+    cv::Mat acquire_input(int index = 0);
+
+    /**
+     * Runs inference on the current content of the input host buffers (see `acquire_input`).
+     * Returns a view onto the host buffer of the first output, which is overwritten by the next
+     * call to `run()` or `predict()` - clone it if you need to keep it. FP16 outputs are returned
+     * as they are (`CV_16F`), use `convert_f16_to_f32` to get floats (`convert_bf16_to_f32` for
+     * the `CV_16U` bits of BF16 outputs). Returns an empty matrix if the execution failed.
+     */
+    cv::Mat run();
+
     std::string summarize(bool verbose = false);
 
     /**
@@ -55,37 +107,145 @@ public:
 
     /**
      * Parse a file (currently only ONNX is supported)
+     * If `engine_file` is empty and `params::engine_cache_dir` is set, the engine is taken from
+     * the cache if it has been built from the same model and parameters before, and added to it
+     * otherwise.
      */
     bool load(std::string file, std::string engine_file = {});
 
+    /**
+     * Loads a serialized engine. The checksums of engines written by `serialize_engine` are
+     * verified before the engine is deserialized; raw engines are accepted with a warning.
+     */
     bool load_engine(std::string file);
 
+    /**
+     * Loads the engine for the ONNX model `onnx_file` from `params::engine_cache_dir`, or builds
+     * and adds it there if the cache does not contain it yet. The network must already be parsed.
+     */
+    bool load_cached_engine(std::string onnx_file);
+
+    /**
+     * Writes the engine together with an integrity header (see `engine_header`) to `file`.
+     */
     bool serialize_engine(std::string file);
+    bool serialize_engine(std::ostream& out);
 
     void apply_params();
 
+    /**
+     * The backend executing the model if it does not run on TensorRT, null otherwise. Builder,
+     * network, config and engine are not available in that case.
+     */
+    execution_backend* backend() { return backend_.get(); }
+
     nvinfer1::INetworkDefinition&          network() { return *network_; }
     nvinfer1::IBuilder&                    builder() { return *builder_; }
     nvinfer1::IBuilderConfig&              config() { return *config_; }
     std::shared_ptr<nvinfer1::ICudaEngine> engine() { return engine_; };
-    void set_engine(std::shared_ptr<nvinfer1::ICudaEngine> engine) { engine_ = engine; }
+    void set_engine(std::shared_ptr<nvinfer1::ICudaEngine> engine);
 
+    /// Layers and tensors of the parsed network, empty if there is none (e.g. for a loaded engine)
     std::vector<nvinfer1::ILayer*>  layers();
     std::vector<nvinfer1::ITensor*> inputs();
     std::vector<nvinfer1::ITensor*> outputs();
 
+    /// Bindings of the inputs and outputs in network order, empty until there is an engine
+    const std::vector<samplesCommon::BindingHandle>& input_bindings() const
+    {
+        return input_bindings_;
+    }
+    const std::vector<samplesCommon::BindingHandle>& output_bindings() const
+    {
+        return output_bindings_;
+    }
+
 protected:
-    cv::Mat wrap_tensor(nvinfer1::ITensor& tensor, void* data);
+    /**
+     * What one inference call runs on: the host buffers of all bindings and the means to execute
+     * the engine on them. On TensorRT, an execution context with its `BufferManager`
+     * (`tensorrt_slot`).
+     */
+    struct execution_slot
+    {
+        virtual ~execution_slot() = default;
+
+        /// The host buffer of `binding`, null if there is none
+        virtual void* host_buffer(const samplesCommon::BindingHandle& binding) = 0;
+
+        /// Copies the inputs to the device, executes and copies the outputs back to the host
+        virtual bool execute() = 0;
+
+        /// The buffers for the statistics of `summarize()`, null if there are none
+        virtual const samplesCommon::BufferManager* buffers() const { return nullptr; }
+    };
+    struct tensorrt_slot;
+
+    /// Creates a slot, returns null if that fails. Must not refer to the model, which is movable.
+    using slot_factory = std::function<std::unique_ptr<execution_slot>()>;
+
+    /// A view of `data` shaped and typed like `binding`
+    cv::Mat wrap_tensor(const samplesCommon::BindingHandle& binding, void* data);
+
+    /// Copies an output out of the slot buffers, FP16 and BF16 outputs are converted to `CV_32F`
+    static cv::Mat detach_output(const cv::Mat& output);
+
+    /**
+     * Creates a new execution context with its buffers for `engine`, or returns null if that
+     * fails.
+     */
+    static std::unique_ptr<execution_slot>
+    create_slot(std::shared_ptr<nvinfer1::ICudaEngine> engine, int batch_size,
+                const samplesCommon::GrowthPolicy& growth);
+
+    /**
+     * (Re-)creates the pool of execution contexts and resolves the bindings of the network inputs
+     * and outputs, called whenever the engine changes. Without a parsed network (e.g. after
+     * `load_engine()` on a fresh model), the bindings are taken from the engine in binding order.
+     */
+    void reset_execution();
+
+    /**
+     * Same as above with the given bindings and slots, e.g. slots that do not run on a GPU. An
+     * empty `factory` leaves the model without execution.
+     */
+    void reset_execution(std::vector<samplesCommon::BindingHandle> inputs,
+                         std::vector<samplesCommon::BindingHandle> outputs, slot_factory factory);
+
+    /**
+     * Deserializes the engine payload of `load_engine()`, returns null if that fails. Only the
+     * verified payload of a container gets here, without its header.
+     */
+    virtual std::shared_ptr<nvinfer1::ICudaEngine> deserialize_engine(const void* data,
+                                                                       size_t      size);
+
+    /**
+     * Creates the execution slot used by `acquire_input()` and `run()` if that has not happened
+     * yet.
+     */
+    void prepare_execution();
+
+    /**
+     * Executes the network on the input host buffers of `slot` and returns a view onto its first
+     * output host buffer.
+     */
+    cv::Mat execute(execution_slot& slot);
 
 private:
-    InferUniquePtr<nvinfer1::IExecutionContext>         context_;
     eztrt::InferUniquePtr<nvinfer1::IBuilder>           builder_;
     eztrt::InferUniquePtr<nvinfer1::INetworkDefinition> network_;
     eztrt::InferUniquePtr<nvinfer1::IBuilderConfig>     config_;
     std::shared_ptr<nvinfer1::ICudaEngine>              engine_;
     InferUniquePtr<nvinfer1::IRuntime>                  runtime_;
 
-    std::unique_ptr<samplesCommon::BufferManager> buffers_;
+    slot_factory                               factory_; //!< creates the slots below
+    std::unique_ptr<slot_pool<execution_slot>> pool_;    //!< used by predict()
+    std::unique_ptr<execution_slot>            direct_;  //!< used by acquire_input() and run()
+
+    /// Bindings of `inputs()` and `outputs()`, valid for the buffers of every slot
+    std::vector<samplesCommon::BindingHandle> input_bindings_, output_bindings_;
+
+    std::unique_ptr<execution_backend> backend_; //!< replaces all of the above if set
 
     logger& logger_;
     params  params_;
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace eztrt
+{
+
+/**
+ * Element types of ONNX tensors, values of `onnx.TensorProto.DataType`.
+ */
+enum class onnx_type : int32_t
+{
+    undefined  = 0,
+    float32    = 1,
+    uint8      = 2,
+    int8       = 3,
+    uint16     = 4,
+    int16      = 5,
+    int32      = 6,
+    int64      = 7,
+    string     = 8,
+    boolean    = 9,
+    float16    = 10,
+    float64    = 11,
+    uint32     = 12,
+    uint64     = 13,
+    complex64  = 14,
+    complex128 = 15,
+    bfloat16   = 16,
+};
+
+const char* to_str(onnx_type type);
+
+/**
+ * Size of one element in bytes, 0 for types without a fixed size (strings).
+ */
+size_t element_size(onnx_type type);
+
+/**
+ * A graph input or output.
+ */
+struct onnx_tensor_info
+{
+    std::string              name;
+    onnx_type                type{onnx_type::undefined};
+    std::vector<int64_t>     shape;      //!< -1 for symbolic or unknown dimensions
+    std::vector<std::string> dim_params; //!< name of each symbolic dimension, empty otherwise
+};
+
+/**
+ * A constant tensor (usually weights) stored in the model.
+ */
+struct onnx_initializer_info
+{
+    std::string          name;
+    onnx_type            type{onnx_type::undefined};
+    std::vector<int64_t> shape;
+    uint64_t             bytes{0};        //!< Size of the data, wherever it is stored
+    bool                 external{false}; //!< The data lives in a separate file
+};
+
+/**
+ * Structure of an ONNX model, as far as it is needed to talk about its interface.
+ */
+struct onnx_model_info
+{
+    int64_t                            ir_version{0};
+    std::string                        producer;
+    std::map<std::string, int64_t>     opsets; //!< operator set version per domain, "" = ai.onnx
+    std::string                        graph_name;
+    std::vector<onnx_tensor_info>      inputs; //!< real inputs, i.e. without initializers
+    std::vector<onnx_tensor_info>      outputs;
+    size_t                             node_count{0};
+    std::map<std::string, size_t>      op_histogram; //!< number of nodes per (domain.)op_type
+    std::vector<onnx_initializer_info> initializers;
+    uint64_t                           initializer_bytes{0};
+    std::string                        error; //!< Why the model could not be read
+
+    bool valid() const { return error.empty(); }
+
+    /**
+     * Human-readable description of the model, similar to `model::summarize()`.
+     */
+    std::string summarize(bool verbose = false) const;
+};
+
+/**
+ * Reads the interface of an ONNX model directly from the protobuf wire format, without TensorRT
+ * and without building anything. The file is memory-mapped and the weight payloads are skipped,
+ * not read, so this takes milliseconds even for large models.
+ */
+onnx_model_info inspect_onnx(const std::string& file);
+
+/**
+ * Same as above for a model that is already in memory.
+ */
+onnx_model_info inspect_onnx(const void* data, size_t size);
+
+} // namespace eztrt
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace eztrt
+{
+
+/**
+ * A fixed number of lazily created objects that threads check out for exclusive use, e.g. one
+ * execution context with its buffers per concurrent inference call.
+ *
+ * Checking out a free slot is lock-free: every thread starts probing at a slot derived from its
+ * id and claims the first free one with an atomic exchange. Only if all slots are in use does the
+ * caller block until one is returned.
+ *
+ * The object of a slot is created by `factory` on its first checkout, by the thread that holds
+ * the slot. Calls of the factory are serialized, as the objects usually share a parent that is not
+ * safe to use from several threads at once (e.g. the engine of the execution contexts). If the
+ * factory returns null, the lease is empty and creation is retried on the next checkout of that
+ * slot.
+ */
+template<typename T>
+class slot_pool
+{
+    struct entry
+    {
+        std::atomic<bool>  busy{false};
+        std::unique_ptr<T> object;
+    };
+
+public:
+    using factory_type = std::function<std::unique_ptr<T>()>;
+
+    struct stats
+    {
+        uint64_t checkouts{0}; //!< Number of successful checkouts
+        uint64_t waits{0};     //!< Number of checkouts that had to wait for a free slot
+    };
+
+    /**
+     * Exclusive access to one slot, returns it to the pool when destroyed.
+     */
+    class lease
+    {
+    public:
+        lease() = default;
+        lease(slot_pool* pool, size_t index) : pool_{pool}, index_{index} {}
+        lease(lease&& rhs) noexcept : pool_{rhs.pool_}, index_{rhs.index_} { rhs.pool_ = nullptr; }
+        lease& operator=(lease&& rhs) noexcept
+        {
+            if (this != &rhs)
+            {
+                release();
+                pool_     = rhs.pool_;
+                index_    = rhs.index_;
+                rhs.pool_ = nullptr;
+            }
+            return *this;
+        }
+        lease(const lease&) = delete;
+        lease& operator=(const lease&) = delete;
+        ~lease() { release(); }
+
+        T*   get() const { return pool_ ? pool_->slots_[index_].object.get() : nullptr; }
+        T&   operator*() const { return *get(); }
+        T*   operator->() const { return get(); }
+        explicit operator bool() const { return get() != nullptr; }
+        size_t index() const { return index_; }
+
+        /// Returns the slot to the pool before the lease goes out of scope
+        void release()
+        {
+            if (pool_) pool_->release(index_);
+            pool_ = nullptr;
+        }
+
+    private:
+        slot_pool* pool_{nullptr};
+        size_t     index_{0};
+    };
+
+    slot_pool(size_t size, factory_type factory)
+        : size_{size ? size : 1}, slots_{new entry[size_]}, factory_{std::move(factory)}
+    {
+    }
+
+    // Non-copyable, non-movable: leases point back to the pool
+    slot_pool(const slot_pool& rhs) = delete;
+    slot_pool& operator=(const slot_pool& rhs) = delete;
+
+    /**
+     * Claims a free slot, blocking while all of them are checked out. Thread-safe.
+     */
+    lease checkout()
+    {
+        size_t index;
+        if (!try_claim(index))
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_.fetch_add(1);
+            waits_.fetch_add(1, std::memory_order_relaxed);
+            // release() takes the mutex before notifying whenever it sees a waiter, so a slot
+            // returned after the failed claim below cannot be missed
+            while (!try_claim(index))
+                returned_.wait(lock);
+            waiting_.fetch_sub(1);
+        }
+        checkouts_.fetch_add(1, std::memory_order_relaxed);
+
+        auto& slot = slots_[index];
+        if (!slot.object)
+        {
+            std::lock_guard<std::mutex> lock(factory_mutex_);
+            slot.object = factory_();
+        }
+        return lease(this, index);
+    }
+
+    size_t size() const { return size_; }
+
+    /// Number of slots currently checked out
+    size_t in_use() const
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < size_; ++i)
+            n += slots_[i].busy.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    /**
+     * Calls `fn(T&)` with the object of every slot that is not checked out (and has been created),
+     * e.g. to collect statistics. Each slot is claimed while `fn` runs, busy slots are skipped.
+     * Returns the number of skipped slots.
+     */
+    template<typename Fn>
+    size_t for_each_idle(Fn fn)
+    {
+        size_t skipped = 0;
+        for (size_t i = 0; i < size_; ++i)
+        {
+            if (slots_[i].busy.exchange(true))
+            {
+                ++skipped;
+                continue;
+            }
+            if (slots_[i].object) fn(*slots_[i].object);
+            release(i);
+        }
+        return skipped;
+    }
+
+    stats statistics() const
+    {
+        return {checkouts_.load(std::memory_order_relaxed), waits_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    bool try_claim(size_t& index)
+    {
+        // spread the threads over the slots so they do not all contend for the first one
+        const size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % size_;
+        for (size_t i = 0; i < size_; ++i)
+        {
+            auto& slot = slots_[(start + i) % size_];
+            if (!slot.busy.load(std::memory_order_relaxed) && !slot.busy.exchange(true))
+            {
+                index = (start + i) % size_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release(size_t index)
+    {
+        slots_[index].busy.store(false);
+        if (waiting_.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            returned_.notify_one();
+        }
+    }
+
+    const size_t             size_;
+    std::unique_ptr<entry[]> slots_;
+    factory_type             factory_;
+    std::mutex               factory_mutex_; //!< serializes the calls of `factory_`
+
+    std::mutex              mutex_;
+    std::condition_variable returned_;
+    std::atomic<int>        waiting_{0};
+    std::atomic<uint64_t>   checkouts_{0};
+    std::atomic<uint64_t>   waits_{0};
+};
+
+} // namespace eztrt
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+namespace eztrt
+{
+
+/**
+ * Bounded single-producer/single-consumer queue on a lock-free ring buffer, e.g. to connect the
+ * stages of a pipeline that each run on their own thread.
+ *
+ * `try_push()` and `try_pop()` never block. `push()` and `pop()` wait while the queue is full or
+ * empty (spinning briefly, then yielding, then sleeping) and return false once the queue is
+ * closed; `pop()` still drains the remaining elements of a closed queue first. Either side may
+ * call `close()`, so a consumer that stops early also releases a producer waiting in `push()`.
+ *
+ * Exactly one thread may push and one thread may pop at a time.
+ */
+template<typename T>
+class spsc_queue
+{
+public:
+    /// The capacity is rounded up to the next power of two
+    explicit spsc_queue(size_t capacity)
+    {
+        while (capacity_ < capacity)
+            capacity_ *= 2;
+        slots_.reset(new T[capacity_]);
+    }
+
+    // Non-copyable, non-movable: shared between two threads
+    spsc_queue(const spsc_queue& rhs) = delete;
+    spsc_queue& operator=(const spsc_queue& rhs) = delete;
+
+    /// Moves `value` into the queue if it is not full, leaves it untouched otherwise
+    bool try_push(T&& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == capacity_)
+        {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == capacity_) return false;
+        }
+        slots_[tail & (capacity_ - 1)] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_)
+        {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) return false;
+        }
+        // the slot is reset so that it does not keep resources (e.g. image data) alive
+        T& slot = slots_[head & (capacity_ - 1)];
+        value   = std::move(slot);
+        slot    = T{};
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Waits for a free slot, returns false without moving `value` if the queue is closed
+    bool push(T&& value)
+    {
+        for (backoff wait; !closed(); wait())
+            if (try_push(std::move(value))) return true;
+        return false;
+    }
+
+    /// Waits for an element, returns false once the queue is closed and empty
+    bool pop(T& value)
+    {
+        for (backoff wait;; wait())
+        {
+            if (try_pop(value)) return true;
+            // an element pushed right before closing must not be lost
+            if (closed()) return try_pop(value);
+        }
+    }
+
+    void close() { closed_.store(true, std::memory_order_release); }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    size_t capacity() const { return capacity_; }
+
+    /// Number of queued elements, only a snapshot if the other side is active
+    size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+private:
+    /// Spins for short waits, but does not burn a core while a stage waits for a slow neighbour
+    struct backoff
+    {
+        int round{0};
+        void operator()()
+        {
+            if (++round < 64) return;
+            if (round < 256)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    };
+
+    size_t               capacity_{1};
+    std::unique_ptr<T[]> slots_;
+
+    // producer and consumer indices on separate cache lines, each with a cached copy of the other
+    alignas(64) std::atomic<size_t> tail_{0};
+    size_t head_cache_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t tail_cache_{0};
+    alignas(64) std::atomic<bool> closed_{false};
+};
+
+} // namespace eztrt
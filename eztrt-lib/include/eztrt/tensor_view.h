@@ -0,0 +1,353 @@
+#pragma once
+
+#include "eztrt/bfloat16.h"
+#include "eztrt/half.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace eztrt
+{
+
+/// Element types of a `tensor_view`: the TensorRT types plus 8-bit unsigned images
+enum class dtype
+{
+    float32,
+    float16,
+    bfloat16,
+    int32,
+    int8,
+    uint8,
+    boolean,
+};
+
+constexpr const char* to_str(dtype t)
+{
+    switch (t)
+    {
+    case dtype::float32: return "float32";
+    case dtype::float16: return "float16";
+    case dtype::bfloat16: return "bfloat16";
+    case dtype::int32: return "int32";
+    case dtype::int8: return "int8";
+    case dtype::uint8: return "uint8";
+    case dtype::boolean: return "bool";
+    default: return "unknown";
+    }
+}
+
+/// OpenCV depth of the elements, bfloat16 has none and is stored as its bits (`CV_16U`)
+constexpr int cv_depth(dtype t)
+{
+    switch (t)
+    {
+    case dtype::float16: return CV_16F;
+    case dtype::bfloat16: return CV_16U;
+    case dtype::int32: return CV_32S;
+    case dtype::int8: return CV_8S;
+    case dtype::uint8:
+    case dtype::boolean: return CV_8U;
+    case dtype::float32:
+    default: return CV_32F;
+    }
+}
+
+template<typename T>
+struct dtype_of;
+template<>
+struct dtype_of<float>
+{
+    static constexpr dtype value = dtype::float32;
+};
+template<>
+struct dtype_of<half_float::half>
+{
+    static constexpr dtype value = dtype::float16;
+};
+template<>
+struct dtype_of<bfloat16>
+{
+    static constexpr dtype value = dtype::bfloat16;
+};
+template<>
+struct dtype_of<int32_t>
+{
+    static constexpr dtype value = dtype::int32;
+};
+template<>
+struct dtype_of<int8_t>
+{
+    static constexpr dtype value = dtype::int8;
+};
+template<>
+struct dtype_of<uint8_t>
+{
+    static constexpr dtype value = dtype::uint8;
+};
+template<>
+struct dtype_of<bool>
+{
+    static constexpr dtype value = dtype::boolean;
+};
+
+/// Same limit as `nvinfer1::Dims`
+constexpr int kMaxTensorDims = 8;
+
+/**
+ * Copies the strided tensor at `src` (shape and strides counted in elements of `elem_size` bytes,
+ * strides may be 0 for broadcast dimensions) into the row-major buffer `dst`.
+ *
+ * The layout is simplified first: size-1 dimensions are dropped and dimensions that are
+ * contiguous in the source are merged. What remains is copied in contiguous runs, or as a 2D
+ * transpose in cache-sized tiles (with SIMD kernels for 4-byte elements) where the innermost
+ * source dimension moves outwards, e.g. NHWC -> NCHW. Large tensors are copied in parallel.
+ */
+void copy_strided(const void* src, int dims, const int64_t* shape, const int64_t* strides,
+                  size_t elem_size, void* dst);
+
+/**
+ * Rearranges the dense buffer at `data` in place so that it becomes the row-major copy of the
+ * strided tensor described by `shape` and `strides`, which has to be a permutation of that buffer
+ * (e.g. a `tensor_view::permute()` of a contiguous view). Follows the cycles of the permutation,
+ * so it needs one bit of scratch memory per element but is slower than `copy_strided`.
+ */
+void permute_in_place(void* data, int dims, const int64_t* shape, const int64_t* strides,
+                      size_t elem_size);
+
+/**
+ * Non-owning view onto a tensor of `T` with up to `kMaxTensorDims` dimensions and arbitrary
+ * (non-negative) strides, counted in elements.
+ *
+ * `permute`, `slice`, `select` and `broadcast_to` only change the shape and strides, no data is
+ * moved until the view is materialized with `copy_to` or `to_mat`. Use `as_tensor_view` and
+ * `host_tensor_view` (host_tensor_view.h) to look at the data of a cv::Mat or a BufferManager
+ * host buffer without a copy. The viewed memory has to outlive the view.
+ */
+template<typename T>
+class tensor_view
+{
+public:
+    using value_type = std::remove_const_t<T>;
+
+    static constexpr eztrt::dtype type() { return dtype_of<value_type>::value; }
+
+    tensor_view() = default;
+
+    /// Row-major view of the given shape
+    tensor_view(T* data, std::initializer_list<int64_t> shape)
+        : tensor_view(data, int(shape.size()), shape.begin())
+    {
+    }
+
+    /// View of the given shape and strides, row-major if `strides` is null
+    tensor_view(T* data, int dims, const int64_t* shape, const int64_t* strides = nullptr)
+        : data_{data}, dims_{dims}
+    {
+        assert(dims >= 0 && dims <= kMaxTensorDims && "too many dimensions for a tensor_view");
+        int64_t step = 1;
+        for (int d = dims - 1; d >= 0; --d)
+        {
+            shape_[d]   = shape[d];
+            strides_[d] = strides ? strides[d] : step;
+            step *= shape[d];
+        }
+    }
+
+    /// Views of mutable elements convert to views of const elements
+    template<typename U, typename = std::enable_if_t<std::is_same<const U, T>::value>>
+    tensor_view(const tensor_view<U>& other)
+        : tensor_view(other.data(), other.dims(), other.shape(), other.strides())
+    {
+    }
+
+    T*             data() const { return data_; }
+    int            dims() const { return dims_; }
+    int64_t        size(int d) const { return shape_[d]; }
+    int64_t        stride(int d) const { return strides_[d]; }
+    const int64_t* shape() const { return shape_.data(); }
+    const int64_t* strides() const { return strides_.data(); }
+
+    size_t total() const
+    {
+        size_t n = 1;
+        for (int d = 0; d < dims_; ++d)
+            n *= size_t(shape_[d]);
+        return n;
+    }
+
+    bool empty() const { return !data_ || total() == 0; }
+
+    /// True if the elements are densely packed in row-major order, size-1 dimensions are ignored
+    bool is_contiguous() const
+    {
+        int64_t step = 1;
+        for (int d = dims_ - 1; d >= 0; --d)
+        {
+            if (shape_[d] == 1) continue;
+            if (strides_[d] != step) return false;
+            step *= shape_[d];
+        }
+        return true;
+    }
+
+    template<typename... Index>
+    T& operator()(Index... index) const
+    {
+        static_assert(sizeof...(Index) <= kMaxTensorDims, "too many indices");
+        assert(int(sizeof...(Index)) == dims_ && "one index per dimension expected");
+        const int64_t idx[sizeof...(Index) + 1] = {int64_t(index)...};
+        int64_t       offset                    = 0;
+        for (int d = 0; d < dims_; ++d)
+            offset += idx[d] * strides_[d];
+        return data_[offset];
+    }
+
+    /// Dimension `i` of the result is dimension `order[i]` of this view
+    tensor_view permute(const std::vector<int>& order) const
+    {
+        assert(int(order.size()) == dims_ && "permute needs one entry per dimension");
+        tensor_view res = *this;
+        for (int i = 0; i < dims_; ++i)
+        {
+            assert(order[i] >= 0 && order[i] < dims_ && "permute: dimension out of range");
+            res.shape_[i]   = shape_[order[i]];
+            res.strides_[i] = strides_[order[i]];
+        }
+        return res;
+    }
+
+    /// Elements `begin`, `begin + step`, ... before `end` of dimension `dim`
+    tensor_view slice(int dim, int64_t begin, int64_t end, int64_t step = 1) const
+    {
+        assert(dim >= 0 && dim < dims_ && step > 0 && 0 <= begin && begin <= end &&
+               end <= shape_[dim] && "slice out of range");
+        tensor_view res = *this;
+        res.data_ += begin * strides_[dim];
+        res.shape_[dim]   = (end - begin + step - 1) / step;
+        res.strides_[dim] = strides_[dim] * step;
+        return res;
+    }
+
+    /// The sub-tensor at `index` of dimension `dim`, which is removed
+    tensor_view select(int dim, int64_t index) const
+    {
+        assert(dim >= 0 && dim < dims_ && index >= 0 && index < shape_[dim] &&
+               "select out of range");
+        tensor_view res = *this;
+        res.data_ += index * strides_[dim];
+        for (int d = dim; d + 1 < dims_; ++d)
+        {
+            res.shape_[d]   = shape_[d + 1];
+            res.strides_[d] = strides_[d + 1];
+        }
+        --res.dims_;
+        return res;
+    }
+
+    /**
+     * Expands the view to `shape` by repeating size-1 dimensions (stride 0), leading dimensions
+     * are added as needed, like numpy's broadcasting rules.
+     */
+    tensor_view broadcast_to(const std::vector<int64_t>& shape) const
+    {
+        const int dims = int(shape.size());
+        assert(dims >= dims_ && dims <= kMaxTensorDims && "cannot broadcast to fewer dimensions");
+        tensor_view res;
+        res.data_ = data_;
+        res.dims_ = dims;
+        for (int d = 0; d < dims; ++d)
+        {
+            const int own = d - (dims - dims_);
+            assert((own < 0 || shape_[own] == shape[d] || shape_[own] == 1) &&
+                   "broadcast dimensions have to be equal or 1");
+            res.shape_[d]   = shape[d];
+            res.strides_[d] = own >= 0 && shape_[own] == shape[d] ? strides_[own] : 0;
+        }
+        return res;
+    }
+
+    /// Same elements in a new row-major shape, only for contiguous views
+    tensor_view reshape(const std::vector<int64_t>& shape) const
+    {
+        assert(is_contiguous() && "reshape needs a contiguous view, use copy_to first");
+        tensor_view res(data_, int(shape.size()), shape.data());
+        assert(res.total() == total() && "reshape must keep the number of elements");
+        return res;
+    }
+
+    /// Materializes the view into the contiguous `dst` of the same number of elements
+    void copy_to(const tensor_view<value_type>& dst) const
+    {
+        assert(dst.is_contiguous() && dst.total() == total() &&
+               "copy_to needs a contiguous destination of the same size");
+        copy_strided(data_, dims_, shape(), strides(), sizeof(T), dst.data());
+    }
+
+    /**
+     * The view as a cv::Mat of the same shape (a single-dimensional view becomes a column).
+     * Contiguous views are wrapped without a copy, so the Mat does not own its data; all others
+     * are copied into a newly allocated Mat.
+     */
+    cv::Mat to_mat() const
+    {
+        int sizes[kMaxTensorDims] = {int(total()), 1};
+        for (int d = 0; d < dims_; ++d)
+            sizes[d] = int(shape_[d]);
+        const int mat_dims = std::max(dims_, 2);
+        const int mat_type = CV_MAKETYPE(cv_depth(type()), 1);
+        if (is_contiguous())
+            return cv::Mat(mat_dims, sizes, mat_type, const_cast<value_type*>(data_));
+
+        cv::Mat res(mat_dims, sizes, mat_type);
+        copy_to(tensor_view<value_type>(res.ptr<value_type>(), dims_, shape()));
+        return res;
+    }
+
+private:
+    T*                                  data_{nullptr};
+    int                                 dims_{0};
+    std::array<int64_t, kMaxTensorDims> shape_{};
+    std::array<int64_t, kMaxTensorDims> strides_{};
+};
+
+/**
+ * Views the data of `m` without a copy. The channels of a multi-channel Mat become the innermost
+ * dimension, like `reshape_channels`; ROIs and other non-continuous Mats keep their steps.
+ * Returns an empty view if the depth of `m` does not match `T` or a step is not a whole number of
+ * elements.
+ */
+template<typename T>
+tensor_view<T> as_tensor_view(const cv::Mat& m)
+{
+    using value_type = std::remove_const_t<T>;
+    if (m.empty() || m.depth() != cv_depth(dtype_of<value_type>::value) ||
+        m.dims + (m.channels() > 1) > kMaxTensorDims)
+        return {};
+
+    int64_t shape[kMaxTensorDims], strides[kMaxTensorDims];
+    for (int d = 0; d < m.dims; ++d)
+    {
+        // e.g. a Mat around external data whose step in bytes splits an element
+        if (m.step[d] % sizeof(value_type) != 0) return {};
+        shape[d]   = m.size[d];
+        strides[d] = int64_t(m.step[d] / sizeof(value_type));
+    }
+    int dims = m.dims;
+    if (m.channels() > 1)
+    {
+        shape[dims]   = m.channels();
+        strides[dims] = 1;
+        ++dims;
+    }
+    return tensor_view<T>(reinterpret_cast<T*>(m.data), dims, shape, strides);
+}
+
+} // namespace eztrt
@@ -3,19 +3,92 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/opencv.hpp>
 
+#include <limits>
+#include <string>
+#include <vector>
+
 namespace eztrt
 {
 class model;
+struct onnx_model_info;
 
 /**
- * Computes the softmax function for the specified input along the specified dimension.
+ * Computes the softmax function for the specified input along the specified dimension (negative
+ * values count from the back). The logits are divided by `temperature` first; values above 1
+ * flatten the distribution, values below 1 sharpen it.
+ *
+ * The maximum along `dim` is subtracted before exponentiating, so large logits do not overflow.
+ * Non-float inputs are converted to float. Returns an empty matrix for multi-channel inputs or an
+ * invalid dimension.
  */
-cv::Mat softmax(cv::Mat in, int dim = 1);
+cv::Mat softmax(cv::Mat in, int dim = 1, float temperature = 1.f);
 
 /**
- * Applies a set of preprocessing operations that can be flexibly defined through the content of the
- * `step_list` parameter.
+ * log(softmax(in, dim, temperature)), computed without taking the logarithm of small
+ * probabilities, i.e. without losing precision for unlikely classes.
+ */
+cv::Mat log_softmax(cv::Mat in, int dim = 1, float temperature = 1.f);
+
+/**
+ * A preprocessing step string, compiled once so that it can be applied to many frames.
+ *
+ * The string is a sequence of the following steps, applied left to right:
+ *  - 'v': vertical flip
+ *  - 'h': horizontal flip
+ *  - 'r': rotate 90 degrees counter-clockwise
+ *  - 't': transpose
+ *  - 'I': invert intensities $y = 1 - x$ (on all channels)
+ *  - 'C': convert grayscale to BGR
+ *  - 'G': convert BGR to grayscale
  *
+ * Any sequence of geometric steps is one of the eight symmetries of the rectangle, so all of them
+ * collapse into a single index remap. The per-pixel steps ('I', 'C', 'G') are fused into the same
+ * pass, i.e. `apply()` reads every input pixel exactly once and writes one output image,
+ * independent of the length of the step string. Unknown characters are ignored.
+ *
+ * On integer images every per-pixel step rounds and saturates its result to the element type, like
+ * applying the steps one by one does. 'I' therefore yields `saturate(1 - x)`, i.e. 1 for 0 and 0
+ * for all other values of an unsigned image, and "II" is not the identity. On floating point
+ * images the steps are computed without intermediate rounding and pairs of 'I' cancel out.
+ * `CV_32S` and `CV_64F` images are computed in double precision, all other depths in float.
+ */
+class preprocess_plan
+{
+public:
+    explicit preprocess_plan(const std::string& step_list = {});
+
+    /**
+     * Applies the plan to `in`. The input is never modified. Returns an empty matrix if a color
+     * conversion does not fit the number of channels of the input.
+     */
+    cv::Mat apply(cv::Mat in) const;
+
+    /// Size of the output image for an input of size `in`
+    cv::Size output_size(cv::Size in) const;
+
+    /// True if `apply()` would just return a copy of any input
+    bool is_identity() const
+    {
+        return !swap_axes_ && !flip_rows_ && !flip_cols_ && pixel_ops_.empty();
+    }
+
+private:
+    /// Composes the current mapping with one more geometric step
+    void append_geometric(bool swap_axes, bool flip_rows, bool flip_cols);
+
+    // output pixel (r, c) reads input pixel (swap ? c : r, swap ? r : c), with the row and/or
+    // column coordinate mirrored afterwards
+    bool        swap_axes_{false};
+    bool        flip_rows_{false};
+    bool        flip_cols_{false};
+    std::string pixel_ops_;       //!< per-pixel steps ('I', 'C', 'G') in order
+    std::string float_pixel_ops_; //!< same without the pairs of 'I', for floating point images
+};
+
+/**
+ * Applies a set of preprocessing operations that can be flexibly defined through the content of the
+ * `step_list` parameter. See `preprocess_plan` for the supported steps; when processing a stream of
+ * frames, construct the plan once and call `preprocess_plan::apply` instead.
  */
 cv::Mat apply_preprocess_steps(cv::Mat in, std::string step_list);
 
@@ -45,6 +118,17 @@ void save_all_channels(cv::Mat result, std::string file_base);
  */
 std::vector<cv::Mat> separate_channels(cv::Mat result);
 
+/**
+ * Per-pixel argmax over the channels of a $[1,C,H,W]$- or $[C,H,W]$-shaped segmentation output,
+ * computed in one sweep without materializing a softmax or the separate channels.
+ *
+ * Returns an $H \times W$ label image, `CV_8U` for up to 256 channels and `CV_16U` otherwise (at
+ * most 65536), or an empty Mat for unsupported inputs. Ties resolve to the lowest channel index,
+ * NaNs never win. If `confidence` is given, it receives the `CV_32F` softmax probability of the
+ * winning channel, i.e. `result` is treated as logits.
+ */
+cv::Mat argmax_channels(cv::Mat result, cv::Mat* confidence = nullptr);
+
 /**
  * Reshapes a Mat to make the channels an explicit dimension. I.e. a
  * 3-channel image of (128,64) size will result in a (128,64,3) 1-channel image.
@@ -52,17 +136,60 @@ std::vector<cv::Mat> separate_channels(cv::Mat result);
 cv::Mat reshape_channels(cv::Mat m);
 
 /**
- * Reorders the dimensions in-place and returns a new cv::Mat header with the appropriate shape.
- * This is equivalent to for example pytorch's tensor.permute, and actually copies data **in
- * place**. The returned `cv::Mat` is merely a new matrix header to the same data as `m`, but
- * permuted. For example, to permute an input `m` from $H,W,C$ order to channel separated order
- * $[C,W,H]$, use `auto permuted = permute_dims(m, {2,0,1});`.
+ * Reorders the dimensions of `m`, equivalent to for example pytorch's `tensor.permute` followed by
+ * `.contiguous()`. Output dimension `i` is input dimension `new_order[i]`; to permute an input `m`
+ * from $[H,W,C]$ order to channel separated order $[C,H,W]$, use
+ * `auto permuted = permute_dims(m, {2,0,1});`.
+ *
+ * Works for any element type, multi-channel elements are moved as a whole. This is
+ * `tensor_view::permute` followed by `copy_to` (see `copy_strided`), so non-continuous inputs
+ * such as ROIs are read through their steps without an intermediate clone. To chain further
+ * slicing or permutations before the data is moved, use `as_tensor_view` directly.
  *
- * \param m			The input matrix to permute
+ * \param m			The input matrix to permute, it is left untouched
  * \param new_order The new order of dimensions
- * \return			A new matrix header to the permuted data of `m`
+ * \param dst		Optional continuous destination with room for `m.total()` elements of `m.type()`
+ *                  that does not overlap `m`. If empty, a new matrix is allocated.
+ * \return			The permuted matrix, or an empty matrix if `new_order` is not a permutation of
+ *                  the dimensions of `m` or `dst` does not fit
  */
-cv::Mat permute_dims(cv::Mat m, std::vector<int> new_order);
+cv::Mat permute_dims(cv::Mat m, const std::vector<int>& new_order, cv::Mat dst = {});
+
+/**
+ * Same as `permute_dims`, but permutes the data of `m` in place by following the cycles of the
+ * permutation, for when the original is not needed anymore and a second buffer does not fit. Needs
+ * one bit of scratch memory per element and is slower than `permute_dims` on large tensors, since
+ * the cycles access memory in a scattered order.
+ *
+ * \return A new header onto the (now permuted) data of `m`, or an empty matrix if `m` is not
+ *         continuous or `new_order` is not a permutation of its dimensions
+ */
+cv::Mat permute_dims_in_place(cv::Mat m, const std::vector<int>& new_order);
+
+/**
+ * Converts an interleaved 2D image of shape $[H,W,C_{in}]$ into a planar tensor of shape $[C,H,W]$
+ * in a single pass. Every element is read once, scaled as `v * mul + add`, saturated to `depth`
+ * and written to its channel plane, so no intermediate full-frame copies are created.
+ *
+ * Channel counts are adapted on the fly where the conversion is unambiguous:
+ *  - $C_{in} = C$: plain de-interleaving
+ *  - $C_{in} = 1$, $C \in \{3,4\}$: the gray value is broadcast (alpha is set to the input's
+ *    maximum value, like `cv::COLOR_GRAY2BGRA`)
+ *  - $C_{in} \in \{3,4\}$, $C = 1$: BGR is reduced to luminance with the `cv::COLOR_BGR2GRAY`
+ *    weights
+ *
+ * \param in		The interleaved input image (8U, 8S, 16U, 16S, 32S or 32F elements)
+ * \param depth		Output element depth, one of CV_32F, CV_32S or CV_8S
+ * \param channels	Number of output channels $C$
+ * \param mul		Scale applied to each input value
+ * \param add		Offset applied to each input value after scaling
+ * \param dst		Optional destination with room for exactly $C \cdot H \cdot W$ continuous elements
+ *                  of `depth`. If empty, a new $[C,H,W]$ matrix is allocated.
+ * \return			A $[C,H,W]$ header onto the written data, or an empty matrix if the conversion is
+ *                  not supported or `dst` does not match
+ */
+cv::Mat convert_to_planar(cv::Mat in, int depth, int channels, double mul = 1.0, double add = 0.0,
+                          cv::Mat dst = {});
 
 /**
  * Attempts to automatically adjust the shape of the given input to what the model expects.
@@ -72,6 +199,7 @@ cv::Mat permute_dims(cv::Mat m, std::vector<int> new_order);
  * Tries to guess what to do based on some heuristics:
  *  - tries to adapt the element type according to the expected input:
  *	   FLOAT: Values are REMAPPED to [-1,1] for a signed input and [0,1] for an unsigned input
+ *     HALF: Same as FLOAT, rounded to half precision in a final bulk pass
  *     INT8: Values are REMAPPED from integer formats. Floating point remaps [-1,1] to [-127,127]
  *     INT32: Values are CONVERTED from integer and floating point formats
  *  - If H,W do not match the rows and cols of the input, use `cv::resize` to resample the input
@@ -81,10 +209,37 @@ cv::Mat permute_dims(cv::Mat m, std::vector<int> new_order);
  * transforms from the standard OpenCV layout of [H,W,C] (interleaved channels) to [C,H,W]
  * (separated channels)
  *
+ * Type conversion, channel adaption and the layout change are fused into a single pass through
+ * `convert_to_planar`; only the resize (if needed) creates an intermediate image.
+ *
+ * If `dst` is given, the result is written there instead of into a newly allocated matrix. Pass
+ * `m.acquire_input(input_index)` to write directly into the model's input buffer. Inputs of
+ * type bfloat16 are written as their bits (`CV_16U`), see `convert_f32_to_bf16`.
+ *
+ * Only available with the TensorRT backend (`EZTRT_WITH_TENSORRT`), builds without it use the
+ * `onnx_model_info` overload below.
+ *
  * \return a `cv::Mat` that should have a shape that can be passed directly to `m.predict()`. If
  * this method was not successful, will return an emtpy matrix.
  */
-cv::Mat try_adjust_input(cv::Mat input, int input_index, model& m);
+#ifdef EZTRT_WITH_TENSORRT
+cv::Mat try_adjust_input(cv::Mat input, int input_index, model& m, cv::Mat dst = {});
+#endif
+
+/**
+ * Same as above, but takes the input description from an `inspect_onnx()` result, so the input
+ * can be prepared before any engine exists. Symbolic dimensions are taken from `input`, a symbolic
+ * batch dimension is 1.
+ */
+cv::Mat try_adjust_input(cv::Mat input, int input_index, const onnx_model_info& info,
+                         cv::Mat dst = {});
+
+/**
+ * Same as above for an explicit input tensor `shape` $[N,C,H,W]$ and element type `depth`
+ * (`CV_32F`, `CV_16F`, `CV_32S` or `CV_8S`).
+ */
+cv::Mat try_adjust_input(cv::Mat input, const std::vector<int>& shape, int depth,
+                         cv::Mat dst = {});
 
 /**
  * Helper function to iterate over all channels in a channel-separated image.
@@ -112,6 +267,39 @@ void for_each_channel(cv::Mat result, Functor appliedFunction)
     }
 }
 
-std::unordered_map<size_t, std::string> load_class_labels(const std::string& filename);
+/**
+ * Loads class labels from a JSON object mapping class indices to names, e.g. the ImageNet
+ * `{"0": "tench", ...}` files. The result is indexed by class, indices missing from the file have
+ * an empty label. Returns an empty vector if the file cannot be read or is not a JSON object.
+ *
+ * Entries whose key is not a non-negative decimal index below `kMaxLabelSparseness` times the
+ * number of entries, or whose value is not a string, are skipped with an error log.
+ */
+std::vector<std::string> load_class_labels(const std::string& filename);
+
+/// Bound of the class indices accepted by `load_class_labels()`, relative to the number of entries
+constexpr size_t kMaxLabelSparseness = 4;
+
+/**
+ * One entry of a `top_k()` result.
+ */
+struct class_score
+{
+    int         index; //!< flat index into the scores
+    float       score;
+    std::string label; //!< empty if no label is known for `index`
+};
+
+/**
+ * Returns the (at most) `k` highest scores of `scores` that are above `threshold`, sorted by
+ * descending score, with ties ordered by index. `scores` can have any shape and is treated as a
+ * flat vector, e.g. the output of `softmax()` for a classifier. NaNs are never returned.
+ *
+ * Only the candidates above the threshold are ranked (partially, with `std::nth_element`), so a
+ * few top classes out of tens of thousands cost little more than a single pass over the scores.
+ */
+std::vector<class_score> top_k(cv::Mat scores, int k,
+                               float threshold = -std::numeric_limits<float>::infinity(),
+                               const std::vector<std::string>& labels = {});
 
 } // namespace eztrt
@@ -0,0 +1,217 @@
+#include "eztrt/batching.h"
+#include "eztrt/convert.h"
+#ifdef EZTRT_WITH_TENSORRT
+#include "eztrt/model.h"
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace eztrt
+{
+
+namespace
+{
+/// Header onto item `i` of the $[N,...]$ tensor `batch`, shaped $[1,...]$
+cv::Mat batch_item(const cv::Mat& batch, int i)
+{
+    std::vector<cv::Range> ranges(batch.dims, cv::Range::all());
+    ranges[0] = cv::Range(i, i + 1);
+    return batch(ranges);
+}
+
+/// The input buffer of `be`, or an empty matrix if the backend throws
+cv::Mat acquire_input(const batching_executor::backend& be)
+{
+    try
+    {
+        return be.acquire_input();
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error("Batching backend failed to provide its input buffer: {}", e.what());
+        return {};
+    }
+}
+} // namespace
+
+batching_executor::batching_executor(backend be) : batching_executor(std::move(be), options{}) {}
+
+batching_executor::batching_executor(backend be, options opts)
+    : backend_{std::move(be)}, options_{opts}
+{
+    thread_ = std::thread([this] { worker(); });
+}
+
+#ifdef EZTRT_WITH_TENSORRT
+batching_executor::batching_executor(model& m) : batching_executor(m, options{}) {}
+
+batching_executor::batching_executor(model& m, options opts)
+    : batching_executor(backend{[&m] { return m.acquire_input(0); }, [&m](int) { return m.run(); }},
+                        opts)
+{
+}
+#endif
+
+batching_executor::~batching_executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_all();
+    thread_.join();
+}
+
+std::future<cv::Mat> batching_executor::submit(cv::Mat sample)
+{
+    request req;
+    req.sample   = sample;
+    req.enqueued = clock::now();
+    auto result  = req.result.get_future();
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_)
+        {
+            req.result.set_value({});
+            return result;
+        }
+        queue_.push_back(std::move(req));
+        // the worker only needs to wake up early for the first request and a full batch
+        notify = queue_.size() == 1 || int(queue_.size()) >= stats_.max_batch;
+    }
+    if (notify) wakeup_.notify_one();
+    return result;
+}
+
+batching_executor::stats batching_executor::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void batching_executor::worker()
+{
+    // the capacity of the backend limits the batch size
+    const int capacity  = std::max(acquire_input(backend_).size[0], 1);
+    const int max_batch = std::max(1, std::min(options_.max_batch, capacity));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.max_batch = max_batch;
+    }
+
+    std::deque<request> batch;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return; // stopped and drained
+
+            // wait for the batch to fill up, but not longer than the oldest request may wait
+            const auto deadline =
+                queue_.front().enqueued + std::chrono::microseconds(options_.max_wait_us);
+            wakeup_.wait_until(lock, deadline, [&] {
+                return stop_ || int(queue_.size()) >= max_batch;
+            });
+
+            const auto n = std::min<size_t>(queue_.size(), max_batch);
+            std::move(queue_.begin(), queue_.begin() + n, std::back_inserter(batch));
+            queue_.erase(queue_.begin(), queue_.begin() + n);
+
+            const auto now = clock::now();
+            for (const auto& req : batch)
+            {
+                const double delay =
+                    std::chrono::duration<double, std::micro>(now - req.enqueued).count();
+                stats_.total_queue_us += delay;
+                stats_.max_queue_us = std::max(stats_.max_queue_us, delay);
+            }
+            stats_.samples += batch.size();
+            stats_.batches++;
+        }
+
+        execute(batch);
+        batch.clear();
+    }
+}
+
+void batching_executor::execute(std::deque<request>& batch)
+{
+    // pack the samples into the input buffer of the backend
+    cv::Mat input = acquire_input(backend_);
+    if (input.empty() || !input.isContinuous())
+    {
+        spdlog::error("Batching backend did not provide a continuous input buffer.");
+        for (auto& req : batch)
+            req.result.set_value({});
+        return;
+    }
+
+    const size_t item_bytes = input.total() * input.elemSize() / input.size[0];
+    const size_t item_elems = item_bytes / CV_ELEM_SIZE1(input.depth());
+    const int    n          = static_cast<int>(batch.size());
+    std::vector<bool> valid(n, true);
+    for (int i = 0; i < n; ++i)
+    {
+        cv::Mat sample = batch[i].sample;
+        if (!sample.isContinuous()) sample = sample.clone();
+        // float samples for an FP16 or BF16 (bits as CV_16U) input are converted while they are
+        // packed
+        const bool float_sample =
+            sample.depth() == CV_32F && sample.total() * sample.channels() == item_elems;
+        if (input.depth() == CV_16F && float_sample)
+        {
+            convert_f32_to_f16(sample.ptr<float>(),
+                               reinterpret_cast<half_float::half*>(input.data + i * item_bytes),
+                               item_elems);
+            continue;
+        }
+        if (input.depth() == CV_16U && float_sample)
+        {
+            convert_f32_to_bf16(sample.ptr<float>(),
+                                reinterpret_cast<bfloat16*>(input.data + i * item_bytes),
+                                item_elems);
+            continue;
+        }
+        if (sample.total() * sample.elemSize() != item_bytes || sample.depth() != input.depth())
+        {
+            spdlog::error("Sample {} does not match the batch item shape and type, skipping it.",
+                          i);
+            valid[i] = false;
+            std::memset(input.data + i * item_bytes, 0, item_bytes);
+            continue;
+        }
+        std::memcpy(input.data + i * item_bytes, sample.data, item_bytes);
+    }
+
+    cv::Mat output;
+    try
+    {
+        output = backend_.run(n);
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error("Batch execution failed: {}", e.what());
+    }
+
+    // scatter the outputs, they have to be copied as the buffer is reused for the next batch
+    // (FP16 and BF16 outputs are converted to float, like `model::predict` does)
+    for (int i = 0; i < n; ++i)
+    {
+        if (!valid[i] || output.empty() || output.size[0] <= i)
+            batch[i].result.set_value({});
+        else if (output.depth() == CV_16F)
+            batch[i].result.set_value(convert_f16_to_f32(batch_item(output, i)));
+        else if (output.depth() == CV_16U)
+            batch[i].result.set_value(convert_bf16_to_f32(batch_item(output, i)));
+        else
+            batch[i].result.set_value(batch_item(output, i).clone());
+    }
+}
+
+} // namespace eztrt
@@ -0,0 +1,152 @@
+#include "eztrt/convert.h"
+#include "eztrt/kernels.h"
+
+#include <opencv2/core/utility.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace eztrt
+{
+
+namespace
+{
+
+/// Elements per task, large enough to amortize the scheduling but small enough to stay in L2
+constexpr size_t kConvertChunk = size_t(1) << 16;
+
+/// Runs `convert(begin, count)` over [0, n) in chunks, in parallel if there is more than one
+template<typename Convert>
+void convert_chunked(size_t n, Convert convert)
+{
+    const size_t chunks = (n + kConvertChunk - 1) / kConvertChunk;
+    if (chunks <= 1)
+    {
+        convert(size_t(0), n);
+        return;
+    }
+    cv::parallel_for_(cv::Range(0, int(chunks)), [&](const cv::Range& range) {
+        for (int c = range.start; c < range.end; ++c)
+        {
+            const size_t begin = size_t(c) * kConvertChunk;
+            convert(begin, std::min(kConvertChunk, n - begin));
+        }
+    });
+}
+
+/**
+ * Allocates `dst` in the shape of `m` with the given depth, or checks and reshapes the given one.
+ * Returns an empty matrix if the given destination does not fit, `name` is the calling function.
+ */
+cv::Mat prepare_destination(const char* name, const cv::Mat& m, int depth, cv::Mat dst)
+{
+    const int type = CV_MAKETYPE(depth, m.channels());
+    if (dst.empty())
+    {
+        dst.create(m.dims, m.size.p, type);
+        return dst;
+    }
+    if (!dst.isContinuous() || dst.depth() != depth ||
+        dst.total() * dst.channels() != m.total() * m.channels())
+    {
+        spdlog::warn("The destination of {} does not match the {} converted elements of depth {}.",
+                     name, m.total() * m.channels(), depth);
+        return {};
+    }
+    return dst.reshape(m.channels(), m.dims, m.size.p);
+}
+
+} // namespace
+
+void convert_f32_to_f16(const float* src, half_float::half* dst, size_t n)
+{
+    static_assert(sizeof(half_float::half) == sizeof(uint16_t), "half is not 16 bits wide");
+    auto* bits = reinterpret_cast<uint16_t*>(dst);
+    convert_chunked(n, [&](size_t begin, size_t count) {
+        kernels::active().f32_to_f16(src + begin, bits + begin, count);
+    });
+}
+
+void convert_f16_to_f32(const half_float::half* src, float* dst, size_t n)
+{
+    const auto* bits = reinterpret_cast<const uint16_t*>(src);
+    convert_chunked(n, [&](size_t begin, size_t count) {
+        kernels::active().f16_to_f32(bits + begin, dst + begin, count);
+    });
+}
+
+cv::Mat convert_f32_to_f16(const cv::Mat& m, cv::Mat dst)
+{
+    if (m.depth() != CV_32F)
+    {
+        spdlog::warn("convert_f32_to_f16 expects a CV_32F matrix, got depth {}", m.depth());
+        return {};
+    }
+    const cv::Mat src = m.isContinuous() ? m : m.clone();
+    dst               = prepare_destination("convert_f32_to_f16", src, CV_16F, dst);
+    if (dst.empty()) return {};
+    convert_f32_to_f16(src.ptr<float>(), dst.ptr<half_float::half>(),
+                       src.total() * src.channels());
+    return dst;
+}
+
+cv::Mat convert_f16_to_f32(const cv::Mat& m, cv::Mat dst)
+{
+    if (m.depth() != CV_16F)
+    {
+        spdlog::warn("convert_f16_to_f32 expects a CV_16F matrix, got depth {}", m.depth());
+        return {};
+    }
+    const cv::Mat src = m.isContinuous() ? m : m.clone();
+    dst               = prepare_destination("convert_f16_to_f32", src, CV_32F, dst);
+    if (dst.empty()) return {};
+    convert_f16_to_f32(src.ptr<half_float::half>(), dst.ptr<float>(),
+                       src.total() * src.channels());
+    return dst;
+}
+
+void convert_f32_to_bf16(const float* src, bfloat16* dst, size_t n)
+{
+    auto* bits = reinterpret_cast<uint16_t*>(dst);
+    convert_chunked(n, [&](size_t begin, size_t count) {
+        kernels::active().f32_to_bf16(src + begin, bits + begin, count);
+    });
+}
+
+void convert_bf16_to_f32(const bfloat16* src, float* dst, size_t n)
+{
+    const auto* bits = reinterpret_cast<const uint16_t*>(src);
+    convert_chunked(n, [&](size_t begin, size_t count) {
+        kernels::active().bf16_to_f32(bits + begin, dst + begin, count);
+    });
+}
+
+cv::Mat convert_f32_to_bf16(const cv::Mat& m, cv::Mat dst)
+{
+    if (m.depth() != CV_32F)
+    {
+        spdlog::warn("convert_f32_to_bf16 expects a CV_32F matrix, got depth {}", m.depth());
+        return {};
+    }
+    const cv::Mat src = m.isContinuous() ? m : m.clone();
+    dst               = prepare_destination("convert_f32_to_bf16", src, CV_16U, dst);
+    if (dst.empty()) return {};
+    convert_f32_to_bf16(src.ptr<float>(), dst.ptr<bfloat16>(), src.total() * src.channels());
+    return dst;
+}
+
+cv::Mat convert_bf16_to_f32(const cv::Mat& m, cv::Mat dst)
+{
+    if (m.depth() != CV_16U)
+    {
+        spdlog::warn("convert_bf16_to_f32 expects the bits as CV_16U, got depth {}", m.depth());
+        return {};
+    }
+    const cv::Mat src = m.isContinuous() ? m : m.clone();
+    dst               = prepare_destination("convert_bf16_to_f32", src, CV_32F, dst);
+    if (dst.empty()) return {};
+    convert_bf16_to_f32(src.ptr<bfloat16>(), dst.ptr<float>(), src.total() * src.channels());
+    return dst;
+}
+
+} // namespace eztrt
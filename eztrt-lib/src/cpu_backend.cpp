@@ -0,0 +1,526 @@
+#include "eztrt/cpu_backend.h"
+#include "eztrt/file_mapping.h"
+
+#include "cpu_ops.h"
+#include "protobuf_reader.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cassert>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace eztrt
+{
+
+namespace
+{
+
+// Field numbers of the ONNX protobuf messages (onnx.proto3), see also onnx_inspector.cpp
+namespace field
+{
+// ModelProto
+constexpr uint32_t model_graph = 7;
+// GraphProto
+constexpr uint32_t graph_node        = 1;
+constexpr uint32_t graph_initializer = 5;
+// NodeProto
+constexpr uint32_t node_input     = 1;
+constexpr uint32_t node_output    = 2;
+constexpr uint32_t node_name      = 3;
+constexpr uint32_t node_op_type   = 4;
+constexpr uint32_t node_attribute = 5;
+constexpr uint32_t node_domain    = 7;
+// AttributeProto
+constexpr uint32_t attr_name   = 1;
+constexpr uint32_t attr_f      = 2;
+constexpr uint32_t attr_i      = 3;
+constexpr uint32_t attr_s      = 4;
+constexpr uint32_t attr_t      = 5;
+constexpr uint32_t attr_floats = 7;
+constexpr uint32_t attr_ints   = 8;
+// TensorProto
+constexpr uint32_t tensor_dims          = 1;
+constexpr uint32_t tensor_data_type     = 2;
+constexpr uint32_t tensor_float_data    = 4;
+constexpr uint32_t tensor_int32_data    = 5;
+constexpr uint32_t tensor_int64_data    = 7;
+constexpr uint32_t tensor_name          = 8;
+constexpr uint32_t tensor_raw_data      = 9;
+constexpr uint32_t tensor_data_location = 14;
+} // namespace field
+
+/**
+ * Decodes a TensorProto. Only float, int32 and int64 tensors with data stored in the model are
+ * supported, integer tensors are widened to int64.
+ */
+bool read_tensor(pb::reader in, cpu::tensor& t, std::string& name, std::string& error)
+{
+    std::vector<float>   float_data;
+    std::vector<int64_t> int_data;
+    const uint8_t*       raw      = nullptr;
+    size_t               raw_size = 0;
+    bool                 external = false;
+
+    t.type = onnx_type::undefined;
+    uint32_t f, w;
+    while (in.next(f, w))
+    {
+        if (f == field::tensor_dims)
+            in.repeated_varint(w, t.shape);
+        else if (f == field::tensor_data_type && w == pb::wire_varint)
+            t.type = static_cast<onnx_type>(in.varint());
+        else if (f == field::tensor_float_data)
+            in.repeated_float(w, float_data);
+        else if (f == field::tensor_int32_data || f == field::tensor_int64_data)
+            in.repeated_varint(w, int_data);
+        else if (f == field::tensor_name && w == pb::wire_bytes)
+            name = in.string();
+        else if (f == field::tensor_raw_data && w == pb::wire_bytes)
+        {
+            auto payload = in.message();
+            raw          = payload.data();
+            raw_size     = payload.size();
+        }
+        else if (f == field::tensor_data_location && w == pb::wire_varint)
+            external = in.varint() == 1;
+        else
+            in.skip(w);
+    }
+    if (in.failed())
+    {
+        error = fmt::format("malformed tensor {}", name);
+        return false;
+    }
+    if (external)
+    {
+        error = fmt::format("tensor {} uses external data, which is not supported", name);
+        return false;
+    }
+
+    const size_t n = t.numel();
+    switch (t.type)
+    {
+    case onnx_type::float32:
+        if (raw)
+        {
+            if (raw_size != n * sizeof(float)) break;
+            t.f.resize(n);
+            std::memcpy(t.f.data(), raw, raw_size);
+        }
+        else
+            t.f = std::move(float_data);
+        if (t.f.size() == n) return true;
+        break;
+    case onnx_type::int32:
+    case onnx_type::int64:
+        if (raw)
+        {
+            const size_t elem = t.type == onnx_type::int32 ? 4 : 8;
+            if (raw_size != n * elem) break;
+            t.i.resize(n);
+            for (size_t k = 0; k < n; ++k)
+            {
+                if (elem == 4)
+                {
+                    int32_t v;
+                    std::memcpy(&v, raw + k * 4, 4);
+                    t.i[k] = v;
+                }
+                else
+                    std::memcpy(&t.i[k], raw + k * 8, 8);
+            }
+        }
+        else
+            t.i = std::move(int_data);
+        // int32 values are sign-extended varints on the wire, cut them back to 32 bit
+        if (t.type == onnx_type::int32)
+            for (auto& v : t.i)
+                v = static_cast<int32_t>(v);
+        t.type = onnx_type::int64;
+        if (t.i.size() == n) return true;
+        break;
+    default:
+        error = fmt::format("tensor {} is {}, which is not supported", name, to_str(t.type));
+        return false;
+    }
+    error = fmt::format("size of tensor {} does not match its shape", name);
+    return false;
+}
+
+bool read_attribute(pb::reader in, std::string& name, cpu::attribute& a, std::string& error)
+{
+    uint32_t f, w;
+    while (in.next(f, w))
+    {
+        if (f == field::attr_name && w == pb::wire_bytes)
+            name = in.string();
+        else if (f == field::attr_f && w == pb::wire_fixed32)
+            a.f = in.fixed32_float();
+        else if (f == field::attr_i && w == pb::wire_varint)
+            a.i = static_cast<int64_t>(in.varint());
+        else if (f == field::attr_s && w == pb::wire_bytes)
+            a.s = in.string();
+        else if (f == field::attr_t && w == pb::wire_bytes)
+        {
+            std::string tensor_name;
+            if (!read_tensor(in.message(), a.t, tensor_name, error)) return false;
+        }
+        else if (f == field::attr_floats)
+            in.repeated_float(w, a.floats);
+        else if (f == field::attr_ints)
+            in.repeated_varint(w, a.ints);
+        else
+            in.skip(w); // graphs, sparse tensors and their lists
+    }
+    if (in.failed()) error = fmt::format("malformed attribute {}", name);
+    return !in.failed();
+}
+
+std::vector<int64_t> to_shape(const cv::Mat& m)
+{
+    return std::vector<int64_t>(m.size.p, m.size.p + m.dims);
+}
+
+/// Copies `t` into `dst` as a float matrix of the same shape, (re-)allocating `dst` if necessary
+void copy_to_mat(const cpu::tensor& t, cv::Mat& dst)
+{
+    std::vector<int> dims(t.shape.begin(), t.shape.end());
+    if (dims.empty()) dims.push_back(1);
+    dst.create(static_cast<int>(dims.size()), dims.data(), CV_32F);
+    if (t.is_float())
+        std::copy(t.f.begin(), t.f.end(), dst.ptr<float>());
+    else
+        std::copy(t.i.begin(), t.i.end(), dst.ptr<float>());
+}
+
+} // namespace
+
+/**
+ * The executable graph: nodes in topological order (as required by ONNX) operating on numbered
+ * values. Immutable after loading, so any number of threads can execute it concurrently.
+ */
+struct cpu_backend::graph
+{
+    std::vector<cpu::node>        nodes;
+    std::vector<cpu::op_function> ops;       //!< implementation of each node
+    std::vector<std::string>      values;    //!< name of each value
+    std::vector<int>              last_use;  //!< index of the last node reading each value
+    std::vector<cpu::tensor>      constants; //!< initializers, indexed like `values`
+    std::vector<bool>             is_constant;
+    std::vector<int>              inputs;  //!< values of the graph inputs
+    std::vector<int>              outputs; //!< values of the graph outputs
+    int                           opset{1};
+
+    int value_index(const std::string& name)
+    {
+        auto it = index.find(name);
+        if (it != index.end()) return it->second;
+        values.push_back(name);
+        constants.emplace_back();
+        is_constant.push_back(false);
+        return index[name] = static_cast<int>(values.size()) - 1;
+    }
+
+    /**
+     * Runs the graph on `feeds` (one tensor per graph input) and returns the first graph output.
+     */
+    bool execute(std::vector<cpu::tensor> feeds, cpu::tensor& result, std::string& error) const
+    {
+        std::vector<cpu::tensor>        workspace(values.size());
+        std::vector<const cpu::tensor*> in;
+        for (size_t k = 0; k < inputs.size(); ++k)
+            workspace[inputs[k]] = std::move(feeds[k]);
+
+        for (size_t n = 0; n < nodes.size(); ++n)
+        {
+            const auto& node = nodes[n];
+            in.clear();
+            for (int v : node.inputs)
+                in.push_back(v < 0 ? nullptr : is_constant[v] ? &constants[v] : &workspace[v]);
+
+            std::vector<cpu::tensor> out(node.outputs.size());
+            if (!ops[n](node, in, out, opset, error)) return false;
+            for (size_t k = 0; k < out.size(); ++k)
+                if (node.outputs[k] >= 0) workspace[node.outputs[k]] = std::move(out[k]);
+
+            // release intermediate results as soon as nobody needs them anymore
+            for (int v : node.inputs)
+                if (v >= 0 && last_use[v] == int(n)) workspace[v] = cpu::tensor{};
+        }
+
+        const int v = outputs.front();
+        result      = is_constant[v] ? constants[v] : std::move(workspace[v]);
+        return true;
+    }
+
+private:
+    std::unordered_map<std::string, int> index;
+};
+
+cpu_backend::cpu_backend() = default;
+
+cpu_backend::~cpu_backend() = default;
+
+bool cpu_backend::load(const std::string& file)
+{
+    graph_.reset();
+    input_buffers_.clear();
+    output_ = cv::Mat{};
+
+    mapped_file mapping(file);
+    if (!mapping.valid())
+    {
+        spdlog::error("Could not load {}: {}", file, mapping.error());
+        return false;
+    }
+    info_ = inspect_onnx(mapping.data(), mapping.size());
+    if (!info_.valid())
+    {
+        spdlog::error("Could not load {}: {}", file, info_.error);
+        return false;
+    }
+    if (info_.outputs.empty())
+    {
+        spdlog::error("Could not load {}: the model has no outputs", file);
+        return false;
+    }
+
+    auto g = std::make_unique<graph>();
+    for (const char* domain : {"", "ai.onnx"})
+    {
+        auto it = info_.opsets.find(domain);
+        if (it != info_.opsets.end()) g->opset = static_cast<int>(it->second);
+    }
+
+    // the inspector has already validated the outer structure, find the graph again
+    std::string error;
+    pb::reader  model(mapping.data(), mapping.data() + mapping.size());
+    uint32_t    f, w;
+    while (model.next(f, w))
+    {
+        if (f != field::model_graph || w != pb::wire_bytes)
+        {
+            model.skip(w);
+            continue;
+        }
+
+        auto graph = model.message();
+        while (graph.next(f, w) && error.empty())
+        {
+            if (f == field::graph_initializer && w == pb::wire_bytes)
+            {
+                cpu::tensor t;
+                std::string name;
+                if (!read_tensor(graph.message(), t, name, error)) break;
+                const int v       = g->value_index(name);
+                g->constants[v]   = std::move(t);
+                g->is_constant[v] = true;
+            }
+            else if (f == field::graph_node && w == pb::wire_bytes)
+            {
+                auto        msg = graph.message();
+                cpu::node   n;
+                std::string domain;
+                while (msg.next(f, w) && error.empty())
+                {
+                    if (f == field::node_input && w == pb::wire_bytes)
+                    {
+                        auto name = msg.string();
+                        n.inputs.push_back(name.empty() ? -1 : g->value_index(name));
+                    }
+                    else if (f == field::node_output && w == pb::wire_bytes)
+                    {
+                        auto name = msg.string();
+                        n.outputs.push_back(name.empty() ? -1 : g->value_index(name));
+                    }
+                    else if (f == field::node_name && w == pb::wire_bytes)
+                        n.name = msg.string();
+                    else if (f == field::node_op_type && w == pb::wire_bytes)
+                        n.op_type = msg.string();
+                    else if (f == field::node_attribute && w == pb::wire_bytes)
+                    {
+                        std::string    name;
+                        cpu::attribute a;
+                        if (read_attribute(msg.message(), name, a, error))
+                            n.attributes[name] = std::move(a);
+                    }
+                    else if (f == field::node_domain && w == pb::wire_bytes)
+                        domain = msg.string();
+                    else
+                        msg.skip(w);
+                }
+                if (!domain.empty() && domain != "ai.onnx") n.op_type = domain + "." + n.op_type;
+                g->nodes.push_back(std::move(n));
+            }
+            else
+                graph.skip(w);
+        }
+        if (graph.failed() && error.empty()) error = "malformed graph";
+    }
+    if (!error.empty())
+    {
+        spdlog::error("Could not load {}: {}", file, error);
+        return false;
+    }
+
+    // resolve all operators before running anything, so that all missing ones are reported
+    std::set<std::string> unsupported;
+    for (const auto& n : g->nodes)
+    {
+        g->ops.push_back(cpu::find_op(n.op_type));
+        if (!g->ops.back()) unsupported.insert(n.op_type);
+    }
+    if (!unsupported.empty())
+    {
+        std::ostringstream list;
+        for (const auto& op : unsupported)
+            list << (list.tellp() ? ", " : "") << op;
+        spdlog::error("Could not load {}: the CPU backend does not support {}", file, list.str());
+        return false;
+    }
+
+    for (const auto& input : info_.inputs)
+        g->inputs.push_back(g->value_index(input.name));
+    for (const auto& output : info_.outputs)
+        g->outputs.push_back(g->value_index(output.name));
+
+    // graph outputs are never released
+    g->last_use.assign(g->values.size(), -1);
+    for (size_t n = 0; n < g->nodes.size(); ++n)
+        for (int v : g->nodes[n].inputs)
+            if (v >= 0) g->last_use[v] = static_cast<int>(n);
+    for (int v : g->outputs)
+        g->last_use[v] = static_cast<int>(g->nodes.size());
+
+    spdlog::info("Loaded {} for the CPU backend: {} nodes, opset {}", file, g->nodes.size(),
+                 g->opset);
+    graph_ = std::move(g);
+    return true;
+}
+
+bool cpu_backend::ready() const { return graph_ != nullptr; }
+
+cv::Mat cpu_backend::predict(cv::Mat input)
+{
+    assert(graph_ && "model not loaded");
+    assert(graph_->inputs.size() == 1 &&
+           "this API can only be used for a model with a single input tensor");
+
+    // the input has been written to the buffer of the zero-copy API directly. The result gets a
+    // matrix of its own, the one of run() may be in use by its caller.
+    if (!input_buffers_.empty() && input.data == input_buffers_.front().data)
+    {
+        cv::Mat output;
+        return execute_input_buffers(output, "predict") ? output : cv::Mat{};
+    }
+
+    // the input is taken as a flat buffer like for TensorRT, only symbolic dimensions are
+    // taken from the matrix
+    const auto& info  = info_.inputs.front();
+    cpu::tensor feed;
+    feed.shape        = info.shape;
+    int64_t known     = 1;
+    int     symbolics = 0;
+    for (auto d : feed.shape)
+        d < 0 ? ++symbolics : known *= d;
+    if (symbolics == 1 && known > 0)
+    {
+        for (auto& d : feed.shape)
+            if (d < 0) d = static_cast<int64_t>(input.total() * input.channels()) / known;
+    }
+    else if (symbolics)
+        feed.shape = to_shape(input);
+
+    if (feed.numel() != input.total() * input.channels())
+    {
+        spdlog::error("predict: input has {} elements, the model expects {}",
+                      input.total() * input.channels(), feed.numel());
+        return {};
+    }
+
+    cv::Mat values;
+    input.convertTo(values, CV_32F);
+    values = values.isContinuous() ? values : values.clone();
+    feed.f.assign(values.ptr<float>(), values.ptr<float>() + feed.numel());
+
+    std::vector<cpu::tensor> feeds;
+    feeds.push_back(std::move(feed));
+    cpu::tensor result;
+    std::string error;
+    if (!graph_->execute(std::move(feeds), result, error))
+    {
+        spdlog::error("predict: {}", error);
+        return {};
+    }
+
+    cv::Mat output;
+    copy_to_mat(result, output);
+    return output;
+}
+
+cv::Mat cpu_backend::acquire_input(int index)
+{
+    assert(graph_ && "model not loaded");
+    if (index < 0 || index >= int(info_.inputs.size())) return {};
+
+    if (input_buffers_.empty())
+    {
+        for (const auto& input : info_.inputs)
+        {
+            // symbolic dimensions are assumed to be batch dimensions of size 1
+            std::vector<int> dims;
+            for (auto d : input.shape)
+                dims.push_back(d < 0 ? 1 : static_cast<int>(d));
+            if (dims.empty()) dims.push_back(1);
+            input_buffers_.emplace_back(static_cast<int>(dims.size()), dims.data(), CV_32F,
+                                        cv::Scalar(0));
+        }
+    }
+    return input_buffers_[index];
+}
+
+cv::Mat cpu_backend::run()
+{
+    assert(graph_ && "model not loaded");
+    if (input_buffers_.empty()) acquire_input(0);
+    return execute_input_buffers(output_, "run") ? output_ : cv::Mat{};
+}
+
+bool cpu_backend::execute_input_buffers(cv::Mat& output, const char* caller) const
+{
+    std::vector<cpu::tensor> feeds;
+    for (const auto& buffer : input_buffers_)
+    {
+        cpu::tensor feed;
+        feed.shape = to_shape(buffer);
+        feed.f.assign(buffer.ptr<float>(), buffer.ptr<float>() + buffer.total());
+        feeds.push_back(std::move(feed));
+    }
+
+    cpu::tensor result;
+    std::string error;
+    if (!graph_->execute(std::move(feeds), result, error))
+    {
+        spdlog::error("{}: {}", caller, error);
+        return false;
+    }
+
+    copy_to_mat(result, output);
+    return true;
+}
+
+std::string cpu_backend::summarize(bool verbose) const
+{
+    if (!graph_) return "!!! No model loaded on the CPU backend\n";
+
+    std::ostringstream summary;
+    summary << info_.summarize(verbose);
+    summary << fmt::format("Running on the CPU backend (opset {}, {} threads)\n", graph_->opset,
+                           cv::getNumThreads());
+    return summary.str();
+}
+
+} // namespace eztrt
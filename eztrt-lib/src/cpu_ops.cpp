@@ -0,0 +1,810 @@
+#include "cpu_ops.h"
+
+#include <opencv2/core.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace eztrt
+{
+namespace cpu
+{
+
+size_t tensor::numel() const
+{
+    return std::accumulate(shape.begin(), shape.end(), size_t(1),
+                           [](size_t a, int64_t b) { return a * static_cast<size_t>(b); });
+}
+
+const attribute* node::attr(const std::string& attr_name) const
+{
+    auto it = attributes.find(attr_name);
+    return it == attributes.end() ? nullptr : &it->second;
+}
+
+int64_t node::attr_int(const std::string& attr_name, int64_t fallback) const
+{
+    auto a = attr(attr_name);
+    return a ? a->i : fallback;
+}
+
+float node::attr_float(const std::string& attr_name, float fallback) const
+{
+    auto a = attr(attr_name);
+    return a ? a->f : fallback;
+}
+
+std::string node::attr_string(const std::string& attr_name, std::string fallback) const
+{
+    auto a = attr(attr_name);
+    return a ? a->s : fallback;
+}
+
+std::vector<int64_t> node::attr_ints(const std::string& attr_name) const
+{
+    auto a = attr(attr_name);
+    return a ? a->ints : std::vector<int64_t>{};
+}
+
+namespace
+{
+
+/// Minimum number of elements per task for element-wise operations to be parallelized
+constexpr size_t kParallelGrain = 1 << 14;
+
+/// Runs `fn(begin, end)` over [0, n) in parallel chunks of at least `grain` elements
+template<typename Fn>
+void parallel_range(size_t n, size_t grain, Fn&& fn)
+{
+    const size_t tasks = std::max<size_t>(1, n / std::max<size_t>(grain, 1));
+    if (tasks == 1)
+    {
+        fn(size_t(0), n);
+        return;
+    }
+    cv::parallel_for_(cv::Range(0, static_cast<int>(tasks)), [&](const cv::Range& r) {
+        fn(n * r.start / tasks, n * r.end / tasks);
+    });
+}
+
+bool require_float(const node& n, const std::vector<const tensor*>& in, size_t count,
+                   std::string& error)
+{
+    for (size_t k = 0; k < count; ++k)
+    {
+        if (k >= in.size() || !in[k])
+        {
+            error = fmt::format("{} ({}): input {} is missing", n.op_type, n.name, k);
+            return false;
+        }
+        if (!in[k]->is_float())
+        {
+            error = fmt::format("{} ({}): input {} is {}, only float is supported", n.op_type,
+                                n.name, k, to_str(in[k]->type));
+            return false;
+        }
+    }
+    return true;
+}
+
+tensor make_float(std::vector<int64_t> shape)
+{
+    tensor t;
+    t.shape = std::move(shape);
+    t.f.resize(t.numel());
+    return t;
+}
+
+// -------------------------------------------------------------------------------------------------
+// matrix multiplication
+
+/**
+ * C[M,N] (+)= A[M,K] * B[K,N], all row-major and contiguous. Parallelized over rows, and over
+ * column blocks if there are fewer rows than threads (e.g. M = 1 for fully connected layers).
+ */
+void gemm(const float* A, const float* B, float* C, int M, int N, int K, bool accumulate)
+{
+    constexpr int kBlock   = 256;
+    const int     n_blocks = (N + kBlock - 1) / kBlock;
+    const int     tasks    = M * n_blocks;
+
+    auto body = [&](const cv::Range& r) {
+        for (int task = r.start; task < r.end; ++task)
+        {
+            const int m  = task / n_blocks;
+            const int j0 = (task % n_blocks) * kBlock;
+            const int j1 = std::min(N, j0 + kBlock);
+            float*    c  = C + size_t(m) * N;
+            if (!accumulate) std::fill(c + j0, c + j1, 0.f);
+            for (int k = 0; k < K; ++k)
+            {
+                const float  a = A[size_t(m) * K + k];
+                const float* b = B + size_t(k) * N;
+                for (int j = j0; j < j1; ++j)
+                    c[j] += a * b[j];
+            }
+        }
+    };
+
+    if (size_t(M) * N * K < kParallelGrain)
+        body(cv::Range(0, tasks));
+    else
+        cv::parallel_for_(cv::Range(0, tasks), body);
+}
+
+std::vector<float> transposed(const float* src, int rows, int cols)
+{
+    std::vector<float> dst(size_t(rows) * cols);
+    for (int r = 0; r < rows; ++r)
+        for (int c = 0; c < cols; ++c)
+            dst[size_t(c) * rows + r] = src[size_t(r) * cols + c];
+    return dst;
+}
+
+// -------------------------------------------------------------------------------------------------
+// element-wise operations
+
+bool broadcast_shape(const std::vector<int64_t>& a, const std::vector<int64_t>& b,
+                     std::vector<int64_t>& out)
+{
+    const size_t rank = std::max(a.size(), b.size());
+    out.assign(rank, 1);
+    for (size_t k = 0; k < rank; ++k)
+    {
+        const int64_t da = k < rank - a.size() ? 1 : a[k - (rank - a.size())];
+        const int64_t db = k < rank - b.size() ? 1 : b[k - (rank - b.size())];
+        if (da != db && da != 1 && db != 1) return false;
+        out[k] = da == 1 ? db : da;
+    }
+    return true;
+}
+
+/// Strides of `shape` when broadcast to `out_shape`, 0 along broadcast dimensions
+std::vector<size_t> broadcast_strides(const std::vector<int64_t>& shape,
+                                      const std::vector<int64_t>& out_shape)
+{
+    std::vector<size_t> strides(out_shape.size(), 0);
+    size_t              stride = 1;
+    for (size_t k = shape.size(); k-- > 0;)
+    {
+        const size_t o = k + out_shape.size() - shape.size();
+        strides[o]     = shape[k] == 1 ? 0 : stride;
+        stride *= static_cast<size_t>(shape[k]);
+    }
+    return strides;
+}
+
+template<typename Op>
+bool binary_op(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+               int opset, std::string& error, Op op)
+{
+    if (!require_float(n, in, 2, error)) return false;
+    const tensor& a = *in[0];
+    const tensor& b = *in[1];
+
+    // before opset 7, B was only broadcast if asked to, aligned with A starting at `axis`
+    auto b_shape = b.shape;
+    if (opset < 7 && n.attr_int("broadcast", 0) && b_shape.size() < a.shape.size())
+    {
+        const auto axis =
+            n.attr_int("axis", static_cast<int64_t>(a.shape.size() - b_shape.size()));
+        while (int64_t(b_shape.size()) + axis < int64_t(a.shape.size()))
+            b_shape.push_back(1);
+    }
+
+    std::vector<int64_t> shape;
+    if (!broadcast_shape(a.shape, b_shape, shape))
+    {
+        error = fmt::format("{} ({}): shapes cannot be broadcast", n.op_type, n.name);
+        return false;
+    }
+    out[0]       = make_float(shape);
+    float* dst   = out[0].f.data();
+    const auto N = out[0].numel();
+
+    if (a.shape == b_shape)
+    {
+        parallel_range(N, kParallelGrain, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k)
+                dst[k] = op(a.f[k], b.f[k]);
+        });
+        return true;
+    }
+    if (b.numel() == 1)
+    {
+        const float s = b.f[0];
+        parallel_range(N, kParallelGrain, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k)
+                dst[k] = op(a.f[k], s);
+        });
+        return true;
+    }
+
+    // general case: walk the rows of the innermost dimension
+    const auto   sa    = broadcast_strides(a.shape, shape);
+    const auto   sb    = broadcast_strides(b_shape, shape);
+    const size_t rank  = shape.size();
+    const size_t inner = rank ? static_cast<size_t>(shape.back()) : 1;
+    const size_t rows  = inner ? N / inner : 0;
+    const size_t ia    = rank ? sa.back() : 0;
+    const size_t ib    = rank ? sb.back() : 0;
+
+    parallel_range(rows, std::max<size_t>(1, kParallelGrain / std::max<size_t>(inner, 1)),
+                   [&](size_t begin, size_t end) {
+                       for (size_t row = begin; row < end; ++row)
+                       {
+                           // offsets of the row start in a and b
+                           size_t oa = 0, ob = 0, rem = row;
+                           for (size_t k = rank - 1; k-- > 0;)
+                           {
+                               const size_t idx = rem % static_cast<size_t>(shape[k]);
+                               rem /= static_cast<size_t>(shape[k]);
+                               oa += idx * sa[k];
+                               ob += idx * sb[k];
+                           }
+                           float* d = dst + row * inner;
+                           for (size_t j = 0; j < inner; ++j)
+                               d[j] = op(a.f[oa + j * ia], b.f[ob + j * ib]);
+                       }
+                   });
+    return true;
+}
+
+bool op_add(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+            int opset, std::string& error)
+{
+    return binary_op(n, in, out, opset, error, [](float a, float b) { return a + b; });
+}
+
+bool op_sub(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+            int opset, std::string& error)
+{
+    return binary_op(n, in, out, opset, error, [](float a, float b) { return a - b; });
+}
+
+bool op_mul(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+            int opset, std::string& error)
+{
+    return binary_op(n, in, out, opset, error, [](float a, float b) { return a * b; });
+}
+
+bool op_div(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+            int opset, std::string& error)
+{
+    return binary_op(n, in, out, opset, error, [](float a, float b) { return a / b; });
+}
+
+bool op_relu(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out, int,
+             std::string& error)
+{
+    if (!require_float(n, in, 1, error)) return false;
+    out[0]           = make_float(in[0]->shape);
+    const float* src = in[0]->f.data();
+    float*       dst = out[0].f.data();
+    parallel_range(out[0].numel(), kParallelGrain, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k)
+            dst[k] = std::max(src[k], 0.f);
+    });
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+// shape operations
+
+bool op_identity(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+                 int, std::string& error)
+{
+    if (in.empty() || !in[0])
+    {
+        error = fmt::format("{} ({}): input is missing", n.op_type, n.name);
+        return false;
+    }
+    out[0] = *in[0];
+    // Dropout may be asked for its mask, which is all ones at inference time
+    if (out.size() > 1)
+    {
+        out[1]       = tensor{};
+        out[1].shape = in[0]->shape;
+        out[1].type  = onnx_type::boolean;
+        out[1].i.assign(in[0]->numel(), 1);
+    }
+    return true;
+}
+
+bool op_reshape(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+                int opset, std::string& error)
+{
+    if (in.empty() || !in[0])
+    {
+        error = fmt::format("Reshape ({}): input is missing", n.name);
+        return false;
+    }
+
+    // the target shape was an attribute before opset 5
+    std::vector<int64_t> target =
+        opset < 5 || in.size() < 2 || !in[1] ? n.attr_ints("shape") : in[1]->i;
+    const auto& src = in[0]->shape;
+
+    int     infer = -1;
+    int64_t known = 1;
+    for (size_t k = 0; k < target.size(); ++k)
+    {
+        if (target[k] == 0 && k < src.size() && !n.attr_int("allowzero", 0)) target[k] = src[k];
+        if (target[k] == -1)
+            infer = static_cast<int>(k);
+        else
+            known *= target[k];
+    }
+    const auto total = static_cast<int64_t>(in[0]->numel());
+    if (infer >= 0 && known > 0) target[infer] = total / known;
+
+    tensor result = *in[0];
+    result.shape  = target;
+    if (static_cast<int64_t>(result.numel()) != total)
+    {
+        error = fmt::format("Reshape ({}): cannot reshape {} elements", n.name, total);
+        return false;
+    }
+    out[0] = std::move(result);
+    return true;
+}
+
+bool op_flatten(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+                int, std::string& error)
+{
+    if (in.empty() || !in[0])
+    {
+        error = fmt::format("Flatten ({}): input is missing", n.name);
+        return false;
+    }
+    const auto& shape = in[0]->shape;
+    int64_t     axis  = n.attr_int("axis", 1);
+    if (axis < 0) axis += static_cast<int64_t>(shape.size());
+
+    int64_t outer = 1;
+    for (int64_t k = 0; k < axis && k < int64_t(shape.size()); ++k)
+        outer *= shape[k];
+
+    out[0]       = *in[0];
+    out[0].shape = {outer, outer ? static_cast<int64_t>(in[0]->numel()) / outer : 0};
+    return true;
+}
+
+bool op_constant(const node& n, const std::vector<const tensor*>&, std::vector<tensor>& out, int,
+                 std::string& error)
+{
+    if (auto a = n.attr("value"))
+        out[0] = a->t;
+    else if (auto a = n.attr("value_float"))
+    {
+        out[0]   = make_float({});
+        out[0].f = {a->f};
+    }
+    else if (auto a = n.attr("value_floats"))
+    {
+        out[0]   = make_float({static_cast<int64_t>(a->floats.size())});
+        out[0].f = a->floats;
+    }
+    else if (auto a = n.attr("value_int"))
+    {
+        out[0] = tensor{{}, onnx_type::int64, {}, {a->i}};
+    }
+    else if (auto a = n.attr("value_ints"))
+    {
+        out[0] = tensor{{static_cast<int64_t>(a->ints.size())}, onnx_type::int64, {}, a->ints};
+    }
+    else
+    {
+        error = fmt::format("Constant ({}): unsupported value attribute", n.name);
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+// matrix products
+
+bool op_matmul(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out, int,
+               std::string& error)
+{
+    if (!require_float(n, in, 2, error)) return false;
+    auto a_shape = in[0]->shape;
+    auto b_shape = in[1]->shape;
+
+    // 1D operands are promoted to matrices and the extra dimension is removed afterwards
+    const bool a_vec = a_shape.size() == 1;
+    const bool b_vec = b_shape.size() == 1;
+    if (a_vec) a_shape.insert(a_shape.begin(), 1);
+    if (b_vec) b_shape.push_back(1);
+    if (a_shape.size() < 2 || b_shape.size() < 2)
+    {
+        error = fmt::format("MatMul ({}): scalar operands are not supported", n.name);
+        return false;
+    }
+
+    const int64_t M = a_shape[a_shape.size() - 2], K = a_shape.back();
+    const int64_t N = b_shape.back();
+    if (b_shape[b_shape.size() - 2] != K)
+    {
+        error = fmt::format("MatMul ({}): inner dimensions {} and {} do not match", n.name, K,
+                            b_shape[b_shape.size() - 2]);
+        return false;
+    }
+
+    // batch dimensions: either B is a plain matrix (shared by all batches) or both match
+    const std::vector<int64_t> a_batch(a_shape.begin(), a_shape.end() - 2);
+    const std::vector<int64_t> b_batch(b_shape.begin(), b_shape.end() - 2);
+    if (!b_batch.empty() && a_batch != b_batch)
+    {
+        error = fmt::format("MatMul ({}): broadcasting of batch dimensions is not supported",
+                            n.name);
+        return false;
+    }
+    const int64_t batches = std::accumulate(a_batch.begin(), a_batch.end(), int64_t(1),
+                                            std::multiplies<int64_t>());
+
+    std::vector<int64_t> shape = a_batch;
+    if (!a_vec) shape.push_back(M);
+    if (!b_vec) shape.push_back(N);
+    out[0] = make_float(shape);
+
+    if (b_batch.empty())
+    {
+        // fold the batches into the rows of one big product
+        gemm(in[0]->f.data(), in[1]->f.data(), out[0].f.data(), int(batches * M), int(N), int(K),
+             false);
+    }
+    else
+    {
+        for (int64_t b = 0; b < batches; ++b)
+            gemm(in[0]->f.data() + b * M * K, in[1]->f.data() + b * K * N,
+                 out[0].f.data() + b * M * N, int(M), int(N), int(K), false);
+    }
+    return true;
+}
+
+bool op_gemm(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out, int,
+             std::string& error)
+{
+    if (!require_float(n, in, 2, error)) return false;
+    const tensor& a = *in[0];
+    const tensor& b = *in[1];
+    if (a.shape.size() != 2 || b.shape.size() != 2)
+    {
+        error = fmt::format("Gemm ({}): A and B have to be matrices", n.name);
+        return false;
+    }
+
+    const bool  trans_a = n.attr_int("transA", 0) != 0;
+    const bool  trans_b = n.attr_int("transB", 0) != 0;
+    const float alpha   = n.attr_float("alpha", 1.f);
+    const float beta    = n.attr_float("beta", 1.f);
+
+    const int M = int(trans_a ? a.shape[1] : a.shape[0]);
+    const int K = int(trans_a ? a.shape[0] : a.shape[1]);
+    const int N = int(trans_b ? b.shape[0] : b.shape[1]);
+    if ((trans_b ? b.shape[1] : b.shape[0]) != K)
+    {
+        error = fmt::format("Gemm ({}): inner dimensions do not match", n.name);
+        return false;
+    }
+
+    std::vector<float> at, bt;
+    const float*       pa = a.f.data();
+    const float*       pb = b.f.data();
+    if (trans_a) pa = (at = transposed(pa, int(a.shape[0]), int(a.shape[1]))).data();
+    if (trans_b) pb = (bt = transposed(pb, int(b.shape[0]), int(b.shape[1]))).data();
+
+    out[0] = make_float({M, N});
+    gemm(pa, pb, out[0].f.data(), M, N, K, false);
+    float* y = out[0].f.data();
+    if (alpha != 1.f)
+        for (auto& v : out[0].f)
+            v *= alpha;
+
+    // bias, broadcastable to [M, N]
+    if (in.size() > 2 && in[2] && beta != 0.f)
+    {
+        if (!in[2]->is_float())
+        {
+            error = fmt::format("Gemm ({}): C has to be float", n.name);
+            return false;
+        }
+        std::vector<int64_t> shape;
+        if (!broadcast_shape(in[2]->shape, {M, N}, shape) || shape != std::vector<int64_t>{M, N})
+        {
+            error = fmt::format("Gemm ({}): C cannot be broadcast to [M, N]", n.name);
+            return false;
+        }
+        const auto   sc = broadcast_strides(in[2]->shape, shape);
+        const float* c  = in[2]->f.data();
+        for (int m = 0; m < M; ++m)
+            for (int j = 0; j < N; ++j)
+                y[size_t(m) * N + j] += beta * c[m * sc[0] + j * sc[1]];
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+// convolution and pooling
+
+/**
+ * Spatial geometry shared by Conv and MaxPool (2D only).
+ */
+struct window
+{
+    int kernel[2]{1, 1};
+    int stride[2]{1, 1};
+    int dilation[2]{1, 1};
+    int pad_begin[2]{0, 0};
+    int out[2]{0, 0};
+
+    bool init(const node& n, const std::vector<int64_t>& kernel_shape, int in_h, int in_w,
+              bool ceil_mode, std::string& error)
+    {
+        const int in[2] = {in_h, in_w};
+        if (kernel_shape.size() != 2)
+        {
+            error = fmt::format("{} ({}): only 2D kernels are supported", n.op_type, n.name);
+            return false;
+        }
+        const auto strides   = n.attr_ints("strides");
+        const auto dilations = n.attr_ints("dilations");
+        const auto pads      = n.attr_ints("pads");
+        const auto auto_pad  = n.attr_string("auto_pad", "NOTSET");
+
+        for (int d = 0; d < 2; ++d)
+        {
+            kernel[d]     = int(kernel_shape[d]);
+            stride[d]     = strides.size() == 2 ? int(strides[d]) : 1;
+            dilation[d]   = dilations.size() == 2 ? int(dilations[d]) : 1;
+            const int ext = dilation[d] * (kernel[d] - 1) + 1;
+
+            if (auto_pad == "SAME_UPPER" || auto_pad == "SAME_LOWER")
+            {
+                out[d]          = (in[d] + stride[d] - 1) / stride[d];
+                const int total = std::max(0, (out[d] - 1) * stride[d] + ext - in[d]);
+                pad_begin[d]    = auto_pad == "SAME_UPPER" ? total / 2 : total - total / 2;
+            }
+            else if (auto_pad == "VALID")
+            {
+                pad_begin[d] = 0;
+                out[d]       = (in[d] - ext) / stride[d] + 1;
+            }
+            else
+            {
+                pad_begin[d]     = pads.size() == 4 ? int(pads[d]) : 0;
+                const int padded = in[d] + pad_begin[d] + (pads.size() == 4 ? int(pads[d + 2]) : 0);
+                out[d]           = ceil_mode ? (padded - ext + stride[d] - 1) / stride[d] + 1
+                                             : (padded - ext) / stride[d] + 1;
+            }
+            if (out[d] <= 0)
+            {
+                error = fmt::format("{} ({}): the output would be empty", n.op_type, n.name);
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+bool op_conv(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out, int,
+             std::string& error)
+{
+    if (!require_float(n, in, 2, error)) return false;
+    const tensor& x = *in[0];
+    const tensor& w = *in[1];
+    if (x.shape.size() != 4 || w.shape.size() != 4)
+    {
+        error = fmt::format("Conv ({}): only 2D convolutions on NCHW data are supported", n.name);
+        return false;
+    }
+
+    const int N = int(x.shape[0]), C = int(x.shape[1]), H = int(x.shape[2]), W = int(x.shape[3]);
+    const int M      = int(w.shape[0]);
+    const int groups = int(n.attr_int("group", 1));
+    if (groups <= 0 || C % groups || M % groups || w.shape[1] != C / groups)
+    {
+        error = fmt::format("Conv ({}): channels do not match the weights", n.name);
+        return false;
+    }
+
+    auto kernel_shape = n.attr_ints("kernel_shape");
+    if (kernel_shape.empty()) kernel_shape = {w.shape[2], w.shape[3]};
+    window win;
+    if (!win.init(n, kernel_shape, H, W, false, error)) return false;
+
+    const float* bias = nullptr;
+    if (in.size() > 2 && in[2])
+    {
+        if (!in[2]->is_float() || in[2]->numel() != size_t(M))
+        {
+            error = fmt::format("Conv ({}): bias does not match the output channels", n.name);
+            return false;
+        }
+        bias = in[2]->f.data();
+    }
+
+    const int OH = win.out[0], OW = win.out[1];
+    const int Cg = C / groups, Mg = M / groups;
+    const int KH = win.kernel[0], KW = win.kernel[1];
+    const int rows = Cg * KH * KW; // rows of the im2col matrix
+    const int cols = OH * OW;
+
+    out[0] = make_float({N, M, OH, OW});
+    std::vector<float> col(size_t(rows) * cols);
+
+    for (int b = 0; b < N; ++b)
+    {
+        for (int g = 0; g < groups; ++g)
+        {
+            // im2col: one row per (input channel, kernel y, kernel x), zero outside the image
+            const float* src = x.f.data() + (size_t(b) * C + size_t(g) * Cg) * H * W;
+            cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& r) {
+                for (int row = r.start; row < r.end; ++row)
+                {
+                    const int    c   = row / (KH * KW);
+                    const int    ky  = (row / KW) % KH;
+                    const int    kx  = row % KW;
+                    const float* ch  = src + size_t(c) * H * W;
+                    float*       dst = col.data() + size_t(row) * cols;
+                    for (int oy = 0; oy < OH; ++oy)
+                    {
+                        const int iy = oy * win.stride[0] - win.pad_begin[0] + ky * win.dilation[0];
+                        for (int ox = 0; ox < OW; ++ox)
+                        {
+                            const int ix =
+                                ox * win.stride[1] - win.pad_begin[1] + kx * win.dilation[1];
+                            dst[oy * OW + ox] =
+                                iy >= 0 && iy < H && ix >= 0 && ix < W ? ch[iy * W + ix] : 0.f;
+                        }
+                    }
+                }
+            });
+
+            // [Mg, rows] x [rows, cols]
+            const float* weights = w.f.data() + size_t(g) * Mg * rows;
+            float*       dst     = out[0].f.data() + (size_t(b) * M + size_t(g) * Mg) * cols;
+            gemm(weights, col.data(), dst, Mg, cols, rows, false);
+            if (bias)
+            {
+                for (int m = 0; m < Mg; ++m)
+                {
+                    const float bm = bias[g * Mg + m];
+                    float*      d  = dst + size_t(m) * cols;
+                    for (int k = 0; k < cols; ++k)
+                        d[k] += bm;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool op_maxpool(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+                int, std::string& error)
+{
+    if (!require_float(n, in, 1, error)) return false;
+    const tensor& x = *in[0];
+    if (x.shape.size() != 4)
+    {
+        error = fmt::format("MaxPool ({}): only 2D pooling on NCHW data is supported", n.name);
+        return false;
+    }
+    if (out.size() > 1)
+    {
+        error = fmt::format("MaxPool ({}): the Indices output is not supported", n.name);
+        return false;
+    }
+
+    const int planes = int(x.shape[0] * x.shape[1]);
+    const int H = int(x.shape[2]), W = int(x.shape[3]);
+    window    win;
+    if (!win.init(n, n.attr_ints("kernel_shape"), H, W, n.attr_int("ceil_mode", 0) != 0, error))
+        return false;
+
+    const int OH = win.out[0], OW = win.out[1];
+    out[0]       = make_float({x.shape[0], x.shape[1], OH, OW});
+
+    cv::parallel_for_(cv::Range(0, planes), [&](const cv::Range& r) {
+        for (int p = r.start; p < r.end; ++p)
+        {
+            const float* src = x.f.data() + size_t(p) * H * W;
+            float*       dst = out[0].f.data() + size_t(p) * OH * OW;
+            for (int oy = 0; oy < OH; ++oy)
+            {
+                for (int ox = 0; ox < OW; ++ox)
+                {
+                    float m = -std::numeric_limits<float>::infinity();
+                    for (int ky = 0; ky < win.kernel[0]; ++ky)
+                    {
+                        const int iy = oy * win.stride[0] - win.pad_begin[0] + ky * win.dilation[0];
+                        if (iy < 0 || iy >= H) continue;
+                        for (int kx = 0; kx < win.kernel[1]; ++kx)
+                        {
+                            const int ix =
+                                ox * win.stride[1] - win.pad_begin[1] + kx * win.dilation[1];
+                            if (ix >= 0 && ix < W) m = std::max(m, src[iy * W + ix]);
+                        }
+                    }
+                    dst[oy * OW + ox] = m;
+                }
+            }
+        }
+    });
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+// softmax
+
+bool op_softmax(const node& n, const std::vector<const tensor*>& in, std::vector<tensor>& out,
+                int opset, std::string& error)
+{
+    if (!require_float(n, in, 1, error)) return false;
+    const auto& shape = in[0]->shape;
+    const auto  rank  = static_cast<int64_t>(shape.size());
+
+    // before opset 13 the input is coerced into a 2D matrix at `axis`, after it is a single axis
+    int64_t axis = n.attr_int("axis", opset < 13 ? 1 : -1);
+    if (axis < 0) axis += rank;
+    if (axis < 0 || axis > rank || (opset >= 13 && axis == rank))
+    {
+        error = fmt::format("Softmax ({}): invalid axis", n.name);
+        return false;
+    }
+
+    size_t outer = 1, len = 1, inner = 1;
+    for (int64_t k = 0; k < rank; ++k)
+    {
+        if (k < axis)
+            outer *= size_t(shape[k]);
+        else if (k == axis || opset < 13)
+            len *= size_t(shape[k]);
+        else
+            inner *= size_t(shape[k]);
+    }
+
+    out[0]           = make_float(shape);
+    const float* src = in[0]->f.data();
+    float*       dst = out[0].f.data();
+    parallel_range(outer * inner, std::max<size_t>(1, kParallelGrain / std::max<size_t>(len, 1)),
+                   [&](size_t begin, size_t end) {
+                       for (size_t t = begin; t < end; ++t)
+                       {
+                           const size_t base = (t / inner) * len * inner + t % inner;
+                           float        m    = -std::numeric_limits<float>::infinity();
+                           for (size_t k = 0; k < len; ++k)
+                               m = std::max(m, src[base + k * inner]);
+                           float sum = 0.f;
+                           for (size_t k = 0; k < len; ++k)
+                               sum += dst[base + k * inner] = std::exp(src[base + k * inner] - m);
+                           for (size_t k = 0; k < len; ++k)
+                               dst[base + k * inner] /= sum;
+                       }
+                   });
+    return true;
+}
+
+} // namespace
+
+op_function find_op(const std::string& op_type)
+{
+    static const std::unordered_map<std::string, op_function> ops = {
+        {"Add", op_add},         {"Sub", op_sub},         {"Mul", op_mul},
+        {"Div", op_div},         {"Relu", op_relu},       {"Identity", op_identity},
+        {"Dropout", op_identity}, {"Reshape", op_reshape}, {"Flatten", op_flatten},
+        {"Constant", op_constant}, {"MatMul", op_matmul}, {"Gemm", op_gemm},
+        {"Conv", op_conv},       {"MaxPool", op_maxpool}, {"Softmax", op_softmax},
+    };
+    auto it = ops.find(op_type);
+    return it == ops.end() ? nullptr : it->second;
+}
+
+} // namespace cpu
+} // namespace eztrt
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "eztrt/onnx_inspector.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Private tensor type and operator implementations of the CPU backend.
+
+namespace eztrt
+{
+namespace cpu
+{
+
+/**
+ * A dense tensor. Float tensors keep their data in `f`, integer tensors (shapes, indices) in `i`.
+ */
+struct tensor
+{
+    std::vector<int64_t> shape;
+    onnx_type            type{onnx_type::float32};
+    std::vector<float>   f;
+    std::vector<int64_t> i;
+
+    size_t numel() const;
+    bool   is_float() const { return type == onnx_type::float32; }
+};
+
+/**
+ * Value of a node attribute, only the member matching the attribute type is set.
+ */
+struct attribute
+{
+    int64_t              i{0};
+    float                f{0.f};
+    std::string          s;
+    std::vector<int64_t> ints;
+    std::vector<float>   floats;
+    tensor               t;
+};
+
+struct node
+{
+    std::string                      op_type;
+    std::string                      name;
+    std::vector<int>                 inputs;  //!< value indices, -1 for omitted optional inputs
+    std::vector<int>                 outputs; //!< value indices, -1 for omitted optional outputs
+    std::map<std::string, attribute> attributes;
+
+    int64_t              attr_int(const std::string& name, int64_t fallback) const;
+    float                attr_float(const std::string& name, float fallback) const;
+    std::string          attr_string(const std::string& name, std::string fallback) const;
+    std::vector<int64_t> attr_ints(const std::string& name) const;
+    const attribute*     attr(const std::string& name) const;
+};
+
+/**
+ * Executes one operator. `in` holds null for omitted optional inputs, `out` is sized to the
+ * number of outputs of the node. Returns false and sets `error` if the node cannot be executed.
+ */
+using op_function = bool (*)(const node& n, const std::vector<const tensor*>& in,
+                             std::vector<tensor>& out, int opset, std::string& error);
+
+/**
+ * Returns the implementation of `op_type` (in the default ONNX domain), or null if it is not
+ * supported.
+ */
+op_function find_op(const std::string& op_type);
+
+} // namespace cpu
+} // namespace eztrt
@@ -0,0 +1,70 @@
+#include "eztrt/crc32c.h"
+
+#include "kernels_impl.h"
+
+#include <cstring>
+
+namespace eztrt
+{
+
+namespace
+{
+constexpr uint32_t kPolynomial = 0x82F63B78; // reversed Castagnoli polynomial
+
+struct slice_tables
+{
+    slice_tables()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (kPolynomial & (0u - (crc & 1)));
+            t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i)
+            for (int k = 1; k < 8; ++k)
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+    }
+
+    uint32_t t[8][256];
+};
+
+/// Processes 8 bytes per step with eight table lookups, little endian only
+uint32_t crc32c_slice8(const uint8_t* p, size_t n, uint32_t crc)
+{
+    static const slice_tables tables;
+    const auto&               t = tables.t;
+
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; n; --n, ++p)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+    return crc;
+}
+
+using crc_fn = uint32_t (*)(const uint8_t*, size_t, uint32_t);
+
+crc_fn select_crc()
+{
+#ifdef EZTRT_X86_KERNELS
+    if (kernels::cpu().sse42) return kernels::sse42::crc32c;
+#endif
+    return crc32c_slice8;
+}
+} // namespace
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc)
+{
+    static const crc_fn impl = select_crc();
+    return ~impl(static_cast<const uint8_t*>(data), size, ~crc);
+}
+
+} // namespace eztrt
@@ -0,0 +1,42 @@
+#include "kernels_impl.h"
+
+#include <nmmintrin.h>
+
+#include <cstring>
+
+namespace eztrt
+{
+namespace kernels
+{
+namespace sse42
+{
+
+uint32_t crc32c(const uint8_t* p, size_t n, uint32_t crc)
+{
+    // a single dependency chain of crc32 instructions processes 8 bytes every 3 cycles, several
+    // GB/s and thus well above disk bandwidth, so the streams are not interleaved
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t c = crc;
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = static_cast<uint32_t>(c);
+#else
+    for (; n >= 4; n -= 4, p += 4)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+    }
+#endif
+    for (; n; --n, ++p)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+
+} // namespace sse42
+} // namespace kernels
+} // namespace eztrt
@@ -0,0 +1,389 @@
+#include "eztrt/detection.h"
+#include "eztrt/kernels.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace eztrt
+{
+
+namespace
+{
+
+/// Candidates above which the classes are suppressed in parallel
+constexpr size_t kParallelNms = 4096;
+
+/// Upper limit of NMS grid cells per axis
+constexpr int kMaxGridCells = 64;
+
+/**
+ * Views `m` as a float tensor $[B, rows, cols]$ (a missing batch dimension counts as 1), converts
+ * or compacts it if needed. Returns false for other shapes.
+ */
+bool as_batched_matrix(cv::Mat& m, int& batch, int& rows, int& cols)
+{
+    if (m.empty() || m.channels() != 1 || m.dims < 2 || m.dims > 3) return false;
+    batch = m.dims == 3 ? m.size[0] : 1;
+    rows  = m.size[m.dims - 2];
+    cols  = m.size[m.dims - 1];
+    if (m.depth() != CV_32F)
+        m.convertTo(m, CV_32F);
+    else if (!m.isContinuous())
+        m = m.clone();
+    return true;
+}
+
+cv::Rect2f from_center(float cx, float cy, float w, float h)
+{
+    return {cx - 0.5f * w, cy - 0.5f * h, w, h};
+}
+
+/// Indices of the `n` scores above `threshold`, in ascending order
+std::vector<int32_t> select_above(const float* scores, size_t n, float threshold)
+{
+    // in chunks, so that no index buffer for all scores has to be allocated
+    constexpr size_t     kChunk = 4096;
+    const auto&          k      = kernels::active();
+    int32_t              chunk[kChunk];
+    std::vector<int32_t> hits;
+    for (size_t begin = 0; begin < n; begin += kChunk)
+    {
+        const size_t count =
+            k.select_above_f32(scores + begin, std::min(kChunk, n - begin), threshold, chunk);
+        for (size_t i = 0; i < count; ++i)
+            hits.push_back(int32_t(begin) + chunk[i]);
+    }
+    return hits;
+}
+
+std::vector<detection> decode_ssd_image(const float* loc, const float* scores, int n, int classes,
+                                        const std::vector<anchor_box>& anchors,
+                                        const ssd_params&              params)
+{
+    std::vector<detection> result;
+    for (int32_t hit : select_above(scores, size_t(n) * classes, params.score_threshold))
+    {
+        const int c = hit % classes;
+        if (c == params.background_class) continue;
+
+        const int         i = hit / classes;
+        const anchor_box& a = anchors[i];
+        const float*      l = loc + size_t(i) * 4;
+        const float       w = a.w * std::exp(l[2] * params.size_variance);
+        const float       h = a.h * std::exp(l[3] * params.size_variance);
+        result.push_back({from_center(a.cx + l[0] * params.center_variance * a.w,
+                                      a.cy + l[1] * params.center_variance * a.h, w, h),
+                          scores[hit], c});
+    }
+    return result;
+}
+
+std::vector<detection> decode_yolo_image(const float* data, int rows, int cols,
+                                         const yolo_params& params)
+{
+    const bool boxes_first = params.layout == yolo_layout::boxes_first;
+    const int  n           = boxes_first ? rows : cols;
+    const int  attributes  = boxes_first ? cols : rows;
+    const int  first_class = params.objectness ? 5 : 4;
+    const int  classes     = attributes - first_class;
+    const auto at          = [&](int box, int attribute) {
+        return boxes_first ? data[size_t(box) * attributes + attribute]
+                                    : data[size_t(attribute) * n + box];
+    };
+
+    struct candidate
+    {
+        int   box, cls;
+        float score;
+    };
+    std::vector<candidate> candidates;
+    const auto             add = [&](int box, int cls) {
+        // objectness * class score never exceeds the class score, so the class score prefilter
+        // does not lose candidates
+        const float score = at(box, first_class + cls) * (params.objectness ? at(box, 4) : 1.f);
+        if (score > params.score_threshold) candidates.push_back({box, cls, score});
+    };
+    if (boxes_first)
+    {
+        // the objectness bounds the scores of all classes of a box, most rows end there
+        const auto&          k = kernels::active();
+        std::vector<int32_t> hits(classes);
+        for (int box = 0; box < n; ++box)
+        {
+            const float* row = data + size_t(box) * attributes;
+            if (params.objectness && !(row[4] > params.score_threshold)) continue;
+            const size_t count = k.select_above_f32(row + first_class, classes,
+                                                    params.score_threshold, hits.data());
+            for (size_t i = 0; i < count; ++i)
+                add(box, hits[i]);
+        }
+    }
+    else
+    {
+        const float* scores = data + size_t(first_class) * n;
+        for (int32_t hit : select_above(scores, size_t(n) * classes, params.score_threshold))
+            add(hit % n, hit / n);
+    }
+
+    if (params.best_class_only)
+    {
+        std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) {
+            return a.box != b.box ? a.box < b.box
+                                  : a.score != b.score ? a.score > b.score : a.cls < b.cls;
+        });
+        candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                                     [](const candidate& a, const candidate& b) {
+                                         return a.box == b.box;
+                                     }),
+                         candidates.end());
+    }
+
+    std::vector<detection> result;
+    result.reserve(candidates.size());
+    for (const candidate& c : candidates)
+        result.push_back(
+            {from_center(at(c.box, 0), at(c.box, 1), at(c.box, 2), at(c.box, 3)), c.score, c.cls});
+    return result;
+}
+
+bool overlaps(const cv::Rect2f& a, const cv::Rect2f& b, float iou_threshold)
+{
+    const float iw = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+    const float ih = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+    if (iw <= 0.f || ih <= 0.f) return false;
+    const float inter = iw * ih;
+    return inter / (a.area() + b.area() - inter) > iou_threshold;
+}
+
+/// Sort key of a candidate, kept apart from the boxes so that sorting does not chase indices
+struct ranked
+{
+    int   class_id; //!< 0 for class-agnostic suppression
+    float score;
+    int   index;
+
+    bool operator<(const ranked& rhs) const
+    {
+        if (class_id != rhs.class_id) return class_id < rhs.class_id;
+        return score != rhs.score ? score > rhs.score : index < rhs.index;
+    }
+};
+
+/**
+ * Greedy NMS of the `n` candidates of one class in `group` (sorted by descending score), sets
+ * `keep` for the surviving ones. Kept boxes are entered into all cells of a uniform grid they
+ * cover, a candidate is only compared with the kept boxes of its own cells: boxes with a positive
+ * intersection always share a cell, so this gives the same result as comparing with all of them.
+ */
+void suppress(const detection* candidates, const ranked* group, size_t n, float iou_threshold,
+              size_t max_keep, char* keep)
+{
+    // in double, the extent of finite float boxes can exceed the float range
+    double x0 = std::numeric_limits<double>::max(), y0 = x0;
+    double x1 = std::numeric_limits<double>::lowest(), y1 = x1;
+    double side_sum = 0.0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        const cv::Rect2f& b = candidates[group[k].index].box;
+        x0                  = std::min(x0, double(b.x));
+        y0                  = std::min(y0, double(b.y));
+        x1                  = std::max(x1, double(b.x) + b.width);
+        y1                  = std::max(y1, double(b.y) + b.height);
+        side_sum += std::max(b.width, b.height);
+    }
+
+    // cells of about the average box size, so that a box covers a few cells only
+    double cell = std::max(side_sum / n, std::max(x1 - x0, y1 - y0) / kMaxGridCells);
+    if (!(cell > 0.0)) cell = 1.0;
+    const int gx = std::min(kMaxGridCells, int((x1 - x0) / cell) + 1);
+    const int gy = std::min(kMaxGridCells, int((y1 - y0) / cell) + 1);
+    // clamped before the conversion, the far edge of a box may be infinite in float
+    const auto cell_x = [&](float x) { return int(std::min(double(gx - 1), (x - x0) / cell)); };
+    const auto cell_y = [&](float y) { return int(std::min(double(gy - 1), (y - y0) / cell)); };
+
+    // every cell is a linked list of entries, every entry refers to a kept box
+    std::vector<int>               head(size_t(gx) * gy, -1);
+    std::vector<int>               next, entry_box;
+    std::vector<const cv::Rect2f*> kept;
+    std::vector<uint32_t>          visited; // stamp of the last candidate compared with a kept box
+    uint32_t                       stamp = 0;
+
+    for (size_t k = 0; k < n && kept.size() < max_keep; ++k)
+    {
+        const cv::Rect2f& b   = candidates[group[k].index].box;
+        const int         cx0 = cell_x(b.x), cx1 = cell_x(b.x + b.width);
+        const int         cy0 = cell_y(b.y), cy1 = cell_y(b.y + b.height);
+
+        ++stamp;
+        const auto suppressed = [&]() {
+            for (int cy = cy0; cy <= cy1; ++cy)
+                for (int cx = cx0; cx <= cx1; ++cx)
+                    for (int e = head[size_t(cy) * gx + cx]; e >= 0; e = next[e])
+                    {
+                        const int j = entry_box[e];
+                        if (visited[j] == stamp) continue;
+                        visited[j] = stamp;
+                        if (overlaps(*kept[j], b, iou_threshold)) return true;
+                    }
+            return false;
+        };
+        if (suppressed()) continue;
+
+        keep[group[k].index] = 1;
+        for (int cy = cy0; cy <= cy1; ++cy)
+            for (int cx = cx0; cx <= cx1; ++cx)
+            {
+                int& first = head[size_t(cy) * gx + cx];
+                next.push_back(first);
+                entry_box.push_back(int(kept.size()));
+                first = int(next.size()) - 1;
+            }
+        kept.push_back(&b);
+        visited.push_back(0);
+    }
+}
+
+} // namespace
+
+std::vector<detection> decode_ssd(cv::Mat locations, cv::Mat scores,
+                                  const std::vector<anchor_box>& anchors, const ssd_params& params)
+{
+    int lb, ln, lc, sb, sn, sc;
+    if (!as_batched_matrix(locations, lb, ln, lc) || !as_batched_matrix(scores, sb, sn, sc) ||
+        lb != 1 || sb != 1 || lc != 4 || ln != sn || ln != int(anchors.size()))
+    {
+        spdlog::warn("decode_ssd expects [N,4] locations, [N,C] scores and N anchors");
+        return {};
+    }
+    return decode_ssd_image(locations.ptr<float>(), scores.ptr<float>(), ln, sc, anchors, params);
+}
+
+std::vector<detection> decode_yolo(cv::Mat output, const yolo_params& params)
+{
+    int batch, rows, cols;
+    if (!as_batched_matrix(output, batch, rows, cols) || batch != 1)
+    {
+        spdlog::warn("decode_yolo expects a [N,K] or [1,N,K] output");
+        return {};
+    }
+    const int attributes = params.layout == yolo_layout::boxes_first ? cols : rows;
+    if (attributes <= (params.objectness ? 5 : 4))
+    {
+        spdlog::warn("decode_yolo: {} attributes per box leave no class scores", attributes);
+        return {};
+    }
+    return decode_yolo_image(output.ptr<float>(), rows, cols, params);
+}
+
+std::vector<detection> nms(std::vector<detection> candidates, const nms_params& params)
+{
+    std::vector<ranked> order;
+    order.reserve(candidates.size());
+    for (int i = 0; i < int(candidates.size()); ++i)
+    {
+        const detection& d = candidates[i];
+        if (std::isfinite(d.box.x) && std::isfinite(d.box.y) && std::isfinite(d.box.width) &&
+            std::isfinite(d.box.height) && d.box.width >= 0.f && d.box.height >= 0.f &&
+            !std::isnan(d.score))
+            order.push_back({params.class_agnostic ? 0 : d.class_id, d.score, i});
+    }
+
+    // grouped by class, each group by descending score
+    std::sort(order.begin(), order.end());
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (size_t begin = 0, end = 0; begin < order.size(); begin = end)
+    {
+        end = begin + 1;
+        while (end < order.size() && order[end].class_id == order[begin].class_id)
+            ++end;
+        groups.emplace_back(begin, end);
+    }
+
+    // a class never contributes more than the overall limit
+    const size_t max_keep =
+        params.max_detections > 0 ? size_t(params.max_detections) : candidates.size();
+    std::vector<char> keep(candidates.size(), 0);
+    const auto        body = [&](const cv::Range& range) {
+        for (int g = range.start; g < range.end; ++g)
+            suppress(candidates.data(), order.data() + groups[g].first,
+                     groups[g].second - groups[g].first, params.iou_threshold, max_keep,
+                     keep.data());
+    };
+    const cv::Range range(0, int(groups.size()));
+    if (order.size() >= kParallelNms && groups.size() > 1)
+        cv::parallel_for_(range, body);
+    else
+        body(range);
+
+    std::vector<ranked> kept;
+    for (const ranked& r : order)
+        if (keep[r.index]) kept.push_back({0, r.score, r.index});
+    if (kept.size() > max_keep)
+    {
+        std::nth_element(kept.begin(), kept.begin() + max_keep, kept.end());
+        kept.resize(max_keep);
+    }
+    std::sort(kept.begin(), kept.end());
+
+    std::vector<detection> result;
+    result.reserve(kept.size());
+    for (const ranked& r : kept)
+        result.push_back(candidates[r.index]);
+    return result;
+}
+
+std::vector<std::vector<detection>> postprocess_ssd(cv::Mat locations, cv::Mat scores,
+                                                    const std::vector<anchor_box>& anchors,
+                                                    const ssd_params&              params,
+                                                    const nms_params&              suppression)
+{
+    int lb, ln, lc, sb, sn, sc;
+    if (!as_batched_matrix(locations, lb, ln, lc) || !as_batched_matrix(scores, sb, sn, sc) ||
+        lb != sb || lc != 4 || ln != sn || ln != int(anchors.size()))
+    {
+        spdlog::warn("postprocess_ssd expects [B,N,4] locations, [B,N,C] scores and N anchors");
+        return {};
+    }
+
+    std::vector<std::vector<detection>> result(lb);
+    cv::parallel_for_(cv::Range(0, lb), [&](const cv::Range& range) {
+        for (int b = range.start; b < range.end; ++b)
+            result[b] = nms(decode_ssd_image(locations.ptr<float>() + size_t(b) * ln * 4,
+                                             scores.ptr<float>() + size_t(b) * sn * sc, ln, sc,
+                                             anchors, params),
+                            suppression);
+    });
+    return result;
+}
+
+std::vector<std::vector<detection>> postprocess_yolo(cv::Mat output, const yolo_params& params,
+                                                     const nms_params& suppression)
+{
+    int batch, rows, cols;
+    if (!as_batched_matrix(output, batch, rows, cols))
+    {
+        spdlog::warn("postprocess_yolo expects a [B,N,K] output");
+        return {};
+    }
+    const int attributes = params.layout == yolo_layout::boxes_first ? cols : rows;
+    if (attributes <= (params.objectness ? 5 : 4))
+    {
+        spdlog::warn("postprocess_yolo: {} attributes per box leave no class scores", attributes);
+        return {};
+    }
+
+    std::vector<std::vector<detection>> result(batch);
+    cv::parallel_for_(cv::Range(0, batch), [&](const cv::Range& range) {
+        for (int b = range.start; b < range.end; ++b)
+            result[b] = nms(decode_yolo_image(output.ptr<float>() + size_t(b) * rows * cols, rows,
+                                              cols, params),
+                            suppression);
+    });
+    return result;
+}
+
+} // namespace eztrt
@@ -0,0 +1,278 @@
+#include "eztrt/engine_cache.h"
+
+#include <cuda_runtime_api.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#ifndef EZTRT_VERSION
+#define EZTRT_VERSION "unknown"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace eztrt
+{
+
+namespace
+{
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+constexpr const char* kExtension = ".engine";
+
+inline uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+inline uint64_t read64(const uint8_t* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v; // the hash is only stored on the machine that computed it, endianness is irrelevant
+}
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * kPrime2;
+    return rotl(acc, 31) * kPrime1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh_round(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+/// Accumulates the values that make up a cache key
+struct key_builder
+{
+    template<typename T>
+    key_builder& add(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be hashed");
+        h = hash64(&value, sizeof(value), h);
+        return *this;
+    }
+
+    key_builder& add(const std::string& value)
+    {
+        add(value.size());
+        h = hash64(value.data(), value.size(), h);
+        return *this;
+    }
+
+    key_builder& add(const std::vector<std::string>& values)
+    {
+        add(values.size());
+        for (const auto& v : values)
+            add(v);
+        return *this;
+    }
+
+    uint64_t h{0};
+};
+} // namespace
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed)
+{
+    auto       p   = static_cast<const uint8_t*>(data);
+    const auto end = p + size;
+    uint64_t   h;
+
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (const auto limit = end - 32; p <= limit; p += 32)
+        {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    }
+    else
+    {
+        h = seed + kPrime5;
+    }
+    h += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ xxh_round(0, read64(p)), 27) * kPrime1 + kPrime4;
+    if (p + 4 <= end)
+    {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h ^= (*p) * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t params_fingerprint(const model::params& params)
+{
+    return key_builder{}
+        .add(params.batchSize)
+        .add(params.dlaCore)
+        .add(params.int8)
+        .add(params.fp16)
+        .add(params.workspace_size)
+        .add(params.inputTensorNames)
+        .add(params.outputTensorNames)
+        .h;
+}
+
+std::string device_signature()
+{
+    int            device = 0;
+    cudaDeviceProp props;
+    if (cudaGetDevice(&device) != cudaSuccess ||
+        cudaGetDeviceProperties(&props, device) != cudaSuccess)
+        return "unknown";
+    return fmt::format("{} sm_{}{}", props.name, props.major, props.minor);
+}
+
+engine_cache::engine_cache(std::string directory, uint64_t max_bytes)
+    : directory_{std::move(directory)}, max_bytes_{max_bytes}
+{
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec)
+        spdlog::error("Could not create engine cache directory {}: {}", directory_, ec.message());
+}
+
+std::string engine_cache::make_key(const void* onnx, size_t size, const model::params& params)
+{
+    return make_key(onnx, size, params, device_signature());
+}
+
+std::string engine_cache::make_key(const void* onnx, size_t size, const model::params& params,
+                                   const std::string& device)
+{
+    const auto h = key_builder{}
+                       .add(hash64(onnx, size))
+                       .add(params_fingerprint(params))
+                       .add(std::string(EZTRT_VERSION))
+                       .add(NV_TENSORRT_MAJOR)
+                       .add(NV_TENSORRT_MINOR)
+                       .add(NV_TENSORRT_PATCH)
+                       .add(device)
+                       .h;
+    return fmt::format("{:016x}", h);
+}
+
+std::string engine_cache::path_for(const std::string& key) const
+{
+    return (fs::path(directory_) / (key + kExtension)).string();
+}
+
+std::string engine_cache::lookup(const std::string& key)
+{
+    const auto      path = path_for(key);
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec)) return {};
+
+    // the modification time doubles as the last access time for the LRU eviction
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return path;
+}
+
+bool engine_cache::store(const std::string& key, const std::function<bool(std::ostream&)>& write)
+{
+    // write to a unique temporary file first, renaming it is atomic
+    const auto path = path_for(key);
+    const auto tmp  = fmt::format("{}.{:08x}.tmp", path, std::random_device{}());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!write(out) || !out.flush())
+        {
+            spdlog::error("Could not write engine cache entry {}", tmp);
+            std::error_code ec;
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec)
+    {
+        spdlog::error("Could not move engine cache entry into place at {}: {}", path, ec.message());
+        fs::remove(tmp, ec);
+        return false;
+    }
+
+    evict(key);
+    return true;
+}
+
+void engine_cache::evict(const std::string& keep)
+{
+    if (max_bytes_ == 0) return;
+
+    struct entry
+    {
+        fs::path            path;
+        uint64_t            size;
+        fs::file_time_type  used;
+    };
+    std::vector<entry> entries;
+    uint64_t           total = 0;
+
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(directory_, ec))
+    {
+        if (!item.is_regular_file(ec) || item.path().extension() != kExtension) continue;
+        entry e{item.path(), item.file_size(ec), item.last_write_time(ec)};
+        if (ec) continue;
+        total += e.size;
+        if (item.path().stem() != keep) entries.push_back(std::move(e));
+    }
+
+    // oldest first
+    std::sort(begin(entries), end(entries),
+              [](const entry& a, const entry& b) { return a.used < b.used; });
+    for (const auto& e : entries)
+    {
+        if (total <= max_bytes_) break;
+        if (fs::remove(e.path, ec))
+        {
+            total -= e.size;
+            spdlog::info("Evicted {} from the engine cache", e.path.string());
+        }
+    }
+}
+
+} // namespace eztrt
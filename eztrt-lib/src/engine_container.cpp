@@ -0,0 +1,145 @@
+#include "eztrt/engine_container.h"
+#include "eztrt/crc32c.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+
+namespace eztrt
+{
+
+constexpr char     engine_header::kMagic[8];
+constexpr uint32_t engine_header::kVersion;
+constexpr size_t   engine_header::kSize;
+
+namespace
+{
+/// The header checksum covers all bytes of the encoded header before it
+constexpr size_t kHeaderCrcOffset = engine_header::kSize - 4;
+
+template<typename T>
+void store_le(uint8_t*& p, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+        *p++ = static_cast<uint8_t>(value >> (8 * i));
+}
+
+template<typename T>
+T load_le(const uint8_t*& p)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        value |= static_cast<T>(*p++) << (8 * i);
+    return value;
+}
+
+void encode(const engine_header& header, uint8_t* out)
+{
+    std::memcpy(out, header.magic, sizeof(header.magic));
+    uint8_t* p = out + sizeof(header.magic);
+    store_le(p, header.version);
+    store_le(p, header.header_size);
+    store_le(p, header.params_fingerprint);
+    store_le(p, header.payload_size);
+    store_le(p, header.payload_crc);
+    store_le(p, header.header_crc);
+}
+
+engine_header decode(const uint8_t* in)
+{
+    engine_header header;
+    std::memcpy(header.magic, in, sizeof(header.magic));
+    const uint8_t* p          = in + sizeof(header.magic);
+    header.version            = load_le<uint32_t>(p);
+    header.header_size        = load_le<uint32_t>(p);
+    header.params_fingerprint = load_le<uint64_t>(p);
+    header.payload_size       = load_le<uint64_t>(p);
+    header.payload_crc        = load_le<uint32_t>(p);
+    header.header_crc         = load_le<uint32_t>(p);
+    return header;
+}
+} // namespace
+
+bool write_engine_container(std::ostream& out, const void* payload, size_t size,
+                            uint64_t params_fingerprint)
+{
+    engine_header header{};
+    std::memcpy(header.magic, engine_header::kMagic, sizeof(header.magic));
+    header.version            = engine_header::kVersion;
+    header.header_size        = engine_header::kSize;
+    header.params_fingerprint = params_fingerprint;
+    header.payload_size       = size;
+    header.payload_crc        = crc32c(payload, size);
+
+    uint8_t encoded[engine_header::kSize];
+    encode(header, encoded);
+    header.header_crc = crc32c(encoded, kHeaderCrcOffset);
+    encode(header, encoded);
+
+    out.write(reinterpret_cast<const char*>(encoded), sizeof(encoded));
+    out.write(static_cast<const char*>(payload), static_cast<std::streamsize>(size));
+    return static_cast<bool>(out);
+}
+
+engine_payload open_engine_container(const void* data, size_t size, uint64_t params_fingerprint)
+{
+    engine_payload result;
+    const auto     bytes = static_cast<const uint8_t*>(data);
+
+    if (size < sizeof(engine_header::kMagic) ||
+        std::memcmp(bytes, engine_header::kMagic, sizeof(engine_header::kMagic)) != 0)
+    {
+        // engines serialized before the container format was introduced
+        result.data   = bytes;
+        result.size   = size;
+        result.legacy = true;
+        return result;
+    }
+
+    if (size < engine_header::kSize)
+    {
+        result.error = fmt::format("file is truncated: {} bytes are not even a full header", size);
+        return result;
+    }
+
+    const engine_header header = decode(bytes);
+    if (crc32c(bytes, kHeaderCrcOffset) != header.header_crc)
+    {
+        result.error = "header checksum mismatch, the header is corrupted";
+        return result;
+    }
+    if (header.version > engine_header::kVersion || header.header_size < engine_header::kSize)
+    {
+        result.error = fmt::format("unsupported container version {}", header.version);
+        return result;
+    }
+    if (size < header.header_size || size - header.header_size < header.payload_size)
+    {
+        result.error = fmt::format("file is truncated: expected {} bytes of engine data, found {}",
+                                   header.payload_size,
+                                   size > header.header_size ? size - header.header_size : 0);
+        return result;
+    }
+    if (size - header.header_size > header.payload_size)
+    {
+        result.error = fmt::format("file has {} unexpected trailing bytes",
+                                   size - header.header_size - header.payload_size);
+        return result;
+    }
+
+    const uint8_t* payload = bytes + header.header_size;
+    if (crc32c(payload, header.payload_size) != header.payload_crc)
+    {
+        result.error = "engine checksum mismatch, the file is corrupted";
+        return result;
+    }
+
+    result.data            = payload;
+    result.size            = header.payload_size;
+    result.params_mismatch = header.params_fingerprint != params_fingerprint;
+    return result;
+}
+
+} // namespace eztrt
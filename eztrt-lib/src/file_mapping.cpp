@@ -0,0 +1,152 @@
+#include "eztrt/file_mapping.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace eztrt
+{
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::string& path) : path_{path}
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        error_ = "could not open file (error " + std::to_string(GetLastError()) + ")";
+        return;
+    }
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size))
+    {
+        error_ = "could not query the file size (error " + std::to_string(GetLastError()) + ")";
+        CloseHandle(file);
+        return;
+    }
+    if (size.QuadPart == 0)
+    {
+        error_ = "file is empty";
+        CloseHandle(file);
+        return;
+    }
+
+    // the mapping object keeps the file open, the file handle is not needed anymore
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping_)
+    {
+        error_ = "could not create file mapping (error " + std::to_string(GetLastError()) + ")";
+        return;
+    }
+
+    data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (!data_)
+    {
+        error_ = "could not map view of file (error " + std::to_string(GetLastError()) + ")";
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+        return;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+
+    // prefetch the whole range, the consumer will read all of it
+    WIN32_MEMORY_RANGE_ENTRY range{data_, size_};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void mapped_file::close()
+{
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    data_    = nullptr;
+    mapping_ = nullptr;
+    size_    = 0;
+}
+
+#else
+
+mapped_file::mapped_file(const std::string& path) : path_{path}
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error_ = std::string("could not open file: ") + std::strerror(errno);
+        return;
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0)
+    {
+        // read errno before close() can overwrite it
+        error_ = std::string("could not stat file: ") + std::strerror(errno);
+        ::close(fd);
+        return;
+    }
+    if (st.st_size == 0)
+    {
+        error_ = "file is empty";
+        ::close(fd);
+        return;
+    }
+
+    // the mapping keeps a reference to the file, so the descriptor can be closed right away
+    void* data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        error_ = std::string("could not map file: ") + std::strerror(errno);
+        return;
+    }
+    data_ = data;
+    size_ = static_cast<size_t>(st.st_size);
+
+    // the advice is only a hint, failing to apply it is not an error
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+    ::madvise(data_, size_, MADV_WILLNEED);
+}
+
+void mapped_file::close()
+{
+    if (data_) ::munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+mapped_file::mapped_file(mapped_file&& rhs) noexcept { *this = std::move(rhs); }
+
+mapped_file& mapped_file::operator=(mapped_file&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        close();
+        data_  = std::exchange(rhs.data_, nullptr);
+        size_  = std::exchange(rhs.size_, 0);
+        path_  = std::move(rhs.path_);
+        error_ = std::move(rhs.error_);
+#ifdef _WIN32
+        mapping_ = std::exchange(rhs.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+mapped_file::~mapped_file() { close(); }
+
+} // namespace eztrt
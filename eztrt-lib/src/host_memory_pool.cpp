@@ -0,0 +1,239 @@
+#include "eztrt/host_memory_pool.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <limits>
+#include <tuple>
+
+#ifdef _WIN32
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace eztrt
+{
+
+namespace
+{
+
+/// Large blocks are rounded up to the (default) huge page size, as MAP_HUGETLB requires
+constexpr size_t kHugePageBytes = size_t(2) << 20;
+
+size_t round_up(size_t n, size_t multiple) { return (n + multiple - 1) / multiple * multiple; }
+
+size_t class_of(size_t bytes, const host_pool_params& params)
+{
+    constexpr size_t alignment = host_memory_pool::alignment;
+    size_t           size      = alignment;
+    if (bytes > alignment)
+    {
+        // four classes per power of two: steps of a quarter of the power of two below `bytes`
+        size_t pow = alignment;
+        while (pow * 2 < bytes)
+            pow *= 2;
+        size = round_up(bytes, std::max(alignment, pow / 4));
+    }
+    return size >= params.large_block_bytes ? round_up(size, kHugePageBytes) : size;
+}
+
+} // namespace
+
+host_memory_pool::host_memory_pool(host_pool_params params) : params_{params} {}
+
+host_memory_pool::~host_memory_pool()
+{
+    trim();
+    if (!live_.empty())
+        spdlog::warn("Host memory pool destroyed with {} blocks still in use", live_.size());
+}
+
+host_memory_pool& host_memory_pool::global()
+{
+    // intentionally leaked, buffers of static objects may be freed after it would be destroyed
+    static host_memory_pool* pool = new host_memory_pool();
+    return *pool;
+}
+
+void* host_memory_pool::allocate(size_t bytes)
+{
+    // larger requests would overflow the size class computation and fail anyway
+    if (bytes > std::numeric_limits<size_t>::max() / 4) return nullptr;
+
+    block info;
+    void* ptr = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        info.size = class_of(bytes, params_);
+        auto it   = cached_.find(info.size);
+        if (it != cached_.end() && !it->second.empty())
+        {
+            std::tie(ptr, info) = it->second.back();
+            it->second.pop_back();
+            stats_.bytes_cached -= info.size;
+            ++stats_.hits;
+        }
+        else
+        {
+            info.mapped = info.size >= params_.large_block_bytes;
+            info.huge   = info.mapped && params_.huge_pages;
+        }
+    }
+
+    // new blocks are requested without holding the lock, mapping them can take a while
+    if (!ptr)
+    {
+        ptr = allocate_system(info);
+        if (!ptr) return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_.emplace(ptr, info);
+    ++stats_.allocations;
+    stats_.bytes_live += info.size;
+    stats_.bytes_peak = std::max(stats_.bytes_peak, stats_.bytes_live);
+    if (info.huge) stats_.bytes_huge_pages += info.size;
+    return ptr;
+}
+
+void host_memory_pool::deallocate(void* ptr)
+{
+    if (!ptr) return;
+
+    block info;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto                        it = live_.find(ptr);
+        if (it == live_.end())
+        {
+            assert(false && "block was not allocated by this pool");
+            spdlog::warn("Host memory pool: ignoring unknown block {}", ptr);
+            return;
+        }
+        info = it->second;
+        live_.erase(it);
+        stats_.bytes_live -= info.size;
+        if (info.huge) stats_.bytes_huge_pages -= info.size;
+
+        if (stats_.bytes_cached + info.size <= params_.max_cached_bytes)
+        {
+            cached_[info.size].emplace_back(ptr, info);
+            stats_.bytes_cached += info.size;
+            return;
+        }
+    }
+    release_system(ptr, info);
+}
+
+void host_memory_pool::trim()
+{
+    block_list blocks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks = take_cached();
+    }
+    for (const auto& b : blocks)
+        release_system(b.first, b.second);
+}
+
+void host_memory_pool::set_params(const host_pool_params& params)
+{
+    block_list blocks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        params_ = params;
+        blocks  = take_cached();
+    }
+    for (const auto& b : blocks)
+        release_system(b.first, b.second);
+}
+
+host_pool_params host_memory_pool::params() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return params_;
+}
+
+host_pool_stats host_memory_pool::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t host_memory_pool::size_class(size_t bytes) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return class_of(bytes, params_);
+}
+
+host_memory_pool::block_list host_memory_pool::take_cached()
+{
+    block_list blocks;
+    for (auto& entry : cached_)
+        blocks.insert(blocks.end(), entry.second.begin(), entry.second.end());
+    cached_.clear();
+    stats_.bytes_cached = 0;
+    return blocks;
+}
+
+void* host_memory_pool::allocate_system(block& info)
+{
+#ifdef __linux__
+    if (info.mapped)
+    {
+        void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (info.huge && hugetlb_)
+        {
+            ptr = ::mmap(nullptr, info.size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED) return ptr;
+            // most systems reserve no huge pages (vm.nr_hugepages), so don't try again
+            hugetlb_ = false;
+        }
+#endif
+        ptr = ::mmap(nullptr, info.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                     0);
+        if (ptr == MAP_FAILED) return nullptr;
+#ifdef MADV_HUGEPAGE
+        // transparent huge pages instead, the advice fails if they are disabled
+        if (info.huge) info.huge = ::madvise(ptr, info.size, MADV_HUGEPAGE) == 0;
+#else
+        info.huge = false;
+#endif
+        return ptr;
+    }
+#else
+    info.mapped = false;
+    info.huge   = false;
+#endif
+
+#ifdef _WIN32
+    return _aligned_malloc(info.size, alignment);
+#else
+    void* ptr = nullptr;
+    return ::posix_memalign(&ptr, alignment, info.size) == 0 ? ptr : nullptr;
+#endif
+}
+
+void host_memory_pool::release_system(void* ptr, const block& info)
+{
+#ifdef __linux__
+    if (info.mapped)
+    {
+        ::munmap(ptr, info.size);
+        return;
+    }
+#endif
+
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+} // namespace eztrt
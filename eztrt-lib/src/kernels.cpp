@@ -0,0 +1,312 @@
+#include "kernels_impl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef EZTRT_X86_KERNELS
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace eztrt
+{
+namespace kernels
+{
+
+namespace scalar
+{
+
+void u8_to_f32_planar(const uint8_t* src, size_t n, int channels, float* const* planes, float mul,
+                      float add)
+{
+    for (size_t i = 0; i < n; ++i, src += channels)
+        for (int c = 0; c < channels; ++c)
+            planes[c][i] = static_cast<float>(src[c]) * mul + add;
+}
+
+void u8_to_s8_planar(const uint8_t* src, size_t n, int channels, int8_t* const* planes)
+{
+    for (size_t i = 0; i < n; ++i, src += channels)
+        for (int c = 0; c < channels; ++c)
+            planes[c][i] = static_cast<int8_t>(std::min(int(src[c]) - 127, 127));
+}
+
+void u8_gray_to_f32_planar(const uint8_t* src, size_t n, float* const* planes, int n_planes,
+                           float mul, float add)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        float v = static_cast<float>(src[i]) * mul + add;
+        for (int p = 0; p < n_planes; ++p)
+            planes[p][i] = v;
+    }
+}
+
+void u8_bgr_to_gray_f32(const uint8_t* src, size_t n, int channels, float* dst, float mul,
+                        float add)
+{
+    for (size_t i = 0; i < n; ++i, src += channels)
+    {
+        float v = kGrayB * static_cast<float>(src[0]) + kGrayG * static_cast<float>(src[1]);
+        v       = v + kGrayR * static_cast<float>(src[2]);
+        dst[i]  = v * mul + add;
+    }
+}
+
+namespace
+{
+
+/// exp(x) with the operation order shared by all variants (see kExpP)
+inline float exp_poly(float x)
+{
+    // written like the SIMD min/max, which return their second operand for NaN
+    x             = kExpHi < x ? kExpHi : x;
+    x             = kExpLo > x ? kExpLo : x;
+    const float n = std::floor(x * kLog2e + 0.5f);
+    float       r = x - n * kExpC1;
+    r             = r - n * kExpC2;
+
+    float y = kExpP[0];
+    for (int k = 1; k < 6; ++k)
+        y = y * r + kExpP[k];
+    y = y * (r * r) + r;
+    y = y + 1.0f;
+
+    // 2^n, n is in [-127, 128] after clamping; NaN is carried through y
+    const int32_t bits = (n != n ? 0 : static_cast<int32_t>(n) + 127) << 23;
+    float         pow2;
+    std::memcpy(&pow2, &bits, sizeof(pow2));
+    return y * pow2;
+}
+
+} // namespace
+
+void exp_f32(const float* src, float* dst, size_t n, float shift, float scale)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = exp_poly((src[i] - shift) * scale);
+}
+
+void exp_shifted_f32(const float* src, const float* shift, float* dst, size_t n, float scale)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = exp_poly((src[i] - shift[i]) * scale);
+}
+
+void argmax_update_f32(const float* src, size_t n, int32_t index, float* max, int32_t* arg)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (src[i] > max[i])
+        {
+            max[i] = src[i];
+            arg[i] = index;
+        }
+    }
+}
+
+size_t select_above_f32(const float* src, size_t n, float threshold, int32_t* indices)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (src[i] > threshold) indices[count++] = int32_t(i);
+    return count;
+}
+
+void transpose_32(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride,
+                  size_t rows, size_t cols)
+{
+    for (size_t r = 0; r < rows; ++r)
+        for (size_t c = 0; c < cols; ++c)
+            dst[c * dst_stride + r] = src[r * src_stride + c];
+}
+
+void f32_to_f16(const float* src, uint16_t* dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = half_float::detail::float2half<kHalfRoundStyle>(src[i]);
+}
+
+void f16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = half_float::detail::half2float<float>(src[i]);
+}
+
+void f32_to_bf16(const float* src, uint16_t* dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = bfloat16::round(src[i]);
+}
+
+void bf16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = float(bfloat16::from_bits(src[i]));
+}
+
+} // namespace scalar
+
+const kernel_table scalar_table{isa::scalar,
+                                scalar::u8_to_f32_planar,
+                                scalar::u8_to_s8_planar,
+                                scalar::u8_gray_to_f32_planar,
+                                scalar::u8_bgr_to_gray_f32,
+                                scalar::exp_f32,
+                                scalar::exp_shifted_f32,
+                                scalar::argmax_update_f32,
+                                scalar::select_above_f32,
+                                scalar::transpose_32,
+                                scalar::f32_to_f16,
+                                scalar::f16_to_f32,
+                                scalar::f32_to_bf16,
+                                scalar::bf16_to_f32};
+
+namespace
+{
+
+#ifdef EZTRT_X86_KERNELS
+void cpuid(int leaf, int subleaf, unsigned regs[4])
+{
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, subleaf);
+    for (int i = 0; i < 4; ++i)
+        regs[i] = static_cast<unsigned>(r[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+cpu_features query_cpu()
+{
+    cpu_features f;
+    unsigned     r[4];
+
+    cpuid(0, 0, r);
+    const unsigned max_leaf = r[0];
+    if (max_leaf < 1) return f;
+
+    cpuid(1, 0, r);
+    f.sse41           = (r[2] >> 19) & 1;
+    f.sse42           = (r[2] >> 20) & 1;
+    const bool osxsave = (r[2] >> 27) & 1;
+    const bool avx     = (r[2] >> 28) & 1;
+
+    // the OS has to save the extended register state for us to use AVX/AVX-512
+    const unsigned long long xcr0       = osxsave ? xgetbv0() : 0;
+    const bool               os_ymm     = (xcr0 & 0x6) == 0x6;
+    const bool               os_zmm     = (xcr0 & 0xE6) == 0xE6;
+
+    if (max_leaf >= 7)
+    {
+        cpuid(7, 0, r);
+        f.avx2     = avx && os_ymm && ((r[1] >> 5) & 1);
+        f.avx512f  = os_zmm && ((r[1] >> 16) & 1);
+        f.avx512bw = f.avx512f && ((r[1] >> 30) & 1);
+    }
+    return f;
+}
+#else
+cpu_features query_cpu() { return {}; }
+#endif
+
+const kernel_table* compiled_table(isa level)
+{
+    switch (level)
+    {
+    case isa::scalar: return &scalar_table;
+#ifdef EZTRT_X86_KERNELS
+    case isa::sse41: return &sse41_table;
+    case isa::avx2: return &avx2_table;
+    case isa::avx512: return &avx512_table;
+#endif
+    default: return nullptr;
+    }
+}
+
+bool supported(isa level)
+{
+    const auto& f = cpu();
+    switch (level)
+    {
+    case isa::scalar: return true;
+    case isa::sse41: return f.sse41;
+    case isa::avx2: return f.avx2;
+    case isa::avx512: return f.avx512f && f.avx512bw;
+    default: return false;
+    }
+}
+
+const kernel_table* initial_table()
+{
+    isa level = detect_isa();
+
+    // allow to restrict the level from the outside, e.g. to reproduce issues on older machines
+    if (const char* env = std::getenv("EZTRT_ISA"))
+    {
+        for (isa l : {isa::scalar, isa::sse41, isa::avx2, isa::avx512})
+        {
+            if (std::strcmp(env, to_str(l)) == 0 && l < level) level = l;
+        }
+    }
+    return compiled_table(level);
+}
+
+std::atomic<const kernel_table*>& selected()
+{
+    static std::atomic<const kernel_table*> table{initial_table()};
+    return table;
+}
+
+} // namespace
+
+const cpu_features& cpu()
+{
+    static const cpu_features features = query_cpu();
+    return features;
+}
+
+isa detect_isa()
+{
+    for (isa l : {isa::avx512, isa::avx2, isa::sse41})
+    {
+        if (compiled_table(l) && supported(l)) return l;
+    }
+    return isa::scalar;
+}
+
+const kernel_table* table_for(isa level)
+{
+    return supported(level) ? compiled_table(level) : nullptr;
+}
+
+const kernel_table& active() { return *selected().load(std::memory_order_acquire); }
+
+bool select_isa(isa level)
+{
+    auto table = table_for(level);
+    if (!table) return false;
+    selected().store(table, std::memory_order_release);
+    return true;
+}
+
+} // namespace kernels
+} // namespace eztrt
@@ -0,0 +1,367 @@
+#include "kernels_x86.h"
+
+#include <cstring>
+
+// AVX2 kernels, compiled with -mavx2 (/arch:AVX2 on MSVC).
+
+namespace eztrt
+{
+namespace kernels
+{
+namespace avx2
+{
+namespace
+{
+
+/// dst[0..15] = v[0..15] * mul + add
+inline void store16_f32(__m128i v, float* dst, float mul, float add)
+{
+    const __m128i parts[2] = {v, _mm_srli_si128(v, 8)};
+    for (int k = 0; k < 2; ++k)
+    {
+        __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(parts[k]));
+        _mm256_storeu_ps(dst + 8 * k,
+                         _mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(mul)), _mm256_set1_ps(add)));
+    }
+}
+
+/// dst[0..15] = gray(b, g, r) * mul + add
+inline void store16_gray_f32(__m128i b, __m128i g, __m128i r, float* dst, float mul, float add)
+{
+    const __m128i bs[2] = {b, _mm_srli_si128(b, 8)};
+    const __m128i gs[2] = {g, _mm_srli_si128(g, 8)};
+    const __m128i rs[2] = {r, _mm_srli_si128(r, 8)};
+    for (int k = 0; k < 2; ++k)
+    {
+        __m256 fb = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bs[k]));
+        __m256 fg = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(gs[k]));
+        __m256 fr = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(rs[k]));
+        __m256 v  = _mm256_add_ps(_mm256_mul_ps(fb, _mm256_set1_ps(kGrayB)),
+                                 _mm256_mul_ps(fg, _mm256_set1_ps(kGrayG)));
+        v         = _mm256_add_ps(v, _mm256_mul_ps(fr, _mm256_set1_ps(kGrayR)));
+        _mm256_storeu_ps(dst + 8 * k,
+                         _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(mul)), _mm256_set1_ps(add)));
+    }
+}
+
+void u8_to_f32_planar(const uint8_t* src, size_t n, int channels, float* const* planes, float mul,
+                      float add)
+{
+    size_t i = 0;
+    if (x86::supported_channels(channels))
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            for (int c = 0; c < channels; ++c)
+                store16_f32(v[c], planes[c] + i, mul, add);
+        }
+    }
+    offset_planes<float> tail(planes, channels, i);
+    scalar::u8_to_f32_planar(src + i * channels, n - i, channels, tail.ptrs, mul, add);
+}
+
+void u8_to_s8_planar(const uint8_t* src, size_t n, int channels, int8_t* const* planes)
+{
+    size_t i = 0;
+    if (x86::supported_channels(channels))
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            for (int c = 0; c < channels; ++c)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c] + i), x86::u8_minus_127(v[c]));
+        }
+    }
+    offset_planes<int8_t> tail(planes, channels, i);
+    scalar::u8_to_s8_planar(src + i * channels, n - i, channels, tail.ptrs);
+}
+
+void u8_gray_to_f32_planar(const uint8_t* src, size_t n, float* const* planes, int n_planes,
+                           float mul, float add)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        // convert once, then replicate the result into the remaining planes
+        store16_f32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), planes[0] + i, mul,
+                    add);
+        for (int p = 1; p < n_planes; ++p)
+            std::memcpy(planes[p] + i, planes[0] + i, 16 * sizeof(float));
+    }
+    offset_planes<float> tail(planes, n_planes, i);
+    scalar::u8_gray_to_f32_planar(src + i, n - i, tail.ptrs, n_planes, mul, add);
+}
+
+void u8_bgr_to_gray_f32(const uint8_t* src, size_t n, int channels, float* dst, float mul,
+                        float add)
+{
+    size_t i = 0;
+    if (channels == 3 || channels == 4)
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            store16_gray_f32(v[0], v[1], v[2], dst + i, mul, add);
+        }
+    }
+    scalar::u8_bgr_to_gray_f32(src + i * channels, n - i, channels, dst + i, mul, add);
+}
+
+/// exp(x) for 8 lanes, see kExpP for the operation order
+inline __m256 exp8(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_set1_ps(kExpHi), x);
+    x = _mm256_max_ps(_mm256_set1_ps(kExpLo), x);
+    const __m256 t = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)), _mm256_set1_ps(0.5f));
+    const __m256 n = _mm256_floor_ps(t);
+    __m256       r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(kExpC1)));
+    r             = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(kExpC2)));
+
+    __m256 y = _mm256_set1_ps(kExpP[0]);
+    for (int k = 1; k < 6; ++k)
+        y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(kExpP[k]));
+    y = _mm256_add_ps(_mm256_mul_ps(y, _mm256_mul_ps(r, r)), r);
+    y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+    const __m256i e = _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127));
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)));
+}
+
+void exp_f32(const float* src, float* dst, size_t n, float shift, float scale)
+{
+    const __m256 vshift = _mm256_set1_ps(shift);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t       i      = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 v = _mm256_sub_ps(_mm256_loadu_ps(src + i), vshift);
+        _mm256_storeu_ps(dst + i, exp8(_mm256_mul_ps(v, vscale)));
+    }
+    scalar::exp_f32(src + i, dst + i, n - i, shift, scale);
+}
+
+void exp_shifted_f32(const float* src, const float* shift, float* dst, size_t n, float scale)
+{
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t       i      = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 v = _mm256_sub_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(shift + i));
+        _mm256_storeu_ps(dst + i, exp8(_mm256_mul_ps(v, vscale)));
+    }
+    scalar::exp_shifted_f32(src + i, shift + i, dst + i, n - i, scale);
+}
+
+void argmax_update_f32(const float* src, size_t n, int32_t index, float* max, int32_t* arg)
+{
+    const __m256i vindex = _mm256_set1_epi32(index);
+    size_t        i      = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256  x  = _mm256_loadu_ps(src + i);
+        const __m256  m  = _mm256_loadu_ps(max + i);
+        const __m256  gt = _mm256_cmp_ps(x, m, _CMP_GT_OQ);
+        const __m256i a  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(arg + i));
+        _mm256_storeu_ps(max + i, _mm256_blendv_ps(m, x, gt));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(arg + i),
+                            _mm256_blendv_epi8(a, vindex, _mm256_castps_si256(gt)));
+    }
+    scalar::argmax_update_f32(src + i, n - i, index, max + i, arg + i);
+}
+
+size_t select_above_f32(const float* src, size_t n, float threshold, int32_t* indices)
+{
+    // most scores of a classifier are far below the threshold, only groups with a hit are scanned
+    const __m256 vthreshold = _mm256_set1_ps(threshold);
+    size_t       count      = 0;
+    size_t       i          = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256   x    = _mm256_loadu_ps(src + i);
+        const unsigned mask = _mm256_movemask_ps(_mm256_cmp_ps(x, vthreshold, _CMP_GT_OQ));
+        if (!mask) continue;
+        for (int j = 0; j < 8; ++j)
+            if (mask & (1u << j)) indices[count++] = int32_t(i + j);
+    }
+    for (; i < n; ++i)
+        if (src[i] > threshold) indices[count++] = int32_t(i);
+    return count;
+}
+
+/// Transposes an 8x8 tile of 32-bit elements
+inline void transpose8x8(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride)
+{
+    __m256i r[8], t[8], u[8];
+    for (int k = 0; k < 8; ++k)
+        r[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k * src_stride));
+
+    // interleave pairs of rows, then pairs of pairs: u[4 * h + j] holds column j (lane 0) and
+    // column j + 4 (lane 1) of rows 4 * h .. 4 * h + 3
+    for (int k = 0; k < 4; ++k)
+    {
+        t[2 * k]     = _mm256_unpacklo_epi32(r[2 * k], r[2 * k + 1]);
+        t[2 * k + 1] = _mm256_unpackhi_epi32(r[2 * k], r[2 * k + 1]);
+    }
+    for (int h = 0; h < 2; ++h)
+    {
+        u[4 * h + 0] = _mm256_unpacklo_epi64(t[4 * h + 0], t[4 * h + 2]);
+        u[4 * h + 1] = _mm256_unpackhi_epi64(t[4 * h + 0], t[4 * h + 2]);
+        u[4 * h + 2] = _mm256_unpacklo_epi64(t[4 * h + 1], t[4 * h + 3]);
+        u[4 * h + 3] = _mm256_unpackhi_epi64(t[4 * h + 1], t[4 * h + 3]);
+    }
+    for (int j = 0; j < 4; ++j)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j * dst_stride),
+                            _mm256_permute2x128_si256(u[j], u[4 + j], 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (j + 4) * dst_stride),
+                            _mm256_permute2x128_si256(u[j], u[4 + j], 0x31));
+    }
+}
+
+void transpose_32(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride,
+                  size_t rows, size_t cols)
+{
+    x86::transpose_tiled<8>(src, src_stride, dst, dst_stride, rows, cols, transpose8x8);
+}
+
+/// Bits of the halves closest to x[0..7], see `kHalfSimdRounding`
+inline __m128i f32_to_f16_8(__m256 x)
+{
+    const __m256i one  = _mm256_set1_epi32(1);
+    const __m256i u    = _mm256_castps_si256(x);
+    const __m256i a    = _mm256_and_si256(u, _mm256_set1_epi32(0x7FFFFFFF));
+    const __m256i sign = _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(0x8000));
+
+    // normal results: rebias the exponent, round at bit 12 (a carry may overflow into infinity)
+    __m256i normal = _mm256_srli_epi32(_mm256_sub_epi32(a, _mm256_set1_epi32(112 << 23)), 13);
+    __m256i round  = _mm256_and_si256(_mm256_srli_epi32(a, 12), one);
+#if HALF_ROUND_TIES_TO_EVEN
+    const __m256i sticky = _mm256_min_epu32(_mm256_and_si256(a, _mm256_set1_epi32(0xFFF)), one);
+    round                = _mm256_and_si256(round, _mm256_or_si256(sticky, normal));
+#endif
+    normal = _mm256_add_epi32(normal, round);
+
+    // subnormal results (and zero)
+    const __m256 t = _mm256_mul_ps(_mm256_castsi256_ps(a), _mm256_set1_ps(16777216.f));
+#if HALF_ROUND_TIES_TO_EVEN
+    const __m256i sub =
+        _mm256_cvttps_epi32(_mm256_round_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+#else
+    const __m256i sub =
+        _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(t, _mm256_set1_ps(0.5f))));
+#endif
+
+    // overflow to infinity, NaNs keep the upper bits of their payload
+    const __m256i payload = _mm256_and_si256(_mm256_srli_epi32(a, 13), _mm256_set1_epi32(0x3FF));
+    const __m256i is_nan  = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7F800000));
+    const __m256i inf =
+        _mm256_or_si256(_mm256_set1_epi32(0x7C00), _mm256_and_si256(is_nan, payload));
+
+    __m256i h =
+        _mm256_blendv_epi8(sub, normal, _mm256_cmpgt_epi32(a, _mm256_set1_epi32((113 << 23) - 1)));
+    h = _mm256_blendv_epi8(h, inf, _mm256_cmpgt_epi32(a, _mm256_set1_epi32((143 << 23) - 1)));
+    h = _mm256_or_si256(h, sign);
+    return _mm_packus_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+}
+
+/// Floats of the halves h[0..7]
+inline __m256 f16_to_f32_8(__m128i halves)
+{
+    const __m256i h        = _mm256_cvtepu16_epi32(halves);
+    const __m256i exp_mask = _mm256_set1_epi32(0x7C00 << 13);
+    __m256i       o        = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x7FFF)), 13);
+    const __m256i e        = _mm256_and_si256(o, exp_mask);
+    o                      = _mm256_add_epi32(o, _mm256_set1_epi32(112 << 23));
+
+    // infinities and NaNs get the maximum exponent, subnormals are normalized by a subtraction
+    const __m256i special = _mm256_cmpeq_epi32(e, exp_mask);
+    o = _mm256_add_epi32(o, _mm256_and_si256(special, _mm256_set1_epi32(112 << 23)));
+    const __m256i tiny   = _mm256_cmpeq_epi32(e, _mm256_setzero_si256());
+    const __m256i biased = _mm256_add_epi32(o, _mm256_set1_epi32(1 << 23));
+    const __m256  normed = _mm256_sub_ps(_mm256_castsi256_ps(biased),
+                                         _mm256_castsi256_ps(_mm256_set1_epi32(113 << 23)));
+    o = _mm256_blendv_epi8(o, _mm256_castps_si256(normed), tiny);
+
+    const __m256i sign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16);
+    return _mm256_castsi256_ps(_mm256_or_si256(o, sign));
+}
+
+void f32_to_f16(const float* src, uint16_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         f32_to_f16_8(_mm256_loadu_ps(src + i)));
+    scalar::f32_to_f16(src + i, dst + i, n - i);
+}
+
+void f16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, f16_to_f32_8(h));
+    }
+    scalar::f16_to_f32(src + i, dst + i, n - i);
+}
+
+/// Bits of the bfloat16s closest to x[0..7], see `bfloat16::round`
+inline __m128i f32_to_bf16_8(__m256 x)
+{
+    const __m256i u       = _mm256_castps_si256(x);
+    const __m256i lsb     = _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1));
+    const __m256i sum     = _mm256_add_epi32(_mm256_add_epi32(u, lsb), _mm256_set1_epi32(0x7FFF));
+    const __m256i rounded = _mm256_srli_epi32(sum, 16);
+    const __m256i nan     = _mm256_or_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(0x40));
+    const __m256i a       = _mm256_and_si256(u, _mm256_set1_epi32(0x7FFFFFFF));
+    const __m256i b =
+        _mm256_blendv_epi8(rounded, nan, _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7F800000)));
+    return _mm_packus_epi32(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+}
+
+void f32_to_bf16(const float* src, uint16_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         f32_to_bf16_8(_mm256_loadu_ps(src + i)));
+    scalar::f32_to_bf16(src + i, dst + i, n - i);
+}
+
+void bf16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                            _mm256_slli_epi32(_mm256_cvtepu16_epi32(b), 16));
+    }
+    scalar::bf16_to_f32(src + i, dst + i, n - i);
+}
+
+} // namespace
+} // namespace avx2
+
+const kernel_table avx2_table{isa::avx2,
+                              avx2::u8_to_f32_planar,
+                              avx2::u8_to_s8_planar,
+                              avx2::u8_gray_to_f32_planar,
+                              avx2::u8_bgr_to_gray_f32,
+                              avx2::exp_f32,
+                              avx2::exp_shifted_f32,
+                              avx2::argmax_update_f32,
+                              avx2::select_above_f32,
+                              avx2::transpose_32,
+                              kHalfSimdRounding ? avx2::f32_to_f16 : scalar::f32_to_f16,
+                              avx2::f16_to_f32,
+                              avx2::f32_to_bf16,
+                              avx2::bf16_to_f32};
+
+} // namespace kernels
+} // namespace eztrt
@@ -0,0 +1,365 @@
+#include "kernels_x86.h"
+
+#include <cstring>
+
+// AVX-512 (F + BW) kernels, compiled with -mavx512f -mavx512bw (/arch:AVX512 on MSVC).
+
+namespace eztrt
+{
+namespace kernels
+{
+namespace avx512
+{
+namespace
+{
+
+/// dst[0..15] = v[0..15] * mul + add
+inline void store16_f32(__m128i v, float* dst, float mul, float add)
+{
+    __m512 f = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(v));
+    _mm512_storeu_ps(dst, _mm512_add_ps(_mm512_mul_ps(f, _mm512_set1_ps(mul)), _mm512_set1_ps(add)));
+}
+
+/// dst[0..15] = gray(b, g, r) * mul + add
+inline void store16_gray_f32(__m128i b, __m128i g, __m128i r, float* dst, float mul, float add)
+{
+    __m512 fb = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(b));
+    __m512 fg = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(g));
+    __m512 fr = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(r));
+    __m512 v  = _mm512_add_ps(_mm512_mul_ps(fb, _mm512_set1_ps(kGrayB)),
+                             _mm512_mul_ps(fg, _mm512_set1_ps(kGrayG)));
+    v         = _mm512_add_ps(v, _mm512_mul_ps(fr, _mm512_set1_ps(kGrayR)));
+    _mm512_storeu_ps(dst, _mm512_add_ps(_mm512_mul_ps(v, _mm512_set1_ps(mul)), _mm512_set1_ps(add)));
+}
+
+void u8_to_f32_planar(const uint8_t* src, size_t n, int channels, float* const* planes, float mul,
+                      float add)
+{
+    size_t i = 0;
+    if (x86::supported_channels(channels))
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            for (int c = 0; c < channels; ++c)
+                store16_f32(v[c], planes[c] + i, mul, add);
+        }
+    }
+    offset_planes<float> tail(planes, channels, i);
+    scalar::u8_to_f32_planar(src + i * channels, n - i, channels, tail.ptrs, mul, add);
+}
+
+void u8_to_s8_planar(const uint8_t* src, size_t n, int channels, int8_t* const* planes)
+{
+    size_t i = 0;
+    if (x86::supported_channels(channels))
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            for (int c = 0; c < channels; ++c)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c] + i), x86::u8_minus_127(v[c]));
+        }
+    }
+    offset_planes<int8_t> tail(planes, channels, i);
+    scalar::u8_to_s8_planar(src + i * channels, n - i, channels, tail.ptrs);
+}
+
+void u8_gray_to_f32_planar(const uint8_t* src, size_t n, float* const* planes, int n_planes,
+                           float mul, float add)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        // convert once, then replicate the result into the remaining planes
+        store16_f32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), planes[0] + i, mul,
+                    add);
+        for (int p = 1; p < n_planes; ++p)
+            std::memcpy(planes[p] + i, planes[0] + i, 16 * sizeof(float));
+    }
+    offset_planes<float> tail(planes, n_planes, i);
+    scalar::u8_gray_to_f32_planar(src + i, n - i, tail.ptrs, n_planes, mul, add);
+}
+
+void u8_bgr_to_gray_f32(const uint8_t* src, size_t n, int channels, float* dst, float mul,
+                        float add)
+{
+    size_t i = 0;
+    if (channels == 3 || channels == 4)
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            store16_gray_f32(v[0], v[1], v[2], dst + i, mul, add);
+        }
+    }
+    scalar::u8_bgr_to_gray_f32(src + i * channels, n - i, channels, dst + i, mul, add);
+}
+
+/// exp(x) for 16 lanes, see kExpP for the operation order
+inline __m512 exp16(__m512 x)
+{
+    x = _mm512_min_ps(_mm512_set1_ps(kExpHi), x);
+    x = _mm512_max_ps(_mm512_set1_ps(kExpLo), x);
+    const __m512 t = _mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(kLog2e)), _mm512_set1_ps(0.5f));
+    const __m512 n = _mm512_roundscale_ps(t, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512       r = _mm512_sub_ps(x, _mm512_mul_ps(n, _mm512_set1_ps(kExpC1)));
+    r             = _mm512_sub_ps(r, _mm512_mul_ps(n, _mm512_set1_ps(kExpC2)));
+
+    __m512 y = _mm512_set1_ps(kExpP[0]);
+    for (int k = 1; k < 6; ++k)
+        y = _mm512_add_ps(_mm512_mul_ps(y, r), _mm512_set1_ps(kExpP[k]));
+    y = _mm512_add_ps(_mm512_mul_ps(y, _mm512_mul_ps(r, r)), r);
+    y = _mm512_add_ps(y, _mm512_set1_ps(1.0f));
+
+    const __m512i e = _mm512_add_epi32(_mm512_cvttps_epi32(n), _mm512_set1_epi32(127));
+    return _mm512_mul_ps(y, _mm512_castsi512_ps(_mm512_slli_epi32(e, 23)));
+}
+
+void exp_f32(const float* src, float* dst, size_t n, float shift, float scale)
+{
+    const __m512 vshift = _mm512_set1_ps(shift);
+    const __m512 vscale = _mm512_set1_ps(scale);
+    size_t       i      = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 v = _mm512_sub_ps(_mm512_loadu_ps(src + i), vshift);
+        _mm512_storeu_ps(dst + i, exp16(_mm512_mul_ps(v, vscale)));
+    }
+    scalar::exp_f32(src + i, dst + i, n - i, shift, scale);
+}
+
+void exp_shifted_f32(const float* src, const float* shift, float* dst, size_t n, float scale)
+{
+    const __m512 vscale = _mm512_set1_ps(scale);
+    size_t       i      = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 v = _mm512_sub_ps(_mm512_loadu_ps(src + i), _mm512_loadu_ps(shift + i));
+        _mm512_storeu_ps(dst + i, exp16(_mm512_mul_ps(v, vscale)));
+    }
+    scalar::exp_shifted_f32(src + i, shift + i, dst + i, n - i, scale);
+}
+
+void argmax_update_f32(const float* src, size_t n, int32_t index, float* max, int32_t* arg)
+{
+    const __m512i vindex = _mm512_set1_epi32(index);
+    size_t        i      = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512    x  = _mm512_loadu_ps(src + i);
+        const __mmask16 gt = _mm512_cmp_ps_mask(x, _mm512_loadu_ps(max + i), _CMP_GT_OQ);
+        _mm512_mask_storeu_ps(max + i, gt, x);
+        _mm512_mask_storeu_epi32(arg + i, gt, vindex);
+    }
+    scalar::argmax_update_f32(src + i, n - i, index, max + i, arg + i);
+}
+
+size_t select_above_f32(const float* src, size_t n, float threshold, int32_t* indices)
+{
+    // most scores of a classifier are far below the threshold, only groups with a hit are scanned
+    const __m512 vthreshold = _mm512_set1_ps(threshold);
+    size_t       count      = 0;
+    size_t       i          = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512    x    = _mm512_loadu_ps(src + i);
+        const __mmask16 mask = _mm512_cmp_ps_mask(x, vthreshold, _CMP_GT_OQ);
+        if (!mask) continue;
+        for (int j = 0; j < 16; ++j)
+            if (mask & (1u << j)) indices[count++] = int32_t(i + j);
+    }
+    for (; i < n; ++i)
+        if (src[i] > threshold) indices[count++] = int32_t(i);
+    return count;
+}
+
+/// Transposes a 16x16 tile of 32-bit elements
+inline void transpose16x16(const uint32_t* src, size_t src_stride, uint32_t* dst,
+                           size_t dst_stride)
+{
+    __m512i r[16], t[16], u[16], v[16];
+    for (int k = 0; k < 16; ++k)
+        r[k] = _mm512_loadu_si512(src + k * src_stride);
+
+    // within every 128-bit lane, as for a 4x4 transpose: u[4 * q + j] holds columns j, j + 4,
+    // j + 8 and j + 12 (one per lane) of rows 4 * q .. 4 * q + 3
+    for (int k = 0; k < 8; ++k)
+    {
+        t[2 * k]     = _mm512_unpacklo_epi32(r[2 * k], r[2 * k + 1]);
+        t[2 * k + 1] = _mm512_unpackhi_epi32(r[2 * k], r[2 * k + 1]);
+    }
+    for (int q = 0; q < 4; ++q)
+    {
+        u[4 * q + 0] = _mm512_unpacklo_epi64(t[4 * q + 0], t[4 * q + 2]);
+        u[4 * q + 1] = _mm512_unpackhi_epi64(t[4 * q + 0], t[4 * q + 2]);
+        u[4 * q + 2] = _mm512_unpacklo_epi64(t[4 * q + 1], t[4 * q + 3]);
+        u[4 * q + 3] = _mm512_unpackhi_epi64(t[4 * q + 1], t[4 * q + 3]);
+    }
+
+    // then the 128-bit lanes, in two rounds of picking the even or the odd lanes of two registers:
+    // v[j] and v[4 + j] hold columns (j, j + 8) and (j + 4, j + 12) of rows 0 - 7, v[8 + j] and
+    // v[12 + j] the same for rows 8 - 15
+    for (int j = 0; j < 4; ++j)
+    {
+        v[j]      = _mm512_shuffle_i32x4(u[j], u[4 + j], 0x88);
+        v[4 + j]  = _mm512_shuffle_i32x4(u[j], u[4 + j], 0xdd);
+        v[8 + j]  = _mm512_shuffle_i32x4(u[8 + j], u[12 + j], 0x88);
+        v[12 + j] = _mm512_shuffle_i32x4(u[8 + j], u[12 + j], 0xdd);
+    }
+    const auto store = [&](int column, __m512i x) {
+        _mm512_storeu_si512(dst + column * dst_stride, x);
+    };
+    for (int j = 0; j < 4; ++j)
+    {
+        store(j, _mm512_shuffle_i32x4(v[j], v[8 + j], 0x88));
+        store(j + 8, _mm512_shuffle_i32x4(v[j], v[8 + j], 0xdd));
+        store(j + 4, _mm512_shuffle_i32x4(v[4 + j], v[12 + j], 0x88));
+        store(j + 12, _mm512_shuffle_i32x4(v[4 + j], v[12 + j], 0xdd));
+    }
+}
+
+void transpose_32(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride,
+                  size_t rows, size_t cols)
+{
+    x86::transpose_tiled<16>(src, src_stride, dst, dst_stride, rows, cols, transpose16x16);
+}
+
+/// Bits of the halves closest to x[0..15], see `kHalfSimdRounding`
+inline __m256i f32_to_f16_16(__m512 x)
+{
+    const __m512i one  = _mm512_set1_epi32(1);
+    const __m512i u    = _mm512_castps_si512(x);
+    const __m512i a    = _mm512_and_si512(u, _mm512_set1_epi32(0x7FFFFFFF));
+    const __m512i sign = _mm512_and_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(0x8000));
+
+    // normal results: rebias the exponent, round at bit 12 (a carry may overflow into infinity)
+    __m512i normal = _mm512_srli_epi32(_mm512_sub_epi32(a, _mm512_set1_epi32(112 << 23)), 13);
+    __m512i round  = _mm512_and_si512(_mm512_srli_epi32(a, 12), one);
+#if HALF_ROUND_TIES_TO_EVEN
+    const __m512i sticky = _mm512_min_epu32(_mm512_and_si512(a, _mm512_set1_epi32(0xFFF)), one);
+    round                = _mm512_and_si512(round, _mm512_or_si512(sticky, normal));
+#endif
+    normal = _mm512_add_epi32(normal, round);
+
+    // subnormal results (and zero)
+    const __m512 t = _mm512_mul_ps(_mm512_castsi512_ps(a), _mm512_set1_ps(16777216.f));
+#if HALF_ROUND_TIES_TO_EVEN
+    const __m512i sub =
+        _mm512_cvttps_epi32(_mm512_roundscale_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+#else
+    const __m512i sub = _mm512_cvttps_epi32(_mm512_roundscale_ps(
+        _mm512_add_ps(t, _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+#endif
+
+    // overflow to infinity, NaNs keep the upper bits of their payload
+    const __m512i payload = _mm512_and_si512(_mm512_srli_epi32(a, 13), _mm512_set1_epi32(0x3FF));
+    const __mmask16 is_nan = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7F800000));
+    const __m512i   inf    = _mm512_mask_or_epi32(_mm512_set1_epi32(0x7C00), is_nan,
+                                                  _mm512_set1_epi32(0x7C00), payload);
+
+    __m512i h = _mm512_mask_blend_epi32(
+        _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32((113 << 23) - 1)), sub, normal);
+    h = _mm512_mask_blend_epi32(_mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32((143 << 23) - 1)), h,
+                                inf);
+    return _mm512_cvtepi32_epi16(_mm512_or_si512(h, sign));
+}
+
+/// Floats of the halves h[0..15]
+inline __m512 f16_to_f32_16(__m256i halves)
+{
+    const __m512i h        = _mm512_cvtepu16_epi32(halves);
+    const __m512i exp_mask = _mm512_set1_epi32(0x7C00 << 13);
+    __m512i       o        = _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(0x7FFF)), 13);
+    const __m512i e        = _mm512_and_si512(o, exp_mask);
+    o                      = _mm512_add_epi32(o, _mm512_set1_epi32(112 << 23));
+
+    // infinities and NaNs get the maximum exponent, subnormals are normalized by a subtraction
+    const __mmask16 special = _mm512_cmpeq_epi32_mask(e, exp_mask);
+    o = _mm512_mask_add_epi32(o, special, o, _mm512_set1_epi32(112 << 23));
+    const __mmask16 tiny   = _mm512_cmpeq_epi32_mask(e, _mm512_setzero_si512());
+    const __m512i   biased = _mm512_add_epi32(o, _mm512_set1_epi32(1 << 23));
+    const __m512    normed = _mm512_sub_ps(_mm512_castsi512_ps(biased),
+                                           _mm512_castsi512_ps(_mm512_set1_epi32(113 << 23)));
+    o = _mm512_mask_blend_epi32(tiny, o, _mm512_castps_si512(normed));
+
+    const __m512i sign = _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(0x8000)), 16);
+    return _mm512_castsi512_ps(_mm512_or_si512(o, sign));
+}
+
+void f32_to_f16(const float* src, uint16_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                            f32_to_f16_16(_mm512_loadu_ps(src + i)));
+    scalar::f32_to_f16(src + i, dst + i, n - i);
+}
+
+void f16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm512_storeu_ps(dst + i, f16_to_f32_16(h));
+    }
+    scalar::f16_to_f32(src + i, dst + i, n - i);
+}
+
+/// Bits of the bfloat16s closest to x[0..15], see `bfloat16::round`
+inline __m256i f32_to_bf16_16(__m512 x)
+{
+    const __m512i   u       = _mm512_castps_si512(x);
+    const __m512i   lsb     = _mm512_and_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(1));
+    const __m512i   sum     = _mm512_add_epi32(_mm512_add_epi32(u, lsb), _mm512_set1_epi32(0x7FFF));
+    const __m512i   rounded = _mm512_srli_epi32(sum, 16);
+    const __m512i   nan     = _mm512_or_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(0x40));
+    const __m512i   a       = _mm512_and_si512(u, _mm512_set1_epi32(0x7FFFFFFF));
+    const __mmask16 is_nan  = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7F800000));
+    return _mm512_cvtepi32_epi16(_mm512_mask_blend_epi32(is_nan, rounded, nan));
+}
+
+void f32_to_bf16(const float* src, uint16_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                            f32_to_bf16_16(_mm512_loadu_ps(src + i)));
+    scalar::f32_to_bf16(src + i, dst + i, n - i);
+}
+
+void bf16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm512_storeu_si512(dst + i, _mm512_slli_epi32(_mm512_cvtepu16_epi32(b), 16));
+    }
+    scalar::bf16_to_f32(src + i, dst + i, n - i);
+}
+
+} // namespace
+} // namespace avx512
+
+const kernel_table avx512_table{isa::avx512,
+                                avx512::u8_to_f32_planar,
+                                avx512::u8_to_s8_planar,
+                                avx512::u8_gray_to_f32_planar,
+                                avx512::u8_bgr_to_gray_f32,
+                                avx512::exp_f32,
+                                avx512::exp_shifted_f32,
+                                avx512::argmax_update_f32,
+                                avx512::select_above_f32,
+                                avx512::transpose_32,
+                                kHalfSimdRounding ? avx512::f32_to_f16 : scalar::f32_to_f16,
+                                avx512::f16_to_f32,
+                                avx512::f32_to_bf16,
+                                avx512::bf16_to_f32};
+
+} // namespace kernels
+} // namespace eztrt
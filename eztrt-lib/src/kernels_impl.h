@@ -0,0 +1,104 @@
+#pragma once
+
+#include "eztrt/bfloat16.h"
+#include "eztrt/half.h"
+#include "eztrt/kernels.h"
+
+// Private declarations shared between the per-ISA kernel translation units.
+
+namespace eztrt
+{
+namespace kernels
+{
+namespace scalar
+{
+void u8_to_f32_planar(const uint8_t* src, size_t n, int channels, float* const* planes, float mul,
+                      float add);
+void u8_to_s8_planar(const uint8_t* src, size_t n, int channels, int8_t* const* planes);
+void u8_gray_to_f32_planar(const uint8_t* src, size_t n, float* const* planes, int n_planes,
+                           float mul, float add);
+void u8_bgr_to_gray_f32(const uint8_t* src, size_t n, int channels, float* dst, float mul,
+                        float add);
+void exp_f32(const float* src, float* dst, size_t n, float shift, float scale);
+void exp_shifted_f32(const float* src, const float* shift, float* dst, size_t n, float scale);
+void argmax_update_f32(const float* src, size_t n, int32_t index, float* max, int32_t* arg);
+size_t select_above_f32(const float* src, size_t n, float threshold, int32_t* indices);
+void transpose_32(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride,
+                  size_t rows, size_t cols);
+void f32_to_f16(const float* src, uint16_t* dst, size_t n);
+void f16_to_f32(const uint16_t* src, float* dst, size_t n);
+void f32_to_bf16(const float* src, uint16_t* dst, size_t n);
+void bf16_to_f32(const uint16_t* src, float* dst, size_t n);
+} // namespace scalar
+
+// weights used by cv::COLOR_BGR2GRAY. All variants must evaluate
+// (kGrayB * b + kGrayG * g) + kGrayR * r in this order to stay bit-exact.
+constexpr float kGrayB = 0.114f;
+constexpr float kGrayG = 0.587f;
+constexpr float kGrayR = 0.299f;
+
+// exp(x) as in Cephes' expf: x = n * ln(2) + r with |r| <= ln(2) / 2, exp(r) from a degree 5
+// polynomial and 2^n built in the exponent bits. The relative error is below 2 ulp on the whole
+// clamped range [kExpLo, kExpHi]; kExpLo maps to exactly 0. All variants have to evaluate
+//   x = min(kExpHi, x), x = max(kExpLo, x), n = floor(x * kLog2e + 0.5),
+//   r = (x - n * kExpC1) - n * kExpC2, y = ((((p0 r + p1) r + p2) r + p3) r + p4) r + p5,
+//   y = (y * r^2 + r) + 1, result = y * 2^n
+// in this order to stay bit-exact.
+constexpr float kExpHi  = 88.3762626647949f;
+constexpr float kExpLo  = -88.3762626647949f;
+constexpr float kLog2e  = 1.44269504088896341f;
+constexpr float kExpC1  = 0.693359375f;
+constexpr float kExpC2  = -2.12194440e-4f;
+constexpr float kExpP[] = {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+                           4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+
+// half_float::half conversions. The SIMD variants of f32_to_f16 implement round to nearest as
+// configured in half.h (ties away from zero unless HALF_ROUND_TIES_TO_EVEN): normal results round
+// at mantissa bit 12, subnormal ones round |x| * 2^24 to an integer in float arithmetic, which is
+// exact there. Other rounding styles always use the scalar kernel. NaNs keep the upper 10 bits of
+// their payload (so a NaN with only lower payload bits becomes infinity, like in half.h).
+constexpr auto kHalfRoundStyle   = static_cast<std::float_round_style>(HALF_ROUND_STYLE);
+constexpr bool kHalfSimdRounding = kHalfRoundStyle == std::round_to_nearest;
+
+// bfloat16 conversions round to nearest, ties to even, by adding 0x7FFF plus the lowest kept bit
+// and truncating; NaNs are made quiet instead (see `bfloat16::round`). The SIMD variants do not
+// use AVX-512 BF16's vcvtneps2bf16, which flushes subnormal inputs to zero.
+
+constexpr int kMaxPlanes = 4;
+
+// Everything defined in this header is compiled into the per-ISA translation units with different
+// target flags. Templates and inline functions must therefore have internal linkage, an ODR-merged
+// copy could contain instructions the CPU running the lower ISA level does not support.
+namespace
+{
+
+/// Advances every plane pointer by `offset` elements, used to hand the tail of a row to the
+/// scalar kernels.
+template<typename T>
+struct offset_planes
+{
+    offset_planes(T* const* planes, int n, size_t offset)
+    {
+        for (int p = 0; p < n && p < kMaxPlanes; ++p)
+            ptrs[p] = planes[p] + offset;
+    }
+    T* ptrs[kMaxPlanes]{};
+};
+
+} // namespace
+
+extern const kernel_table scalar_table;
+#ifdef EZTRT_X86_KERNELS
+extern const kernel_table sse41_table;
+extern const kernel_table avx2_table;
+extern const kernel_table avx512_table;
+
+namespace sse42
+{
+/// CRC-32C update without the pre- and post-inversion, see `eztrt::crc32c`
+uint32_t crc32c(const uint8_t* p, size_t n, uint32_t crc);
+} // namespace sse42
+#endif
+
+} // namespace kernels
+} // namespace eztrt
@@ -0,0 +1,352 @@
+#include "kernels_x86.h"
+
+#include <cstring>
+
+// SSE4.1 kernels, compiled with -msse4.1 (or the MSVC x64 default).
+
+namespace eztrt
+{
+namespace kernels
+{
+namespace sse41
+{
+namespace
+{
+
+/// dst[0..15] = v[0..15] * mul + add
+inline void store16_f32(__m128i v, float* dst, float mul, float add)
+{
+    const __m128i parts[4] = {v, _mm_srli_si128(v, 4), _mm_srli_si128(v, 8), _mm_srli_si128(v, 12)};
+    for (int k = 0; k < 4; ++k)
+    {
+        __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(parts[k]));
+        _mm_storeu_ps(dst + 4 * k, _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(mul)), _mm_set1_ps(add)));
+    }
+}
+
+/// dst[0..15] = gray(b, g, r) * mul + add
+inline void store16_gray_f32(__m128i b, __m128i g, __m128i r, float* dst, float mul, float add)
+{
+    const __m128i bs[4] = {b, _mm_srli_si128(b, 4), _mm_srli_si128(b, 8), _mm_srli_si128(b, 12)};
+    const __m128i gs[4] = {g, _mm_srli_si128(g, 4), _mm_srli_si128(g, 8), _mm_srli_si128(g, 12)};
+    const __m128i rs[4] = {r, _mm_srli_si128(r, 4), _mm_srli_si128(r, 8), _mm_srli_si128(r, 12)};
+    for (int k = 0; k < 4; ++k)
+    {
+        __m128 fb = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(bs[k]));
+        __m128 fg = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(gs[k]));
+        __m128 fr = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(rs[k]));
+        __m128 v  = _mm_add_ps(_mm_mul_ps(fb, _mm_set1_ps(kGrayB)), _mm_mul_ps(fg, _mm_set1_ps(kGrayG)));
+        v         = _mm_add_ps(v, _mm_mul_ps(fr, _mm_set1_ps(kGrayR)));
+        _mm_storeu_ps(dst + 4 * k, _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(mul)), _mm_set1_ps(add)));
+    }
+}
+
+void u8_to_f32_planar(const uint8_t* src, size_t n, int channels, float* const* planes, float mul,
+                      float add)
+{
+    size_t i = 0;
+    if (x86::supported_channels(channels))
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            for (int c = 0; c < channels; ++c)
+                store16_f32(v[c], planes[c] + i, mul, add);
+        }
+    }
+    offset_planes<float> tail(planes, channels, i);
+    scalar::u8_to_f32_planar(src + i * channels, n - i, channels, tail.ptrs, mul, add);
+}
+
+void u8_to_s8_planar(const uint8_t* src, size_t n, int channels, int8_t* const* planes)
+{
+    size_t i = 0;
+    if (x86::supported_channels(channels))
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            for (int c = 0; c < channels; ++c)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c] + i), x86::u8_minus_127(v[c]));
+        }
+    }
+    offset_planes<int8_t> tail(planes, channels, i);
+    scalar::u8_to_s8_planar(src + i * channels, n - i, channels, tail.ptrs);
+}
+
+void u8_gray_to_f32_planar(const uint8_t* src, size_t n, float* const* planes, int n_planes,
+                           float mul, float add)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        // convert once, then replicate the result into the remaining planes
+        store16_f32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), planes[0] + i, mul,
+                    add);
+        for (int p = 1; p < n_planes; ++p)
+            std::memcpy(planes[p] + i, planes[0] + i, 16 * sizeof(float));
+    }
+    offset_planes<float> tail(planes, n_planes, i);
+    scalar::u8_gray_to_f32_planar(src + i, n - i, tail.ptrs, n_planes, mul, add);
+}
+
+void u8_bgr_to_gray_f32(const uint8_t* src, size_t n, int channels, float* dst, float mul,
+                        float add)
+{
+    size_t i = 0;
+    if (channels == 3 || channels == 4)
+    {
+        __m128i v[4];
+        for (; i + 16 <= n; i += 16)
+        {
+            x86::load_deinterleave16(src + i * channels, channels, v);
+            store16_gray_f32(v[0], v[1], v[2], dst + i, mul, add);
+        }
+    }
+    scalar::u8_bgr_to_gray_f32(src + i * channels, n - i, channels, dst + i, mul, add);
+}
+
+/// exp(x) for 4 lanes, see kExpP for the operation order
+inline __m128 exp4(__m128 x)
+{
+    x = _mm_min_ps(_mm_set1_ps(kExpHi), x);
+    x = _mm_max_ps(_mm_set1_ps(kExpLo), x);
+    const __m128 t = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(kLog2e)), _mm_set1_ps(0.5f));
+    const __m128 n = _mm_floor_ps(t);
+    __m128       r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(kExpC1)));
+    r             = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(kExpC2)));
+
+    __m128 y = _mm_set1_ps(kExpP[0]);
+    for (int k = 1; k < 6; ++k)
+        y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(kExpP[k]));
+    y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(r, r)), r);
+    y = _mm_add_ps(y, _mm_set1_ps(1.0f));
+
+    const __m128i e = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127));
+    return _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(e, 23)));
+}
+
+void exp_f32(const float* src, float* dst, size_t n, float shift, float scale)
+{
+    const __m128 vshift = _mm_set1_ps(shift);
+    const __m128 vscale = _mm_set1_ps(scale);
+    size_t       i      = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 v = _mm_sub_ps(_mm_loadu_ps(src + i), vshift);
+        _mm_storeu_ps(dst + i, exp4(_mm_mul_ps(v, vscale)));
+    }
+    scalar::exp_f32(src + i, dst + i, n - i, shift, scale);
+}
+
+void exp_shifted_f32(const float* src, const float* shift, float* dst, size_t n, float scale)
+{
+    const __m128 vscale = _mm_set1_ps(scale);
+    size_t       i      = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 v = _mm_sub_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(shift + i));
+        _mm_storeu_ps(dst + i, exp4(_mm_mul_ps(v, vscale)));
+    }
+    scalar::exp_shifted_f32(src + i, shift + i, dst + i, n - i, scale);
+}
+
+void argmax_update_f32(const float* src, size_t n, int32_t index, float* max, int32_t* arg)
+{
+    const __m128i vindex = _mm_set1_epi32(index);
+    size_t        i      = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128  x  = _mm_loadu_ps(src + i);
+        const __m128  m  = _mm_loadu_ps(max + i);
+        const __m128  gt = _mm_cmpgt_ps(x, m);
+        const __m128i a  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(arg + i));
+        _mm_storeu_ps(max + i, _mm_blendv_ps(m, x, gt));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(arg + i),
+                         _mm_blendv_epi8(a, vindex, _mm_castps_si128(gt)));
+    }
+    scalar::argmax_update_f32(src + i, n - i, index, max + i, arg + i);
+}
+
+size_t select_above_f32(const float* src, size_t n, float threshold, int32_t* indices)
+{
+    // most scores of a classifier are far below the threshold, only groups with a hit are scanned
+    const __m128 vthreshold = _mm_set1_ps(threshold);
+    size_t       count      = 0;
+    size_t       i          = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128   x    = _mm_loadu_ps(src + i);
+        const unsigned mask = _mm_movemask_ps(_mm_cmpgt_ps(x, vthreshold));
+        if (!mask) continue;
+        for (int j = 0; j < 4; ++j)
+            if (mask & (1u << j)) indices[count++] = int32_t(i + j);
+    }
+    for (; i < n; ++i)
+        if (src[i] > threshold) indices[count++] = int32_t(i);
+    return count;
+}
+
+/// Transposes a 4x4 tile of 32-bit elements
+inline void transpose4x4(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride)
+{
+    __m128i r[4];
+    for (int k = 0; k < 4; ++k)
+        r[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * src_stride));
+
+    const __m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+    const __m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+    const __m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+    const __m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+    const __m128i c[4] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+                          _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+    for (int k = 0; k < 4; ++k)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + k * dst_stride), c[k]);
+}
+
+void transpose_32(const uint32_t* src, size_t src_stride, uint32_t* dst, size_t dst_stride,
+                  size_t rows, size_t cols)
+{
+    x86::transpose_tiled<4>(src, src_stride, dst, dst_stride, rows, cols, transpose4x4);
+}
+
+/// Bits of the halves closest to x[0..3], see `kHalfSimdRounding`
+inline __m128i f32_to_f16_4(__m128 x)
+{
+    const __m128i one  = _mm_set1_epi32(1);
+    const __m128i u    = _mm_castps_si128(x);
+    const __m128i a    = _mm_and_si128(u, _mm_set1_epi32(0x7FFFFFFF));
+    const __m128i sign = _mm_and_si128(_mm_srli_epi32(u, 16), _mm_set1_epi32(0x8000));
+
+    // normal results: rebias the exponent, round at bit 12 (a carry may overflow into infinity)
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(a, _mm_set1_epi32(112 << 23)), 13);
+    __m128i round  = _mm_and_si128(_mm_srli_epi32(a, 12), one);
+#if HALF_ROUND_TIES_TO_EVEN
+    const __m128i sticky = _mm_min_epu32(_mm_and_si128(a, _mm_set1_epi32(0xFFF)), one);
+    round                = _mm_and_si128(round, _mm_or_si128(sticky, normal));
+#endif
+    normal = _mm_add_epi32(normal, round);
+
+    // subnormal results (and zero)
+    const __m128 t = _mm_mul_ps(_mm_castsi128_ps(a), _mm_set1_ps(16777216.f));
+#if HALF_ROUND_TIES_TO_EVEN
+    const __m128i sub =
+        _mm_cvttps_epi32(_mm_round_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+#else
+    const __m128i sub = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(t, _mm_set1_ps(0.5f))));
+#endif
+
+    // overflow to infinity, NaNs keep the upper bits of their payload
+    const __m128i payload = _mm_and_si128(_mm_srli_epi32(a, 13), _mm_set1_epi32(0x3FF));
+    const __m128i is_nan  = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7F800000));
+    const __m128i inf = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(is_nan, payload));
+
+    __m128i h = _mm_blendv_epi8(sub, normal, _mm_cmpgt_epi32(a, _mm_set1_epi32((113 << 23) - 1)));
+    h         = _mm_blendv_epi8(h, inf, _mm_cmpgt_epi32(a, _mm_set1_epi32((143 << 23) - 1)));
+    return _mm_or_si128(h, sign);
+}
+
+/// Floats of the halves with bits h[0..3] (zero-extended to 32 bits)
+inline __m128 f16_to_f32_4(__m128i h)
+{
+    const __m128i exp_mask = _mm_set1_epi32(0x7C00 << 13);
+    __m128i       o        = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+    const __m128i e        = _mm_and_si128(o, exp_mask);
+    o                      = _mm_add_epi32(o, _mm_set1_epi32(112 << 23));
+
+    // infinities and NaNs get the maximum exponent, subnormals are normalized by a subtraction
+    const __m128i special = _mm_cmpeq_epi32(e, exp_mask);
+    o = _mm_add_epi32(o, _mm_and_si128(special, _mm_set1_epi32(112 << 23)));
+    const __m128i tiny   = _mm_cmpeq_epi32(e, _mm_setzero_si128());
+    const __m128  normed = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(o, _mm_set1_epi32(1 << 23))),
+                                      _mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+    o = _mm_blendv_epi8(o, _mm_castps_si128(normed), tiny);
+
+    const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+    return _mm_castsi128_ps(_mm_or_si128(o, sign));
+}
+
+void f32_to_f16(const float* src, uint16_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i lo = f32_to_f16_4(_mm_loadu_ps(src + i));
+        const __m128i hi = f32_to_f16_4(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi32(lo, hi));
+    }
+    scalar::f32_to_f16(src + i, dst + i, n - i);
+}
+
+void f16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, f16_to_f32_4(_mm_cvtepu16_epi32(h)));
+        _mm_storeu_ps(dst + i + 4, f16_to_f32_4(_mm_cvtepu16_epi32(_mm_srli_si128(h, 8))));
+    }
+    scalar::f16_to_f32(src + i, dst + i, n - i);
+}
+
+/// Bits of the bfloat16s closest to x[0..3], see `bfloat16::round`
+inline __m128i f32_to_bf16_4(__m128 x)
+{
+    const __m128i u       = _mm_castps_si128(x);
+    const __m128i lsb     = _mm_and_si128(_mm_srli_epi32(u, 16), _mm_set1_epi32(1));
+    const __m128i sum     = _mm_add_epi32(_mm_add_epi32(u, lsb), _mm_set1_epi32(0x7FFF));
+    const __m128i rounded = _mm_srli_epi32(sum, 16);
+    const __m128i nan     = _mm_or_si128(_mm_srli_epi32(u, 16), _mm_set1_epi32(0x40));
+    const __m128i a       = _mm_and_si128(u, _mm_set1_epi32(0x7FFFFFFF));
+    return _mm_blendv_epi8(rounded, nan, _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7F800000)));
+}
+
+void f32_to_bf16(const float* src, uint16_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i lo = f32_to_bf16_4(_mm_loadu_ps(src + i));
+        const __m128i hi = f32_to_bf16_4(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi32(lo, hi));
+    }
+    scalar::f32_to_bf16(src + i, dst + i, n - i);
+}
+
+void bf16_to_f32(const uint16_t* src, float* dst, size_t n)
+{
+    // interleaving with zeros puts every value into the upper half of a 32-bit lane
+    const __m128i zero = _mm_setzero_si128();
+    size_t        i    = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(zero, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(zero, b));
+    }
+    scalar::bf16_to_f32(src + i, dst + i, n - i);
+}
+
+} // namespace
+} // namespace sse41
+
+const kernel_table sse41_table{isa::sse41,
+                               sse41::u8_to_f32_planar,
+                               sse41::u8_to_s8_planar,
+                               sse41::u8_gray_to_f32_planar,
+                               sse41::u8_bgr_to_gray_f32,
+                               sse41::exp_f32,
+                               sse41::exp_shifted_f32,
+                               sse41::argmax_update_f32,
+                               sse41::select_above_f32,
+                               sse41::transpose_32,
+                               kHalfSimdRounding ? sse41::f32_to_f16 : scalar::f32_to_f16,
+                               sse41::f16_to_f32,
+                               sse41::f32_to_bf16,
+                               sse41::bf16_to_f32};
+
+} // namespace kernels
+} // namespace eztrt
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "kernels_impl.h"
+
+#include <immintrin.h>
+
+// SSSE3 helpers shared by the SSE4.1, AVX2 and AVX-512 kernels. These are `static` on purpose:
+// every per-ISA translation unit is compiled with different target flags and must get its own
+// copy instead of an ODR-merged one.
+
+namespace eztrt
+{
+namespace kernels
+{
+namespace x86
+{
+
+/// De-interleaves 16 pixels of 1, 3 or 4 channels into one register per channel.
+static inline void load_deinterleave16(const uint8_t* src, int channels, __m128i out[4])
+{
+    if (channels == 1) { out[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); }
+    else if (channels == 3)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+
+        // masks[channel][load], -128 zeroes the byte
+        static const int8_t masks[3][3][16] = {
+            {{0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+             {-128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14, -128, -128, -128, -128, -128},
+             {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1, 4, 7, 10, 13}},
+            {{1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+             {-128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128},
+             {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14}},
+            {{2, 5, 8, 11, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+             {-128, -128, -128, -128, -128, 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128},
+             {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15}}};
+
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            const auto m = reinterpret_cast<const __m128i*>(masks[ch]);
+            out[ch]      = _mm_or_si128(
+                _mm_or_si128(_mm_shuffle_epi8(a, _mm_loadu_si128(m + 0)),
+                             _mm_shuffle_epi8(b, _mm_loadu_si128(m + 1))),
+                _mm_shuffle_epi8(c, _mm_loadu_si128(m + 2)));
+        }
+    }
+    else // channels == 4
+    {
+        // group the channels of four pixels inside each register, then transpose the 4x4 block
+        // of 32-bit lanes
+        const __m128i group = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        __m128i       v[4];
+        for (int k = 0; k < 4; ++k)
+            v[k] = _mm_shuffle_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16 * k)), group);
+
+        const __m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+        const __m128i t1 = _mm_unpacklo_epi32(v[2], v[3]);
+        const __m128i t2 = _mm_unpackhi_epi32(v[0], v[1]);
+        const __m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+        out[0]           = _mm_unpacklo_epi64(t0, t1);
+        out[1]           = _mm_unpackhi_epi64(t0, t1);
+        out[2]           = _mm_unpacklo_epi64(t2, t3);
+        out[3]           = _mm_unpackhi_epi64(t2, t3);
+    }
+}
+
+/// saturate(v - 127) for 16 unsigned bytes, reinterpreted as signed bytes
+static inline __m128i u8_minus_127(__m128i v)
+{
+    return _mm_adds_epi8(_mm_xor_si128(v, _mm_set1_epi8(char(0x80))), _mm_set1_epi8(1));
+}
+
+static inline bool supported_channels(int channels)
+{
+    return channels == 1 || channels == 3 || channels == 4;
+}
+
+/// Transposes all full `T` x `T` tiles with `tile(src, src_stride, dst, dst_stride)`, the ragged
+/// edges with the scalar kernel.
+template<size_t T, typename Tile>
+static inline void transpose_tiled(const uint32_t* src, size_t src_stride, uint32_t* dst,
+                                   size_t dst_stride, size_t rows, size_t cols, Tile tile)
+{
+    size_t r = 0;
+    for (; r + T <= rows; r += T)
+    {
+        size_t c = 0;
+        for (; c + T <= cols; c += T)
+            tile(src + r * src_stride + c, src_stride, dst + c * dst_stride + r, dst_stride);
+        scalar::transpose_32(src + r * src_stride + c, src_stride, dst + c * dst_stride + r,
+                             dst_stride, T, cols - c);
+    }
+    scalar::transpose_32(src + r * src_stride, src_stride, dst + r, dst_stride, rows - r, cols);
+}
+
+} // namespace x86
+} // namespace kernels
+} // namespace eztrt
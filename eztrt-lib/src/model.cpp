@@ -1,17 +1,58 @@
 
 #include "eztrt/model.h"
+#include "eztrt/convert.h"
+#include "eztrt/cpu_backend.h"
+#include "eztrt/engine_cache.h"
+#include "eztrt/engine_container.h"
+#include "eztrt/file_mapping.h"
+#include "eztrt/host_memory_pool.h"
+
 #include <stdio.h>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 
 namespace eztrt
 {
 
+/**
+ * An execution context with the host/device buffers it operates on.
+ */
+struct model::tensorrt_slot : model::execution_slot
+{
+    void* host_buffer(const samplesCommon::BindingHandle& binding) override
+    {
+        return manager->getHostBuffer(binding);
+    }
+
+    bool execute() override
+    {
+        // Memcpy from host input buffers to device input buffers
+        manager->copyInputToDevice();
+        if (!context->executeV2(manager->getDeviceBindings().data())) return false;
+        // Memcpy from device output buffers to host output buffers
+        manager->copyOutputToHost();
+        return true;
+    }
+
+    const samplesCommon::BufferManager* buffers() const override { return manager.get(); }
+
+    InferUniquePtr<nvinfer1::IExecutionContext>   context;
+    std::unique_ptr<samplesCommon::BufferManager> manager;
+};
+
 model::model(params params, logger& logger) : params_{params}, logger_{logger}
 {
     auto logctx_ = logger_.context_scope("construct");
-    builder_     = eztrt::InferUniquePtr<nvinfer1::IBuilder>(nvinfer1::createInferBuilder(logger_));
+    if (params_.backend == backend_type::cpu)
+    {
+        backend_ = std::make_unique<cpu_backend>();
+        return;
+    }
+
+    builder_ = eztrt::InferUniquePtr<nvinfer1::IBuilder>(nvinfer1::createInferBuilder(logger_));
     if (!builder_)
     {
         logger_.log(ILogger::Severity::kERROR,
@@ -41,66 +82,255 @@ model::model(params params, logger& logger) : params_{params}, logger_{logger}
 
 cv::Mat model::predict(cv::Mat input)
 {
-    auto logctx_ = logger_.context_scope("predict");
-    assert(engine_ && network_ && config_ && "network, engine or config not initialized");
+    // no logger context scope here: the context stack of the logger is shared by all threads
+    if (backend_) return backend_->predict(input);
 
     // this API only works for a single input and output
-    assert(network_->getNbInputs() == 1 &&
+    assert(pool_ && "engine not initialized");
+    assert(input_bindings_.size() == 1 &&
            "this API can only be used for a model with a single input tensor");
-    assert(network_->getNbOutputs() == 1 &&
+    assert(output_bindings_.size() == 1 &&
            "this API can only be used for a model with a single output tensor");
+    const auto& input_binding = input_bindings_[0];
 
-    // Create RAII buffer manager object
-    if (!buffers_)
-        buffers_ = std::make_unique<samplesCommon::BufferManager>(engine_, params_.batchSize);
+    // the input has been written to the buffer of the zero-copy API directly. Executed here
+    // instead of through run(), which takes a logger context scope.
+    if (direct_ && input.data == direct_->host_buffer(input_binding))
+        return detach_output(execute(*direct_));
 
-    // create execution context if we don't have it already
-    if (!context_)
-        context_ = InferUniquePtr<nvinfer1::IExecutionContext>(engine_->createExecutionContext());
+    auto slot = pool_->checkout();
+    if (!slot)
+    {
+        logger_.log(ILogger::Severity::kERROR, "predict: Could not create an execution context!");
+        return {};
+    }
 
-    // get the host buffer
-    auto input_tensor     = network_->getInput(0);
-    auto input_buffer_ptr = buffers_->getHostBuffer(input_tensor->getName());
-    auto input_buffer     = wrap_tensor(*input_tensor, input_buffer_ptr);
+    // fill the host buffer of the checked out slot
+    auto input_buffer = wrap_tensor(input_binding, slot->host_buffer(input_binding));
+    if (input.depth() == CV_32F &&
+        (input_buffer.depth() == CV_16F || input_buffer.depth() == CV_16U))
+    {
+        // FP16 bindings take float inputs, converted on the way into the buffer. CV_16U only
+        // wraps bfloat16 bindings, TensorRT has no 16-bit integers.
+        const cv::Mat converted = input_buffer.depth() == CV_16F
+                                      ? convert_f32_to_f16(input, input_buffer)
+                                      : convert_f32_to_bf16(input, input_buffer);
+        if (converted.empty())
+        {
+            logger_.log(ILogger::Severity::kERROR,
+                        "predict: The input does not match the size of the input binding!");
+            return {};
+        }
+    }
+    else
+    {
+        assert(input_buffer.elemSize() * input_buffer.total() ==
+                   input.elemSize() * input.total() &&
+               "byte sizes do not match");
+        auto input_ptr = input_buffer.data;
+        input_buffer   = input_buffer.reshape(input.channels(), input.dims, input.size.p);
+        input.copyTo(input_buffer);
+        assert(input_buffer.data == input_ptr &&
+               "buffer was not actually copied but re-allocated instead.");
+    }
+
+    // the output buffer belongs to the slot, which is handed to the next caller after this
+    return detach_output(execute(*slot));
+}
+
+cv::Mat model::detach_output(const cv::Mat& output)
+{
+    if (output.empty()) return output;
+    switch (output.depth())
+    {
+    case CV_16F: return convert_f16_to_f32(output);
+    case CV_16U: return convert_bf16_to_f32(output);
+    default: return output.clone();
+    }
+}
+
+cv::Mat model::acquire_input(int index)
+{
+    if (backend_) return backend_->acquire_input(index);
+    assert(pool_ && "engine not initialized");
+    prepare_execution();
+    if (!direct_ || index < 0 || index >= int(input_bindings_.size())) return {};
+
+    const auto& binding = input_bindings_[index];
+    return wrap_tensor(binding, direct_->host_buffer(binding));
+}
 
-    // fill the host buffer
-    assert(input_buffer.elemSize() * input_buffer.total() == input.elemSize() * input.total() &&
-           "byte sizes do not match");
-    input_buffer = input_buffer.reshape(input.channels(), input.dims, input.size.p);
-    input.copyTo(input_buffer);
-    assert(input_buffer.data == input_buffer_ptr &&
-           "buffer was not actually copied but re-allocated instead.");
+cv::Mat model::run()
+{
+    auto logctx_ = logger_.context_scope("run");
+    if (backend_) return backend_->run();
+    assert(pool_ && "engine not initialized");
+    prepare_execution();
+    if (!direct_)
+    {
+        logger_.log(ILogger::Severity::kERROR, "Could not create an execution context!");
+        return {};
+    }
 
-    // Memcpy from host input buffers to device input buffers
-    buffers_->copyInputToDevice();
+    return execute(*direct_);
+}
 
-    bool status = context_->executeV2(buffers_->getDeviceBindings().data());
-    if (!status)
+cv::Mat model::execute(execution_slot& slot)
+{
+    if (!slot.execute())
     {
         logger_.log(ILogger::Severity::kERROR, "Network execution failed!");
         return {};
     }
 
-    // Memcpy from device output buffers to host output buffers
-    buffers_->copyOutputToHost();
+    assert(!output_bindings_.empty() && "engine not initialized");
+    const auto& binding = output_bindings_[0];
+    return wrap_tensor(binding, slot.host_buffer(binding));
+}
 
-    auto output_tensor = network_->getOutput(0);
-    auto output_buffer =
-        wrap_tensor(*output_tensor, buffers_->getHostBuffer(output_tensor->getName()));
+std::unique_ptr<model::execution_slot>
+model::create_slot(std::shared_ptr<nvinfer1::ICudaEngine> engine, int batch_size,
+                   const samplesCommon::GrowthPolicy& growth)
+{
+    auto slot     = std::make_unique<tensorrt_slot>();
+    slot->context = InferUniquePtr<nvinfer1::IExecutionContext>(engine->createExecutionContext());
+    if (!slot->context) return nullptr;
+    slot->manager = std::make_unique<samplesCommon::BufferManager>(engine, batch_size);
+    slot->manager->setGrowthPolicy(growth);
+    return slot;
+}
 
-    return output_buffer.clone();
+void model::reset_execution()
+{
+    if (!engine_)
+    {
+        reset_execution({}, {}, nullptr);
+        return;
+    }
+
+    // resolved by name once, so that inference does not look up any tensor names
+    std::vector<samplesCommon::BindingHandle> inputs, outputs;
+    if (network_ && network_->getNbInputs() > 0)
+    {
+        for (int i = 0; i < network_->getNbInputs(); ++i)
+            inputs.emplace_back(*engine_, network_->getInput(i)->getName());
+        for (int i = 0; i < network_->getNbOutputs(); ++i)
+            outputs.emplace_back(*engine_, network_->getOutput(i)->getName());
+    }
+    else
+    {
+        for (int i = 0; i < engine_->getNbBindings(); ++i)
+        {
+            samplesCommon::BindingHandle binding(*engine_, i);
+            (binding.isInput() ? inputs : outputs).push_back(std::move(binding));
+        }
+    }
+
+    auto engine     = engine_;
+    int  batch_size = params_.batchSize;
+    auto growth     = params_.buffer_growth;
+    reset_execution(std::move(inputs), std::move(outputs), [engine, batch_size, growth] {
+        return create_slot(engine, batch_size, growth);
+    });
+}
+
+void model::reset_execution(std::vector<samplesCommon::BindingHandle> inputs,
+                            std::vector<samplesCommon::BindingHandle> outputs,
+                            slot_factory factory)
+{
+    direct_.reset();
+    pool_.reset();
+    input_bindings_  = std::move(inputs);
+    output_bindings_ = std::move(outputs);
+    factory_         = std::move(factory);
+    if (!factory_) return;
+
+    // the factory must not refer to the model, which may be moved while the pool lives
+    pool_ = std::make_unique<slot_pool<execution_slot>>(std::max(params_.execution_contexts, 1),
+                                                        factory_);
+}
+
+void model::prepare_execution()
+{
+    if (!direct_ && factory_) direct_ = factory_();
+}
+
+void model::set_engine(std::shared_ptr<nvinfer1::ICudaEngine> engine)
+{
+    engine_ = engine;
+    reset_execution();
 }
 
 std::string model::summarize(bool verbose)
 {
+    if (backend_) return backend_->summarize(verbose);
+
     std::ostringstream summary;
 
     if (!config_) summary << "!!! No Builder Config Object\n";
     if (!builder_) summary << "!!! No Builder Object\n";
     if (!engine_) summary << "!!! No Engine Object\n";
-    if (!context_) summary << "!! No context_ Object\n";
+    if (!pool_) summary << "!! No execution contexts\n";
+    else
+    {
+        auto stats = pool_->statistics();
+        summary << fmt::format("Execution contexts: {} ({} in use, {} calls, {} had to wait)\n",
+                               pool_->size(), pool_->in_use(), stats.checkouts, stats.waits);
+    }
+    const auto host = host_memory_pool::global().stats();
+    summary << fmt::format("Host buffers: {:.1f} MiB live, {:.1f} MiB peak, {:.1f} MiB cached, "
+                           "{:.0f}% of {} allocations reused\n",
+                           double(host.bytes_live) / (1 << 20), double(host.bytes_peak) / (1 << 20),
+                           double(host.bytes_cached) / (1 << 20), 100. * host.hit_rate(),
+                           host.allocations);
+
+    // reallocation counters per binding, summed over the contexts that are not in use right now
+    if (engine_)
+    {
+        std::vector<samplesCommon::BufferStats> buffer_stats(engine_->getNbBindings());
+        std::vector<size_t>                     capacity(buffer_stats.size());
+        const auto collect = [&](execution_slot& slot) {
+            const auto* buffers = slot.buffers();
+            if (!buffers) return;
+            const int n = std::min(buffers->getNbBindings(), int(buffer_stats.size()));
+            for (int i = 0; i < n; ++i)
+            {
+                const auto& buffer = buffers->getManagedBuffer(i);
+                buffer_stats[i] += buffer.hostBuffer.stats();
+                buffer_stats[i] += buffer.deviceBuffer.stats();
+                capacity[i] +=
+                    buffer.hostBuffer.capacityBytes() + buffer.deviceBuffer.capacityBytes();
+            }
+        };
+        if (direct_) collect(*direct_);
+        const size_t busy = pool_ ? pool_->for_each_idle(collect) : 0;
+        for (size_t i = 0; i < buffer_stats.size(); ++i)
+        {
+            const auto& s = buffer_stats[i];
+            summary << fmt::format("Buffer [{}]: {:.1f} MiB allocated, {} reallocations ({} grows, "
+                                   "{} shrinks) in {} resizes\n",
+                                   engine_->getBindingName(int(i)), double(capacity[i]) / (1 << 20),
+                                   s.reallocations, s.grows, s.shrinks, s.resizes);
+        }
+        if (busy) summary << fmt::format("({} execution contexts in use are not counted)\n", busy);
+    }
 
-    if (!network_)
+    if ((!network_ || network_->getNbInputs() == 0) && engine_)
+    {
+        // a loaded engine without its network only tells its bindings
+        summary << " ** Engine " << engine_->getName() << ":\n";
+        for (const auto* bindings : {&input_bindings_, &output_bindings_})
+        {
+            for (const auto& binding : *bindings)
+            {
+                std::ostringstream dims;
+                dims << binding.dims();
+                summary << fmt::format("{}: [{}] {} {}\n", binding.isInput() ? "Input" : "Output",
+                                       binding.name(), dims.str(), to_str(binding.dataType()));
+            }
+        }
+    }
+    else if (!network_)
         summary << "!!! No Network loaded!\n";
     else
     {
@@ -148,6 +378,7 @@ bool model::create_engine()
 
     engine_ = std::shared_ptr<nvinfer1::ICudaEngine>(
         builder_->buildEngineWithConfig(*network_, *config_), InferDeleter());
+    reset_execution();
 
     if (!engine_)
     {
@@ -158,12 +389,19 @@ bool model::create_engine()
     return true;
 }
 
-bool model::ready() { return network_ && engine_; }
+bool model::ready() { return backend_ ? backend_->ready() : network_ && engine_; }
 
 bool model::load(std::string file, std::string engine_file)
 {
     auto logctx_ = logger_.context_scope("load");
     logger_.log(ILogger::Severity::kVERBOSE, "Loading model from {}", file);
+    if (backend_)
+    {
+        if (!engine_file.empty())
+            logger_.log(ILogger::Severity::kWARNING, "Ignoring engine {} on the CPU backend",
+                        engine_file);
+        return backend_->load(file);
+    }
 
     auto parser = eztrt::InferUniquePtr<nvonnxparser::IParser>(
         nvonnxparser::createParser(network(), logger_));
@@ -186,54 +424,150 @@ bool model::load(std::string file, std::string engine_file)
 
     apply_params();
     if (!engine_file.empty()) { return load_engine(engine_file); }
+    else if (!params_.engine_cache_dir.empty())
+    {
+        return load_cached_engine(file);
+    }
     else
     {
         return create_engine();
     }
 }
 
+bool model::load_cached_engine(std::string onnx_file)
+{
+    engine_cache cache(params_.engine_cache_dir, params_.engine_cache_max_bytes);
+
+    std::string key;
+    {
+        mapped_file onnx(onnx_file);
+        if (!onnx.valid())
+        {
+            logger_.log(ILogger::Severity::kERROR, "Could not read {} for the engine cache: {}",
+                        onnx_file, onnx.error());
+            return create_engine();
+        }
+        key = engine_cache::make_key(onnx.data(), onnx.size(), params_);
+    }
+
+    auto cached = cache.lookup(key);
+    if (!cached.empty())
+    {
+        logger_.log(ILogger::Severity::kINFO, "Found engine {} in the cache", key);
+        if (load_engine(cached)) return true;
+        logger_.log(ILogger::Severity::kWARNING, "Cached engine {} is unusable, rebuilding it",
+                    key);
+    }
+
+    if (!create_engine()) return false;
+
+    if (cache.store(key, [this](std::ostream& out) { return serialize_engine(out); }))
+        logger_.log(ILogger::Severity::kINFO, "Added engine {} to the cache", key);
+    return true;
+}
+
 bool model::load_engine(std::string file)
 {
     auto logctx_ = logger_.context_scope("load_engine");
     logger_.log(ILogger::Severity::kINFO, "Loading serialized engine from {}", file);
 
-    runtime_ = InferUniquePtr<nvinfer1::IRuntime>(createInferRuntime(logger_));
+    // map the file instead of reading it into a buffer, so that the engine does not need to fit
+    // into memory twice during deserialization
+    const auto  start = std::chrono::steady_clock::now();
+    mapped_file mapping(file);
+    if (!mapping.valid())
+    {
+        logger_.log(ILogger::Severity::kERROR, "Could not load serialized engine from {}: {}", file,
+                    mapping.error());
+        return false;
+    }
 
-    std::ifstream fh(file, std::ios::binary | std::ios::ate);
-    auto          size = fh.tellg();
-    fh.seekg(0, std::ios::beg);
-    std::vector<char> buffer(size);
-    if (fh.read(buffer.data(), size))
+    // check the integrity first, TensorRT does not tell a corrupted file from an incompatible one
+    const auto verify_start = std::chrono::steady_clock::now();
+    auto payload =
+        open_engine_container(mapping.data(), mapping.size(), params_fingerprint(params_));
+    if (!payload.valid())
+    {
+        logger_.log(ILogger::Severity::kERROR, "Invalid engine file {}: {}", file, payload.error);
+        return false;
+    }
+    if (payload.legacy)
     {
+        logger_.log(ILogger::Severity::kWARNING,
+                    "{} is a raw engine without integrity header, it cannot be verified. "
+                    "Serialize it again to add one.",
+                    file);
+    }
+    else
+    {
+        const double ms = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - verify_start)
+                              .count();
+        logger_.log(ILogger::Severity::kVERBOSE, "Verified engine checksum in {:.1f} ms", ms);
+    }
+    if (payload.params_mismatch)
+    {
+        logger_.log(ILogger::Severity::kWARNING,
+                    "{} was built with different model parameters than the current ones", file);
+    }
 
-        engine_ = std::shared_ptr<nvinfer1::ICudaEngine>(
-            runtime_->deserializeCudaEngine(buffer.data(), size, nullptr), InferDeleter());
-        logger_.log(ILogger::Severity::kVERBOSE, "Engine successfully loaded.", file);
-        return true;
+    engine_           = deserialize_engine(payload.data, payload.size);
+    const size_t size = mapping.size();
+    mapping.close();
+    reset_execution();
+
+    if (!engine_)
+    {
+        logger_.log(ILogger::Severity::kERROR, "Could not deserialize engine from {}!", file);
+        return false;
     }
 
-    logger_.log(ILogger::Severity::kERROR, "Could not load serialized engine from {}!", file);
-    return false;
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    logger_.log(ILogger::Severity::kINFO, "Engine loaded: {:.1f} MB in {:.3f} s ({:.1f} MB/s)",
+                size / 1e6, seconds, seconds > 0.0 ? size / 1e6 / seconds : 0.0);
+    return true;
+}
+
+std::shared_ptr<nvinfer1::ICudaEngine> model::deserialize_engine(const void* data, size_t size)
+{
+    runtime_ = InferUniquePtr<nvinfer1::IRuntime>(createInferRuntime(logger_));
+    if (!runtime_)
+    {
+        logger_.log(ILogger::Severity::kERROR, "Could not instantiate runtime!");
+        return nullptr;
+    }
+    return std::shared_ptr<nvinfer1::ICudaEngine>(
+        runtime_->deserializeCudaEngine(data, size, nullptr), InferDeleter());
 }
 
 bool model::serialize_engine(std::string filename)
 {
     auto logctx_ = logger_.context_scope("serialize_engine");
 
-    InferUniquePtr<IHostMemory> serializedModel(engine_->serialize());
-
     auto myfile = std::fstream(filename, std::ios::out | std::ios::binary);
-    if (myfile.is_open())
+    if (!myfile.is_open())
     {
-        myfile.write((const char*)serializedModel->data(), serializedModel->size());
-        logger_.log(ILogger::Severity::kINFO, "Serialized model to {}", filename);
-        return true;
+        logger_.log(ILogger::Severity::kERROR, "Could not open file {} for writing!", filename);
+        return false;
     }
-    else
+    if (!serialize_engine(myfile))
     {
-        logger_.log(ILogger::Severity::kERROR, "Could not open file {} for writing!", filename);
+        logger_.log(ILogger::Severity::kERROR, "Could not write engine to {}!", filename);
         return false;
     }
+    logger_.log(ILogger::Severity::kINFO, "Serialized model to {}", filename);
+    return true;
+}
+
+bool model::serialize_engine(std::ostream& out)
+{
+    assert(engine_ && "engine not initialized");
+    InferUniquePtr<IHostMemory> serializedModel(engine_->serialize());
+    if (!serializedModel) return false;
+
+    return write_engine_container(out, serializedModel->data(), serializedModel->size(),
+                                  params_fingerprint(params_));
 }
 
 void model::apply_params()
@@ -260,6 +594,7 @@ void model::apply_params()
 
 std::vector<nvinfer1::ILayer*> model::layers()
 {
+    if (!network_) return {};
     std::vector<nvinfer1::ILayer*> v(network_->getNbLayers());
 
     std::generate(begin(v), end(v), [this, i = 0]() mutable { return network_->getLayer(i++); });
@@ -268,6 +603,7 @@ std::vector<nvinfer1::ILayer*> model::layers()
 
 std::vector<nvinfer1::ITensor*> model::inputs()
 {
+    if (!network_) return {};
     std::vector<nvinfer1::ITensor*> v(network_->getNbInputs());
 
     std::generate(begin(v), end(v), [this, i = 0]() mutable { return network_->getInput(i++); });
@@ -276,26 +612,36 @@ std::vector<nvinfer1::ITensor*> model::inputs()
 
 std::vector<nvinfer1::ITensor*> model::outputs()
 {
-    std::vector<nvinfer1::ITensor*> v(network_->getNbInputs());
+    if (!network_) return {};
+    std::vector<nvinfer1::ITensor*> v(network_->getNbOutputs());
 
     std::generate(begin(v), end(v), [this, i = 0]() mutable { return network_->getOutput(i++); });
     return v;
 }
 
-cv::Mat model::wrap_tensor(nvinfer1::ITensor& tensor, void* data)
+cv::Mat model::wrap_tensor(const samplesCommon::BindingHandle& binding, void* data)
 {
-    auto d    = tensor.getDimensions();
-    int  type = 0;
-    switch (tensor.getType())
+    if (!binding.valid() || !data)
+    {
+        logger_.log(ILogger::Severity::kERROR, "Could not wrap tensor: Binding not found");
+        return {};
+    }
+
+    const auto& d    = binding.dims();
+    int         type = 0;
+    switch (binding.dataType())
     {
     case nvinfer1::DataType::kFLOAT: type = CV_32FC1; break;
     case nvinfer1::DataType::kINT32: type = CV_32SC1; break;
     case nvinfer1::DataType::kINT8: type = CV_8SC1; break;
-    case nvinfer1::DataType::kHALF: // fallthrough
+    case nvinfer1::DataType::kHALF: type = CV_16FC1; break;
+#if NV_TENSORRT_MAJOR >= 9
+    case nvinfer1::DataType::kBF16: type = CV_16UC1; break; // bits, OpenCV has no bfloat16
+#endif
     case nvinfer1::DataType::kBOOL: // fallthrough
     default:
         logger_.log(ILogger::Severity::kERROR, "Could not wrap tensor: Unknown/unsupported type {}",
-                    to_str(tensor.getType()));
+                    to_str(binding.dataType()));
         return {};
     }
 
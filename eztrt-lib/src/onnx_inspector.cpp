@@ -0,0 +1,373 @@
+#include "eztrt/onnx_inspector.h"
+#include "eztrt/file_mapping.h"
+
+#include "protobuf_reader.h"
+
+#include <spdlog/spdlog.h>
+
+#include <numeric>
+#include <set>
+#include <sstream>
+
+namespace eztrt
+{
+
+namespace
+{
+
+// Field numbers of the ONNX protobuf messages (onnx.proto3)
+namespace field
+{
+// ModelProto
+constexpr uint32_t model_ir_version   = 1;
+constexpr uint32_t model_producer     = 2;
+constexpr uint32_t model_graph        = 7;
+constexpr uint32_t model_opset_import = 8;
+// OperatorSetIdProto
+constexpr uint32_t opset_domain  = 1;
+constexpr uint32_t opset_version = 2;
+// GraphProto
+constexpr uint32_t graph_node        = 1;
+constexpr uint32_t graph_name        = 2;
+constexpr uint32_t graph_initializer = 5;
+constexpr uint32_t graph_input       = 11;
+constexpr uint32_t graph_output      = 12;
+// NodeProto
+constexpr uint32_t node_op_type = 4;
+constexpr uint32_t node_domain  = 7;
+// ValueInfoProto
+constexpr uint32_t value_name = 1;
+constexpr uint32_t value_type = 2;
+// TypeProto, TypeProto.Tensor, TensorShapeProto, TensorShapeProto.Dimension
+constexpr uint32_t type_tensor        = 1;
+constexpr uint32_t tensor_elem_type   = 1;
+constexpr uint32_t tensor_shape       = 2;
+constexpr uint32_t shape_dim          = 1;
+constexpr uint32_t dim_value          = 1;
+constexpr uint32_t dim_param          = 2;
+// TensorProto
+constexpr uint32_t init_dims          = 1;
+constexpr uint32_t init_data_type     = 2;
+constexpr uint32_t init_name          = 8;
+constexpr uint32_t init_data_location = 14;
+} // namespace field
+
+// The readers below mark the reader of their message as failed if any nested message is
+// malformed, so that the error reaches `inspect_onnx`.
+
+void read_shape(pb::reader& shape, onnx_tensor_info& info)
+{
+    uint32_t f, w;
+    while (shape.next(f, w))
+    {
+        if (f != field::shape_dim)
+        {
+            shape.skip(w);
+            continue;
+        }
+
+        auto        dim   = shape.message();
+        int64_t     value = -1;
+        std::string param;
+        while (dim.next(f, w))
+        {
+            if (f == field::dim_value && w == pb::wire_varint)
+                value = static_cast<int64_t>(dim.varint());
+            else if (f == field::dim_param && w == pb::wire_bytes)
+                param = dim.string();
+            else
+                dim.skip(w);
+        }
+        shape.check(dim);
+        info.shape.push_back(value);
+        info.dim_params.push_back(std::move(param));
+    }
+}
+
+onnx_tensor_info read_value_info(pb::reader& value)
+{
+    onnx_tensor_info info;
+    uint32_t         f, w;
+    while (value.next(f, w))
+    {
+        if (f == field::value_name && w == pb::wire_bytes) { info.name = value.string(); }
+        else if (f == field::value_type && w == pb::wire_bytes)
+        {
+            auto type = value.message();
+            while (type.next(f, w))
+            {
+                if (f != field::type_tensor || w != pb::wire_bytes)
+                {
+                    type.skip(w);
+                    continue;
+                }
+                auto tensor = type.message();
+                while (tensor.next(f, w))
+                {
+                    if (f == field::tensor_elem_type && w == pb::wire_varint)
+                        info.type = static_cast<onnx_type>(tensor.varint());
+                    else if (f == field::tensor_shape && w == pb::wire_bytes)
+                    {
+                        auto shape = tensor.message();
+                        read_shape(shape, info);
+                        tensor.check(shape);
+                    }
+                    else
+                        tensor.skip(w);
+                }
+                type.check(tensor);
+            }
+            value.check(type);
+        }
+        else
+            value.skip(w);
+    }
+    return info;
+}
+
+onnx_initializer_info read_initializer(pb::reader& tensor)
+{
+    onnx_initializer_info info;
+    uint64_t              payload = 0;
+    uint32_t              f, w;
+    while (tensor.next(f, w))
+    {
+        if (f == field::init_dims)
+            tensor.repeated_varint(w, info.shape);
+        else if (f == field::init_data_type && w == pb::wire_varint)
+            info.type = static_cast<onnx_type>(tensor.varint());
+        else if (f == field::init_name && w == pb::wire_bytes)
+            info.name = tensor.string();
+        else if (f == field::init_data_location && w == pb::wire_varint)
+            info.external = tensor.varint() == 1;
+        else
+            payload += tensor.skip(w); // raw_data, typed *_data fields and everything else
+    }
+
+    // the encoded size of the typed data fields is not the size of the data (varints), so prefer
+    // computing it from the shape
+    const auto numel = std::accumulate(info.shape.begin(), info.shape.end(), int64_t(1),
+                                       [](int64_t a, int64_t b) { return a * b; });
+    const auto elem  = element_size(info.type);
+    info.bytes       = elem ? static_cast<uint64_t>(numel) * elem : payload;
+    return info;
+}
+
+void read_graph(pb::reader& graph, onnx_model_info& info)
+{
+    std::vector<onnx_tensor_info> inputs;
+    uint32_t                      f, w;
+    while (graph.next(f, w))
+    {
+        if (w != pb::wire_bytes)
+        {
+            graph.skip(w);
+            continue;
+        }
+        switch (f)
+        {
+        case field::graph_node:
+        {
+            auto        node = graph.message();
+            std::string op_type, domain;
+            while (node.next(f, w))
+            {
+                if (f == field::node_op_type && w == pb::wire_bytes)
+                    op_type = node.string();
+                else if (f == field::node_domain && w == pb::wire_bytes)
+                    domain = node.string();
+                else
+                    node.skip(w); // attributes may contain whole tensors and subgraphs
+            }
+            graph.check(node);
+            info.node_count++;
+            info.op_histogram[domain.empty() ? op_type : domain + "." + op_type]++;
+            break;
+        }
+        case field::graph_name: info.graph_name = graph.string(); break;
+        case field::graph_initializer:
+        {
+            auto tensor = graph.message();
+            info.initializers.push_back(read_initializer(tensor));
+            info.initializer_bytes += info.initializers.back().bytes;
+            graph.check(tensor);
+            break;
+        }
+        case field::graph_input:
+        case field::graph_output:
+        {
+            auto value = graph.message();
+            (f == field::graph_input ? inputs : info.outputs).push_back(read_value_info(value));
+            graph.check(value);
+            break;
+        }
+        default: graph.skip(w);
+        }
+    }
+
+    // models before IR version 4 list the initializers as inputs as well
+    std::set<std::string> initializer_names;
+    for (const auto& init : info.initializers)
+        initializer_names.insert(init.name);
+    for (auto& input : inputs)
+    {
+        if (!initializer_names.count(input.name)) info.inputs.push_back(std::move(input));
+    }
+    if (graph.failed()) info.error = "malformed graph";
+}
+
+std::string format_shape(const std::vector<int64_t>& shape, const std::vector<std::string>& params)
+{
+    std::ostringstream out;
+    out << "(";
+    for (size_t i = 0; i < shape.size(); ++i)
+    {
+        if (i) out << ", ";
+        if (shape[i] >= 0)
+            out << shape[i];
+        else
+            out << (i < params.size() && !params[i].empty() ? params[i] : "?");
+    }
+    out << ")";
+    return out.str();
+}
+
+} // namespace
+
+const char* to_str(onnx_type type)
+{
+    switch (type)
+    {
+    case onnx_type::float32: return "float";
+    case onnx_type::uint8: return "uint8";
+    case onnx_type::int8: return "int8";
+    case onnx_type::uint16: return "uint16";
+    case onnx_type::int16: return "int16";
+    case onnx_type::int32: return "int32";
+    case onnx_type::int64: return "int64";
+    case onnx_type::string: return "string";
+    case onnx_type::boolean: return "bool";
+    case onnx_type::float16: return "half";
+    case onnx_type::float64: return "double";
+    case onnx_type::uint32: return "uint32";
+    case onnx_type::uint64: return "uint64";
+    case onnx_type::complex64: return "complex64";
+    case onnx_type::complex128: return "complex128";
+    case onnx_type::bfloat16: return "bfloat16";
+    default: return "unknown";
+    }
+}
+
+size_t element_size(onnx_type type)
+{
+    switch (type)
+    {
+    case onnx_type::uint8:
+    case onnx_type::int8:
+    case onnx_type::boolean: return 1;
+    case onnx_type::uint16:
+    case onnx_type::int16:
+    case onnx_type::float16:
+    case onnx_type::bfloat16: return 2;
+    case onnx_type::float32:
+    case onnx_type::int32:
+    case onnx_type::uint32: return 4;
+    case onnx_type::int64:
+    case onnx_type::uint64:
+    case onnx_type::float64:
+    case onnx_type::complex64: return 8;
+    case onnx_type::complex128: return 16;
+    default: return 0;
+    }
+}
+
+onnx_model_info inspect_onnx(const void* data, size_t size)
+{
+    onnx_model_info info;
+    const auto      begin = static_cast<const uint8_t*>(data);
+    pb::reader      model(begin, begin + size);
+    bool            has_graph = false;
+
+    uint32_t f, w;
+    while (model.next(f, w))
+    {
+        if (f == field::model_ir_version && w == pb::wire_varint)
+            info.ir_version = static_cast<int64_t>(model.varint());
+        else if (f == field::model_producer && w == pb::wire_bytes)
+            info.producer = model.string();
+        else if (f == field::model_opset_import && w == pb::wire_bytes)
+        {
+            auto        opset = model.message();
+            std::string domain;
+            int64_t     version = 0;
+            while (opset.next(f, w))
+            {
+                if (f == field::opset_domain && w == pb::wire_bytes)
+                    domain = opset.string();
+                else if (f == field::opset_version && w == pb::wire_varint)
+                    version = static_cast<int64_t>(opset.varint());
+                else
+                    opset.skip(w);
+            }
+            model.check(opset);
+            info.opsets[domain] = version;
+        }
+        else if (f == field::model_graph && w == pb::wire_bytes)
+        {
+            auto graph = model.message();
+            read_graph(graph, info);
+            model.check(graph);
+            has_graph = true;
+        }
+        else
+            model.skip(w);
+    }
+
+    if (model.failed() && info.error.empty()) info.error = "malformed protobuf data";
+    if (!has_graph && info.error.empty()) info.error = "the model does not contain a graph";
+    return info;
+}
+
+onnx_model_info inspect_onnx(const std::string& file)
+{
+    mapped_file mapping(file);
+    if (!mapping.valid())
+    {
+        onnx_model_info info;
+        info.error = fmt::format("could not open {}: {}", file, mapping.error());
+        return info;
+    }
+    return inspect_onnx(mapping.data(), mapping.size());
+}
+
+std::string onnx_model_info::summarize(bool verbose) const
+{
+    if (!valid()) return fmt::format("!!! Invalid ONNX model: {}\n", error);
+
+    std::ostringstream summary;
+    summary << fmt::format(" ** ONNX graph {} (IR version {}, produced by {})\n", graph_name,
+                           ir_version, producer.empty() ? "unknown" : producer);
+    for (const auto& input : inputs)
+        summary << fmt::format("Input: [{}] {} {}\n", input.name,
+                               format_shape(input.shape, input.dim_params), to_str(input.type));
+    for (const auto& output : outputs)
+        summary << fmt::format("Output: [{}] {} {}\n", output.name,
+                               format_shape(output.shape, output.dim_params), to_str(output.type));
+    summary << fmt::format("{} nodes, {} initializers with {:.2f} MB of weights\n", node_count,
+                           initializers.size(), initializer_bytes / 1e6);
+
+    if (verbose)
+    {
+        summary << " ** Operators\n";
+        for (const auto& [op, count] : op_histogram)
+            summary << fmt::format("{:>20}: {}\n", op, count);
+        summary << " ** Initializers\n";
+        for (const auto& init : initializers)
+            summary << fmt::format("[{}] {} {}, {} bytes{}\n", init.name,
+                                   format_shape(init.shape, {}), to_str(init.type), init.bytes,
+                                   init.external ? " (external)" : "");
+    }
+    return summary.str();
+}
+
+} // namespace eztrt
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Private reader for the protobuf wire format, shared by the ONNX inspector and the CPU backend.
+
+namespace eztrt
+{
+namespace pb
+{
+
+enum wire_type : uint32_t
+{
+    wire_varint  = 0,
+    wire_fixed64 = 1,
+    wire_bytes   = 2,
+    wire_fixed32 = 5,
+};
+
+/**
+ * Minimal reader for the protobuf wire format. Length-delimited fields are returned as views into
+ * the original buffer, nothing is copied unless it is converted to a string.
+ */
+class reader
+{
+public:
+    reader(const uint8_t* begin, const uint8_t* end) : p_{begin}, end_{end} {}
+
+    bool at_end() const { return p_ >= end_ || failed_; }
+    bool failed() const { return failed_; }
+
+    /// Fails this reader as well if `sub`, a nested message read from it, is malformed
+    void check(const reader& sub) { failed_ |= sub.failed_; }
+
+    /// Reads the next tag, returns false at the end of the message
+    bool next(uint32_t& field, uint32_t& wire)
+    {
+        if (at_end()) return false;
+        const uint64_t tag = varint();
+        field              = static_cast<uint32_t>(tag >> 3);
+        wire               = static_cast<uint32_t>(tag & 7);
+        return !failed_;
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (p_ >= end_) break;
+            const uint8_t byte = *p_++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        failed_ = true;
+        return 0;
+    }
+
+    /// The payload of a length-delimited field
+    reader message()
+    {
+        const uint64_t length = varint();
+        if (failed_ || length > uint64_t(end_ - p_))
+        {
+            failed_ = true;
+            return {end_, end_};
+        }
+        reader sub(p_, p_ + length);
+        p_ += length;
+        return sub;
+    }
+
+    std::string string()
+    {
+        auto sub = message();
+        return std::string(reinterpret_cast<const char*>(sub.p_), sub.end_ - sub.p_);
+    }
+
+    const uint8_t* data() const { return p_; }
+    size_t         size() const { return static_cast<size_t>(end_ - p_); }
+
+    float fixed32_float()
+    {
+        float v = 0.f;
+        if (advance(4)) std::memcpy(&v, p_ - 4, 4);
+        return v;
+    }
+
+    /// Skips the value of a field, returns the number of payload bytes that were skipped
+    uint64_t skip(uint32_t wire)
+    {
+        switch (wire)
+        {
+        case wire_varint: varint(); return 0;
+        case wire_fixed64: return advance(8);
+        case wire_fixed32: return advance(4);
+        case wire_bytes: return message().size();
+        default: failed_ = true; return 0; // groups are deprecated and not used by ONNX
+        }
+    }
+
+    /// Reads a repeated integer field, which may be packed or not
+    void repeated_varint(uint32_t wire, std::vector<int64_t>& out)
+    {
+        if (wire == wire_varint) { out.push_back(static_cast<int64_t>(varint())); }
+        else if (wire == wire_bytes)
+        {
+            auto packed = message();
+            while (!packed.at_end())
+                out.push_back(static_cast<int64_t>(packed.varint()));
+            check(packed);
+        }
+        else
+            skip(wire);
+    }
+
+    /// Reads a repeated float field, which may be packed or not
+    void repeated_float(uint32_t wire, std::vector<float>& out)
+    {
+        if (wire == wire_fixed32) { out.push_back(fixed32_float()); }
+        else if (wire == wire_bytes)
+        {
+            auto packed = message();
+            if (packed.size() % 4) failed_ = true;
+            const size_t n = packed.size() / 4;
+            if (!n) return;
+            out.resize(out.size() + n);
+            std::memcpy(out.data() + out.size() - n, packed.data(), n * 4);
+        }
+        else
+            skip(wire);
+    }
+
+private:
+    uint64_t advance(size_t n)
+    {
+        if (size_t(end_ - p_) < n)
+        {
+            failed_ = true;
+            return 0;
+        }
+        p_ += n;
+        return n;
+    }
+
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool           failed_{false};
+};
+
+} // namespace pb
+} // namespace eztrt
@@ -0,0 +1,278 @@
+#include "eztrt/tensor_view.h"
+#include "eztrt/kernels.h"
+
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <numeric>
+
+namespace eztrt
+{
+
+namespace
+{
+
+/// Rows and columns of the tiles a transpose is split into, so that the source and destination
+/// tile of 4-byte elements (2 x 16 KiB) stay in L1
+constexpr size_t kTransposeTile = 64;
+
+/**
+ * A strided tensor reduced to its essentials: size-1 dimensions are dropped and dimensions that
+ * are contiguous in the source are merged, e.g. an NHWC -> NCHW permutation becomes [C, H*W] with
+ * strides [1, C]. Elements are handled as words of the largest power of two up to 8 bytes that
+ * divides the element size; an element of several words gets an extra innermost dimension.
+ */
+struct strided_layout
+{
+    std::vector<size_t> shape;   //!< Destination (row-major) shape in words
+    std::vector<size_t> stride;  //!< Source stride in words of every destination dimension
+    size_t              word{1}; //!< Word size in bytes
+
+    size_t total() const
+    {
+        return std::accumulate(shape.begin(), shape.end(), size_t(1), std::multiplies<size_t>());
+    }
+};
+
+strided_layout make_layout(int dims, const int64_t* shape, const int64_t* strides,
+                           size_t elem_size)
+{
+    strided_layout layout;
+    layout.word = elem_size % 8 == 0 ? 8 : elem_size % 4 == 0 ? 4 : elem_size % 2 == 0 ? 2 : 1;
+    const size_t per = elem_size / layout.word;
+
+    std::vector<size_t> s, st;
+    for (int d = 0; d < dims; ++d)
+    {
+        if (shape[d] == 1) continue;
+        s.push_back(size_t(shape[d]));
+        st.push_back(size_t(strides[d]) * per);
+    }
+    if (per > 1)
+    {
+        s.push_back(per);
+        st.push_back(1);
+    }
+
+    for (size_t d = 0; d < s.size(); ++d)
+    {
+        if (!layout.shape.empty() && layout.stride.back() == st[d] * s[d])
+        {
+            layout.shape.back() *= s[d];
+            layout.stride.back() = st[d];
+        }
+        else
+        {
+            layout.shape.push_back(s[d]);
+            layout.stride.push_back(st[d]);
+        }
+    }
+    return layout;
+}
+
+/// Maps a row-major index over a set of destination dimensions to source and destination offsets
+struct offset_walker
+{
+    std::vector<size_t> size, src_stride, dst_stride;
+    size_t              src{0}, dst{0};
+
+    void add(size_t n, size_t src_step, size_t dst_step)
+    {
+        size.push_back(n);
+        src_stride.push_back(src_step);
+        dst_stride.push_back(dst_step);
+    }
+
+    void seek(size_t linear)
+    {
+        src = dst = 0;
+        for (size_t d = size.size(); d-- > 0;)
+        {
+            const size_t index = linear % size[d];
+            linear /= size[d];
+            src += index * src_stride[d];
+            dst += index * dst_stride[d];
+        }
+    }
+};
+
+/**
+ * Transposes a block of `rows` x `cols` units of `unit` words each, i.e. unit (r, c) at
+ * `src + r * src_stride + c * unit` moves to `dst + c * dst_stride + r * unit`. Single 4-byte
+ * words use the SIMD kernels.
+ */
+template<typename W>
+void transpose_block(const W* src, size_t src_stride, W* dst, size_t dst_stride, size_t rows,
+                     size_t cols, size_t unit)
+{
+    if (sizeof(W) == 4 && unit == 1 && cols > 1)
+    {
+        kernels::active().transpose_32(reinterpret_cast<const uint32_t*>(src), src_stride,
+                                       reinterpret_cast<uint32_t*>(dst), dst_stride, rows, cols);
+        return;
+    }
+    if (unit == 1)
+    {
+        for (size_t r = 0; r < rows; ++r)
+            for (size_t c = 0; c < cols; ++c)
+                dst[c * dst_stride + r] = src[r * src_stride + c];
+        return;
+    }
+    for (size_t r = 0; r < rows; ++r)
+        for (size_t c = 0; c < cols; ++c)
+            std::copy_n(src + r * src_stride + c * unit, unit, dst + c * dst_stride + r * unit);
+}
+
+template<typename W>
+void copy_words(const W* src, W* dst, const strided_layout& layout)
+{
+    const int rank = int(layout.shape.size());
+
+    // a source-contiguous innermost dimension is moved in runs
+    const bool   runs = rank > 0 && layout.stride[rank - 1] == 1;
+    const size_t unit = runs ? layout.shape[rank - 1] : 1;
+    const int    dims = runs ? rank - 1 : rank;
+    if (dims == 0)
+    {
+        std::memcpy(dst, src, unit * sizeof(W));
+        return;
+    }
+
+    std::vector<size_t> dst_stride(rank, 1);
+    for (int d = rank - 2; d >= 0; --d)
+        dst_stride[d] = dst_stride[d + 1] * layout.shape[d + 1];
+
+    // every combination of the other dimensions is a 2D transpose of the innermost destination
+    // dimension and the one that is adjacent in the source (at position `b`, if there is one,
+    // otherwise the innermost dimension is gathered)
+    int b = -1;
+    for (int d = 0; d < dims - 1; ++d)
+        if (layout.stride[d] == unit) b = d;
+    const size_t rows       = layout.shape[dims - 1];
+    const size_t row_stride = layout.stride[dims - 1];
+    const size_t cols       = b < 0 ? 1 : layout.shape[b];
+    const size_t col_stride = b < 0 ? 0 : dst_stride[b];
+    const size_t tile       = std::max<size_t>(1, kTransposeTile / unit);
+
+    offset_walker outer;
+    for (int d = 0; d < dims - 1; ++d)
+        if (d != b) outer.add(layout.shape[d], layout.stride[d], dst_stride[d]);
+    size_t outer_count = 1;
+    for (size_t n : outer.size)
+        outer_count *= n;
+
+    const size_t bands = (rows + tile - 1) / tile;
+    const auto   body  = [&](const cv::Range& range) {
+        offset_walker walker = outer;
+        for (int t = range.start; t < range.end; ++t)
+        {
+            walker.seek(t / bands);
+            const size_t r0 = (t % bands) * tile;
+            const size_t nr = std::min(tile, rows - r0);
+            for (size_t c0 = 0; c0 < cols; c0 += tile)
+                transpose_block(src + walker.src + r0 * row_stride + c0 * unit, row_stride,
+                                dst + walker.dst + c0 * col_stride + r0 * unit, col_stride, nr,
+                                std::min(tile, cols - c0), unit);
+        }
+    };
+
+    // small tensors are not worth waking up the thread pool
+    const cv::Range range(0, int(outer_count * bands));
+    if (layout.total() < (1u << 15))
+        body(range);
+    else
+        cv::parallel_for_(range, body);
+}
+
+template<typename W>
+void permute_words_in_place(W* data, const strided_layout& layout)
+{
+    const int rank = int(layout.shape.size());
+
+    // contiguous runs that stay innermost are moved as a unit
+    const bool   runs = rank > 0 && layout.stride[rank - 1] == 1;
+    const size_t unit = runs ? layout.shape[rank - 1] : 1;
+    const int    dims = runs ? rank - 1 : rank;
+    if (dims == 0) return;
+
+    // the unit that ends up at destination position `j` comes from `source(j)`
+    const auto source = [&](size_t j) {
+        size_t offset = 0;
+        for (int d = dims - 1; d >= 0; --d)
+        {
+            offset += (j % layout.shape[d]) * layout.stride[d];
+            j /= layout.shape[d];
+        }
+        return offset / unit;
+    };
+
+    const size_t      units = layout.total() / unit;
+    std::vector<bool> done(units, false);
+    std::vector<W>    carry(unit);
+    for (size_t start = 0; start < units; ++start)
+    {
+        if (done[start]) continue;
+        done[start] = true;
+        size_t j    = start;
+        size_t k    = source(j);
+        if (k == j) continue;
+
+        std::copy_n(data + start * unit, unit, carry.begin());
+        for (; k != start; j = k, k = source(k))
+        {
+            assert(k < units && !done[k] && "permute_in_place needs a permutation of the buffer");
+            std::copy_n(data + k * unit, unit, data + j * unit);
+            done[k] = true;
+        }
+        std::copy_n(carry.begin(), unit, data + j * unit);
+    }
+}
+
+bool has_elements(int dims, const int64_t* shape)
+{
+    return std::all_of(shape, shape + dims, [](int64_t n) { return n > 0; });
+}
+
+} // namespace
+
+void copy_strided(const void* src, int dims, const int64_t* shape, const int64_t* strides,
+                  size_t elem_size, void* dst)
+{
+    if (!has_elements(dims, shape)) return;
+
+    const strided_layout layout = make_layout(dims, shape, strides, elem_size);
+    switch (layout.word)
+    {
+    case 8:
+        copy_words(static_cast<const uint64_t*>(src), static_cast<uint64_t*>(dst), layout);
+        break;
+    case 4:
+        copy_words(static_cast<const uint32_t*>(src), static_cast<uint32_t*>(dst), layout);
+        break;
+    case 2:
+        copy_words(static_cast<const uint16_t*>(src), static_cast<uint16_t*>(dst), layout);
+        break;
+    default:
+        copy_words(static_cast<const uint8_t*>(src), static_cast<uint8_t*>(dst), layout);
+        break;
+    }
+}
+
+void permute_in_place(void* data, int dims, const int64_t* shape, const int64_t* strides,
+                      size_t elem_size)
+{
+    if (!has_elements(dims, shape)) return;
+
+    const strided_layout layout = make_layout(dims, shape, strides, elem_size);
+    switch (layout.word)
+    {
+    case 8: permute_words_in_place(static_cast<uint64_t*>(data), layout); break;
+    case 4: permute_words_in_place(static_cast<uint32_t*>(data), layout); break;
+    case 2: permute_words_in_place(static_cast<uint16_t*>(data), layout); break;
+    default: permute_words_in_place(static_cast<uint8_t*>(data), layout); break;
+    }
+}
+
+} // namespace eztrt
@@ -1,77 +1,432 @@
 #include "eztrt/util.h"
+#include "eztrt/convert.h"
+#include "eztrt/kernels.h"
+#include "eztrt/onnx_inspector.h"
+#include "eztrt/tensor_view.h"
+#ifdef EZTRT_WITH_TENSORRT
 #include "eztrt/model.h"
+#endif
+
+#include "kernels_impl.h"
 
 #include "json.hpp"
 
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <type_traits>
+
 namespace eztrt
 {
 
-cv::Mat softmax(cv::Mat in, int dim /*= 1*/)
+using kernels::kGrayB;
+using kernels::kGrayG;
+using kernels::kGrayR;
+
+namespace
+{
+
+/// Number of elements of the inner dimensions handled by one softmax task, so that the running
+/// maxima and sums of a block stay in L1
+constexpr int kSoftmaxBlock = 1024;
+
+/**
+ * Softmax over the middle dimension of `src`, viewed as [outer, len, inner]. Every task handles
+ * one outer index and a block of inner indices: pass one finds the maximum over `len`, pass two
+ * writes exp((x - max) * scale) and accumulates the sums, then the block (now in cache) is
+ * normalized.
+ */
+void softmax_strided(const float* src, float* dst, int outer, int len, int inner, float scale,
+                     bool log)
+{
+    const auto& k         = kernels::active();
+    const int   blocks    = (inner + kSoftmaxBlock - 1) / kSoftmaxBlock;
+    const int   tasks     = outer * blocks;
+    const auto  rows_body = [&](const cv::Range& range) {
+        // contiguous rows, e.g. classification outputs
+        for (int o = range.start; o < range.end; ++o)
+        {
+            const float* x = src + size_t(o) * len;
+            float*       y = dst + size_t(o) * len;
+            float        m = -std::numeric_limits<float>::infinity();
+            for (int i = 0; i < len; ++i)
+                m = std::max(m, x[i]);
+
+            k.exp_f32(x, y, len, m, scale);
+            float sum = 0.f;
+            for (int i = 0; i < len; ++i)
+                sum += y[i];
+
+            if (log)
+            {
+                const float log_sum = std::log(sum);
+                for (int i = 0; i < len; ++i)
+                    y[i] = (x[i] - m) * scale - log_sum;
+            }
+            else
+            {
+                const float inv = 1.f / sum;
+                for (int i = 0; i < len; ++i)
+                    y[i] *= inv;
+            }
+        }
+    };
+    const auto planes_body = [&](const cv::Range& range) {
+        // one plane per element of the softmax dimension, e.g. [N,C,H,W] segmentation outputs
+        float m[kSoftmaxBlock], sum[kSoftmaxBlock];
+        for (int t = range.start; t < range.end; ++t)
+        {
+            const int    o    = t / blocks;
+            const int    i0   = (t % blocks) * kSoftmaxBlock;
+            const int    n    = std::min(kSoftmaxBlock, inner - i0);
+            const size_t base = size_t(o) * len * inner + i0;
+
+            std::fill_n(m, n, -std::numeric_limits<float>::infinity());
+            std::fill_n(sum, n, 0.f);
+            for (int c = 0; c < len; ++c)
+            {
+                const float* x = src + base + size_t(c) * inner;
+                for (int i = 0; i < n; ++i)
+                    m[i] = std::max(m[i], x[i]);
+            }
+            for (int c = 0; c < len; ++c)
+            {
+                float* y = dst + base + size_t(c) * inner;
+                k.exp_shifted_f32(src + base + size_t(c) * inner, m, y, n, scale);
+                for (int i = 0; i < n; ++i)
+                    sum[i] += y[i];
+            }
+
+            if (log)
+            {
+                for (int i = 0; i < n; ++i)
+                    sum[i] = std::log(sum[i]);
+                for (int c = 0; c < len; ++c)
+                {
+                    const float* x = src + base + size_t(c) * inner;
+                    float*       y = dst + base + size_t(c) * inner;
+                    for (int i = 0; i < n; ++i)
+                        y[i] = (x[i] - m[i]) * scale - sum[i];
+                }
+            }
+            else
+            {
+                for (int i = 0; i < n; ++i)
+                    sum[i] = 1.f / sum[i];
+                for (int c = 0; c < len; ++c)
+                {
+                    float* y = dst + base + size_t(c) * inner;
+                    for (int i = 0; i < n; ++i)
+                        y[i] *= sum[i];
+                }
+            }
+        }
+    };
+
+    const cv::Range range(0, inner == 1 ? outer : tasks);
+    const auto      body = [&](const cv::Range& r) { inner == 1 ? rows_body(r) : planes_body(r); };
+
+    // small tensors are not worth waking up the thread pool
+    if (size_t(outer) * len * inner < (1u << 15))
+        body(range);
+    else
+        cv::parallel_for_(range, body);
+}
+
+cv::Mat softmax_impl(cv::Mat in, int dim, float temperature, bool log)
 {
-    cv::Mat res;
-    cv::exp(in, res);
-    if (in.dims == 2 && in.size[0] == 1)
+    if (in.empty()) return {};
+    if (in.channels() != 1)
     {
-        auto s = cv::sum(res)[0];
-        cv::multiply(res, cv::Scalar(1. / s), res);
+        spdlog::warn("softmax expects a single-channel tensor, use reshape_channels() first");
+        return {};
     }
-    else
+    if (!(temperature > 0.f))
     {
-        assert(res.type() == CV_32FC1 && "Generic softmax not implemented for non-float arrays");
-        // we abuse the sub-range and foreach iteration to do a concise iteration scheme over the
-        // dimension we need
-        std::vector<cv::Range> projectedRange(res.dims, cv::Range::all());
-        projectedRange[dim] = cv::Range(0, 1);
-        res(projectedRange).forEach<float>([&](float& v, const int* p) {
-            std::vector<int> pos(p, p + res.dims);
+        spdlog::warn("softmax temperature has to be positive, got {}", temperature);
+        return {};
+    }
+    if (dim < 0) dim += in.dims;
+    if (dim < 0 || dim >= in.dims)
+    {
+        spdlog::warn("softmax dimension {} is out of range for a {}-dimensional tensor", dim,
+                     in.dims);
+        return {};
+    }
 
-            // first pass - sum up
-            float sum{0.0f};
-            for (pos[dim] = 0; pos[dim] < res.size[dim]; ++pos[dim])
-                sum += res.at<float>(pos.data());
+    if (in.depth() != CV_32F)
+        in.convertTo(in, CV_32F);
+    else if (!in.isContinuous())
+        in = in.clone();
 
-            // second pass - divide
-            for (pos[dim] = 0; pos[dim] < res.size[dim]; ++pos[dim])
-                res.at<float>(pos.data()) /= sum;
-        });
-    }
+    int outer = 1, inner = 1;
+    for (int d = 0; d < dim; ++d)
+        outer *= in.size[d];
+    for (int d = dim + 1; d < in.dims; ++d)
+        inner *= in.size[d];
+
+    cv::Mat res(in.dims, in.size.p, CV_32F);
+    softmax_strided(in.ptr<float>(), res.ptr<float>(), outer, in.size[dim], inner,
+                    1.f / temperature, log);
     return res;
 }
 
-cv::Mat apply_preprocess_steps(cv::Mat in, std::string step_list)
+} // namespace
+
+cv::Mat softmax(cv::Mat in, int dim /*= 1*/, float temperature /*= 1.f*/)
+{
+    return softmax_impl(in, dim, temperature, false);
+}
+
+cv::Mat log_softmax(cv::Mat in, int dim /*= 1*/, float temperature /*= 1.f*/)
+{
+    return softmax_impl(in, dim, temperature, true);
+}
+
+namespace
+{
+
+/// Where the pixels of one output row come from: pixel `c` of the row is at `base + c * step`
+struct source_row
+{
+    const uchar* base;
+    ptrdiff_t    step;
+};
+
+template<size_t N>
+struct pixel_bytes
+{
+    uchar b[N];
+};
+
+/// Copies the output row segment [c0, c1) pixel by pixel from its (strided) source
+template<typename Pixel>
+void copy_pixels(uchar* dst, source_row src, int c0, int c1)
+{
+    auto out = reinterpret_cast<Pixel*>(dst);
+    for (int c = c0; c < c1; ++c)
+        std::memcpy(out + c, src.base + c * src.step, sizeof(Pixel));
+}
+
+void copy_pixels(uchar* dst, source_row src, int c0, int c1, size_t esz)
+{
+    if (src.step == ptrdiff_t(esz))
+    {
+        std::memcpy(dst + c0 * esz, src.base + c0 * esz, (c1 - c0) * esz);
+        return;
+    }
+    switch (esz)
+    {
+    case 1: copy_pixels<uint8_t>(dst, src, c0, c1); break;
+    case 2: copy_pixels<uint16_t>(dst, src, c0, c1); break;
+    case 3: copy_pixels<pixel_bytes<3>>(dst, src, c0, c1); break;
+    case 4: copy_pixels<uint32_t>(dst, src, c0, c1); break;
+    case 8: copy_pixels<uint64_t>(dst, src, c0, c1); break;
+    case 12: copy_pixels<pixel_bytes<12>>(dst, src, c0, c1); break;
+    case 16: copy_pixels<pixel_bytes<16>>(dst, src, c0, c1); break;
+    default:
+        for (int c = c0; c < c1; ++c)
+            std::memcpy(dst + c * esz, src.base + c * src.step, esz);
+    }
+}
+
+/// Type the per-pixel steps are computed in: float holds all values of the 8 and 16 bit types
+/// exactly, 32-bit integers and doubles need double precision
+template<typename T>
+using pixel_work_t =
+    std::conditional_t<std::is_same<T, int32_t>::value || std::is_same<T, double>::value, double,
+                       float>;
+
+/// Applies the per-pixel steps to the output row segment [c0, c1) while reading it from its source.
+/// For integer types, every step saturates its result to `T`.
+template<typename T>
+void transform_pixels(uchar* dst, source_row src, int c0, int c1, int in_cn, int out_cn,
+                      const std::string& ops)
+{
+    using W = pixel_work_t<T>;
+
+    T* out = reinterpret_cast<T*>(dst) + size_t(c0) * out_cn;
+    for (int c = c0; c < c1; ++c, out += out_cn)
+    {
+        const T* px = reinterpret_cast<const T*>(src.base + c * src.step);
+        W        v[4];
+        int      cn = in_cn;
+        for (int k = 0; k < cn; ++k)
+            v[k] = static_cast<W>(px[k]);
+
+        for (char op : ops)
+        {
+            switch (op)
+            {
+            case 'I':
+                for (int k = 0; k < cn; ++k)
+                    v[k] = W(1) - v[k];
+                break;
+            case 'C':
+                v[1] = v[2] = v[0];
+                cn          = 3;
+                break;
+            case 'G':
+                v[0] = (W(kGrayB) * v[0] + W(kGrayG) * v[1]) + W(kGrayR) * v[2];
+                cn   = 1;
+                break;
+            }
+            if constexpr (std::is_integral<T>::value)
+            {
+                for (int k = 0; k < cn; ++k)
+                    v[k] = static_cast<W>(cv::saturate_cast<T>(v[k]));
+            }
+        }
+
+        for (int k = 0; k < out_cn; ++k)
+            out[k] = cv::saturate_cast<T>(v[k]);
+    }
+}
+
+void transform_pixels(const cv::Mat& in, uchar* dst, source_row src, int c0, int c1, int out_cn,
+                      const std::string& ops)
+{
+    const int cn = in.channels();
+    switch (in.depth())
+    {
+    case CV_8U: transform_pixels<uint8_t>(dst, src, c0, c1, cn, out_cn, ops); break;
+    case CV_8S: transform_pixels<int8_t>(dst, src, c0, c1, cn, out_cn, ops); break;
+    case CV_16U: transform_pixels<uint16_t>(dst, src, c0, c1, cn, out_cn, ops); break;
+    case CV_16S: transform_pixels<int16_t>(dst, src, c0, c1, cn, out_cn, ops); break;
+    case CV_32S: transform_pixels<int32_t>(dst, src, c0, c1, cn, out_cn, ops); break;
+    case CV_32F: transform_pixels<float>(dst, src, c0, c1, cn, out_cn, ops); break;
+    case CV_64F: transform_pixels<double>(dst, src, c0, c1, cn, out_cn, ops); break;
+    }
+}
+
+} // namespace
+
+preprocess_plan::preprocess_plan(const std::string& step_list)
 {
-    cv::Mat out = in.clone();
     for (const auto& step : step_list)
     {
         switch (step)
         {
-        case 'v': // vertical flip
-            cv::flip(out, out, 0);
-            break;
-        case 'h': // horizontal flip
-            cv::flip(out, out, 1);
-            break;
-        case 'r': // rotate CCW 90 degrees
-            cv::rotate(out, out, cv::ROTATE_90_COUNTERCLOCKWISE);
-            break;
-        case 't': // transpose
-            cv::transpose(out, out);
-            break;
-        case 'I': // invert intensities y = 1-x
-            cv::subtract(cv::Scalar(1.0), out, out);
+        case 'v': append_geometric(false, true, false); break;
+        case 'h': append_geometric(false, false, true); break;
+        case 'r': append_geometric(true, false, true); break;
+        case 't': append_geometric(true, false, false); break;
+        case 'I':
+            pixel_ops_.push_back('I');
+            // two inversions cancel out, unless the intermediate result is saturated
+            if (!float_pixel_ops_.empty() && float_pixel_ops_.back() == 'I')
+                float_pixel_ops_.pop_back();
+            else
+                float_pixel_ops_.push_back('I');
             break;
-        case 'C': // create grayscale to color
-            cv::cvtColor(out, out, cv::COLOR_GRAY2BGR);
-            break;
-        case 'G': // create grayscale to color
-            cv::cvtColor(out, out, cv::COLOR_BGR2GRAY);
-        case 'S': //
+        case 'C': // fallthrough
+        case 'G':
+            pixel_ops_.push_back(step);
+            float_pixel_ops_.push_back(step);
             break;
+        default: break;
+        }
+    }
+}
+
+void preprocess_plan::append_geometric(bool swap_axes, bool flip_rows, bool flip_cols)
+{
+    // the step is applied to the output of the current mapping, so its coordinates are looked up
+    // first and then passed through the current mapping
+    bool rows = flip_rows_ ^ (swap_axes_ ? flip_cols : flip_rows);
+    bool cols = flip_cols_ ^ (swap_axes_ ? flip_rows : flip_cols);
+    flip_rows_ = rows;
+    flip_cols_ = cols;
+    swap_axes_ ^= swap_axes;
+}
+
+cv::Size preprocess_plan::output_size(cv::Size in) const
+{
+    return swap_axes_ ? cv::Size(in.height, in.width) : in;
+}
+
+cv::Mat preprocess_plan::apply(cv::Mat in) const
+{
+    assert(in.dims == 2 && "preprocess_plan only works on 2D images");
+
+    // the channel count changes with the color conversions, validate them up front
+    int out_cn = in.channels();
+    if (!pixel_ops_.empty() && (out_cn > 4 || in.depth() > CV_64F))
+    {
+        spdlog::warn("Per-pixel preprocessing steps are not supported for {}-channel images of "
+                     "depth {}",
+                     out_cn, in.depth());
+        return {};
+    }
+    for (char op : pixel_ops_)
+    {
+        if (op == 'C' && out_cn != 1)
+        {
+            spdlog::warn("Cannot convert a {}-channel image from gray to BGR", out_cn);
+            return {};
         }
+        if (op == 'G' && out_cn != 3 && out_cn != 4)
+        {
+            spdlog::warn("Cannot convert a {}-channel image from BGR to gray", out_cn);
+            return {};
+        }
+        if (op != 'I') out_cn = op == 'C' ? 3 : 1;
     }
+
+    const cv::Size out_size = output_size(in.size());
+    cv::Mat        out(out_size, CV_MAKETYPE(in.depth(), out_cn));
+
+    const bool         is_float = in.depth() == CV_32F || in.depth() == CV_64F;
+    const std::string& ops      = is_float ? float_pixel_ops_ : pixel_ops_;
+
+    const size_t esz   = in.elemSize();
+    auto         rowof = [&](int r) -> source_row {
+        if (!swap_axes_)
+        {
+            const uchar* row = in.ptr(flip_rows_ ? in.rows - 1 - r : r);
+            return flip_cols_ ? source_row{row + (in.cols - 1) * esz, -ptrdiff_t(esz)}
+                              : source_row{row, ptrdiff_t(esz)};
+        }
+        const int    col = flip_cols_ ? in.cols - 1 - r : r;
+        const uchar* top = in.ptr(flip_rows_ ? in.rows - 1 : 0) + col * esz;
+        return {top, flip_rows_ ? -ptrdiff_t(in.step[0]) : ptrdiff_t(in.step[0])};
+    };
+
+    // processes the output block [r0, r1) x [c0, c1)
+    auto process = [&](int r0, int r1, int c0, int c1) {
+        for (int r = r0; r < r1; ++r)
+        {
+            if (ops.empty())
+                copy_pixels(out.ptr(r), rowof(r), c0, c1, esz);
+            else
+                transform_pixels(in, out.ptr(r), rowof(r), c0, c1, out_cn, ops);
+        }
+    };
+
+    // the transposing mappings walk the input column-wise, process those in tiles so the source
+    // rows stay in cache
+    const int tile = swap_axes_ ? 32 : out.cols;
+    cv::parallel_for_(cv::Range(0, (out.rows + 31) / 32), [&](const cv::Range& range) {
+        for (int rb = range.start; rb < range.end; ++rb)
+        {
+            const int r0 = rb * 32, r1 = std::min(r0 + 32, out.rows);
+            for (int c0 = 0; c0 < out.cols; c0 += tile)
+                process(r0, r1, c0, std::min(c0 + tile, out.cols));
+        }
+    });
     return out;
 }
 
+cv::Mat apply_preprocess_steps(cv::Mat in, std::string step_list)
+{
+    return preprocess_plan(step_list).apply(in);
+}
+
 void show_all_channels(cv::Mat result)
 {
     for_each_channel(result, [](const int& c, cv::Mat& channel) {
@@ -94,6 +449,77 @@ std::vector<cv::Mat> separate_channels(cv::Mat result)
     return channels;
 }
 
+cv::Mat argmax_channels(cv::Mat result, cv::Mat* confidence /*= nullptr*/)
+{
+    if (result.channels() != 1 || (result.dims != 3 && !(result.dims == 4 && result.size[0] == 1)))
+    {
+        spdlog::warn("argmax_channels expects a single-channel [1,C,H,W] or [C,H,W] tensor");
+        return {};
+    }
+    const int d = result.dims;
+    const int C = result.size[d - 3];
+    const int H = result.size[d - 2];
+    const int W = result.size[d - 1];
+    if (C > 65536)
+    {
+        spdlog::warn("argmax_channels supports at most 65536 channels, got {}", C);
+        return {};
+    }
+    if (result.depth() != CV_32F)
+        result.convertTo(result, CV_32F);
+    else if (!result.isContinuous())
+        result = result.clone();
+
+    cv::Mat labels(H, W, C <= 256 ? CV_8U : CV_16U);
+    if (confidence)
+        confidence->create(H, W, CV_32F);
+
+    const auto&  k      = kernels::active();
+    const int    pixels = H * W;
+    const float* src    = result.ptr<float>();
+    const auto   body   = [&](const cv::Range& range) {
+        float   m[kSoftmaxBlock], tmp[kSoftmaxBlock];
+        int32_t arg[kSoftmaxBlock];
+        for (int t = range.start; t < range.end; ++t)
+        {
+            const int i0 = t * kSoftmaxBlock;
+            const int n  = std::min(kSoftmaxBlock, pixels - i0);
+
+            std::fill_n(m, n, -std::numeric_limits<float>::infinity());
+            std::fill_n(arg, n, 0);
+            for (int c = 0; c < C; ++c)
+                k.argmax_update_f32(src + size_t(c) * pixels + i0, n, c, m, arg);
+
+            if (labels.depth() == CV_8U)
+                std::copy_n(arg, n, labels.ptr<uint8_t>() + i0);
+            else
+                std::copy_n(arg, n, labels.ptr<uint16_t>() + i0);
+
+            if (!confidence)
+                continue;
+
+            // the winning channel contributes exp(0) = 1, so its probability is 1 / sum
+            float* sum = confidence->ptr<float>() + i0;
+            std::fill_n(sum, n, 0.f);
+            for (int c = 0; c < C; ++c)
+            {
+                k.exp_shifted_f32(src + size_t(c) * pixels + i0, m, tmp, n, 1.f);
+                for (int i = 0; i < n; ++i)
+                    sum[i] += tmp[i];
+            }
+            for (int i = 0; i < n; ++i)
+                sum[i] = 1.f / sum[i];
+        }
+    };
+
+    const cv::Range range(0, (pixels + kSoftmaxBlock - 1) / kSoftmaxBlock);
+    if (size_t(C) * pixels < (1u << 15))
+        body(range);
+    else
+        cv::parallel_for_(range, body);
+    return labels;
+}
+
 cv::Mat reshape_channels(cv::Mat m)
 {
     std::vector<int> shape{m.size.p, m.size.p + m.dims};
@@ -101,65 +527,326 @@ cv::Mat reshape_channels(cv::Mat m)
     return m.reshape(1, shape);
 }
 
-cv::Mat permute_dims(cv::Mat m, std::vector<int> new_order)
+namespace
+{
+
+/// Checks that `order` is a permutation of the dimensions of `m`
+bool valid_order(const cv::Mat& m, const std::vector<int>& order)
+{
+    std::vector<bool> seen(m.dims, false);
+    if (order.size() != size_t(m.dims)) return false;
+    for (int d : order)
+    {
+        if (d < 0 || d >= m.dims || seen[d]) return false;
+        seen[d] = true;
+    }
+    return true;
+}
+
+/// True if the memory spanned by the elements of `a` and `b` intersects
+bool overlaps(const cv::Mat& a, const cv::Mat& b)
+{
+    const auto end = [](const cv::Mat& m) {
+        const uchar* last = m.data;
+        for (int d = 0; d < m.dims; ++d)
+            last += size_t(m.size[d] - 1) * m.step[d];
+        return last + m.elemSize();
+    };
+    return a.data < end(b) && b.data < end(a);
+}
+
+std::vector<int> permuted_shape(const cv::Mat& m, const std::vector<int>& new_order)
+{
+    std::vector<int> shape(m.dims);
+    for (int i = 0; i < m.dims; ++i)
+        shape[i] = m.size[new_order[i]];
+    return shape;
+}
+
+/// `m` as a strided tensor of whole elements (all channels) in the permuted order
+void permuted_layout(const cv::Mat& m, const std::vector<int>& new_order, int64_t* shape,
+                     int64_t* strides)
+{
+    for (int i = 0; i < m.dims; ++i)
+    {
+        shape[i]   = m.size[new_order[i]];
+        strides[i] = int64_t(m.step[new_order[i]] / m.elemSize());
+    }
+}
+
+} // namespace
+
+cv::Mat permute_dims(cv::Mat m, const std::vector<int>& new_order, cv::Mat dst)
+{
+    if (m.empty() || !valid_order(m, new_order) || m.dims > kMaxTensorDims)
+    {
+        spdlog::warn("permute_dims expects a permutation of the {} input dimensions", m.dims);
+        return {};
+    }
+    // ROIs are read through their steps, unless those are not a multiple of the element size
+    for (int d = 0; d < m.dims; ++d)
+        if (m.step[d] % m.elemSize() != 0)
+        {
+            m = m.clone();
+            break;
+        }
+
+    const std::vector<int> shape = permuted_shape(m, new_order);
+    if (dst.empty())
+        dst.create(m.dims, shape.data(), m.type());
+    else
+    {
+        if (!dst.isContinuous() || dst.type() != m.type() || dst.total() != m.total())
+        {
+            spdlog::warn("The destination of permute_dims does not match the {} permuted elements "
+                         "of type {}.",
+                         m.total(), m.type());
+            return {};
+        }
+        if (overlaps(dst, m))
+        {
+            spdlog::warn("The destination of permute_dims overlaps its input, use "
+                         "permute_dims_in_place to permute without a copy.");
+            return {};
+        }
+        dst = dst.reshape(m.channels(), shape);
+    }
+
+    int64_t src_shape[kMaxTensorDims], src_strides[kMaxTensorDims];
+    permuted_layout(m, new_order, src_shape, src_strides);
+    copy_strided(m.data, m.dims, src_shape, src_strides, m.elemSize(), dst.data);
+    return dst;
+}
+
+cv::Mat permute_dims_in_place(cv::Mat m, const std::vector<int>& new_order)
 {
-    assert(new_order.size() == m.dims && "New dimension order length must match matrix dimensions");
-    assert(m.type() == CV_32FC1 && "Generic softmax not implemented for non-float arrays");
+    if (m.empty() || !valid_order(m, new_order) || m.dims > kMaxTensorDims)
+    {
+        spdlog::warn("permute_dims expects a permutation of the {} input dimensions", m.dims);
+        return {};
+    }
+    if (!m.isContinuous())
+    {
+        spdlog::warn("permute_dims_in_place needs a continuous matrix");
+        return {};
+    }
 
-    std::vector<int> new_shape(m.dims);
-    std::generate_n(begin(new_shape), m.dims,
-                    [&, i = 0]() mutable { return m.size[new_order[i++]]; });
-    auto res = m.reshape(m.channels(), m.dims, new_shape.data());
+    int64_t shape[kMaxTensorDims], strides[kMaxTensorDims];
+    permuted_layout(m, new_order, shape, strides);
+    permute_in_place(m.data, m.dims, shape, strides, m.elemSize());
+    return m.reshape(m.channels(), permuted_shape(m, new_order));
+}
+
+namespace
+{
 
-    // \TODO: this is pretty un-performant. I do a copy so I don't have to worry about in-place
-    //       swapping, which would be way more efficient. however, can't figure out a good policy
-    //       right now on account of tiredness and, frankly, who cares.
-    m.clone().forEach<float>([&](float& v, const int* p) {
-        std::vector<int> old_pos(m.dims);
-        std::generate_n(begin(old_pos), m.dims, [&, i = 0]() mutable { return p[new_order[i++]]; });
-        res.at<float>(old_pos.data()) = v;
+template<typename Src>
+constexpr float max_value()
+{
+    return std::is_floating_point<Src>::value ? 1.0f
+                                               : static_cast<float>(std::numeric_limits<Src>::max());
+}
+
+/// Converts the rows in `range` of the interleaved image `in` into the planes of `dst`
+template<typename Src, typename Dst>
+void planar_rows(const cv::Mat& in, Dst* dst, int channels, float mul, float add,
+                 const cv::Range& range)
+{
+    const int    W      = in.cols;
+    const int    in_cn  = in.channels();
+    const size_t plane  = size_t(in.rows) * W;
+    const Dst    alpha  = cv::saturate_cast<Dst>(max_value<Src>() * mul + add);
+    auto         scaled = [&](float v) { return cv::saturate_cast<Dst>(v * mul + add); };
+
+    for (int y = range.start; y < range.end; ++y)
+    {
+        const Src* src = in.ptr<Src>(y);
+        Dst*       out = dst + size_t(y) * W;
+
+        if (in_cn == channels)
+        {
+            for (int x = 0; x < W; ++x, src += in_cn)
+                for (int c = 0; c < channels; ++c)
+                    out[c * plane + x] = scaled(static_cast<float>(src[c]));
+        }
+        else if (in_cn == 1)
+        {
+            // gray to BGR(A): broadcast the value, alpha is opaque
+            for (int x = 0; x < W; ++x)
+            {
+                Dst v = scaled(static_cast<float>(src[x]));
+                for (int c = 0; c < 3; ++c)
+                    out[c * plane + x] = v;
+                if (channels == 4) out[3 * plane + x] = alpha;
+            }
+        }
+        else
+        {
+            // BGR(A) to gray
+            for (int x = 0; x < W; ++x, src += in_cn)
+            {
+                float v = kGrayB * static_cast<float>(src[0]) + kGrayG * static_cast<float>(src[1]) +
+                          kGrayR * static_cast<float>(src[2]);
+                out[x] = scaled(v);
+            }
+        }
+    }
+}
+
+template<typename Dst>
+void planar_dispatch_src(const cv::Mat& in, Dst* dst, int channels, float mul, float add)
+{
+    cv::parallel_for_(cv::Range(0, in.rows), [&](const cv::Range& range) {
+        switch (in.depth())
+        {
+        case CV_8U: planar_rows<uint8_t>(in, dst, channels, mul, add, range); break;
+        case CV_8S: planar_rows<int8_t>(in, dst, channels, mul, add, range); break;
+        case CV_16U: planar_rows<uint16_t>(in, dst, channels, mul, add, range); break;
+        case CV_16S: planar_rows<int16_t>(in, dst, channels, mul, add, range); break;
+        case CV_32S: planar_rows<int32_t>(in, dst, channels, mul, add, range); break;
+        case CV_32F: planar_rows<float>(in, dst, channels, mul, add, range); break;
+        }
     });
-    return res;
 }
 
-cv::Mat try_adjust_input(cv::Mat input, int input_index, model& m)
+/// 8-bit images are converted row by row with the SIMD kernels. Returns false if the combination
+/// of channels and scaling is not covered by a kernel.
+bool planar_kernels(const cv::Mat& in, cv::Mat& dst, int depth, int channels, float mul, float add)
 {
-    auto tensor = m.inputs()[input_index];
-    auto dims   = tensor->getDimensions();
-    auto type   = tensor->getType();
+    const int in_cn = in.channels();
+    if (in.depth() != CV_8U || channels > kernels::kMaxPlanes || in_cn > kernels::kMaxPlanes)
+        return false;
+
+    const bool to_s8 = depth == CV_8S && in_cn == channels && mul == 1.f && add == -127.f;
+    if (depth != CV_32F && !to_s8) return false;
+
+    const auto&  k     = kernels::active();
+    const int    W     = in.cols;
+    const size_t plane = in.total();
+    cv::parallel_for_(cv::Range(0, in.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const uint8_t* src = in.ptr<uint8_t>(y);
+            if (to_s8)
+            {
+                int8_t* planes[kernels::kMaxPlanes];
+                for (int c = 0; c < channels; ++c)
+                    planes[c] = dst.ptr<int8_t>() + c * plane + size_t(y) * W;
+                k.u8_to_s8_planar(src, W, in_cn, planes);
+                continue;
+            }
+
+            float* planes[kernels::kMaxPlanes];
+            for (int c = 0; c < channels; ++c)
+                planes[c] = dst.ptr<float>() + c * plane + size_t(y) * W;
+
+            if (in_cn == channels)
+                k.u8_to_f32_planar(src, W, in_cn, planes, mul, add);
+            else if (in_cn == 1)
+            {
+                k.u8_gray_to_f32_planar(src, W, planes, 3, mul, add);
+                if (channels == 4) std::fill_n(planes[3], W, max_value<uint8_t>() * mul + add);
+            }
+            else
+                k.u8_bgr_to_gray_f32(src, W, in_cn, planes[0], mul, add);
+        }
+    });
+    return true;
+}
+
+} // namespace
+
+cv::Mat convert_to_planar(cv::Mat in, int depth, int channels, double mul, double add, cv::Mat dst)
+{
+    if (in.dims != 2)
+    {
+        spdlog::warn("convert_to_planar expects a 2D (interleaved) image, got {} dimensions.",
+                     in.dims);
+        return {};
+    }
+
+    const int in_cn = in.channels();
+    if (!(in_cn == channels || (in_cn == 1 && (channels == 3 || channels == 4)) ||
+          ((in_cn == 3 || in_cn == 4) && channels == 1)))
+    {
+        spdlog::warn("Cannot convert a {}-channel image to {} planar channels.", in_cn, channels);
+        return {};
+    }
+    if (in.depth() == CV_64F || in.depth() > CV_64F)
+    {
+        spdlog::warn("Cannot convert images of depth {} to planar layout.", in.depth());
+        return {};
+    }
+
+    std::vector<int> shape{channels, in.rows, in.cols};
+    if (dst.empty())
+        dst.create(3, shape.data(), CV_MAKETYPE(depth, 1));
+    else
+    {
+        if (!dst.isContinuous() || dst.depth() != depth ||
+            dst.total() * dst.channels() != size_t(channels) * in.total())
+        {
+            spdlog::warn("The destination of convert_to_planar does not match the converted "
+                         "{}x{}x{} image of depth {}.",
+                         channels, in.rows, in.cols, depth);
+            return {};
+        }
+        dst = dst.reshape(1, shape);
+    }
+
+    const float fmul = static_cast<float>(mul), fadd = static_cast<float>(add);
+    if (planar_kernels(in, dst, depth, channels, fmul, fadd)) return dst;
 
-    if (dims.nbDims != 4)
+    switch (depth)
+    {
+    case CV_32F: planar_dispatch_src(in, dst.ptr<float>(), channels, fmul, fadd); break;
+    case CV_32S: planar_dispatch_src(in, dst.ptr<int32_t>(), channels, fmul, fadd); break;
+    case CV_8S: planar_dispatch_src(in, dst.ptr<int8_t>(), channels, fmul, fadd); break;
+    default: spdlog::warn("Unsupported planar output depth {}.", depth); return {};
+    }
+    return dst;
+}
+
+cv::Mat try_adjust_input(cv::Mat input, const std::vector<int>& shape, int depth, cv::Mat dst)
+{
+    if (shape.size() != 4)
     {
         spdlog::warn("Currently auto-adjust only works for 4-dimensional inputs");
         return {};
     }
 
-    int W{dims.d[3]}, H{dims.d[2]}, C{dims.d[1]} /*, N{dims.d[0]}*/;
-    if (dims.d[0] != 1)
+    int W{shape[3]}, H{shape[2]}, C{shape[1]} /*, N{shape[0]}*/;
+    if (shape[0] != 1)
     {
         spdlog::warn("We assume an internal batch size of 1 but first dimension is actually {}",
-                     dims.d[0]);
+                     shape[0]);
+    }
+
+    if (input.dims != 2)
+    {
+        spdlog::warn("Currently auto-adjust only works for 2D images");
+        return {};
     }
 
     // adjust size
     if (H != input.rows || W != input.cols) cv::resize(input, input, cv::Size(W, H));
 
-    // adjust type
+    // adjust type - the conversion itself happens in the fused pass below
     double mul          = 1.0;
     double add          = 0.0;
-    auto   in_elem_type = input.type() & CV_MAT_DEPTH_MASK;
-    switch (type)
+    auto   in_elem_type = input.depth();
+    switch (depth)
     {
-    case nvinfer1::DataType::kFLOAT:
+    case CV_32F:
+    case CV_16F:
         if (in_elem_type == CV_8U) mul = 1. / double(0xFF);
         if (in_elem_type == CV_8S) mul = 1. / double(0x7F);
         if (in_elem_type == CV_16U) mul = 1. / double(0xFFFF);
         if (in_elem_type == CV_16S) mul = 1. / double(0x7FFF);
         if (in_elem_type == CV_32S) mul = 1. / double(0x7FFFFFFF);
-        input.convertTo(input, CV_32FC(input.channels()), mul, add);
         break;
-    case nvinfer1::DataType::kINT32: input.convertTo(input, CV_32SC(input.channels()), mul, add);
-    case nvinfer1::DataType::kINT8:
+    case CV_32S: break;
+    case CV_8S:
         if (in_elem_type == CV_8U) add = -double(0x7f);
         if (in_elem_type == CV_16U)
         {
@@ -169,54 +856,181 @@ cv::Mat try_adjust_input(cv::Mat input, int input_index, model& m)
         if (in_elem_type == CV_16S) mul = double(0x7F) / double(0x7FFF);
         if (in_elem_type == CV_32S) mul = double(0xFF) / double(0x7FFFFFFF);
         if (in_elem_type == CV_32F) mul = double(0x7F);
-        input.convertTo(input, CV_8SC(input.channels()), mul, add);
+        break;
     default:
-        spdlog::warn("Could not adjust element type - type {} not supported.", to_str(type));
+        spdlog::warn("Could not adjust element type - OpenCV depth {} not supported.", depth);
         return {};
     }
 
     // TODO adjust input range?
 
-    // adjust number of channels if possible
-    if (C == 1 && input.channels() == 3)
-        cv::cvtColor(input, input, CV_BGR2GRAY);
-    else if (C == 1 && input.channels() == 4)
-        cv::cvtColor(input, input, CV_BGRA2GRAY);
-    else if (C == 3 && input.channels() == 1)
-        cv::cvtColor(input, input, CV_GRAY2BGR);
-    else if (C == 4 && input.channels() == 1)
-        cv::cvtColor(input, input, CV_GRAY2BGRA);
-    else if (C != input.channels())
+    // adjust number of channels, element type and HWC -> CHW layout in one pass
+    if (depth != CV_16F) return convert_to_planar(input, depth, C, mul, add, dst);
+
+    // half precision inputs are computed in float first and rounded in one bulk pass
+    cv::Mat planar = convert_to_planar(input, CV_32F, C, mul, add);
+    return planar.empty() ? planar : convert_f32_to_f16(planar, dst);
+}
+
+namespace
+{
+
+/// `try_adjust_input` for bfloat16 inputs, which have no OpenCV depth: adjusted in float and
+/// rounded in one bulk pass into `CV_16U` bits
+cv::Mat try_adjust_input_bf16(cv::Mat input, const std::vector<int>& shape, cv::Mat dst)
+{
+    cv::Mat planar = try_adjust_input(input, shape, CV_32F);
+    return planar.empty() ? planar : convert_f32_to_bf16(planar, dst);
+}
+
+} // namespace
+
+#ifdef EZTRT_WITH_TENSORRT
+cv::Mat try_adjust_input(cv::Mat input, int input_index, model& m, cv::Mat dst)
+{
+    if (m.backend()) return try_adjust_input(input, input_index, m.backend()->info(), dst);
+
+    const auto& bindings = m.input_bindings();
+    if (input_index < 0 || input_index >= int(bindings.size()))
     {
-        spdlog::warn("Could not adjust number of channels to match expected input shape: "
-                     "Given input has {} channels while model expects {} channels.",
-                     input.channels(), C);
+        spdlog::warn("The model has no input {}", input_index);
         return {};
     }
-    // adjust channels from HWC to CHW
-    if (input.dims == 2) { input = permute_dims(reshape_channels(input), {2, 0, 1}); }
+    auto dims = bindings[input_index].dims();
+    auto type = bindings[input_index].dataType();
 
-    return input;
+    int depth = -1;
+    switch (type)
+    {
+    case nvinfer1::DataType::kFLOAT: depth = CV_32F; break;
+    case nvinfer1::DataType::kHALF: depth = CV_16F; break;
+    case nvinfer1::DataType::kINT32: depth = CV_32S; break;
+    case nvinfer1::DataType::kINT8: depth = CV_8S; break;
+#if NV_TENSORRT_MAJOR >= 9
+    case nvinfer1::DataType::kBF16:
+        return try_adjust_input_bf16(input, std::vector<int>(dims.d, dims.d + dims.nbDims), dst);
+#endif
+    default:
+        spdlog::warn("Could not adjust element type - type {} not supported.", to_str(type));
+        return {};
+    }
+
+    return try_adjust_input(input, std::vector<int>(dims.d, dims.d + dims.nbDims), depth, dst);
 }
+#endif
 
-std::unordered_map<size_t, std::string> load_class_labels(const std::string& filename)
+cv::Mat try_adjust_input(cv::Mat input, int input_index, const onnx_model_info& info, cv::Mat dst)
+{
+    if (!info.valid() || input_index < 0 || input_index >= int(info.inputs.size()))
+    {
+        spdlog::warn("The model has no input {}", input_index);
+        return {};
+    }
+    const auto& tensor = info.inputs[input_index];
+
+    int depth = -1;
+    switch (tensor.type)
+    {
+    case onnx_type::float32: depth = CV_32F; break;
+    case onnx_type::float16: depth = CV_16F; break;
+    case onnx_type::bfloat16: break;
+    case onnx_type::int32: depth = CV_32S; break;
+    case onnx_type::int8: depth = CV_8S; break;
+    default:
+        spdlog::warn("Could not adjust element type - type {} not supported.", to_str(tensor.type));
+        return {};
+    }
+
+    // symbolic dimensions take whatever the input has, the batch size is 1
+    std::vector<int> shape(tensor.shape.begin(), tensor.shape.end());
+    if (shape.size() == 4)
+    {
+        const int fallback[4] = {1, input.channels(), input.rows, input.cols};
+        for (int i = 0; i < 4; ++i)
+            if (shape[i] < 0) shape[i] = fallback[i];
+    }
+
+    if (tensor.type == onnx_type::bfloat16) return try_adjust_input_bf16(input, shape, dst);
+    return try_adjust_input(input, shape, depth, dst);
+}
+
+std::vector<std::string> load_class_labels(const std::string& filename)
 {
     using json = nlohmann::json;
 
     std::ifstream ifs(filename);
     if (ifs.is_open())
     {
-        std::unordered_map<size_t, std::string> class_label_map;
-        auto                                    parsed_data = json::parse(ifs);
+        std::vector<std::string> labels;
+        auto                     parsed_data = json::parse(ifs, nullptr, false);
+        if (parsed_data.is_discarded() || !parsed_data.is_object())
+        {
+            spdlog::error("{}: class labels must be a JSON object", filename);
+            return {};
+        }
 
+        // the labels are stored densely, so an index far beyond the number of entries is
+        // treated as an error instead of allocating up to it
+        const size_t max_index = kMaxLabelSparseness * parsed_data.size();
         for (auto& [key, value] : parsed_data.items())
         {
-            size_t cls_idx           = atoi(key.c_str());
-            class_label_map[cls_idx] = value.get<std::string>();
+            size_t     cls_idx = 0;
+            const auto end     = key.data() + key.size();
+            const auto parsed  = std::from_chars(key.data(), end, cls_idx);
+            if (key.empty() || parsed.ec != std::errc() || parsed.ptr != end ||
+                cls_idx >= max_index)
+            {
+                spdlog::error("{}: skipping label of invalid class index \"{}\"", filename, key);
+                continue;
+            }
+            if (!value.is_string())
+            {
+                spdlog::error("{}: skipping label of class {}, it is not a string", filename, key);
+                continue;
+            }
+            if (cls_idx >= labels.size()) labels.resize(cls_idx + 1);
+            labels[cls_idx] = value.get<std::string>();
         }
-        return class_label_map;
+        return labels;
     }
     return {};
 }
 
+std::vector<class_score> top_k(cv::Mat scores, int k, float threshold /*= -inf*/,
+                               const std::vector<std::string>& labels /*= {}*/)
+{
+    if (scores.empty() || k <= 0) return {};
+    if (scores.depth() != CV_32F)
+        scores.convertTo(scores, CV_32F);
+    else if (!scores.isContinuous())
+        scores = scores.clone();
+
+    const size_t n = scores.total() * scores.channels();
+    if (n > size_t(std::numeric_limits<int32_t>::max()))
+    {
+        spdlog::warn("top_k supports at most 2^31 scores, got {}", n);
+        return {};
+    }
+
+    const float*         s = scores.ptr<float>();
+    std::vector<int32_t> candidates(n);
+    candidates.resize(kernels::active().select_above_f32(s, n, threshold, candidates.data()));
+
+    const auto before = [s](int32_t a, int32_t b) {
+        return s[a] > s[b] || (s[a] == s[b] && a < b);
+    };
+    if (candidates.size() > size_t(k))
+    {
+        std::nth_element(candidates.begin(), candidates.begin() + k, candidates.end(), before);
+        candidates.resize(k);
+    }
+    std::sort(candidates.begin(), candidates.end(), before);
+
+    std::vector<class_score> result;
+    result.reserve(candidates.size());
+    for (int32_t i : candidates)
+        result.push_back({i, s[i], size_t(i) < labels.size() ? labels[i] : std::string{}});
+    return result;
+}
+
 } // namespace eztrt
@@ -0,0 +1,240 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/batching.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace eztrt;
+
+namespace
+{
+
+/**
+ * A backend with an $[capacity, 4]$ float input that doubles its input and records the size of
+ * every batch it executes.
+ */
+struct fake_backend
+{
+    explicit fake_backend(int capacity)
+        : input(capacity, 4, CV_32F, cv::Scalar(0)), output(capacity, 4, CV_32F, cv::Scalar(0))
+    {
+    }
+
+    batching_executor::backend make()
+    {
+        return {[this] { return input; },
+                [this](int n) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        batch_sizes.push_back(n);
+                    }
+                    // rows beyond n are stale and must not reach any caller
+                    output = cv::Scalar(-1);
+                    cv::Mat rows = output.rowRange(0, n);
+                    input.rowRange(0, n).convertTo(rows, CV_32F, 2.0);
+                    return output;
+                }};
+    }
+
+    std::vector<int> sizes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return batch_sizes;
+    }
+
+    cv::Mat          input, output;
+    std::mutex       mutex;
+    std::vector<int> batch_sizes;
+};
+
+cv::Mat sample(float value) { return cv::Mat(1, 4, CV_32F, cv::Scalar(value)); }
+
+bool is_result_of(const cv::Mat& result, float value)
+{
+    return !result.empty() && result.total() == 4 && result.depth() == CV_32F &&
+           cv::countNonZero(result.reshape(1, 1) != value * 2) == 0;
+}
+
+constexpr auto kTimeout = std::chrono::seconds(10);
+
+} // namespace
+
+TEST_CASE("full batches are executed without waiting for max_wait_us")
+{
+    fake_backend be(8);
+    // a deadline the test would run into if the executor waited for it
+    batching_executor::options opts;
+    opts.max_batch   = 4;
+    opts.max_wait_us = 60 * 1000 * 1000;
+    batching_executor exec(be.make(), opts);
+
+    std::vector<std::future<cv::Mat>> results;
+    for (int i = 0; i < 8; ++i)
+        results.push_back(exec.submit(sample(float(i))));
+    for (int i = 0; i < 8; ++i)
+    {
+        CAPTURE(i);
+        REQUIRE(results[i].wait_for(kTimeout) == std::future_status::ready);
+        CHECK(is_result_of(results[i].get(), float(i)));
+    }
+
+    CHECK(be.sizes() == std::vector<int>{4, 4});
+    const auto stats = exec.statistics();
+    CHECK(stats.batches == 2);
+    CHECK(stats.samples == 8);
+    CHECK(stats.max_batch == 4);
+    CHECK(stats.fill_rate() == doctest::Approx(1.0));
+}
+
+TEST_CASE("a partial batch is executed once the oldest request waited for max_wait_us")
+{
+    fake_backend be(8);
+    batching_executor::options opts;
+    opts.max_batch   = 8;
+    opts.max_wait_us = 20 * 1000;
+    batching_executor exec(be.make(), opts);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<cv::Mat>> results;
+    for (int i = 0; i < 3; ++i)
+        results.push_back(exec.submit(sample(float(i))));
+    for (int i = 0; i < 3; ++i)
+    {
+        CAPTURE(i);
+        REQUIRE(results[i].wait_for(kTimeout) == std::future_status::ready);
+        CHECK(is_result_of(results[i].get(), float(i)));
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK(be.sizes() == std::vector<int>{3});
+    CHECK(elapsed >= std::chrono::microseconds(opts.max_wait_us));
+    const auto stats = exec.statistics();
+    CHECK(stats.max_queue_us >= doctest::Approx(opts.max_wait_us).epsilon(0.01));
+    CHECK(stats.fill_rate() == doctest::Approx(3.0 / 8.0));
+}
+
+TEST_CASE("the batch size is capped by the capacity of the backend")
+{
+    fake_backend be(3);
+    batching_executor::options opts;
+    opts.max_batch   = 16;
+    opts.max_wait_us = 60 * 1000 * 1000;
+    batching_executor exec(be.make(), opts);
+
+    std::vector<std::future<cv::Mat>> results;
+    for (int i = 0; i < 6; ++i)
+        results.push_back(exec.submit(sample(float(i))));
+    for (auto& r : results)
+        REQUIRE(r.wait_for(kTimeout) == std::future_status::ready);
+
+    CHECK(be.sizes() == std::vector<int>{3, 3});
+    CHECK(exec.statistics().max_batch == 3);
+}
+
+TEST_CASE("every caller gets the output of its own sample")
+{
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 200;
+
+    fake_backend be(8);
+    batching_executor::options opts;
+    opts.max_batch   = 8;
+    opts.max_wait_us = 200;
+    batching_executor exec(be.make(), opts);
+
+    std::vector<std::thread> threads;
+    std::vector<int>         wrong(kThreads, 0);
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; ++i)
+            {
+                const float value = float(t * kPerThread + i);
+                auto        result = exec.submit(sample(value));
+                if (result.wait_for(kTimeout) != std::future_status::ready ||
+                    !is_result_of(result.get(), value))
+                    ++wrong[t];
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    for (int t = 0; t < kThreads; ++t)
+        CHECK(wrong[t] == 0);
+    const auto stats = exec.statistics();
+    CHECK(stats.samples == kThreads * kPerThread);
+    for (int n : be.sizes())
+        CHECK(n <= 8);
+}
+
+TEST_CASE("a sample of the wrong shape fails alone")
+{
+    fake_backend               be(4);
+    batching_executor::options opts;
+    opts.max_batch   = 4;
+    opts.max_wait_us = 60 * 1000 * 1000;
+    batching_executor exec(be.make(), opts);
+
+    auto good       = exec.submit(sample(1.f));
+    auto wrong_size = exec.submit(cv::Mat(1, 5, CV_32F, cv::Scalar(2)));
+    auto wrong_type = exec.submit(cv::Mat(1, 4, CV_8U, cv::Scalar(3)));
+    auto also_good  = exec.submit(sample(4.f));
+
+    REQUIRE(good.wait_for(kTimeout) == std::future_status::ready);
+    CHECK(is_result_of(good.get(), 1.f));
+    CHECK(wrong_size.get().empty());
+    CHECK(wrong_type.get().empty());
+    CHECK(is_result_of(also_good.get(), 4.f));
+}
+
+TEST_CASE("the destructor executes pending requests without waiting for max_wait_us")
+{
+    fake_backend be(4);
+    std::future<cv::Mat> pending;
+    {
+        batching_executor::options opts;
+        opts.max_batch   = 4;
+        opts.max_wait_us = 60 * 1000 * 1000;
+        batching_executor exec(be.make(), opts);
+        pending = exec.submit(sample(5.f));
+    }
+    // the destructor drains the queue instead of waiting for the deadline
+    REQUIRE(pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    CHECK(is_result_of(pending.get(), 5.f));
+}
+
+TEST_CASE("an exception from acquire_input fails the batch instead of the process")
+{
+    fake_backend be(4);
+    auto         healthy = be.make();
+
+    // the first call probes the capacity, the second one packs the first batch
+    std::atomic<int> calls{0};
+    auto             acquire_input = [&] {
+        if (calls++ < 2) throw std::bad_alloc();
+        return healthy.acquire_input();
+    };
+    batching_executor::backend flaky{acquire_input, healthy.run};
+    batching_executor::options opts;
+    opts.max_batch   = 4;
+    opts.max_wait_us = 1000;
+    batching_executor exec(flaky, opts);
+
+    auto failed = exec.submit(sample(1.f));
+    REQUIRE(failed.wait_for(kTimeout) == std::future_status::ready);
+    CHECK(failed.get().empty());
+
+    // the worker survived and executes the next batch
+    auto recovered = exec.submit(sample(2.f));
+    REQUIRE(recovered.wait_for(kTimeout) == std::future_status::ready);
+    CHECK(is_result_of(recovered.get(), 2.f));
+    CHECK(be.sizes() == std::vector<int>{1});
+}
@@ -0,0 +1,175 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/bfloat16.h>
+#include <eztrt/kernels.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// The special cases of the float to bfloat16 rounding, for the scalar class and every SIMD level
+// of the conversion kernels.
+
+using namespace eztrt;
+using namespace eztrt::kernels;
+
+namespace
+{
+
+float from_bits(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t to_bits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint16_t to_bf16(uint32_t float_bits) { return bfloat16(from_bits(float_bits)).bits(); }
+
+bool is_nan(uint16_t bits) { return (bits & 0x7F80) == 0x7F80 && (bits & 0x7F) != 0; }
+
+struct rounding_case
+{
+    uint32_t input;    //!< float bits
+    uint16_t expected; //!< bfloat16 bits
+};
+
+// RNE: the lower 16 bits decide, exactly 0x8000 is a tie that goes to the even neighbour
+const rounding_case kRounding[] = {
+    // exact values
+    {0x3F800000, 0x3F80}, // 1
+    {0x00000000, 0x0000}, // +0
+    {0x80000000, 0x8000}, // -0
+    // below, at and above the midpoint between 1 and the next bfloat16
+    {0x3F807FFF, 0x3F80},
+    {0x3F808000, 0x3F80}, // tie, 0x3F80 is even
+    {0x3F808001, 0x3F81},
+    {0x3F818000, 0x3F82}, // tie, 0x3F81 is odd
+    {0xBF808000, 0xBF80}, // negative ties behave the same
+    {0xBF818000, 0xBF82},
+    // a carry into the exponent
+    {0x3FFF8000, 0x4000},
+    // overflow to infinity: FLT_MAX lies above the midpoint to the largest finite bfloat16
+    {0x7F7F7FFF, 0x7F7F},
+    {0x7F7F8000, 0x7F80},
+    {0x7F7FFFFF, 0x7F80},
+    {0xFF7FFFFF, 0xFF80},
+    // infinities
+    {0x7F800000, 0x7F80},
+    {0xFF800000, 0xFF80},
+    // subnormals are rounded like normal numbers, not flushed to zero
+    {0x00010000, 0x0001}, // smallest bfloat16 subnormal
+    {0x00000001, 0x0000}, // smallest float subnormal
+    {0x00008000, 0x0000}, // tie, 0 is even
+    {0x00008001, 0x0001},
+    {0x00018000, 0x0002}, // tie, 1 is odd
+    {0x807F0000, 0x807F}, // largest bfloat16 subnormal, negative
+    {0x007FFFFF, 0x0080}, // largest float subnormal rounds up to the smallest normal
+};
+
+const uint32_t kNaNs[] = {
+    0x7FC00000, // quiet NaN
+    0xFFC00000, // negative quiet NaN
+    0x7F800001, // signaling NaN whose payload lies only in the discarded bits
+    0xFF800001,
+    0x7FBFFFFF, // signaling NaN with all payload bits set
+    0x7FFFFFFF, // rounding up would carry into the sign bit
+    0xFFFFFFFF, // ... and out of the 32 bits
+    0x7FA00000, // signaling NaN with payload in the kept bits
+};
+
+/// All inputs of this test, with the scalar results as the reference
+std::vector<float> special_inputs()
+{
+    std::vector<float> inputs;
+    for (const auto& c : kRounding)
+        inputs.push_back(from_bits(c.input));
+    for (uint32_t nan : kNaNs)
+        inputs.push_back(from_bits(nan));
+    // long enough for the vector bodies of all levels, with the special values in every lane
+    std::vector<float> repeated;
+    for (int i = 0; i < 8; ++i)
+    {
+        repeated.insert(repeated.end(), inputs.begin() + i % 3, inputs.end());
+        repeated.insert(repeated.end(), inputs.begin(), inputs.begin() + i % 3);
+    }
+    return repeated;
+}
+
+} // namespace
+
+TEST_CASE("float to bfloat16 rounds to nearest, ties to even")
+{
+    for (const auto& c : kRounding)
+    {
+        CAPTURE(c.input);
+        CHECK(to_bf16(c.input) == c.expected);
+    }
+}
+
+TEST_CASE("NaNs stay NaNs of the same sign and become quiet")
+{
+    for (uint32_t nan : kNaNs)
+    {
+        CAPTURE(nan);
+        const uint16_t bits = to_bf16(nan);
+        CHECK(is_nan(bits));
+        CHECK((bits & 0x40) != 0);
+        CHECK((bits & 0x8000) == ((nan >> 16) & 0x8000));
+        CHECK(std::isnan(float(bfloat16::from_bits(bits))));
+    }
+}
+
+TEST_CASE("infinities and subnormals convert back to float exactly")
+{
+    CHECK(float(bfloat16::from_bits(0x7F80)) == std::numeric_limits<float>::infinity());
+    CHECK(float(bfloat16::from_bits(0xFF80)) == -std::numeric_limits<float>::infinity());
+    CHECK(float(bfloat16::from_bits(0x0001)) == std::ldexp(1.f, -133));
+    CHECK(float(bfloat16::from_bits(0x807F)) == -std::ldexp(127.f, -133));
+    CHECK(std::signbit(float(bfloat16::from_bits(0x8000))));
+
+    // every non-NaN bfloat16 survives the round trip through float
+    for (uint32_t bits = 0; bits <= 0xFFFF; ++bits)
+    {
+        if (is_nan(uint16_t(bits))) continue;
+        CAPTURE(bits);
+        CHECK(bfloat16(float(bfloat16::from_bits(uint16_t(bits)))).bits() == bits);
+    }
+}
+
+TEST_CASE("the conversion kernels are bit-identical to bfloat16 on the special cases")
+{
+    const auto inputs = special_inputs();
+    std::vector<uint16_t> expected(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+        expected[i] = bfloat16(inputs[i]).bits();
+
+    for (isa level : {isa::scalar, isa::sse41, isa::avx2, isa::avx512})
+    {
+        const auto* table = table_for(level);
+        if (!table) continue;
+        CAPTURE(to_str(level));
+
+        std::vector<uint16_t> actual(inputs.size());
+        table->f32_to_bf16(inputs.data(), actual.data(), inputs.size());
+        CHECK(actual == expected);
+
+        // and back, which is exact
+        std::vector<float> floats(inputs.size());
+        table->bf16_to_f32(actual.data(), floats.data(), actual.size());
+        for (size_t i = 0; i < floats.size(); ++i)
+        {
+            CAPTURE(i);
+            CHECK(to_bits(floats[i]) == uint32_t(actual[i]) << 16);
+        }
+    }
+}
@@ -0,0 +1,375 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/buffers.h>
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace eztrt::testing;
+using namespace samplesCommon;
+
+namespace
+{
+
+/// What the counting allocator has done so far
+struct allocation_log
+{
+    std::vector<size_t>     allocations;      //!< Bytes of every allocation, in order
+    int                     frees{0};         //!< Calls of the free functor with a block
+    std::map<void*, size_t> live;             //!< Blocks that have not been freed yet
+    bool                    fail_next{false}; //!< Let the next allocation fail
+};
+
+allocation_log& current_log()
+{
+    static allocation_log log;
+    return log;
+}
+
+/// Starts a new log, every test begins with it
+allocation_log& fresh_log() { return current_log() = {}; }
+
+struct CountingAlloc
+{
+    bool operator()(void** ptr, size_t size) const
+    {
+        auto& log = current_log();
+        if (log.fail_next)
+        {
+            log.fail_next = false;
+            return false;
+        }
+        *ptr = std::malloc(size ? size : 1);
+        if (!*ptr) return false;
+        log.allocations.push_back(size);
+        log.live[*ptr] = size;
+        return true;
+    }
+};
+
+struct CountingFree
+{
+    void operator()(void* ptr) const
+    {
+        if (!ptr) return;
+        auto& log = current_log();
+        ++log.frees;
+        log.live.erase(ptr);
+        std::free(ptr);
+    }
+};
+
+using CountingBuffer = GenericBuffer<CountingAlloc, CountingFree>;
+
+GrowthPolicy policy(double factor, size_t maxSlackBytes, int shrinkAfter = 32)
+{
+    GrowthPolicy p;
+    p.factor        = factor;
+    p.maxSlackBytes = maxSlackBytes;
+    p.shrinkAfter   = shrinkAfter;
+    return p;
+}
+
+#if NV_TENSORRT_MAJOR < 8
+/// An image input and two outputs of different element types
+std::shared_ptr<mock_engine> make_engine()
+{
+    return std::make_shared<mock_engine>(std::vector<mock_binding>{
+        {"image", nvinfer1::Dims4(1, 3, 8, 8), nvinfer1::DataType::kFLOAT, true},
+        {"scores", nvinfer1::Dims2(1, 10), nvinfer1::DataType::kHALF, false},
+        {"labels", nvinfer1::Dims3(1, 8, 8), nvinfer1::DataType::kINT32, false},
+    });
+}
+
+#endif
+
+} // namespace
+
+TEST_CASE("a sized buffer allocates once and frees on destruction")
+{
+    allocation_log& log = fresh_log();
+    {
+        CountingBuffer buffer(100, nvinfer1::DataType::kHALF);
+        CHECK(buffer.size() == 100);
+        CHECK(buffer.nbBytes() == 200);
+        CHECK(buffer.capacityBytes() == 200);
+        CHECK(buffer.data() != nullptr);
+        CHECK(log.allocations == std::vector<size_t>{200});
+        CHECK(buffer.stats().reallocations == 0);
+
+        // moving hands over the block
+        CountingBuffer moved(std::move(buffer));
+        CHECK(moved.size() == 100);
+        CHECK(buffer.data() == nullptr);
+        CHECK(log.frees == 0);
+    }
+    CHECK(log.frees == 1);
+    CHECK(log.live.empty());
+}
+
+TEST_CASE("growing buffers reallocate geometrically")
+{
+    allocation_log& log = fresh_log();
+    {
+        CountingBuffer buffer;
+        buffer.resize(100);
+        CHECK(buffer.capacityBytes() == 400);
+        buffer.resize(101);
+        CHECK(buffer.capacityBytes() == 150 * 4);
+        // no reallocation until the capacity is exhausted
+        buffer.resize(150);
+        buffer.resize(20);
+        CHECK(buffer.capacityBytes() == 150 * 4);
+        buffer.resize(151);
+        CHECK(buffer.capacityBytes() == 225 * 4);
+        // a large step is allocated as requested
+        buffer.resize(1000);
+        CHECK(buffer.capacityBytes() == 1000 * 4);
+        CHECK(log.allocations == std::vector<size_t>{400, 600, 900, 4000});
+
+        // growing one element at a time needs a logarithmic number of reallocations
+        for (size_t n = 1001; n <= 100000; ++n)
+        {
+            buffer.resize(n);
+            if (buffer.capacityBytes() < buffer.nbBytes()) REQUIRE(false);
+        }
+        CHECK(buffer.size() == 100000);
+        CHECK(buffer.stats().resizes == 6 + 99000);
+        // 1000 * 1.5^k >= 100000 for k = 12
+        CHECK(buffer.stats().grows == 4 + 12);
+        CHECK(buffer.stats().reallocations == buffer.stats().grows);
+        CHECK(log.allocations.size() == buffer.stats().reallocations);
+        CHECK(log.live.size() == 1);
+    }
+    CHECK(log.live.empty());
+}
+
+TEST_CASE("the slack of a grown buffer is capped at maxSlackBytes")
+{
+    allocation_log& log = fresh_log();
+    CountingBuffer buffer(10000, nvinfer1::DataType::kHALF);
+    buffer.setGrowthPolicy(policy(1.5, 1024));
+
+    buffer.resize(10001);
+    CHECK(buffer.capacityBytes() == 10001 * 2 + 1024);
+    buffer.resize(10001 + 512);
+    CHECK(buffer.stats().grows == 1);
+    buffer.resize(10001 + 513);
+    CHECK(buffer.capacityBytes() == (10001 + 513) * 2 + 1024);
+
+    // without slack every growing resize allocates exactly the requested size
+    buffer.setGrowthPolicy(policy(2.0, 0));
+    buffer.resize(20000);
+    CHECK(buffer.capacityBytes() == 40000);
+    CHECK(log.allocations.back() == 40000);
+}
+
+TEST_CASE("buffers shrink after shrinkAfter consecutive small resizes")
+{
+    allocation_log& log = fresh_log();
+    CountingBuffer buffer;
+    buffer.setGrowthPolicy(policy(1.5, size_t(64) << 20, 4));
+    buffer.resize(1000);
+
+    // below a quarter of the capacity, but interrupted by a larger resize
+    for (int i = 0; i < 3; ++i)
+        buffer.resize(100);
+    buffer.resize(500);
+    for (int i = 0; i < 3; ++i)
+        buffer.resize(100);
+    CHECK(buffer.capacityBytes() == 4000);
+    CHECK(buffer.stats().shrinks == 0);
+
+    // the fourth small resize in a row shrinks to the requested size
+    buffer.resize(100);
+    CHECK(buffer.stats().shrinks == 1);
+    CHECK(buffer.capacityBytes() == 400);
+    CHECK(buffer.size() == 100);
+    CHECK(log.allocations.back() == 400);
+    CHECK(log.live.size() == 1);
+
+    // shrinkAfter = 0 never shrinks
+    buffer.resize(1000);
+    buffer.setGrowthPolicy(policy(1.5, size_t(64) << 20, 0));
+    for (int i = 0; i < 100; ++i)
+        buffer.resize(1);
+    CHECK(buffer.stats().shrinks == 1);
+    CHECK(buffer.capacityBytes() == 4000);
+}
+
+TEST_CASE("reserve allocates ahead without changing the size")
+{
+    allocation_log& log = fresh_log();
+    CountingBuffer buffer(nvinfer1::DataType::kINT8);
+    buffer.reserve(500);
+    CHECK(buffer.size() == 0);
+    CHECK(buffer.capacityBytes() == 500);
+    CHECK(buffer.stats().reallocations == 1);
+    CHECK(buffer.stats().grows == 0);
+
+    // resizes within the reserved capacity and smaller reserves do not reallocate
+    for (size_t n : {10, 500, 200})
+        buffer.resize(n);
+    buffer.reserve(100);
+    CHECK(buffer.capacityBytes() == 500);
+    CHECK(buffer.size() == 200);
+    CHECK(log.allocations == std::vector<size_t>{500});
+
+    buffer.reserve(800);
+    CHECK(buffer.capacityBytes() == 800);
+    CHECK(buffer.size() == 200);
+    CHECK(log.allocations == std::vector<size_t>{500, 800});
+    CHECK(log.frees == 1);
+}
+
+TEST_CASE("a failed reallocation throws and leaves an empty buffer")
+{
+    allocation_log& log = fresh_log();
+    CountingBuffer buffer(100, nvinfer1::DataType::kFLOAT);
+    log.fail_next = true;
+    CHECK_THROWS_AS(buffer.resize(1000), std::bad_alloc);
+    CHECK(buffer.data() == nullptr);
+    CHECK(buffer.size() == 0);
+    CHECK(buffer.capacityBytes() == 0);
+    // the old block was freed before the allocation was tried
+    CHECK(log.live.empty());
+
+    // and the buffer can be used again
+    buffer.resize(10);
+    CHECK(buffer.data() != nullptr);
+    CHECK(buffer.capacityBytes() == 40);
+}
+
+#if NV_TENSORRT_MAJOR < 8
+TEST_CASE("binding handles resolve names and indices alike")
+{
+    const auto engine = make_engine();
+    for (int i = 0; i < engine->getNbBindings(); ++i)
+    {
+        CAPTURE(i);
+        const BindingHandle byIndex(*engine, i);
+        const BindingHandle byName(*engine, engine->getBindingName(i));
+        REQUIRE(byIndex.valid());
+        REQUIRE(byName.valid());
+        CHECK(byName.index() == i);
+        CHECK(byIndex.index() == i);
+        CHECK(byName.name() == byIndex.name());
+        CHECK(byName.dims().nbDims == engine->getBindingDimensions(i).nbDims);
+        CHECK(byName.dataType() == engine->getBindingDataType(i));
+        CHECK(byName.isInput() == (i == 0));
+    }
+
+    CHECK(!BindingHandle().valid());
+    CHECK(!BindingHandle(*engine, "missing").valid());
+    CHECK(!BindingHandle(*engine, -1).valid());
+    CHECK(!BindingHandle(*engine, engine->getNbBindings()).valid());
+    CHECK(BindingHandle(*engine, "missing").index() == -1);
+}
+
+TEST_CASE("BufferManager gives the same buffers for handles and names")
+{
+    if (!has_cuda_device())
+    {
+        MESSAGE("no CUDA device, skipped");
+        return;
+    }
+
+    const auto    engine = make_engine();
+    BufferManager buffers(engine, 1);
+    REQUIRE(buffers.getNbBindings() == 3);
+    REQUIRE(buffers.getBindings().size() == 3);
+
+    for (const BindingHandle& binding : buffers.getBindings())
+    {
+        CAPTURE(binding.name());
+        const int i = binding.index();
+        CHECK(&buffers.getBinding(binding.name()) == &binding);
+        CHECK(buffers.getHostBuffer(binding) != nullptr);
+        CHECK(buffers.getHostBuffer(binding) == buffers.getHostBuffer(binding.name()));
+        CHECK(buffers.getDeviceBuffer(binding) != nullptr);
+        CHECK(buffers.getDeviceBuffer(binding) == buffers.getDeviceBuffer(binding.name()));
+        CHECK(buffers.getDeviceBindings()[i] == buffers.getDeviceBuffer(binding));
+        CHECK(buffers.size(binding) == buffers.size(binding.name()));
+        CHECK(buffers.size(binding) ==
+              size_t(volume(binding.dims())) * getElementSize(binding.dataType()));
+    }
+    CHECK(buffers.size("image") == 3 * 8 * 8 * 4);
+    CHECK(buffers.size("scores") == 10 * 2);
+}
+
+TEST_CASE("invalid handles and unknown names give no buffers")
+{
+    if (!has_cuda_device())
+    {
+        MESSAGE("no CUDA device, skipped");
+        return;
+    }
+
+    const auto          engine = make_engine();
+    BufferManager       buffers(engine, 1);
+    const BindingHandle invalid;
+
+    CHECK(!buffers.getBinding("missing").valid());
+    CHECK(buffers.getHostBuffer(invalid) == nullptr);
+    CHECK(buffers.getDeviceBuffer(invalid) == nullptr);
+    CHECK(buffers.size(invalid) == BufferManager::kINVALID_SIZE_VALUE);
+    CHECK(buffers.getHostBuffer("missing") == nullptr);
+    CHECK(buffers.getDeviceBuffer("missing") == nullptr);
+    CHECK(buffers.size("missing") == BufferManager::kINVALID_SIZE_VALUE);
+
+    CHECK(!buffers.resize(invalid, nvinfer1::Dims2(1, 20)));
+    CHECK(!buffers.resize("missing", nvinfer1::Dims2(1, 20)));
+    CHECK(!buffers.reserve(invalid, nvinfer1::Dims2(1, 20)));
+    CHECK(!buffers.reserve("missing", nvinfer1::Dims2(1, 20)));
+}
+
+TEST_CASE("resize and reserve keep the device bindings up to date")
+{
+    if (!has_cuda_device())
+    {
+        MESSAGE("no CUDA device, skipped");
+        return;
+    }
+
+    const auto           engine = make_engine();
+    BufferManager        buffers(engine, 1);
+    const BindingHandle& image  = buffers.getBinding("image");
+    const BindingHandle& scores = buffers.getBinding("scores");
+    void* const          scoresDevice = buffers.getDeviceBuffer(scores);
+    const auto&          managed      = buffers.getManagedBuffer(image.index());
+
+    // a larger input resolution reallocates both buffers of the binding
+    REQUIRE(buffers.resize(image, nvinfer1::Dims4(1, 3, 16, 16)));
+    CHECK(buffers.size(image) == 3 * 16 * 16 * 4);
+    CHECK(buffers.getDeviceBindings()[image.index()] == buffers.getDeviceBuffer(image));
+    CHECK(buffers.getDeviceBuffer(image) == managed.deviceBuffer.data());
+    CHECK(buffers.getHostBuffer(image) == managed.hostBuffer.data());
+    CHECK(managed.deviceBuffer.stats().grows == 1);
+    CHECK(managed.hostBuffer.stats().grows == 1);
+
+    // by name, and shrinking within the capacity keeps the allocation
+    REQUIRE(buffers.resize("image", nvinfer1::Dims4(1, 3, 12, 12)));
+    CHECK(buffers.size("image") == 3 * 12 * 12 * 4);
+    CHECK(managed.deviceBuffer.stats().reallocations == 1);
+    CHECK(buffers.getDeviceBindings()[image.index()] == buffers.getDeviceBuffer(image));
+
+    // reserving beyond the capacity reallocates without changing the size
+    REQUIRE(buffers.reserve(image, nvinfer1::Dims4(1, 3, 64, 64)));
+    CHECK(managed.deviceBuffer.stats().reallocations == 2);
+    CHECK(managed.deviceBuffer.capacityBytes() == 3 * 64 * 64 * 4);
+    CHECK(buffers.size(image) == 3 * 12 * 12 * 4);
+    CHECK(buffers.getDeviceBindings()[image.index()] == buffers.getDeviceBuffer(image));
+    CHECK(buffers.getHostBuffer("image") == managed.hostBuffer.data());
+
+    // the other bindings are left alone
+    CHECK(buffers.getDeviceBuffer(scores) == scoresDevice);
+    CHECK(buffers.getDeviceBindings()[scores.index()] == scoresDevice);
+}
+#endif
@@ -0,0 +1,179 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/convert.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// The matrix API of convert.h: shapes, destinations and the rejection of matrices that do not fit.
+// The element-wise rounding is covered by kernels_test and bfloat16_test.
+
+using namespace eztrt;
+
+namespace
+{
+
+/// A continuous CV_32F tensor of `shape` and `channels`, element `i` is `(i - 20) / 8`
+cv::Mat make_floats(const std::vector<int>& shape, int channels = 1)
+{
+    cv::Mat m(int(shape.size()), shape.data(), CV_MAKETYPE(CV_32F, channels));
+    float*  values = m.ptr<float>();
+    for (size_t i = 0; i < m.total() * channels; ++i)
+        values[i] = (float(i) - 20.f) / 8.f;
+    return m;
+}
+
+/// True if `m` has the dimensions of `reference`
+bool same_shape(const cv::Mat& m, const cv::Mat& reference)
+{
+    if (m.dims != reference.dims || m.channels() != reference.channels()) return false;
+    for (int d = 0; d < m.dims; ++d)
+        if (m.size[d] != reference.size[d]) return false;
+    return true;
+}
+
+uint16_t half_bits(float value)
+{
+    const half_float::half h(value);
+    uint16_t               bits;
+    std::memcpy(&bits, &h, sizeof(bits));
+    return bits;
+}
+
+} // namespace
+
+TEST_CASE("floats convert to half and back in the same shape")
+{
+    for (const cv::Mat& m : {make_floats({2, 3, 4}), make_floats({5, 7}, 3)})
+    {
+        CAPTURE(m.dims);
+        const cv::Mat h = convert_f32_to_f16(m);
+        REQUIRE(h.depth() == CV_16F);
+        CHECK(same_shape(h, m));
+        const auto* bits = h.ptr<uint16_t>();
+        for (size_t i = 0; i < m.total() * m.channels(); ++i)
+            CHECK(bits[i] == half_bits(m.ptr<float>()[i]));
+
+        // all values are multiples of 1/8 below 32, which halves represent exactly
+        const cv::Mat back = convert_f16_to_f32(h);
+        REQUIRE(back.type() == m.type());
+        CHECK(same_shape(back, m));
+        CHECK(cv::norm(back.reshape(1, 1), m.reshape(1, 1), cv::NORM_INF) == 0.0);
+    }
+}
+
+TEST_CASE("floats convert to bfloat16 bits and back in the same shape")
+{
+    for (const cv::Mat& m : {make_floats({2, 3, 4}), make_floats({5, 7}, 3)})
+    {
+        CAPTURE(m.dims);
+        const cv::Mat b = convert_f32_to_bf16(m);
+        REQUIRE(b.depth() == CV_16U);
+        CHECK(same_shape(b, m));
+        const auto* bits = b.ptr<uint16_t>();
+        for (size_t i = 0; i < m.total() * m.channels(); ++i)
+            CHECK(bits[i] == bfloat16(m.ptr<float>()[i]).bits());
+
+        const cv::Mat back = convert_bf16_to_f32(b);
+        REQUIRE(back.type() == m.type());
+        CHECK(same_shape(back, m));
+        CHECK(cv::norm(back.reshape(1, 1), m.reshape(1, 1), cv::NORM_INF) == 0.0);
+    }
+}
+
+TEST_CASE("non-continuous sources are converted as well")
+{
+    const cv::Mat m      = make_floats({6, 8});
+    const cv::Mat column = m.col(3);
+    REQUIRE(!column.isContinuous());
+
+    const cv::Mat h = convert_f32_to_f16(column);
+    REQUIRE(h.rows == 6);
+    REQUIRE(h.cols == 1);
+    for (int r = 0; r < 6; ++r)
+        CHECK(h.ptr<uint16_t>(r)[0] == half_bits(m.at<float>(r, 3)));
+    CHECK(cv::norm(convert_bf16_to_f32(convert_f32_to_bf16(column)), column, cv::NORM_INF) == 0.0);
+}
+
+TEST_CASE("a given destination is filled in place and takes the shape of the source")
+{
+    const cv::Mat m = make_floats({2, 3, 4});
+
+    // e.g. the host buffer of an input binding, shaped differently
+    cv::Mat       buffer(1, 24, CV_16F);
+    const cv::Mat h = convert_f32_to_f16(m, buffer);
+    REQUIRE(!h.empty());
+    CHECK(h.data == buffer.data);
+    CHECK(same_shape(h, m));
+
+    cv::Mat       bits(4, 6, CV_16U);
+    const cv::Mat b = convert_f32_to_bf16(m, bits);
+    REQUIRE(!b.empty());
+    CHECK(b.data == bits.data);
+    CHECK(same_shape(b, m));
+
+    cv::Mat       floats(24, 1, CV_32F);
+    const cv::Mat back = convert_f16_to_f32(h, floats);
+    CHECK(back.data == floats.data);
+    CHECK(cv::norm(back.reshape(1, 1), m.reshape(1, 1), cv::NORM_INF) == 0.0);
+}
+
+TEST_CASE("destinations of the wrong size or type are rejected")
+{
+    const cv::Mat m = make_floats({2, 3, 4});
+
+    SUBCASE("to half")
+    {
+        cv::Mat too_small(1, 23, CV_16F), too_large(1, 25, CV_16F), wrong_type(1, 24, CV_16U);
+        cv::Mat floats(1, 24, CV_32F);
+        auto*   small_bits = too_small.ptr<uint16_t>();
+        std::fill(small_bits, small_bits + too_small.total(), uint16_t(0));
+        CHECK(convert_f32_to_f16(m, too_small).empty());
+        CHECK(convert_f32_to_f16(m, too_large).empty());
+        CHECK(convert_f32_to_f16(m, wrong_type).empty());
+        CHECK(convert_f32_to_f16(m, floats).empty());
+        // nothing has been written
+        CHECK(std::all_of(small_bits, small_bits + too_small.total(),
+                          [](uint16_t bits) { return bits == 0; }));
+    }
+
+    SUBCASE("to bfloat16")
+    {
+        cv::Mat too_small(1, 23, CV_16U), wrong_type(1, 24, CV_16F);
+        CHECK(convert_f32_to_bf16(m, too_small).empty());
+        CHECK(convert_f32_to_bf16(m, wrong_type).empty());
+    }
+
+    SUBCASE("non-continuous destinations")
+    {
+        cv::Mat wide(24, 2, CV_16F);
+        REQUIRE(!wide.col(0).isContinuous());
+        CHECK(convert_f32_to_f16(m, wide.col(0)).empty());
+    }
+
+    SUBCASE("back to float")
+    {
+        const cv::Mat h = convert_f32_to_f16(m);
+        cv::Mat       too_small(1, 23, CV_32F), wrong_type(1, 24, CV_64F);
+        CHECK(convert_f16_to_f32(h, too_small).empty());
+        CHECK(convert_f16_to_f32(h, wrong_type).empty());
+        CHECK(convert_bf16_to_f32(convert_f32_to_bf16(m), too_small).empty());
+    }
+}
+
+TEST_CASE("sources of the wrong depth are rejected")
+{
+    const cv::Mat m = make_floats({2, 3, 4});
+    cv::Mat       doubles;
+    m.convertTo(doubles, CV_64F);
+
+    CHECK(convert_f32_to_f16(doubles).empty());
+    CHECK(convert_f32_to_bf16(doubles).empty());
+    CHECK(convert_f16_to_f32(m).empty());
+    CHECK(convert_bf16_to_f32(m).empty());
+    // a half matrix is no bfloat16 one, although both are 16 bits wide
+    CHECK(convert_bf16_to_f32(convert_f32_to_f16(m)).empty());
+}
@@ -0,0 +1,140 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/cpu_backend.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <string>
+
+// The outputs of the CPU backend on the bundled MNIST models are compared with those of ONNX
+// Runtime (CPUExecutionProvider) for the same inputs: channel 0 of the image, mapped to
+// x = 1 - pixel / 255.
+
+using namespace eztrt;
+using namespace eztrt::testing;
+
+namespace
+{
+
+struct reference
+{
+    const char* image;
+    int         label; //!< argmax of the reference output, not necessarily the digit shown
+    float       output[10];
+};
+
+// mnist2.onnx (opset 7) and mnist3.onnx (opset 8) share their weights and give the same output
+const reference kReferences[] = {
+    {"test_0", 3, {3.662843f, -7.470849f, 4.858788f, 6.357227f, -6.303929f, -2.740282f, -1.027770f,
+                   -6.106155f, -1.494651f, 2.976578f}},
+    {"test_1", 7, {-2.230397f, 5.959599f, 2.951955f, 0.310683f, -0.749231f, 0.280644f, -14.253713f,
+                   11.975753f, -6.861973f, 0.339305f}},
+    {"test_1_1", 7, {-9.287421f, 11.661069f, 5.522518f, 4.166924f, -4.892531f, -2.142953f,
+                     -27.812256f, 22.757246f, -9.723590f, 6.255125f}},
+    {"test_2", 2, {-0.385979f, 7.139085f, 14.248845f, 4.079830f, -11.170488f, -8.080794f,
+                   -9.797342f, -4.091560f, -0.445623f, -2.066760f}},
+    {"test_3", 3, {-10.711098f, -2.723348f, 4.261557f, 16.640026f, -5.479494f, 4.098021f,
+                   -13.441225f, -1.153682f, 3.926540f, -0.810561f}},
+    {"test_5", 5, {-9.704778f, -8.814729f, -3.750825f, 8.684125f, -3.064505f, 16.433781f,
+                   3.799974f, -6.718594f, 4.647694f, 0.777128f}},
+    {"test_6", 6, {-1.368994f, -8.065343f, -4.066972f, -0.866597f, -7.011694f, 7.668831f,
+                   12.209842f, -13.373534f, 8.617155f, -2.454576f}},
+    {"test_8", 8, {0.775997f, -5.869201f, 9.550813f, 8.468250f, -6.369285f, -5.411806f,
+                   -1.338978f, -12.053452f, 13.845434f, -2.205468f}},
+    {"test_9", 5, {1.037148f, -3.026405f, 4.893200f, 3.986351f, 1.426088f, 6.573136f, -6.568423f,
+                   -4.248807f, 2.214638f, 1.633997f}},
+};
+
+/// Maximum absolute deviation from the reference, summation order differs between the backends
+constexpr double kTolerance = 1e-3;
+
+/**
+ * The $[1,1,28,28]$ input for `image`, the images are gray values stored in all three channels.
+ * `scale` is the value of a white pixel: 1 for the models that take $[0,1]$ inputs, 255 for
+ * mnist1.onnx, which divides by 255 itself.
+ */
+cv::Mat load_input(const std::string& image, double scale = 1.0)
+{
+    const cv::Mat bgr = cv::imread(kDataDir + "/" + image + ".png", cv::IMREAD_COLOR);
+    REQUIRE(!bgr.empty());
+    cv::Mat gray, input;
+    cv::extractChannel(bgr, gray, 0);
+    gray.convertTo(input, CV_32F, -scale / 255.0, scale);
+    const int shape[] = {1, 1, 28, 28};
+    return input.reshape(1, 4, shape);
+}
+
+int argmax(const cv::Mat& output)
+{
+    cv::Point max_loc;
+    cv::minMaxLoc(output.reshape(1, 1), nullptr, nullptr, nullptr, &max_loc);
+    return max_loc.x;
+}
+
+void check_references(cpu_backend& backend, double scale = 1.0)
+{
+    for (const auto& ref : kReferences)
+    {
+        CAPTURE(ref.image);
+        const cv::Mat output = backend.predict(load_input(ref.image, scale));
+        REQUIRE(output.total() == 10);
+        REQUIRE(output.type() == CV_32F);
+
+        const cv::Mat expected(1, 10, CV_32F, const_cast<float*>(ref.output));
+        CHECK(cv::norm(output.reshape(1, 1), expected, cv::NORM_INF) <= kTolerance);
+        CHECK(argmax(output) == ref.label);
+    }
+}
+
+} // namespace
+
+TEST_CASE("the CPU backend matches ONNX Runtime on MNIST (opset 7)")
+{
+    cpu_backend backend;
+    REQUIRE(backend.load(kDataDir + "/mnist2.onnx"));
+    REQUIRE(backend.ready());
+    check_references(backend);
+}
+
+TEST_CASE("the CPU backend matches ONNX Runtime on MNIST (opset 8)")
+{
+    cpu_backend backend;
+    REQUIRE(backend.load(kDataDir + "/mnist3.onnx"));
+    check_references(backend);
+}
+
+TEST_CASE("the CPU backend scales unscaled pixels on MNIST with an internal Div")
+{
+    // mnist1.onnx divides its input by a Constant node of 255 before the same layers as the
+    // others, so pixels of 0..255 give the reference outputs
+    cpu_backend backend;
+    REQUIRE(backend.load(kDataDir + "/mnist1.onnx"));
+    REQUIRE(backend.ready());
+    check_references(backend, 255.0);
+}
+
+TEST_CASE("run() on the input buffer gives the output of predict()")
+{
+    cpu_backend backend;
+    REQUIRE(backend.load(kDataDir + "/mnist2.onnx"));
+
+    const cv::Mat input = load_input("test_2");
+    cv::Mat       buffer = backend.acquire_input(0);
+    REQUIRE(buffer.total() == input.total());
+    input.copyTo(buffer);
+    REQUIRE(backend.acquire_input(0).data == buffer.data);
+
+    const cv::Mat expected = backend.predict(input);
+    const cv::Mat output   = backend.run();
+    REQUIRE(!output.empty());
+    CHECK(cv::norm(output.reshape(1, 1), expected.reshape(1, 1), cv::NORM_INF) == 0.0);
+}
+
+TEST_CASE("loading an invalid model fails")
+{
+    cpu_backend backend;
+    CHECK(!backend.load(kDataDir + "/does_not_exist.onnx"));
+    CHECK(!backend.ready());
+}
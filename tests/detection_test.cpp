@@ -0,0 +1,410 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/detection.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace eztrt;
+
+namespace
+{
+
+/// A float tensor referring to `values`, which have to outlive it
+cv::Mat tensor(const std::vector<int>& shape, std::vector<float>& values)
+{
+    return cv::Mat(int(shape.size()), shape.data(), CV_32F, values.data());
+}
+
+bool same(const detection& a, const detection& b)
+{
+    return a.box.x == b.box.x && a.box.y == b.box.y && a.box.width == b.box.width &&
+           a.box.height == b.box.height && a.score == b.score && a.class_id == b.class_id;
+}
+
+bool same(const std::vector<detection>& a, const std::vector<detection>& b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+                                               [](const detection& x, const detection& y) {
+                                                   return same(x, y);
+                                               });
+}
+
+/// Detections ordered by class and position, for decoders that do not specify an order
+std::vector<detection> by_class(std::vector<detection> d)
+{
+    std::sort(d.begin(), d.end(), [](const detection& a, const detection& b) {
+        return a.class_id != b.class_id ? a.class_id < b.class_id : a.box.x < b.box.x;
+    });
+    return d;
+}
+
+float iou(const cv::Rect2f& a, const cv::Rect2f& b)
+{
+    const float iw = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+    const float ih = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+    if (iw <= 0.f || ih <= 0.f) return 0.f;
+    const float inter = iw * ih;
+    return inter / (a.area() + b.area() - inter);
+}
+
+/// The textbook greedy NMS: compares every candidate with every kept box
+std::vector<detection> reference_nms(const std::vector<detection>& candidates,
+                                     const nms_params&             params)
+{
+    std::vector<int> order;
+    for (int i = 0; i < int(candidates.size()); ++i)
+    {
+        const cv::Rect2f& b = candidates[i].box;
+        if (std::isfinite(b.x) && std::isfinite(b.y) && std::isfinite(b.width) &&
+            std::isfinite(b.height) && b.width >= 0.f && b.height >= 0.f &&
+            !std::isnan(candidates[i].score))
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return candidates[a].score > candidates[b].score; });
+
+    std::vector<detection> kept;
+    for (int i : order)
+    {
+        const detection& c          = candidates[i];
+        bool             suppressed = false;
+        for (const detection& k : kept)
+            if ((params.class_agnostic || k.class_id == c.class_id) &&
+                iou(k.box, c.box) > params.iou_threshold)
+                suppressed = true;
+        if (!suppressed) kept.push_back(c);
+    }
+    if (params.max_detections > 0 && kept.size() > size_t(params.max_detections))
+        kept.resize(params.max_detections);
+    return kept;
+}
+
+/// Random boxes in [0, span]^2, optionally with few distinct scores to provoke ties
+std::vector<detection> random_candidates(std::mt19937& rng, int n, int classes, float span,
+                                         float max_side, bool tied_scores)
+{
+    std::uniform_real_distribution<float> pos(0.f, span), side(0.f, max_side), score(0.f, 1.f);
+    std::vector<detection>                candidates(n);
+    for (auto& c : candidates)
+    {
+        c.box      = {pos(rng), pos(rng), side(rng), side(rng)};
+        c.score    = tied_scores ? float(rng() % 4) / 4.f : score(rng);
+        c.class_id = int(rng() % classes);
+    }
+    return candidates;
+}
+
+const float kNaN = std::numeric_limits<float>::quiet_NaN();
+const float kInf = std::numeric_limits<float>::infinity();
+
+} // namespace
+
+TEST_CASE("nms matches a brute-force reference")
+{
+    std::mt19937 rng(2024);
+    for (int round = 0; round < 300; ++round)
+    {
+        // every 30th round is large enough to suppress the classes in parallel
+        const int   n          = round % 30 == 0 ? 5000 : int(rng() % 300);
+        const int   classes    = rng() % 2 ? 1 : 5;
+        const float span       = rng() % 2 ? 1.f : 1000.f;
+        const float max_side   = span * (rng() % 3 ? 0.1f : 0.6f);
+        const bool  tied       = rng() % 3 == 0;
+        auto        candidates = random_candidates(rng, n, classes, span, max_side, tied);
+
+        // a few broken boxes
+        for (int i = 0; i < n / 50; ++i)
+        {
+            const float broken[] = {kNaN, kInf, -kInf, -1.f};
+            auto&       b        = candidates[rng() % n].box;
+            (rng() % 2 ? b.x : b.width) = broken[rng() % 4];
+        }
+
+        nms_params params;
+        params.iou_threshold  = std::uniform_real_distribution<float>(0.f, 0.9f)(rng);
+        params.class_agnostic = rng() % 2;
+        params.max_detections = rng() % 3 ? int(rng() % 50 + 1) : 0;
+
+        CAPTURE(round);
+        CAPTURE(n);
+        CAPTURE(params.iou_threshold);
+        CAPTURE(params.class_agnostic);
+        CAPTURE(params.max_detections);
+        CHECK(same(nms(candidates, params), reference_nms(candidates, params)));
+    }
+}
+
+TEST_CASE("nms keeps the first of equally scored candidates")
+{
+    const std::vector<detection> candidates = {
+        {{10.f, 10.f, 10.f, 10.f}, 0.5f, 0},
+        {{11.f, 10.f, 10.f, 10.f}, 0.9f, 0},
+        {{12.f, 10.f, 10.f, 10.f}, 0.9f, 0},
+        {{50.f, 50.f, 10.f, 10.f}, 0.9f, 0},
+    };
+    const auto kept = nms(candidates, {});
+    REQUIRE(kept.size() == 2);
+    CHECK(same(kept[0], candidates[1]));
+    CHECK(same(kept[1], candidates[3]));
+}
+
+TEST_CASE("nms suppresses within classes unless it is class-agnostic")
+{
+    const std::vector<detection> candidates = {
+        {{0.f, 0.f, 10.f, 10.f}, 0.8f, 1},
+        {{1.f, 0.f, 10.f, 10.f}, 0.9f, 2},
+        {{2.f, 0.f, 10.f, 10.f}, 0.7f, 1},
+    };
+
+    nms_params params;
+    auto       kept = nms(candidates, params);
+    REQUIRE(kept.size() == 2);
+    CHECK(same(kept[0], candidates[1]));
+    CHECK(same(kept[1], candidates[0]));
+
+    params.class_agnostic = true;
+    kept                  = nms(candidates, params);
+    REQUIRE(kept.size() == 1);
+    CHECK(same(kept[0], candidates[1]));
+}
+
+TEST_CASE("nms returns at most max_detections of the best candidates")
+{
+    std::vector<detection> candidates;
+    for (int i = 0; i < 10; ++i)
+        candidates.push_back({{20.f * i, 0.f, 10.f, 10.f}, 0.05f * ((i * 7) % 10), i % 3});
+
+    nms_params params;
+    params.max_detections = 4;
+    const auto kept       = nms(candidates, params);
+    REQUIRE(kept.size() == 4);
+    for (size_t i = 0; i < kept.size(); ++i)
+        CHECK(kept[i].score == doctest::Approx(0.05 * (9 - i)));
+
+    params.max_detections = 0;
+    CHECK(nms(candidates, params).size() == 10);
+    CHECK(nms({}, params).empty());
+}
+
+TEST_CASE("nms drops boxes with non-finite coordinates")
+{
+    const std::vector<detection> candidates = {
+        {{kNaN, 0.f, 10.f, 10.f}, 0.9f, 0},
+        {{0.f, 0.f, kInf, 10.f}, 0.9f, 0},
+        {{0.f, -kInf, 10.f, 10.f}, 0.9f, 0},
+        {{0.f, 0.f, -1.f, 10.f}, 0.9f, 0},
+        {{0.f, 0.f, 10.f, 10.f}, kNaN, 0},
+        {{0.f, 0.f, 10.f, 10.f}, 0.5f, 0},
+        // finite, but the extent of all boxes overflows
+        {{-3e38f, 3e38f, 1e38f, 1e38f}, 0.4f, 0},
+        {{3e38f, -3e38f, 1e38f, 1e38f}, 0.3f, 0},
+    };
+    const auto kept = nms(candidates, {});
+    REQUIRE(kept.size() == 3);
+    CHECK(same(kept[0], candidates[5]));
+    CHECK(same(kept[1], candidates[6]));
+    CHECK(same(kept[2], candidates[7]));
+}
+
+TEST_CASE("decode_yolo decodes both layouts")
+{
+    // (cx, cy, w, h, objectness, 3 class scores) per box
+    const std::vector<std::vector<float>> boxes = {
+        {50.f, 40.f, 20.f, 10.f, 0.9f, 0.1f, 0.8f, 0.5f},
+        {30.f, 30.f, 8.f, 8.f, 0.2f, 0.9f, 0.9f, 0.9f},
+        {10.f, 10.f, 4.f, 6.f, 1.f, 0.3f, 0.3f, 0.1f},
+    };
+    const int n = int(boxes.size()), attributes = int(boxes[0].size());
+
+    for (const bool objectness : {true, false})
+        for (const bool best_class_only : {true, false})
+            for (const auto layout : {yolo_layout::boxes_first, yolo_layout::attributes_first})
+            {
+                CAPTURE(objectness);
+                CAPTURE(best_class_only);
+                CAPTURE(layout == yolo_layout::boxes_first);
+
+                // without objectness the box is directly followed by the class scores
+                const int          skip = objectness ? 0 : 1;
+                const int          k    = attributes - skip;
+                std::vector<float> values;
+                for (int i = 0; i < n * k; ++i)
+                {
+                    const int box  = layout == yolo_layout::boxes_first ? i / k : i % n;
+                    const int attr = layout == yolo_layout::boxes_first ? i % k : i / n;
+                    values.push_back(boxes[box][attr < 4 ? attr : attr + skip]);
+                }
+                const cv::Mat output = layout == yolo_layout::boxes_first
+                                           ? tensor({1, n, k}, values)
+                                           : tensor({k, n}, values);
+
+                yolo_params params;
+                params.layout          = layout;
+                params.objectness      = objectness;
+                params.best_class_only = best_class_only;
+
+                std::vector<detection> expected;
+                const cv::Rect2f       box0(40.f, 35.f, 20.f, 10.f), box1(26.f, 26.f, 8.f, 8.f);
+                const cv::Rect2f       box2(8.f, 7.f, 4.f, 6.f);
+                if (objectness)
+                {
+                    expected.push_back({box0, 0.9f * 0.8f, 1});
+                    if (!best_class_only) expected.push_back({box0, 0.9f * 0.5f, 2});
+                    // a tie between classes resolves to the lower class
+                    expected.push_back({box2, 0.3f, 0});
+                    if (!best_class_only) expected.push_back({box2, 0.3f, 1});
+                }
+                else
+                {
+                    // the class scores are not scaled, the second box is no longer suppressed
+                    expected.push_back({box0, 0.8f, 1});
+                    if (!best_class_only) expected.push_back({box0, 0.5f, 2});
+                    expected.push_back({box1, 0.9f, 0});
+                    if (!best_class_only) expected.push_back({box1, 0.9f, 1});
+                    if (!best_class_only) expected.push_back({box1, 0.9f, 2});
+                    expected.push_back({box2, 0.3f, 0});
+                    if (!best_class_only) expected.push_back({box2, 0.3f, 1});
+                }
+                CHECK(same(by_class(decode_yolo(output, params)), by_class(expected)));
+            }
+}
+
+TEST_CASE("decode_yolo rejects unsupported outputs")
+{
+    std::vector<float> values(2 * 3 * 6, 0.5f);
+    CHECK(decode_yolo(tensor({2, 3, 6}, values), {}).empty());
+    // 4 box attributes and objectness leave no class scores
+    CHECK(decode_yolo(tensor({3, 5}, values), {}).empty());
+    yolo_params attributes_first;
+    attributes_first.layout = yolo_layout::attributes_first;
+    CHECK(decode_yolo(tensor({5, 3}, values), attributes_first).empty());
+    CHECK(decode_yolo(cv::Mat{}, {}).empty());
+}
+
+TEST_CASE("decode_ssd applies the priors")
+{
+    const std::vector<anchor_box> anchors = {{0.5f, 0.5f, 0.2f, 0.4f}, {0.2f, 0.3f, 0.1f, 0.1f}};
+    std::vector<float>            locations = {
+        1.f, -0.5f, 0.f, std::log(2.f) / 0.2f, //
+        0.f, 0.f,   0.f, 0.f,                  //
+    };
+    std::vector<float> scores = {
+        0.9f, 0.6f, 0.55f, //
+        0.1f, 0.2f, 0.3f,  //
+    };
+
+    ssd_params params;
+    auto       decoded = by_class(decode_ssd(tensor({2, 4}, locations), tensor({2, 3}, scores),
+                                             anchors, params));
+    // the first box is at (0.5 + 1 * 0.1 * 0.2, 0.5 - 0.5 * 0.1 * 0.4) with twice the prior height
+    REQUIRE(decoded.size() == 2);
+    for (const auto& d : decoded)
+    {
+        CHECK(d.box.x == doctest::Approx(0.42f));
+        CHECK(d.box.y == doctest::Approx(0.08f));
+        CHECK(d.box.width == doctest::Approx(0.2f));
+        CHECK(d.box.height == doctest::Approx(0.8f));
+    }
+    CHECK(decoded[0].class_id == 1);
+    CHECK(decoded[0].score == 0.6f);
+    CHECK(decoded[1].class_id == 2);
+    CHECK(decoded[1].score == 0.55f);
+
+    // without a background class, class 0 is a candidate as well
+    params.background_class = -1;
+    decoded = by_class(decode_ssd(tensor({1, 2, 4}, locations), tensor({1, 2, 3}, scores), anchors,
+                                  params));
+    REQUIRE(decoded.size() == 3);
+    CHECK(decoded[0].class_id == 0);
+    CHECK(decoded[0].score == 0.9f);
+
+    params.score_threshold = 0.25f;
+    decoded = by_class(decode_ssd(tensor({2, 4}, locations), tensor({2, 3}, scores), anchors,
+                                  params));
+    REQUIRE(decoded.size() == 4);
+    // the second box has zero offsets and is its prior
+    CHECK(decoded[2].class_id == 2);
+    CHECK(decoded[2].score == 0.3f);
+    CHECK(decoded[2].box.x == doctest::Approx(0.15f));
+    CHECK(decoded[2].box.y == doctest::Approx(0.25f));
+    CHECK(decoded[2].box.width == doctest::Approx(0.1f));
+    CHECK(decoded[2].box.height == doctest::Approx(0.1f));
+}
+
+TEST_CASE("decode_ssd rejects mismatching shapes")
+{
+    const std::vector<anchor_box> anchors(2, {0.5f, 0.5f, 0.1f, 0.1f});
+    std::vector<float>            locations(2 * 2 * 5, 0.f), scores(2 * 2 * 3, 0.9f);
+
+    CHECK(decode_ssd(tensor({2, 5}, locations), tensor({2, 3}, scores), anchors, {}).empty());
+    CHECK(decode_ssd(tensor({2, 4}, locations), tensor({3, 3}, scores), anchors, {}).empty());
+    CHECK(decode_ssd(tensor({2, 4}, locations), tensor({2, 3}, scores), {anchors[0]}, {}).empty());
+    CHECK(decode_ssd(tensor({2, 2, 4}, locations), tensor({2, 2, 3}, scores), anchors, {})
+              .empty());
+}
+
+TEST_CASE("postprocessing decodes and suppresses every image of a batch")
+{
+    std::mt19937                          rng(7);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    const int                             batch = 3, n = 200, classes = 4;
+
+    SUBCASE("SSD")
+    {
+        std::vector<anchor_box> anchors(n);
+        for (auto& a : anchors)
+            a = {u(rng), u(rng), 0.05f + 0.2f * u(rng), 0.05f + 0.2f * u(rng)};
+        std::vector<float> locations(size_t(batch) * n * 4), scores(size_t(batch) * n * classes);
+        for (auto& v : locations)
+            v = u(rng) - 0.5f;
+        for (auto& v : scores)
+            v = u(rng);
+
+        ssd_params params;
+        params.score_threshold = 0.7f;
+        const auto result = postprocess_ssd(tensor({batch, n, 4}, locations),
+                                            tensor({batch, n, classes}, scores), anchors, params,
+                                            {});
+        REQUIRE(result.size() == size_t(batch));
+        for (int b = 0; b < batch; ++b)
+        {
+            CAPTURE(b);
+            std::vector<float> image_locations(locations.begin() + b * n * 4,
+                                               locations.begin() + (b + 1) * n * 4);
+            std::vector<float> image_scores(scores.begin() + b * n * classes,
+                                            scores.begin() + (b + 1) * n * classes);
+            const auto         expected = nms(decode_ssd(tensor({n, 4}, image_locations),
+                                                         tensor({n, classes}, image_scores),
+                                                         anchors, params),
+                                              {});
+            CHECK(!expected.empty());
+            CHECK(same(result[b], expected));
+        }
+    }
+
+    SUBCASE("YOLO")
+    {
+        const int          k = 5 + classes;
+        std::vector<float> output(size_t(batch) * n * k);
+        for (size_t i = 0; i < output.size(); ++i)
+            output[i] = i % k < 4 ? 100.f * u(rng) : u(rng);
+
+        const yolo_params params;
+        const auto        result = postprocess_yolo(tensor({batch, n, k}, output), params, {});
+        REQUIRE(result.size() == size_t(batch));
+        for (int b = 0; b < batch; ++b)
+        {
+            CAPTURE(b);
+            std::vector<float> image(output.begin() + b * n * k, output.begin() + (b + 1) * n * k);
+            const auto         expected = nms(decode_yolo(tensor({n, k}, image), params), {});
+            CHECK(!expected.empty());
+            CHECK(same(result[b], expected));
+        }
+    }
+}
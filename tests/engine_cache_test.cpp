@@ -0,0 +1,274 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/engine_cache.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Everything except `device_signature()` works without a GPU, the tests pass the device explicitly.
+
+using namespace eztrt;
+using namespace eztrt::testing;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+uint64_t hash_string(const char* s, uint64_t seed = 0) { return hash64(s, std::strlen(s), seed); }
+
+std::function<bool(std::ostream&)> writer(const std::string& content)
+{
+    return [content](std::ostream& out) { return bool(out << content); };
+}
+
+/// All file names in `dir`
+std::vector<std::string> list(const std::string& dir)
+{
+    std::vector<std::string> names;
+    for (const auto& item : fs::directory_iterator(dir))
+        names.push_back(item.path().filename().string());
+    return names;
+}
+
+/// Makes `path` look as if it was last used `age` ago
+void set_age(const std::string& path, std::chrono::seconds age)
+{
+    fs::last_write_time(path, fs::file_time_type::clock::now() - age);
+}
+
+const std::string kDevice = "Test GPU sm_86";
+
+std::string key_of(const std::string& onnx, const model::params& params = {},
+                   const std::string& device = kDevice)
+{
+    return engine_cache::make_key(onnx.data(), onnx.size(), params, device);
+}
+
+} // namespace
+
+TEST_CASE("hash64 is XXH64")
+{
+    CHECK(hash_string("") == 0xEF46DB3751D8E999ULL);
+    CHECK(hash_string("", 2654435761U) == 0xAC75FDA2929B17EFULL);
+    CHECK(hash_string("a") == 0xD24EC4F1A98C6E5BULL);
+    CHECK(hash_string("abc") == 0x44BC2CF5AD770999ULL);
+    CHECK(hash_string("message digest") == 0x066ED728FCEEB3BEULL);
+    CHECK(hash_string("abcdefghijklmnopqrstuvwxyz") == 0xCFE1F278FA89835CULL);
+    // longer than one 32 byte stripe
+    CHECK(hash_string("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ULL);
+    CHECK(hash_string("xxhash") == 0x32DD38952C4BC720ULL);
+    CHECK(hash_string("xxhash", 20141025) == 0xB559B98D844E0635ULL);
+}
+
+TEST_CASE("the params fingerprint only covers what changes the engine")
+{
+    const model::params defaults;
+    const uint64_t      reference = params_fingerprint(defaults);
+    CHECK(params_fingerprint(defaults) == reference);
+
+    const std::function<void(model::params&)> relevant[] = {
+        [](model::params& p) { p.batchSize = 8; },
+        [](model::params& p) { p.dlaCore = 0; },
+        [](model::params& p) { p.int8 = true; },
+        [](model::params& p) { p.fp16 = true; },
+        [](model::params& p) { p.workspace_size = 1 << 30; },
+        [](model::params& p) { p.inputTensorNames = {"input"}; },
+        [](model::params& p) { p.outputTensorNames = {"output"}; },
+    };
+    for (size_t i = 0; i < std::size(relevant); ++i)
+    {
+        CAPTURE(i);
+        model::params p = defaults;
+        relevant[i](p);
+        CHECK(params_fingerprint(p) != reference);
+    }
+
+    const std::function<void(model::params&)> runtime_only[] = {
+        [](model::params& p) { p.dataDirs = {"data"}; },
+        [](model::params& p) { p.execution_contexts = 4; },
+        [](model::params& p) { p.engine_cache_dir = "cache"; },
+        [](model::params& p) { p.engine_cache_max_bytes = 1 << 20; },
+        [](model::params& p) { p.buffer_growth.factor = 2.0; },
+    };
+    for (size_t i = 0; i < std::size(runtime_only); ++i)
+    {
+        CAPTURE(i);
+        model::params p = defaults;
+        runtime_only[i](p);
+        CHECK(params_fingerprint(p) == reference);
+    }
+
+    // names are length-prefixed, moving a character between them changes the fingerprint
+    model::params a = defaults, b = defaults;
+    a.inputTensorNames = {"ab", "c"};
+    b.inputTensorNames = {"a", "bc"};
+    CHECK(params_fingerprint(a) != params_fingerprint(b));
+    // as does moving a name between inputs and outputs
+    a.inputTensorNames  = {"x"};
+    b.outputTensorNames = {"x"};
+    b.inputTensorNames  = {};
+    CHECK(params_fingerprint(a) != params_fingerprint(b));
+}
+
+TEST_CASE("cache keys depend on the model, the parameters and the device")
+{
+    const std::string onnx = "onnx model bytes";
+    const std::string key  = key_of(onnx);
+
+    CHECK(key.size() == 16);
+    CHECK(key.find_first_not_of("0123456789abcdef") == std::string::npos);
+    CHECK(key_of(onnx) == key);
+
+    CHECK(key_of("onnx model byteS") != key);
+    model::params fp16;
+    fp16.fp16 = true;
+    CHECK(key_of(onnx, fp16) != key);
+    CHECK(key_of(onnx, {}, "Other GPU sm_86") != key);
+
+    model::params runtime;
+    runtime.execution_contexts = 3;
+    CHECK(key_of(onnx, runtime) == key);
+}
+
+TEST_CASE("stored engines can be looked up")
+{
+    temp_dir     dir("store");
+    engine_cache cache(dir.path);
+    REQUIRE(fs::is_directory(dir.path));
+
+    const std::string key = key_of("model");
+    CHECK(cache.lookup(key).empty());
+
+    REQUIRE(cache.store(key, writer("serialized engine")));
+    const std::string path = cache.lookup(key);
+    CHECK(path == cache.path_for(key));
+    CHECK(read_file(path) == "serialized engine");
+    // the temporary file was renamed into place
+    CHECK(list(dir.path) == std::vector<std::string>{key + ".engine"});
+
+    // storing again replaces the entry
+    REQUIRE(cache.store(key, writer("rebuilt engine")));
+    CHECK(read_file(cache.lookup(key)) == "rebuilt engine");
+    CHECK(list(dir.path).size() == 1);
+}
+
+TEST_CASE("a failing writer leaves no entry behind")
+{
+    temp_dir     dir("failing");
+    engine_cache cache(dir.path);
+
+    const std::string key = key_of("model");
+    CHECK(!cache.store(key, [](std::ostream& out) {
+        out << "half an engine";
+        return false;
+    }));
+    CHECK(cache.lookup(key).empty());
+    CHECK(list(dir.path).empty());
+
+    // a failed rebuild keeps the previous engine
+    REQUIRE(cache.store(key, writer("good engine")));
+    CHECK(!cache.store(key, [](std::ostream&) { return false; }));
+    CHECK(read_file(cache.lookup(key)) == "good engine");
+    CHECK(list(dir.path).size() == 1);
+}
+
+TEST_CASE("concurrent stores of the same key leave one complete engine")
+{
+    temp_dir     dir("concurrent");
+    engine_cache cache(dir.path);
+
+    const std::string key = key_of("model");
+    const std::string a(1 << 20, 'a'), b(1 << 20, 'b');
+
+    std::thread other([&] { CHECK(cache.store(key, writer(a))); });
+    CHECK(cache.store(key, writer(b)));
+    other.join();
+
+    const std::string content = read_file(cache.lookup(key));
+    CHECK((content == a || content == b));
+    CHECK(list(dir.path).size() == 1);
+}
+
+TEST_CASE("lookup marks an entry as recently used")
+{
+    temp_dir     dir("lookup");
+    engine_cache cache(dir.path);
+
+    const std::string key = key_of("model");
+    REQUIRE(cache.store(key, writer("engine")));
+    const std::string path = cache.path_for(key);
+
+    set_age(path, std::chrono::hours(24));
+    const auto old = fs::last_write_time(path);
+    REQUIRE(!cache.lookup(key).empty());
+    CHECK(fs::last_write_time(path) > old + std::chrono::hours(23));
+}
+
+TEST_CASE("eviction removes the least recently used engines")
+{
+    temp_dir     dir("evict");
+    engine_cache cache(dir.path, 250);
+
+    const std::string a = key_of("a"), b = key_of("b"), c = key_of("c"), d = key_of("d");
+    const std::string hundred(100, 'x');
+
+    REQUIRE(cache.store(a, writer(hundred)));
+    set_age(cache.path_for(a), std::chrono::hours(3));
+    REQUIRE(cache.store(b, writer(hundred)));
+    set_age(cache.path_for(b), std::chrono::hours(2));
+    // a is older than b, but used more recently
+    REQUIRE(!cache.lookup(a).empty());
+
+    // other files in the directory are neither counted nor removed
+    std::ofstream(fs::path(dir.path) / "notes.txt") << std::string(1000, 'n');
+
+    SUBCASE("down to the size limit")
+    {
+        REQUIRE(cache.store(c, writer(hundred)));
+        CHECK(!cache.lookup(a).empty());
+        CHECK(cache.lookup(b).empty());
+        CHECK(!cache.lookup(c).empty());
+        CHECK(fs::exists(fs::path(dir.path) / "notes.txt"));
+    }
+
+    SUBCASE("except for the new entry, even if it alone exceeds the limit")
+    {
+        REQUIRE(cache.store(d, writer(std::string(300, 'x'))));
+        CHECK(cache.lookup(a).empty());
+        CHECK(cache.lookup(b).empty());
+        CHECK(read_file(cache.lookup(d)).size() == 300);
+    }
+
+    SUBCASE("except for an explicitly kept entry")
+    {
+        engine_cache smaller(dir.path, 100);
+        smaller.evict(b);
+        CHECK(smaller.lookup(a).empty());
+        CHECK(!smaller.lookup(b).empty());
+    }
+}
+
+TEST_CASE("an unlimited cache never evicts")
+{
+    temp_dir     dir("unlimited");
+    engine_cache cache(dir.path);
+
+    std::vector<std::string> keys;
+    for (char c = 'a'; c <= 'e'; ++c)
+    {
+        keys.push_back(key_of(std::string(1, c)));
+        REQUIRE(cache.store(keys.back(), writer(std::string(1000, c))));
+    }
+    cache.evict();
+    for (const auto& key : keys)
+        CHECK(!cache.lookup(key).empty());
+}
@@ -0,0 +1,101 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/crc32c.h>
+#include <eztrt/engine_container.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace eztrt;
+
+namespace
+{
+
+std::string make_container(const std::string& payload, uint64_t fingerprint)
+{
+    std::ostringstream out;
+    REQUIRE(write_engine_container(out, payload.data(), payload.size(), fingerprint));
+    return out.str();
+}
+
+uint64_t read_le(const std::string& s, size_t offset, size_t bytes)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        v |= uint64_t(uint8_t(s[offset + i])) << (8 * i);
+    return v;
+}
+
+engine_payload open(const std::string& s, uint64_t fingerprint)
+{
+    return open_engine_container(s.data(), s.size(), fingerprint);
+}
+
+} // namespace
+
+TEST_CASE("the header is written in little endian byte order")
+{
+    const std::string payload     = "serialized engine";
+    const uint64_t    fingerprint = 0x0123456789ABCDEFull;
+    const std::string file        = make_container(payload, fingerprint);
+
+    REQUIRE(file.size() == engine_header::kSize + payload.size());
+    CHECK(file.compare(0, 8, "EZTRTENG") == 0);
+    CHECK(read_le(file, 8, 4) == engine_header::kVersion);
+    CHECK(read_le(file, 12, 4) == engine_header::kSize);
+    CHECK(read_le(file, 16, 8) == fingerprint);
+    CHECK(read_le(file, 24, 8) == payload.size());
+    CHECK(read_le(file, 32, 4) == crc32c(payload.data(), payload.size()));
+    CHECK(read_le(file, 36, 4) == crc32c(file.data(), 36));
+    CHECK(file.compare(engine_header::kSize, std::string::npos, payload) == 0);
+}
+
+TEST_CASE("a container round-trips")
+{
+    const std::string file = make_container("engine", 42);
+
+    const auto result = open(file, 42);
+    REQUIRE_MESSAGE(result.valid(), result.error);
+    CHECK(std::string(reinterpret_cast<const char*>(result.data), result.size) == "engine");
+    CHECK(!result.legacy);
+    CHECK(!result.params_mismatch);
+    CHECK(open(file, 43).params_mismatch);
+}
+
+TEST_CASE("damaged containers are rejected")
+{
+    const std::string file = make_container("engine", 42);
+
+    SUBCASE("truncated header")
+    {
+        CHECK(!open(file.substr(0, engine_header::kSize - 1), 42).valid());
+    }
+    SUBCASE("truncated payload") { CHECK(!open(file.substr(0, file.size() - 1), 42).valid()); }
+    SUBCASE("trailing bytes") { CHECK(!open(file + "x", 42).valid()); }
+    SUBCASE("corrupted header")
+    {
+        auto damaged = file;
+        damaged[20] ^= 1;
+        const auto result = open(damaged, 42);
+        CHECK(!result.valid());
+        CHECK(!result.error.empty());
+    }
+    SUBCASE("corrupted payload")
+    {
+        auto damaged = file;
+        damaged.back() ^= 1;
+        CHECK(!open(damaged, 42).valid());
+    }
+}
+
+TEST_CASE("data without the magic number is a legacy engine")
+{
+    const std::string raw    = "raw engine";
+    const auto        result = open(raw, 42);
+    REQUIRE(result.valid());
+    CHECK(result.legacy);
+    CHECK(result.size == raw.size());
+}
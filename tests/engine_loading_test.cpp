@@ -0,0 +1,282 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/engine_cache.h>
+#include <eztrt/engine_container.h>
+#include <eztrt/model.h>
+#include <eztrt/util.h>
+
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// `model::load_engine` maps the engine file and validates its container before TensorRT sees the
+// data. Broken files have to be reported by the container check, not by the deserialization.
+
+using namespace eztrt;
+using namespace eztrt::testing;
+
+namespace
+{
+
+/// Records every message, so that the tests can tell which step rejected a file
+class recording_logger : public logger
+{
+public:
+    recording_logger() : logger("engine_loading_test", ILogger::Severity::kWARNING) {}
+
+    void log(Severity severity, const char* msg) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            messages_.emplace_back(severity, msg);
+        }
+        logger::log(severity, msg);
+    }
+
+    /// True if a message of `severity` containing `part` was logged
+    bool logged(Severity severity, const std::string& part) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [s, msg] : messages_)
+            if (s == severity && msg.find(part) != std::string::npos) return true;
+        return false;
+    }
+
+private:
+    mutable std::mutex                            mutex_;
+    std::vector<std::pair<Severity, std::string>> messages_;
+};
+
+/// A model whose deserialization records every payload that reaches it and returns `engine`
+class recording_model : public model
+{
+public:
+    recording_model(const model::params& params, logger& log) : model(params, log) {}
+
+    std::vector<std::string>               deserialized; //!< Payloads passed on to TensorRT
+    std::shared_ptr<nvinfer1::ICudaEngine> engine;       //!< Result of every deserialization
+
+protected:
+    std::shared_ptr<nvinfer1::ICudaEngine> deserialize_engine(const void* data,
+                                                              size_t      size) override
+    {
+        deserialized.emplace_back(static_cast<const char*>(data), size);
+        return engine;
+    }
+};
+
+std::string make_container(const std::string& payload, uint64_t fingerprint)
+{
+    std::ostringstream out;
+    REQUIRE(write_engine_container(out, payload.data(), payload.size(), fingerprint));
+    return out.str();
+}
+
+/// The output of `m` for one of the sample digits
+cv::Mat predict_digit(model& m)
+{
+    const cv::Mat image = cv::imread(kDataDir + "/test_3.png");
+    REQUIRE(!image.empty());
+    return m.predict(try_adjust_input(image, 0, m));
+}
+
+using Severity = nvinfer1::ILogger::Severity;
+
+} // namespace
+
+TEST_CASE("a missing or empty engine file is reported")
+{
+    recording_logger log;
+    recording_model  m(model::params{}, log);
+
+    CHECK(!m.load_engine(temp_path("missing")));
+    CHECK(log.logged(Severity::kERROR, "Could not load serialized engine"));
+
+    temp_file empty("empty");
+    CHECK(!m.load_engine(empty.path));
+    CHECK(log.logged(Severity::kERROR, "file is empty"));
+    CHECK(!m.ready());
+    CHECK(m.deserialized.empty());
+}
+
+TEST_CASE("broken containers are rejected before TensorRT deserializes them")
+{
+    const model::params params;
+    const std::string   engine(4096, '\x5A');
+    const std::string   valid = make_container(engine, params_fingerprint(params));
+
+    std::string payload_flipped = valid;
+    payload_flipped[engine_header::kSize + 100] ^= 0x01;
+    std::string header_flipped = valid;
+    header_flipped[20] ^= 0x01;
+    std::string newer_version = valid;
+    newer_version[8]          = char(engine_header::kVersion + 1);
+
+    const std::pair<std::string, std::string> broken[] = {
+        {valid.substr(0, engine_header::kSize - 1), "not even a full header"},
+        {valid.substr(0, valid.size() - 1), "file is truncated"},
+        {valid + "trailing", "unexpected trailing bytes"},
+        {payload_flipped, "engine checksum mismatch"},
+        {header_flipped, "header checksum mismatch"},
+        // the version is covered by the header checksum as well
+        {newer_version, "header checksum mismatch"},
+    };
+    for (const auto& [content, reason] : broken)
+    {
+        CAPTURE(reason);
+        recording_logger log;
+        recording_model  m(params, log);
+        temp_file        file("broken.engine", content);
+
+        CHECK(!m.load_engine(file.path));
+        CHECK(log.logged(Severity::kERROR, "Invalid engine file"));
+        CHECK(log.logged(Severity::kERROR, reason));
+        CHECK(!log.logged(Severity::kERROR, "Could not deserialize"));
+        CHECK(m.deserialized.empty());
+        CHECK(!m.ready());
+    }
+}
+
+TEST_CASE("only the payload of an engine file reaches the deserialization")
+{
+    const model::params params;
+    const std::string   engine(4096, '\x5A');
+
+    SUBCASE("a container without its header")
+    {
+        recording_logger log;
+        recording_model  m(params, log);
+        temp_file        file("payload.engine", make_container(engine, params_fingerprint(params)));
+
+        CHECK(!m.load_engine(file.path));
+        REQUIRE(m.deserialized.size() == 1);
+        CHECK(m.deserialized[0] == engine);
+        CHECK(log.logged(Severity::kERROR, "Could not deserialize"));
+    }
+
+    SUBCASE("a raw engine unchanged")
+    {
+        recording_logger log;
+        recording_model  m(params, log);
+        temp_file        file("raw.engine", engine);
+
+        CHECK(!m.load_engine(file.path));
+        REQUIRE(m.deserialized.size() == 1);
+        CHECK(m.deserialized[0] == engine);
+        CHECK(log.logged(Severity::kWARNING, "raw engine without integrity header"));
+    }
+}
+
+#if NV_TENSORRT_MAJOR < 8
+TEST_CASE("a fresh model takes its bindings from a loaded engine")
+{
+    const model::params params;
+    recording_logger    log;
+    recording_model     m(params, log);
+    m.engine = std::make_shared<mock_engine>(std::vector<mock_binding>{
+        {"scores", nvinfer1::Dims2(1, 10), nvinfer1::DataType::kFLOAT, false},
+        {"image", nvinfer1::Dims4(1, 3, 8, 8), nvinfer1::DataType::kFLOAT, true},
+    });
+    temp_file file("mock.engine", make_container("mock", params_fingerprint(params)));
+    REQUIRE(m.load_engine(file.path));
+
+    // the model has not parsed any network, so the bindings come from the engine
+    CHECK(m.inputs().empty());
+    REQUIRE(m.input_bindings().size() == 1);
+    CHECK(m.input_bindings()[0].name() == "image");
+    CHECK(m.input_bindings()[0].index() == 1);
+    REQUIRE(m.output_bindings().size() == 1);
+    CHECK(m.output_bindings()[0].name() == "scores");
+
+    const cv::Mat image = cv::imread(kDataDir + "/test_3.png");
+    REQUIRE(!image.empty());
+    const cv::Mat input = try_adjust_input(image, 0, m);
+    REQUIRE(input.dims == 3);
+    CHECK(input.size[0] == 3);
+    CHECK(input.size[2] == 8);
+    CHECK(input.depth() == CV_32F);
+    CHECK(try_adjust_input(image, 1, m).empty());
+
+    const std::string summary = m.summarize();
+    CHECK(summary.find("Input: [image]") != std::string::npos);
+    CHECK(summary.find("Output: [scores]") != std::string::npos);
+}
+#endif
+
+TEST_CASE("a raw engine without container is passed on to TensorRT with a warning")
+{
+    if (!has_cuda_device())
+    {
+        MESSAGE("no CUDA device, skipped");
+        return;
+    }
+
+    // not an engine at all: the container check accepts it, TensorRT rejects it
+    recording_logger log;
+    model            m(model::params{}, log);
+    temp_file        garbage("garbage.engine", std::string(1024, '\x17'));
+    CHECK(!m.load_engine(garbage.path));
+    CHECK(log.logged(Severity::kWARNING, "raw engine without integrity header"));
+    CHECK(!log.logged(Severity::kERROR, "Invalid engine file"));
+    CHECK(log.logged(Severity::kERROR, "Could not deserialize"));
+}
+
+TEST_CASE("serialized engines load through the mapping")
+{
+    if (!has_cuda_device())
+    {
+        MESSAGE("no CUDA device, skipped");
+        return;
+    }
+
+    model::params params;
+    cv::Mat       expected;
+    temp_file     container("mnist2.engine");
+    {
+        recording_logger log;
+        model            built(params, log);
+        REQUIRE(built.load(kDataDir + "/mnist2.onnx"));
+        REQUIRE(built.serialize_engine(container.path));
+        expected = predict_digit(built);
+        REQUIRE(!expected.empty());
+    }
+
+    SUBCASE("with a verified container")
+    {
+        recording_logger log;
+        model            m(params, log);
+        REQUIRE(m.load_engine(container.path));
+        REQUIRE(m.ready());
+        CHECK(!log.logged(Severity::kWARNING, "raw engine"));
+        CHECK(!log.logged(Severity::kWARNING, "different model parameters"));
+        CHECK(equal_outputs(predict_digit(m), expected));
+    }
+
+    SUBCASE("as a legacy raw engine")
+    {
+        temp_file raw("mnist2_raw.engine", read_file(container.path).substr(engine_header::kSize));
+
+        recording_logger log;
+        model            m(params, log);
+        REQUIRE(m.load_engine(raw.path));
+        REQUIRE(m.ready());
+        CHECK(log.logged(Severity::kWARNING, "raw engine without integrity header"));
+        CHECK(equal_outputs(predict_digit(m), expected));
+    }
+
+    SUBCASE("with different parameters")
+    {
+        model::params other = params;
+        other.fp16          = !params.fp16;
+
+        recording_logger log;
+        model            m(other, log);
+        REQUIRE(m.load_engine(container.path));
+        CHECK(log.logged(Severity::kWARNING, "different model parameters"));
+        CHECK(equal_outputs(predict_digit(m), expected));
+    }
+}
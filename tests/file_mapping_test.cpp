@@ -0,0 +1,73 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/file_mapping.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace eztrt;
+using namespace eztrt::testing;
+
+namespace
+{
+
+bool contains(const std::string& s, const char* part) { return s.find(part) != std::string::npos; }
+
+} // namespace
+
+TEST_CASE("a missing file is reported")
+{
+    const auto  path = temp_path("missing");
+    mapped_file file(path);
+    CHECK(!file.valid());
+    CHECK(file.data() == nullptr);
+    CHECK(file.size() == 0);
+    CHECK(file.path() == path);
+    CHECK_MESSAGE(contains(file.error(), "could not open file"), file.error());
+}
+
+TEST_CASE("an empty file is reported")
+{
+    temp_file   empty("empty");
+    mapped_file file(empty.path);
+    CHECK(!file.valid());
+    CHECK(file.size() == 0);
+    CHECK(file.error() == "file is empty");
+}
+
+TEST_CASE("a mapped file reads back its content")
+{
+    std::mt19937         rng(7);
+    std::vector<uint8_t> content((1 << 20) + 13);
+    for (auto& b : content)
+        b = static_cast<uint8_t>(rng());
+    temp_file written("content", std::string(content.begin(), content.end()));
+
+    mapped_file file(written.path);
+    REQUIRE_MESSAGE(file.valid(), file.error());
+    CHECK(file.error().empty());
+    REQUIRE(file.size() == content.size());
+    CHECK(std::memcmp(file.data(), content.data(), content.size()) == 0);
+
+    SUBCASE("moving transfers the mapping")
+    {
+        const uint8_t* data  = file.data();
+        mapped_file    moved = std::move(file);
+        CHECK(moved.data() == data);
+        CHECK(moved.size() == content.size());
+        CHECK(!file.valid());
+        CHECK(std::memcmp(moved.data(), content.data(), content.size()) == 0);
+    }
+
+    SUBCASE("closing unmaps the file")
+    {
+        file.close();
+        CHECK(!file.valid());
+        CHECK(file.size() == 0);
+    }
+}
@@ -0,0 +1,246 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/host_memory_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace eztrt;
+
+namespace
+{
+
+constexpr size_t kHugePageBytes = size_t(2) << 20;
+
+/// Small blocks from the heap only, so that the tests do not depend on the huge page setup
+host_pool_params heap_params(size_t max_cached_bytes = size_t(512) << 20)
+{
+    host_pool_params params;
+    params.large_block_bytes = size_t(1) << 40;
+    params.huge_pages        = false;
+    params.max_cached_bytes  = max_cached_bytes;
+    return params;
+}
+
+bool aligned(const void* ptr)
+{
+    return reinterpret_cast<uintptr_t>(ptr) % host_memory_pool::alignment == 0;
+}
+
+/// Request sizes around every power of two and a few in between
+std::vector<size_t> request_sizes(size_t max)
+{
+    std::vector<size_t> sizes{0, 1, 2, 3};
+    for (size_t pow = 4; pow <= max; pow *= 2)
+        for (size_t s : {pow - 1, pow, pow + 1, pow + pow / 3, pow + pow / 2, pow + 3 * pow / 4})
+            sizes.push_back(s);
+    return sizes;
+}
+
+} // namespace
+
+TEST_CASE("blocks are aligned and have room for the requested bytes")
+{
+    host_memory_pool pool(heap_params());
+    for (const size_t bytes : request_sizes(size_t(1) << 20))
+    {
+        CAPTURE(bytes);
+        void* ptr = pool.allocate(bytes);
+        REQUIRE(ptr);
+        CHECK(aligned(ptr));
+        // the whole size class is usable, the sanitizers complain otherwise
+        std::memset(ptr, 0xA5, pool.size_class(bytes));
+        pool.deallocate(ptr);
+    }
+
+    SUBCASE("also when mapped from the OS")
+    {
+        host_pool_params params  = heap_params();
+        params.large_block_bytes = size_t(1) << 16;
+        params.huge_pages        = true;
+        host_memory_pool large(params);
+
+        void* ptr = large.allocate(100000);
+        REQUIRE(ptr);
+        CHECK(aligned(ptr));
+        std::memset(ptr, 0xA5, large.size_class(100000));
+        CHECK(large.stats().bytes_huge_pages <= large.stats().bytes_live);
+        large.deallocate(ptr);
+        CHECK(large.stats().bytes_huge_pages == 0);
+    }
+}
+
+TEST_CASE("size classes waste at most 25% or less than the alignment")
+{
+    host_memory_pool pool(heap_params());
+    size_t           previous = 0;
+    for (size_t bytes = 1; bytes <= 100000; ++bytes)
+    {
+        const size_t size = pool.size_class(bytes);
+        if (size < bytes || size % host_memory_pool::alignment != 0 || size < previous ||
+            (size - bytes >= host_memory_pool::alignment && 4 * (size - bytes) >= bytes))
+        {
+            CAPTURE(bytes);
+            CAPTURE(size);
+            REQUIRE(false);
+        }
+        previous = size;
+    }
+    CHECK(pool.size_class(0) == host_memory_pool::alignment);
+    CHECK(pool.size_class(host_memory_pool::alignment) == host_memory_pool::alignment);
+
+    // four classes per power of two
+    for (size_t pow = 256; pow <= (size_t(1) << 30); pow *= 2)
+    {
+        CAPTURE(pow);
+        CHECK(pool.size_class(pow + 1) == pow + pow / 4);
+        CHECK(pool.size_class(pow + pow / 4 + 1) == pow + pow / 2);
+        CHECK(pool.size_class(2 * pow - 1) == 2 * pow);
+    }
+
+    // large blocks are rounded up to whole huge pages
+    host_memory_pool large;
+    for (const size_t bytes : request_sizes(size_t(1) << 30))
+    {
+        if (bytes < large.params().large_block_bytes) continue;
+        CAPTURE(bytes);
+        const size_t size = large.size_class(bytes);
+        CHECK(size % kHugePageBytes == 0);
+        CHECK(size >= bytes);
+        CHECK(size < bytes + bytes / 4 + kHugePageBytes);
+    }
+}
+
+TEST_CASE("freed blocks are reused and counted")
+{
+    host_memory_pool pool(heap_params());
+    const size_t     small = pool.size_class(1000), big = pool.size_class(5000);
+
+    void* a = pool.allocate(1000);
+    void* b = pool.allocate(5000);
+    REQUIRE(a);
+    REQUIRE(b);
+    auto stats = pool.stats();
+    CHECK(stats.allocations == 2);
+    CHECK(stats.hits == 0);
+    CHECK(stats.bytes_live == small + big);
+    CHECK(stats.bytes_peak == small + big);
+    CHECK(stats.bytes_cached == 0);
+    CHECK(stats.hit_rate() == 0.);
+
+    pool.deallocate(a);
+    stats = pool.stats();
+    CHECK(stats.bytes_live == big);
+    CHECK(stats.bytes_peak == small + big);
+    CHECK(stats.bytes_cached == small);
+
+    // any request of the same size class gets the cached block
+    void* c = pool.allocate(small - 10);
+    CHECK(c == a);
+    stats = pool.stats();
+    CHECK(stats.allocations == 3);
+    CHECK(stats.hits == 1);
+    CHECK(stats.bytes_cached == 0);
+    CHECK(stats.hit_rate() == doctest::Approx(1. / 3.));
+
+    // another size class does not
+    void* d = pool.allocate(big + 1);
+    CHECK(d != b);
+    CHECK(pool.stats().hits == 1);
+    CHECK(pool.stats().bytes_peak == small + big + pool.size_class(big + 1));
+
+    for (void* ptr : {b, c, d})
+        pool.deallocate(ptr);
+    pool.deallocate(nullptr);
+    stats = pool.stats();
+    CHECK(stats.bytes_live == 0);
+    CHECK(stats.bytes_cached == small + big + pool.size_class(big + 1));
+
+    pool.trim();
+    CHECK(pool.stats().bytes_cached == 0);
+    CHECK(pool.stats().allocations == 4);
+}
+
+TEST_CASE("no more than max_cached_bytes are kept for reuse")
+{
+    const size_t     size = 4096;
+    host_memory_pool pool(heap_params(3 * size));
+    REQUIRE(pool.size_class(size) == size);
+
+    std::vector<void*> blocks;
+    for (int i = 0; i < 5; ++i)
+        blocks.push_back(pool.allocate(size));
+    for (void* ptr : blocks)
+        pool.deallocate(ptr);
+    CHECK(pool.stats().bytes_cached == 3 * size);
+
+    blocks.clear();
+    for (int i = 0; i < 5; ++i)
+        blocks.push_back(pool.allocate(size));
+    CHECK(pool.stats().hits == 3);
+    CHECK(pool.stats().bytes_cached == 0);
+    for (void* ptr : blocks)
+        pool.deallocate(ptr);
+
+    // new parameters release the cache
+    pool.set_params(heap_params(0));
+    CHECK(pool.stats().bytes_cached == 0);
+    void* ptr = pool.allocate(size);
+    pool.deallocate(ptr);
+    CHECK(pool.stats().bytes_cached == 0);
+    CHECK(pool.params().max_cached_bytes == 0);
+}
+
+TEST_CASE("concurrent allocations never hand out a block twice")
+{
+    constexpr int    kThreads = 4, kIterations = 20000, kHeld = 16;
+    host_memory_pool pool(heap_params(size_t(1) << 20));
+
+    std::atomic<int> failures{0};
+    auto             worker = [&](int id) {
+        std::mt19937                                   rng(id);
+        std::vector<std::pair<unsigned char*, size_t>> held(kHeld, {nullptr, 0});
+        for (int i = 0; i < kIterations; ++i)
+        {
+            auto& [ptr, bytes] = held[rng() % kHeld];
+            if (ptr)
+            {
+                // a block handed out twice would have been overwritten by another thread
+                if (std::count(ptr, ptr + bytes, static_cast<unsigned char>(id)) != long(bytes))
+                    ++failures;
+                pool.deallocate(ptr);
+            }
+            bytes = 1 + rng() % 20000;
+            ptr   = static_cast<unsigned char*>(pool.allocate(bytes));
+            if (!ptr || !aligned(ptr))
+            {
+                ++failures;
+                bytes = 0;
+                continue;
+            }
+            std::memset(ptr, id, bytes);
+        }
+        for (const auto& [ptr, bytes] : held)
+            pool.deallocate(ptr);
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+        threads.emplace_back(worker, t + 1);
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(failures == 0);
+    const auto stats = pool.stats();
+    CHECK(stats.allocations == uint64_t(kThreads) * kIterations);
+    CHECK(stats.hits > 0);
+    CHECK(stats.bytes_live == 0);
+    CHECK(stats.bytes_cached <= pool.params().max_cached_bytes);
+    CHECK(stats.bytes_peak <= size_t(kThreads) * kHeld * pool.size_class(20000));
+}
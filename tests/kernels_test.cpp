@@ -0,0 +1,280 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/kernels.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Every SIMD kernel has to produce bit-identical results to the scalar one. The lengths cover the
+// vector bodies and all tail lengths of the widest (64 byte) registers.
+
+using namespace eztrt::kernels;
+
+namespace
+{
+
+const size_t kLengths[] = {0, 1, 3, 7, 15, 16, 17, 31, 33, 63, 64, 65, 127, 1000};
+
+/// All levels available on this machine, except for scalar
+std::vector<const kernel_table*> simd_tables()
+{
+    std::vector<const kernel_table*> tables;
+    for (isa level : {isa::sse41, isa::avx2, isa::avx512})
+    {
+        if (auto table = table_for(level)) tables.push_back(table);
+    }
+    return tables;
+}
+
+const kernel_table& scalar_table() { return *table_for(isa::scalar); }
+
+template<typename T>
+bool bit_equal(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() &&
+           (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+std::vector<uint8_t> random_bytes(size_t n, std::mt19937& rng)
+{
+    std::vector<uint8_t> v(n);
+    for (auto& x : v)
+        x = static_cast<uint8_t>(rng());
+    return v;
+}
+
+/// Floats from random bit patterns, which includes NaNs, infinities and subnormals
+std::vector<float> random_bit_floats(size_t n, std::mt19937& rng)
+{
+    std::vector<float> v(n);
+    for (auto& x : v)
+    {
+        const uint32_t bits = rng();
+        std::memcpy(&x, &bits, sizeof(x));
+    }
+    return v;
+}
+
+std::vector<float> random_floats(size_t n, float lo, float hi, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(lo, hi);
+    std::vector<float>                    v(n);
+    for (auto& x : v)
+        x = dist(rng);
+    return v;
+}
+
+/// Output planes of `n` elements each, with pointers to all of them
+template<typename T>
+struct planes
+{
+    planes(int count, size_t n) : data(count, std::vector<T>(n, T(-1)))
+    {
+        for (auto& plane : data)
+            ptrs.push_back(plane.data());
+    }
+    std::vector<std::vector<T>> data;
+    std::vector<T*>             ptrs;
+};
+
+} // namespace
+
+TEST_CASE("the scalar kernels are always available")
+{
+    REQUIRE(table_for(isa::scalar) != nullptr);
+    CHECK(table_for(detect_isa()) != nullptr);
+}
+
+TEST_CASE("8-bit to planar conversions are bit-exact on every ISA")
+{
+    std::mt19937 rng(1);
+    for (const auto* table : simd_tables())
+        for (size_t n : kLengths)
+        {
+            CAPTURE(to_str(table->level));
+            CAPTURE(n);
+            for (int channels = 1; channels <= 4; ++channels)
+            {
+                CAPTURE(channels);
+                const auto src = random_bytes(n * channels, rng);
+
+                planes<float> expected(channels, n), actual(channels, n);
+                scalar_table().u8_to_f32_planar(src.data(), n, channels, expected.ptrs.data(),
+                                                1.f / 255.f, -0.5f);
+                table->u8_to_f32_planar(src.data(), n, channels, actual.ptrs.data(), 1.f / 255.f,
+                                        -0.5f);
+                for (int c = 0; c < channels; ++c)
+                    CHECK(bit_equal(expected.data[c], actual.data[c]));
+
+                planes<int8_t> expected_s8(channels, n), actual_s8(channels, n);
+                scalar_table().u8_to_s8_planar(src.data(), n, channels, expected_s8.ptrs.data());
+                table->u8_to_s8_planar(src.data(), n, channels, actual_s8.ptrs.data());
+                for (int c = 0; c < channels; ++c)
+                    CHECK(bit_equal(expected_s8.data[c], actual_s8.data[c]));
+
+                planes<float> expected_gray(channels, n), actual_gray(channels, n);
+                scalar_table().u8_gray_to_f32_planar(src.data(), n, expected_gray.ptrs.data(),
+                                                     channels, 2.f, 1.f);
+                table->u8_gray_to_f32_planar(src.data(), n, actual_gray.ptrs.data(), channels,
+                                             2.f, 1.f);
+                for (int c = 0; c < channels; ++c)
+                    CHECK(bit_equal(expected_gray.data[c], actual_gray.data[c]));
+
+                if (channels >= 3)
+                {
+                    std::vector<float> expected_lum(n), actual_lum(n);
+                    scalar_table().u8_bgr_to_gray_f32(src.data(), n, channels, expected_lum.data(),
+                                                      1.f / 255.f, 0.f);
+                    table->u8_bgr_to_gray_f32(src.data(), n, channels, actual_lum.data(),
+                                              1.f / 255.f, 0.f);
+                    CHECK(bit_equal(expected_lum, actual_lum));
+                }
+            }
+        }
+}
+
+TEST_CASE("exp kernels are bit-exact on every ISA")
+{
+    std::mt19937 rng(2);
+    for (const auto* table : simd_tables())
+        for (size_t n : kLengths)
+        {
+            CAPTURE(to_str(table->level));
+            CAPTURE(n);
+            // beyond the clamped range on both sides
+            auto src = random_floats(n, -120.f, 120.f, rng);
+            if (n > 2)
+            {
+                src[0] = std::numeric_limits<float>::infinity();
+                src[1] = -std::numeric_limits<float>::infinity();
+            }
+            const auto shift = random_floats(n, -10.f, 10.f, rng);
+
+            std::vector<float> expected(n), actual(n);
+            scalar_table().exp_f32(src.data(), expected.data(), n, 3.f, 0.5f);
+            table->exp_f32(src.data(), actual.data(), n, 3.f, 0.5f);
+            CHECK(bit_equal(expected, actual));
+
+            scalar_table().exp_shifted_f32(src.data(), shift.data(), expected.data(), n, 1.f);
+            table->exp_shifted_f32(src.data(), shift.data(), actual.data(), n, 1.f);
+            CHECK(bit_equal(expected, actual));
+        }
+}
+
+TEST_CASE("argmax and selection kernels match the scalar kernels on every ISA")
+{
+    std::mt19937 rng(3);
+    for (const auto* table : simd_tables())
+        for (size_t n : kLengths)
+        {
+            CAPTURE(to_str(table->level));
+            CAPTURE(n);
+            std::vector<float>   expected_max(n, -std::numeric_limits<float>::infinity());
+            std::vector<int32_t> expected_arg(n, 0);
+            auto                 actual_max = expected_max;
+            auto                 actual_arg = expected_arg;
+            for (int32_t channel = 0; channel < 5; ++channel)
+            {
+                // small integers produce ties, which have to keep the lower index
+                std::vector<float> src(n);
+                for (auto& v : src)
+                    v = float(rng() % 4);
+                if (n > 4) src[rng() % n] = std::numeric_limits<float>::quiet_NaN();
+                scalar_table().argmax_update_f32(src.data(), n, channel, expected_max.data(),
+                                                 expected_arg.data());
+                table->argmax_update_f32(src.data(), n, channel, actual_max.data(),
+                                         actual_arg.data());
+            }
+            CHECK(bit_equal(expected_max, actual_max));
+            CHECK(bit_equal(expected_arg, actual_arg));
+
+            const auto           scores = random_floats(n, 0.f, 1.f, rng);
+            std::vector<int32_t> expected(n), actual(n);
+            const size_t expected_count = scalar_table().select_above_f32(scores.data(), n, 0.7f,
+                                                                          expected.data());
+            const size_t actual_count = table->select_above_f32(scores.data(), n, 0.7f,
+                                                                actual.data());
+            REQUIRE(expected_count == actual_count);
+            expected.resize(expected_count);
+            actual.resize(actual_count);
+            CHECK(expected == actual);
+        }
+}
+
+TEST_CASE("32-bit transposition matches the scalar kernel on every ISA")
+{
+    std::mt19937 rng(4);
+    const size_t sizes[] = {1, 3, 4, 5, 8, 9, 16, 17, 33};
+    for (const auto* table : simd_tables())
+        for (size_t rows : sizes)
+            for (size_t cols : sizes)
+            {
+                CAPTURE(to_str(table->level));
+                CAPTURE(rows);
+                CAPTURE(cols);
+                // padded strides on both sides
+                std::vector<uint32_t> src(rows * (cols + 3));
+                for (auto& v : src)
+                    v = rng();
+                std::vector<uint32_t> expected(cols * (rows + 5), 0), actual = expected;
+                scalar_table().transpose_32(src.data(), cols + 3, expected.data(), rows + 5, rows,
+                                            cols);
+                table->transpose_32(src.data(), cols + 3, actual.data(), rows + 5, rows, cols);
+                CHECK(bit_equal(expected, actual));
+            }
+}
+
+TEST_CASE("half and bfloat16 conversions are bit-exact on every ISA")
+{
+    // all 16-bit patterns
+    std::vector<uint16_t> all_bits(1 << 16);
+    for (size_t i = 0; i < all_bits.size(); ++i)
+        all_bits[i] = static_cast<uint16_t>(i);
+
+    std::mt19937 rng(5);
+    auto         floats = random_bit_floats(1 << 16, rng);
+    // values close to the rounding boundaries of both formats, including ties
+    for (uint32_t i = 0; i < (1 << 14); ++i)
+    {
+        const uint32_t bits = (rng() & 0xFFFF0000u) | (i & 1 ? 0x8000u : 0x1000u) | (i >> 13);
+        float          v;
+        std::memcpy(&v, &bits, sizeof(v));
+        floats.push_back(v);
+    }
+
+    for (const auto* table : simd_tables())
+    {
+        CAPTURE(to_str(table->level));
+        for (size_t n : kLengths)
+        {
+            CAPTURE(n);
+            std::vector<uint16_t> expected(n), actual(n);
+            scalar_table().f32_to_f16(floats.data(), expected.data(), n);
+            table->f32_to_f16(floats.data(), actual.data(), n);
+            CHECK(bit_equal(expected, actual));
+            scalar_table().f32_to_bf16(floats.data(), expected.data(), n);
+            table->f32_to_bf16(floats.data(), actual.data(), n);
+            CHECK(bit_equal(expected, actual));
+        }
+
+        std::vector<uint16_t> expected_bits(floats.size()), actual_bits(floats.size());
+        scalar_table().f32_to_f16(floats.data(), expected_bits.data(), floats.size());
+        table->f32_to_f16(floats.data(), actual_bits.data(), floats.size());
+        CHECK(bit_equal(expected_bits, actual_bits));
+        scalar_table().f32_to_bf16(floats.data(), expected_bits.data(), floats.size());
+        table->f32_to_bf16(floats.data(), actual_bits.data(), floats.size());
+        CHECK(bit_equal(expected_bits, actual_bits));
+
+        std::vector<float> expected(all_bits.size()), actual(all_bits.size());
+        scalar_table().f16_to_f32(all_bits.data(), expected.data(), all_bits.size());
+        table->f16_to_f32(all_bits.data(), actual.data(), all_bits.size());
+        CHECK(bit_equal(expected, actual));
+        scalar_table().bf16_to_f32(all_bits.data(), expected.data(), all_bits.size());
+        table->bf16_to_f32(all_bits.data(), actual.data(), all_bits.size());
+        CHECK(bit_equal(expected, actual));
+    }
+}
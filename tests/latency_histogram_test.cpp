@@ -0,0 +1,126 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <latency_histogram.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+/// Largest value in microseconds that is not clamped
+const double kClampUs = double(1ull << latency_histogram::kMaxExponent) / 1000.;
+
+const double kPercentiles[] = {0., 1., 10., 50., 90., 99., 99.9, 100.};
+
+/// The exact value of rank ceil(p / 100 * n) ("nearest rank"), as selected by the histogram
+double exact_percentile(std::vector<double> values, double p)
+{
+    std::sort(values.begin(), values.end());
+    const double rank = std::max(1., std::min(p / 100., 1.) * values.size());
+    return values[size_t(std::ceil(rank)) - 1];
+}
+
+/// Buckets are at most 1/64 wide and report their middle, values are truncated to nanoseconds
+bool within_error_bound(double actual, double exact)
+{
+    return std::abs(actual - exact) <= exact / 128. + 0.001;
+}
+
+} // namespace
+
+TEST_CASE("percentiles are within 1/128 of the exact quantiles")
+{
+    std::mt19937_64 rng(1);
+    struct
+    {
+        const char*             name;
+        std::function<double()> sample;
+    } distributions[] = {
+        {"uniform", [&] { return std::uniform_real_distribution<double>(0., 100.)(rng); }},
+        {"lognormal", [&] { return std::lognormal_distribution<double>(6.9, 1.5)(rng); }},
+        {"exponential", [&] { return std::exponential_distribution<double>(1. / 50.)(rng); }},
+        // below 128 ns, where the buckets are exactly one nanosecond wide
+        {"nanoseconds", [&] { return std::uniform_real_distribution<double>(0., 0.2)(rng); }},
+        {"seconds", [&] { return std::uniform_real_distribution<double>(1e6, 1e7)(rng); }},
+        {"constant", [] { return 16.7; }},
+    };
+
+    for (auto& d : distributions)
+    {
+        CAPTURE(d.name);
+        latency_histogram   h;
+        std::vector<double> values(20000);
+        for (double& v : values)
+        {
+            v = d.sample();
+            h.record(v);
+        }
+        for (const double p : kPercentiles)
+        {
+            CAPTURE(p);
+            const double exact = exact_percentile(values, p);
+            CAPTURE(exact);
+            CHECK(within_error_bound(h.percentile(p), exact));
+        }
+        CHECK(h.percentile(100.) == *std::max_element(values.begin(), values.end()));
+    }
+}
+
+TEST_CASE("count, minimum, maximum and mean are exact")
+{
+    latency_histogram h;
+    CHECK(h.count() == 0);
+    CHECK(h.min() == 0.);
+    CHECK(h.max() == 0.);
+    CHECK(h.mean() == 0.);
+    CHECK(h.percentile(50.) == 0.);
+
+    for (double v : {3., 1., 10., 2.})
+        h.record(v);
+    CHECK(h.count() == 4);
+    CHECK(h.min() == 1.);
+    CHECK(h.max() == 10.);
+    CHECK(h.mean() == 4.);
+    // out of range percentiles clamp to the extremes
+    CHECK(h.percentile(-5.) == doctest::Approx(1.).epsilon(1. / 128));
+    CHECK(h.percentile(250.) == 10.);
+}
+
+TEST_CASE("zero latencies are reported as zero")
+{
+    latency_histogram h;
+    for (int i = 0; i < 3; ++i)
+        h.record(0.);
+    h.record(10.);
+    CHECK(h.min() == 0.);
+    CHECK(h.percentile(0.) == 0.);
+    CHECK(h.percentile(75.) == 0.);
+    CHECK(within_error_bound(h.percentile(76.), 10.));
+}
+
+TEST_CASE("values above 2^50 ns are clamped into the last bucket")
+{
+    // just below the clamp the error bound still holds
+    latency_histogram below;
+    below.record(0.999 * kClampUs);
+    below.record(1.);
+    CHECK(within_error_bound(below.percentile(100. - 1e-9), 0.999 * kClampUs));
+
+    latency_histogram above;
+    above.record(1.);
+    for (double v : {10. * kClampUs, 20. * kClampUs, 30. * kClampUs})
+        above.record(v);
+    CHECK(above.count() == 4);
+    CHECK(above.max() == 30. * kClampUs);
+    CHECK(above.percentile(100.) == 30. * kClampUs);
+    CHECK(within_error_bound(above.percentile(25.), 1.));
+    // the clamped values are only known to be in the last bucket, i.e. at least about 2^50 ns
+    const double clamped = above.percentile(75.);
+    CHECK(clamped == doctest::Approx(kClampUs).epsilon(1. / 128));
+    CHECK(clamped <= above.max());
+}
@@ -0,0 +1,410 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/convert.h>
+#include <eztrt/model.h>
+#include <eztrt/util.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The zero-copy API: preprocessing writes into the host buffer returned by `acquire_input()` and
+// `run()` executes on it without copying the input anywhere on the host side. `predict()` has to
+// stay correct with more concurrent callers than execution contexts. `stub_model` checks the
+// execution paths of `model` without a GPU, the other tests run the sample model.
+
+using namespace eztrt;
+using namespace eztrt::testing;
+
+namespace
+{
+
+/// Forwards to OpenCV's default allocator and counts the allocated matrices
+class counting_allocator : public cv::MatAllocator
+{
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const override
+    {
+        ++allocations;
+        return inner->allocate(dims, sizes, type, data, step, flags, usage);
+    }
+    bool allocate(cv::UMatData* data, cv::AccessFlag flags,
+                  cv::UMatUsageFlags usage) const override
+    {
+        return inner->allocate(data, flags, usage);
+    }
+    void deallocate(cv::UMatData* data) const override { inner->deallocate(data); }
+
+    cv::MatAllocator*        inner = cv::Mat::getStdAllocator();
+    mutable std::atomic<int> allocations{0};
+};
+
+/// Installs a `counting_allocator` as the default allocator while it lives
+struct count_allocations
+{
+    count_allocations() { cv::Mat::setDefaultAllocator(&allocator); }
+    ~count_allocations() { cv::Mat::setDefaultAllocator(nullptr); }
+    int count() const { return allocator.allocations; }
+
+    counting_allocator allocator;
+};
+
+/// What the slots of a `stub_model` have done, shared by all of them
+struct stub_stats
+{
+    std::atomic<int> slots{0};      //!< Slots created
+    std::atomic<int> executions{0}; //!< Calls of `execute()`
+    std::atomic<int> overlaps{0};   //!< Executions that found their slot in use by another one
+};
+
+/**
+ * A model whose execution slots compute on the host instead of running an engine, so that the
+ * execution paths of `model` are tested without a GPU: the single output is twice the single input,
+ * both tensors of shape 1 x `kSize` and element type `type` (float, half or bfloat16).
+ */
+class stub_model : public model
+{
+public:
+    static constexpr int kSize = 16;
+
+    explicit stub_model(logger& log, int execution_contexts = 1,
+                        nvinfer1::DataType type = nvinfer1::DataType::kFLOAT)
+        : model(make_params(execution_contexts), log), stats_{std::make_shared<stub_stats>()}
+    {
+        const nvinfer1::Dims2 dims(1, kSize);
+        reset_execution({{0, "input", dims, type, true}}, {{1, "output", dims, type, false}},
+                        [stats = stats_, type] { return std::make_unique<slot>(stats, type); });
+    }
+
+    const stub_stats& stats() const { return *stats_; }
+
+private:
+    static params make_params(int execution_contexts)
+    {
+        params p;
+        p.execution_contexts = execution_contexts;
+        return p;
+    }
+
+    struct slot : execution_slot
+    {
+        slot(std::shared_ptr<stub_stats> stats, nvinfer1::DataType type)
+            : stats{std::move(stats)}, type{type}, input(kSize), output(kSize)
+        {
+            ++this->stats->slots;
+        }
+
+        /// Element `i` of `buffer`, which holds `kSize` elements of `type`
+        float load(const std::vector<float>& buffer, int i) const
+        {
+            switch (type)
+            {
+            case nvinfer1::DataType::kHALF:
+                return reinterpret_cast<const half_float::half*>(buffer.data())[i];
+#if NV_TENSORRT_MAJOR >= 9
+            case nvinfer1::DataType::kBF16:
+                return reinterpret_cast<const bfloat16*>(buffer.data())[i];
+#endif
+            default: return buffer[i];
+            }
+        }
+
+        void store(std::vector<float>& buffer, int i, float value) const
+        {
+            switch (type)
+            {
+            case nvinfer1::DataType::kHALF:
+                reinterpret_cast<half_float::half*>(buffer.data())[i] = half_float::half(value);
+                break;
+#if NV_TENSORRT_MAJOR >= 9
+            case nvinfer1::DataType::kBF16:
+                reinterpret_cast<bfloat16*>(buffer.data())[i] = bfloat16(value);
+                break;
+#endif
+            default: buffer[i] = value;
+            }
+        }
+
+        void* host_buffer(const samplesCommon::BindingHandle& binding) override
+        {
+            return binding.isInput() ? input.data() : output.data();
+        }
+
+        bool execute() override
+        {
+            if (busy.exchange(true)) ++stats->overlaps;
+            ++stats->executions;
+            for (int i = 0; i < kSize; ++i)
+                store(output, i, 2 * load(input, i));
+            // give other threads a chance to run into this slot
+            std::this_thread::yield();
+            busy = false;
+            return true;
+        }
+
+        std::shared_ptr<stub_stats> stats;
+        nvinfer1::DataType          type;
+        std::vector<float>          input, output; //!< large enough for 16 bit types as well
+        std::atomic<bool>           busy{false};
+    };
+
+    std::shared_ptr<stub_stats> stats_;
+};
+
+/// A `CV_32F` input for `stub_model`, element `i` is `i + offset`
+cv::Mat stub_input(float offset)
+{
+    cv::Mat input(1, stub_model::kSize, CV_32F);
+    for (int i = 0; i < stub_model::kSize; ++i)
+        input.at<float>(i) = float(i) + offset;
+    return input;
+}
+
+void check_zero_copy(model& m)
+{
+    const cv::Mat image = cv::imread(kDataDir + "/test_3.png");
+    REQUIRE(!image.empty());
+
+    // reference: the copying API
+    const cv::Mat adjusted = try_adjust_input(image, 0, m);
+    REQUIRE(!adjusted.empty());
+    const cv::Mat expected = m.predict(adjusted);
+    REQUIRE(!expected.empty());
+
+    // the view is the input buffer itself, and preprocessing writes into it in place
+    cv::Mat view = m.acquire_input(0);
+    REQUIRE(!view.empty());
+    CHECK(m.acquire_input(0).data == view.data);
+    const cv::Mat written = try_adjust_input(image, 0, m, view);
+    CHECK(written.data == view.data);
+
+    const cv::Mat output = m.run();
+    REQUIRE(!output.empty());
+    CHECK(equal_outputs(output, expected));
+
+    // the output is a view as well, which the next run overwrites
+    cv::Mat second;
+    {
+        count_allocations counter;
+        second = m.run();
+        CHECK(counter.count() == 0);
+    }
+    CHECK(second.data == output.data);
+    CHECK(equal_outputs(second, expected));
+
+    // predict() recognizes the view and does not copy it into another buffer
+    CHECK(equal_outputs(m.predict(view), expected));
+    CHECK(m.acquire_input(0).data == view.data);
+}
+
+/**
+ * Calls `predict()` from more threads than `m` has execution contexts, each thread on its own
+ * digit, and checks that every call returns the output of the caller's input.
+ */
+void check_concurrent_predict(model& m)
+{
+    const char* digits[] = {"test_0", "test_1", "test_2", "test_3", "test_5",
+                            "test_6", "test_8", "test_9"};
+
+    // reference outputs from sequential calls
+    std::vector<cv::Mat> inputs, expected;
+    for (const char* digit : digits)
+    {
+        const cv::Mat image = cv::imread(kDataDir + "/" + digit + ".png");
+        REQUIRE(!image.empty());
+        inputs.push_back(try_adjust_input(image, 0, m));
+        REQUIRE(!inputs.back().empty());
+        expected.push_back(m.predict(inputs.back()));
+        REQUIRE(!expected.back().empty());
+    }
+
+    constexpr int            kIterations = 50;
+    std::atomic<int>         wrong{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < inputs.size(); ++t)
+    {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kIterations; ++i)
+                if (!equal_outputs(m.predict(inputs[t]), expected[t])) ++wrong;
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    CHECK(wrong == 0);
+}
+
+} // namespace
+
+TEST_CASE("the zero-copy path matches predict() on the TensorRT backend")
+{
+    if (!has_cuda_device())
+    {
+        MESSAGE("no CUDA device, skipped");
+        return;
+    }
+
+    logger        log("model_test", ILogger::Severity::kWARNING);
+    model::params params;
+    model         m(params, log);
+    REQUIRE(m.load(kDataDir + "/mnist2.onnx"));
+    REQUIRE(m.ready());
+    check_zero_copy(m);
+}
+
+TEST_CASE("the zero-copy path matches predict() on the CPU backend")
+{
+    logger        log("model_test", ILogger::Severity::kWARNING);
+    model::params params;
+    params.backend = backend_type::cpu;
+    model m(params, log);
+    REQUIRE(m.load(kDataDir + "/mnist2.onnx"));
+    check_zero_copy(m);
+}
+
+TEST_CASE("concurrent predict() calls get their own outputs on the TensorRT backend")
+{
+    if (!has_cuda_device())
+    {
+        MESSAGE("no CUDA device, skipped");
+        return;
+    }
+
+    logger        log("model_test", ILogger::Severity::kWARNING);
+    model::params params;
+    params.execution_contexts = 3; // fewer than callers, and created while others run
+    model m(params, log);
+    REQUIRE(m.load(kDataDir + "/mnist2.onnx"));
+    REQUIRE(m.ready());
+    check_concurrent_predict(m);
+}
+
+TEST_CASE("concurrent predict() calls get their own outputs on the CPU backend")
+{
+    logger        log("model_test", ILogger::Severity::kWARNING);
+    model::params params;
+    params.backend = backend_type::cpu;
+    model m(params, log);
+    REQUIRE(m.load(kDataDir + "/mnist2.onnx"));
+    check_concurrent_predict(m);
+}
+
+TEST_CASE("predict() on the view of acquire_input() executes it without any host-side copy")
+{
+    logger     log("model_test", ILogger::Severity::kWARNING);
+    stub_model m(log);
+
+    cv::Mat view = m.acquire_input(0);
+    REQUIRE(view.type() == CV_32F);
+    REQUIRE(view.total() == size_t(stub_model::kSize));
+    stub_input(1).copyTo(view);
+    REQUIRE(view.data == m.acquire_input(0).data);
+
+    cv::Mat output;
+    {
+        count_allocations counter;
+        output = m.predict(view);
+        // the copy of the output that predict() returns is the only allocation
+        CHECK(counter.count() == 1);
+    }
+    CHECK(m.stats().executions == 1);
+    // executed on the slot of acquire_input(), no slot of the pool has been created
+    CHECK(m.stats().slots == 1);
+    REQUIRE(output.total() == size_t(stub_model::kSize));
+    for (int i = 0; i < stub_model::kSize; ++i)
+        CHECK(output.at<float>(i) == 2 * (i + 1));
+
+    // any other matrix is copied into a slot of the pool
+    CHECK(equal_outputs(m.predict(view.clone()), output));
+    CHECK(m.stats().slots == 2);
+    CHECK(m.stats().overlaps == 0);
+}
+
+TEST_CASE("concurrent predict() calls share the pool of a stub model without interfering")
+{
+    constexpr int kContexts   = 3;
+    constexpr int kThreads    = 8;
+    constexpr int kIterations = 2000;
+
+    logger     log("model_test", ILogger::Severity::kWARNING);
+    stub_model m(log, kContexts);
+
+    std::atomic<int>         wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&, t] {
+            const cv::Mat input = stub_input(100.f * t);
+            cv::Mat       expected;
+            input.convertTo(expected, CV_32F, 2);
+            for (int i = 0; i < kIterations; ++i)
+                if (!equal_outputs(m.predict(input), expected)) ++wrong;
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(wrong == 0);
+    // every call got a slot of its own, and no more slots than contexts were created
+    CHECK(m.stats().overlaps == 0);
+    CHECK(m.stats().executions == kThreads * kIterations);
+    CHECK(m.stats().slots <= kContexts);
+}
+
+TEST_CASE("FP16 bindings are wrapped as CV_16F and take and return floats in predict()")
+{
+    logger     log("model_test", ILogger::Severity::kWARNING);
+    stub_model m(log, 1, nvinfer1::DataType::kHALF);
+
+    const cv::Mat input = stub_input(1);
+    cv::Mat       expected;
+    input.convertTo(expected, CV_32F, 2);
+
+    // converted into the buffer of a slot, the output is converted back
+    const cv::Mat output = m.predict(input);
+    REQUIRE(output.type() == CV_32F);
+    CHECK(equal_outputs(output, expected));
+
+    // the view of the input buffer holds the halves themselves
+    cv::Mat view = m.acquire_input(0);
+    REQUIRE(view.type() == CV_16F);
+    REQUIRE(view.total() == size_t(stub_model::kSize));
+    REQUIRE(convert_f32_to_f16(input, view).data == view.data);
+
+    // run() returns them as they are, predict() on the view converts them to float
+    const cv::Mat halves = m.run();
+    REQUIRE(halves.type() == CV_16F);
+    CHECK(equal_outputs(convert_f16_to_f32(halves), expected));
+    CHECK(equal_outputs(m.predict(view), expected));
+    CHECK(m.stats().slots == 2);
+
+    // a float input of the wrong size does not fit the buffer
+    CHECK(m.predict(cv::Mat(1, stub_model::kSize - 1, CV_32F, cv::Scalar(1))).empty());
+}
+
+#if NV_TENSORRT_MAJOR >= 9
+TEST_CASE("BF16 bindings are wrapped as CV_16U bits and take and return floats in predict()")
+{
+    logger     log("model_test", ILogger::Severity::kWARNING);
+    stub_model m(log, 1, nvinfer1::DataType::kBF16);
+
+    const cv::Mat input = stub_input(1);
+    cv::Mat       expected;
+    input.convertTo(expected, CV_32F, 2);
+
+    const cv::Mat output = m.predict(input);
+    REQUIRE(output.type() == CV_32F);
+    CHECK(equal_outputs(output, expected));
+
+    cv::Mat view = m.acquire_input(0);
+    REQUIRE(view.type() == CV_16U);
+    REQUIRE(convert_f32_to_bf16(input, view).data == view.data);
+    const cv::Mat bits = m.run();
+    REQUIRE(bits.type() == CV_16U);
+    CHECK(equal_outputs(convert_bf16_to_f32(bits), expected));
+    CHECK(equal_outputs(m.predict(view), expected));
+}
+#endif
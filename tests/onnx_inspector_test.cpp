@@ -0,0 +1,159 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/onnx_inspector.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+// The expected values come from the onnx Python package.
+
+using namespace eztrt;
+using namespace eztrt::testing;
+
+namespace
+{
+
+std::vector<uint8_t> read_bytes(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+/// Inspects a copy of the first `size` bytes in a buffer of exactly that size, so that the address
+/// sanitizer catches any read beyond it
+onnx_model_info inspect_prefix(const std::vector<uint8_t>& data, size_t size)
+{
+    const std::vector<uint8_t> prefix(data.begin(), data.begin() + size);
+    return inspect_onnx(prefix.data(), prefix.size());
+}
+
+} // namespace
+
+TEST_CASE("the interface of the bundled MNIST model is read")
+{
+    const auto info = inspect_onnx(kDataDir + "/mnist2.onnx");
+    REQUIRE_MESSAGE(info.valid(), info.error);
+
+    CHECK(info.ir_version == 3);
+    CHECK(info.producer == "CNTK");
+    CHECK(info.graph_name == "CNTKGraph");
+    CHECK(info.opsets == std::map<std::string, int64_t>{{"", 7}});
+
+    // the initializers are listed as graph inputs as well, which does not make them inputs
+    REQUIRE(info.inputs.size() == 1);
+    CHECK(info.inputs[0].name == "Input3");
+    CHECK(info.inputs[0].type == onnx_type::float32);
+    CHECK(info.inputs[0].shape == std::vector<int64_t>{1, 1, 28, 28});
+
+    REQUIRE(info.outputs.size() == 1);
+    CHECK(info.outputs[0].name == "Plus214_Output_0");
+    CHECK(info.outputs[0].type == onnx_type::float32);
+    CHECK(info.outputs[0].shape == std::vector<int64_t>{1, 10});
+
+    CHECK(info.node_count == 12);
+    CHECK(info.op_histogram == std::map<std::string, size_t>{{"Add", 3},
+                                                             {"Conv", 2},
+                                                             {"MatMul", 1},
+                                                             {"MaxPool", 2},
+                                                             {"Relu", 2},
+                                                             {"Reshape", 2}});
+
+    REQUIRE(info.initializers.size() == 8);
+    CHECK(info.initializers[0].name == "Parameter193");
+    CHECK(info.initializers[0].shape == std::vector<int64_t>{16, 4, 4, 10});
+    CHECK(info.initializers[0].bytes == 10240);
+    CHECK(info.initializer_bytes == 24008);
+
+    const auto summary = info.summarize(true);
+    CHECK(summary.find("Input3") != std::string::npos);
+    CHECK(summary.find("(1, 1, 28, 28)") != std::string::npos);
+}
+
+TEST_CASE("the other bundled models are read")
+{
+    const auto mnist3 = inspect_onnx(kDataDir + "/mnist3.onnx");
+    REQUIRE_MESSAGE(mnist3.valid(), mnist3.error);
+    CHECK(mnist3.opsets == std::map<std::string, int64_t>{{"", 8}});
+    CHECK(mnist3.node_count == 12);
+
+    // an old export without opset imports and with its weights in Constant nodes
+    const auto mnist1 = inspect_onnx(kDataDir + "/mnist1.onnx");
+    REQUIRE_MESSAGE(mnist1.valid(), mnist1.error);
+    CHECK(mnist1.opsets.empty());
+    REQUIRE(mnist1.inputs.size() == 1);
+    CHECK(mnist1.inputs[0].name == "Input73");
+    REQUIRE(mnist1.outputs.size() == 1);
+    CHECK(mnist1.outputs[0].name == "Plus422_Output_0");
+    CHECK(mnist1.node_count == 25);
+    CHECK(mnist1.op_histogram.at("Constant") == 7);
+    CHECK(mnist1.initializers.empty());
+}
+
+TEST_CASE("a missing file is reported")
+{
+    const auto info = inspect_onnx(kDataDir + "/does_not_exist.onnx");
+    CHECK(!info.valid());
+    CHECK(!info.summarize().empty());
+}
+
+TEST_CASE("truncated models are rejected without reading past the end")
+{
+    const auto data = read_bytes(kDataDir + "/mnist2.onnx");
+    REQUIRE(data.size() == 26454);
+
+    // the opset imports follow the graph, so cutting between the two leaves a readable model
+    // which only lacks them
+    size_t accepted = 0;
+    for (size_t size = 0; size < data.size(); ++size)
+    {
+        const auto info = inspect_prefix(data, size);
+        if (!info.valid()) continue;
+        ++accepted;
+        CAPTURE(size);
+        CHECK(info.opsets.empty());
+    }
+    CHECK(accepted <= 1);
+}
+
+TEST_CASE("corrupted models are rejected")
+{
+    auto data = read_bytes(kDataDir + "/mnist2.onnx");
+    REQUIRE(!data.empty());
+    REQUIRE(inspect_prefix(data, data.size()).valid());
+
+    SUBCASE("garbage")
+    {
+        const std::vector<uint8_t> garbage(1000, 0xFF);
+        CHECK(!inspect_onnx(garbage.data(), garbage.size()).valid());
+    }
+
+    SUBCASE("a nested length beyond the end of its message")
+    {
+        // the first use of the weights, as the input of a node, is preceded by the length of the
+        // name, which now exceeds the node. Only the reader of the node sees this, the graph
+        // around it stays well-formed.
+        const std::string name = "Parameter193";
+        auto              it   = std::search(data.begin(), data.end(), name.begin(), name.end());
+        REQUIRE(it != data.end());
+        REQUIRE(it[-1] == name.size());
+        it[-1] = 0x7F;
+        CHECK(!inspect_prefix(data, data.size()).valid());
+    }
+
+    SUBCASE("flipped bytes never read out of bounds")
+    {
+        for (size_t i = 0; i < data.size(); i += 7)
+        {
+            auto corrupted = data;
+            corrupted[i] ^= 0xA5;
+            inspect_prefix(corrupted, corrupted.size());
+        }
+    }
+}
@@ -0,0 +1,353 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/util.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The fused preprocessing passes are compared with the step-by-step OpenCV operations they
+// replace.
+
+using namespace eztrt;
+
+namespace
+{
+
+/// A random interleaved image, integers cover the whole range of 8 and 16 bit types
+cv::Mat random_image(int rows, int cols, int depth, int channels)
+{
+    cv::Mat m(rows, cols, CV_MAKETYPE(depth, channels));
+    switch (depth)
+    {
+    case CV_8U: cv::randu(m, 0, 256); break;
+    case CV_8S: cv::randu(m, -128, 128); break;
+    case CV_16U: cv::randu(m, 0, 65536); break;
+    case CV_16S: cv::randu(m, -32768, 32768); break;
+    case CV_32S: cv::randu(m, -(1 << 20), 1 << 20); break;
+    default: cv::randu(m, -2.0, 2.0); break;
+    }
+    return m;
+}
+
+/// The largest absolute difference between two matrices of the same shape
+double max_difference(const cv::Mat& a, const cv::Mat& b)
+{
+    cv::Mat a64, b64;
+    a.convertTo(a64, CV_64F);
+    b.convertTo(b64, CV_64F);
+    return cv::norm(a64, b64, cv::NORM_INF);
+}
+
+bool same_shape(const cv::Mat& a, const cv::Mat& b)
+{
+    if (a.dims != b.dims || a.type() != b.type()) return false;
+    for (int d = 0; d < a.dims; ++d)
+        if (a.size[d] != b.size[d]) return false;
+    return true;
+}
+
+/// The color conversion `try_adjust_input` does for `channels` output channels, in float
+cv::Mat convert_channels(cv::Mat in, int channels)
+{
+    const int in_cn = in.channels();
+    if (in_cn == 3 && channels == 1) cv::cvtColor(in, in, cv::COLOR_BGR2GRAY);
+    if (in_cn == 4 && channels == 1) cv::cvtColor(in, in, cv::COLOR_BGRA2GRAY);
+    if (in_cn == 1 && channels == 3) cv::cvtColor(in, in, cv::COLOR_GRAY2BGR);
+    if (in_cn == 1 && channels == 4) cv::cvtColor(in, in, cv::COLOR_GRAY2BGRA);
+    return in;
+}
+
+/**
+ * `try_adjust_input` done step by step: `convertTo`, `cvtColor` and `permute_dims` from HWC to
+ * CHW. cvtColor only works on 8U, 16U and 32F, so the color conversion happens in float. Float
+ * outputs are scaled first, so that an added alpha channel is opaque (1) like the fused path makes
+ * it; the alpha of integer outputs is not compared.
+ */
+cv::Mat reference_adjust(const cv::Mat& in, int depth, int channels, double mul, double add)
+{
+    cv::Mat converted;
+    if (depth == CV_32F)
+    {
+        in.convertTo(converted, CV_32F, mul, add);
+        converted = convert_channels(converted, channels);
+    }
+    else
+    {
+        in.convertTo(converted, CV_32F);
+        convert_channels(converted, channels).convertTo(converted, depth, mul, add);
+    }
+    return permute_dims(reshape_channels(converted), {2, 0, 1});
+}
+
+struct conversion
+{
+    int    in_depth;
+    int    depth;
+    double mul;
+    double add;
+};
+
+/// The scaling `try_adjust_input` applies for every combination of input and output depth
+const conversion kConversions[] = {
+    {CV_8U, CV_32F, 1. / 0xFF, 0.},
+    {CV_8S, CV_32F, 1. / 0x7F, 0.},
+    {CV_16U, CV_32F, 1. / 0xFFFF, 0.},
+    {CV_16S, CV_32F, 1. / 0x7FFF, 0.},
+    {CV_32S, CV_32F, 1. / 0x7FFFFFFF, 0.},
+    {CV_32F, CV_32F, 1., 0.},
+    {CV_8U, CV_32S, 1., 0.},
+    {CV_16S, CV_32S, 1., 0.},
+    {CV_32S, CV_32S, 1., 0.},
+    {CV_32F, CV_32S, 1., 0.},
+    {CV_8U, CV_8S, 1., -0x7F},
+    {CV_16U, CV_8S, double(0xFF) / 0xFFFF, -0x7F},
+    {CV_16S, CV_8S, double(0x7F) / 0x7FFF, 0.},
+    {CV_32F, CV_8S, double(0x7F), 0.},
+};
+
+/// `apply_preprocess_steps` as it used to be: one OpenCV call per step
+cv::Mat reference_steps(const cv::Mat& in, const std::string& steps)
+{
+    cv::Mat out = in.clone();
+    for (char step : steps)
+    {
+        switch (step)
+        {
+        case 'v': cv::flip(out, out, 0); break;
+        case 'h': cv::flip(out, out, 1); break;
+        case 'r': cv::rotate(out, out, cv::ROTATE_90_COUNTERCLOCKWISE); break;
+        case 't': cv::transpose(out, out); break;
+        case 'I': cv::subtract(cv::Scalar::all(1.0), out, out); break;
+        case 'C':
+        {
+            // cvtColor does not support all depths, the conversion just repeats the channel
+            const cv::Mat planes[] = {out, out, out};
+            cv::merge(planes, 3, out);
+            break;
+        }
+        case 'G': cv::cvtColor(out, out, cv::COLOR_BGR2GRAY); break;
+        }
+    }
+    return out;
+}
+
+/// All strings of up to `max_length` characters out of `alphabet`, including the empty one
+std::vector<std::string> all_strings(const std::string& alphabet, size_t max_length)
+{
+    std::vector<std::string> result{""};
+    for (size_t begin = 0; begin < result.size(); ++begin)
+    {
+        if (result[begin].size() == max_length) continue;
+        for (char c : alphabet)
+            result.push_back(result[begin] + c);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("geometric step strings collapse into one remap")
+{
+    cv::setRNGSeed(3);
+    // non-square, so that every swap of the axes shows; the types cover several element sizes
+    const cv::Mat images[] = {random_image(5, 7, CV_8U, 1), random_image(5, 7, CV_8U, 3),
+                              random_image(6, 3, CV_16U, 1), random_image(37, 45, CV_32F, 4),
+                              random_image(40, 70, CV_64F, 1)};
+
+    const auto step_lists = all_strings("vhrt", 4);
+    REQUIRE(step_lists.size() == 1 + 4 + 16 + 64 + 256);
+    for (const auto& image : images)
+        for (const auto& steps : step_lists)
+        {
+            CAPTURE(steps);
+            CAPTURE(image.type());
+            const preprocess_plan plan(steps);
+            const cv::Mat         expected = reference_steps(image, steps);
+            const cv::Mat         actual   = plan.apply(image);
+            REQUIRE(same_shape(actual, expected));
+            CHECK(max_difference(actual, expected) == 0.);
+            CHECK(plan.output_size(image.size()) == expected.size());
+            // the random images have no symmetries, only the identity leaves them unchanged
+            const bool unchanged =
+                same_shape(expected, image) && max_difference(expected, image) == 0.;
+            CHECK(plan.is_identity() == unchanged);
+        }
+}
+
+TEST_CASE("the identity plan copies its input")
+{
+    const cv::Mat in = random_image(4, 6, CV_8U, 3);
+    for (const char* steps : {"", "vv", "hh", "tt", "rrrr", "vhvh", "rtrt", "xyz"})
+    {
+        CAPTURE(steps);
+        const preprocess_plan plan(steps);
+        CHECK(plan.is_identity());
+        const cv::Mat out = plan.apply(in);
+        CHECK(out.data != in.data);
+        CHECK(max_difference(out, in) == 0.);
+    }
+}
+
+TEST_CASE("per-pixel steps match the step-by-step operations")
+{
+    cv::setRNGSeed(4);
+    struct pixel_case
+    {
+        cv::Mat     image;
+        const char* steps;
+        double      tolerance;
+    };
+    // cvtColor computes gray of 8-bit images in fixed point, which can round differently
+    const pixel_case cases[] = {
+        {random_image(9, 11, CV_8U, 1), "I", 0.},
+        {random_image(9, 11, CV_8U, 1), "II", 0.},
+        {random_image(9, 11, CV_8U, 1), "C", 0.},
+        {random_image(9, 11, CV_8U, 1), "CIh", 0.},
+        {random_image(9, 11, CV_8U, 3), "rIvG", 1.},
+        {random_image(9, 11, CV_8U, 4), "G", 1.},
+        {random_image(9, 11, CV_16S, 3), "tI", 0.},
+        {random_image(9, 11, CV_16U, 1), "vCGI", 1.},
+        {random_image(9, 11, CV_32S, 1), "ICr", 0.},
+        {random_image(9, 11, CV_32F, 3), "GIC", 1e-6},
+        {random_image(9, 11, CV_32F, 1), "IIhI", 1e-6},
+        {random_image(9, 11, CV_64F, 1), "ICt", 0.},
+    };
+    for (const auto& c : cases)
+    {
+        CAPTURE(c.steps);
+        CAPTURE(c.image.type());
+        const cv::Mat expected = reference_steps(c.image, c.steps);
+        const cv::Mat actual   = apply_preprocess_steps(c.image, c.steps);
+        REQUIRE(same_shape(actual, expected));
+        CHECK(max_difference(actual, expected) <= c.tolerance);
+    }
+}
+
+TEST_CASE("per-pixel steps keep the precision of 32-bit integers and doubles")
+{
+    // neither the values nor their inversions are representable as floats
+    cv::Mat ints(2, 3, CV_32SC3);
+    cv::randu(ints, (1 << 30) - 1000, 1 << 30);
+    ints.at<cv::Vec3i>(0, 0) = {(1 << 24) + 1, -(1 << 24) - 3, (1 << 30) + 1};
+    CHECK(max_difference(apply_preprocess_steps(ints, "I"), reference_steps(ints, "I")) == 0.);
+    CHECK(max_difference(apply_preprocess_steps(ints, "IvI"), reference_steps(ints, "IvI")) == 0.);
+
+    cv::Mat doubles(3, 2, CV_64FC3);
+    cv::randu(doubles, -1e9, 1e9);
+    CHECK(max_difference(apply_preprocess_steps(doubles, "I"), reference_steps(doubles, "I")) ==
+          0.);
+    const cv::Mat gray = apply_preprocess_steps(doubles, "G");
+    REQUIRE(gray.type() == CV_64FC1);
+    for (int r = 0; r < doubles.rows; ++r)
+        for (int c = 0; c < doubles.cols; ++c)
+        {
+            const auto&  px       = doubles.at<cv::Vec3d>(r, c);
+            const double expected = (double(0.114f) * px[0] + double(0.587f) * px[1]) +
+                                    double(0.299f) * px[2];
+            // a float computation would be off by about 1e-7
+            CHECK(gray.at<double>(r, c) == doctest::Approx(expected).epsilon(1e-12));
+        }
+}
+
+TEST_CASE("color steps that do not fit the channels are rejected")
+{
+    CHECK(apply_preprocess_steps(random_image(4, 4, CV_8U, 3), "C").empty());
+    CHECK(apply_preprocess_steps(random_image(4, 4, CV_8U, 1), "G").empty());
+    CHECK(apply_preprocess_steps(random_image(4, 4, CV_8U, 1), "CC").empty());
+    CHECK(!apply_preprocess_steps(random_image(4, 4, CV_8U, 1), "CG").empty());
+}
+
+TEST_CASE("try_adjust_input matches convertTo, cvtColor and permute_dims")
+{
+    cv::setRNGSeed(1);
+    const std::pair<int, int> channel_pairs[] = {{1, 1}, {3, 3}, {4, 4}, {1, 3},
+                                                 {3, 1}, {4, 1}, {1, 4}};
+
+    for (const auto& conv : kConversions)
+        for (auto [in_cn, channels] : channel_pairs)
+        {
+            // only the alpha of float outputs has a defined reference
+            if (channels == 4 && in_cn == 1 && conv.depth != CV_32F) continue;
+            CAPTURE(conv.in_depth);
+            CAPTURE(conv.depth);
+            CAPTURE(in_cn);
+            CAPTURE(channels);
+
+            // odd widths leave a tail after the SIMD bodies of the 8-bit kernels
+            const cv::Mat in       = random_image(23, 67, conv.in_depth, in_cn);
+            const cv::Mat expected = reference_adjust(in, conv.depth, channels, conv.mul, conv.add);
+            const cv::Mat actual   = try_adjust_input(in, {1, channels, 23, 67}, conv.depth);
+            REQUIRE(same_shape(actual, expected));
+
+            // the fused pass scales in float, integer outputs may round differently at .5
+            const double scale     = std::max(1.0, cv::norm(expected, cv::NORM_INF));
+            const double tolerance = conv.depth == CV_32F ? 1e-5 * scale : 1.0;
+            CHECK(max_difference(actual, expected) <= tolerance);
+        }
+}
+
+TEST_CASE("try_adjust_input converts exactly when no scaling is involved")
+{
+    cv::setRNGSeed(2);
+    for (int in_cn : {1, 3})
+    {
+        const cv::Mat in = random_image(9, 35, CV_8U, in_cn);
+
+        cv::Mat s8;
+        in.convertTo(s8, CV_8S, 1., -0x7F);
+        CHECK(max_difference(try_adjust_input(in, {1, in_cn, 9, 35}, CV_8S),
+                             permute_dims(reshape_channels(s8), {2, 0, 1})) == 0.);
+
+        cv::Mat s32;
+        in.convertTo(s32, CV_32S);
+        CHECK(max_difference(try_adjust_input(in, {1, in_cn, 9, 35}, CV_32S),
+                             permute_dims(reshape_channels(s32), {2, 0, 1})) == 0.);
+    }
+}
+
+TEST_CASE("try_adjust_input resizes to the input shape")
+{
+    const cv::Mat in     = random_image(40, 60, CV_8U, 3);
+    const cv::Mat actual = try_adjust_input(in, {1, 3, 20, 30}, CV_32F);
+    REQUIRE(actual.dims == 3);
+    CHECK(actual.size[0] == 3);
+    CHECK(actual.size[1] == 20);
+    CHECK(actual.size[2] == 30);
+}
+
+TEST_CASE("try_adjust_input writes into a given destination")
+{
+    const cv::Mat in = random_image(16, 24, CV_8U, 3);
+    cv::Mat       dst(1, 3 * 16 * 24, CV_32F);
+
+    const cv::Mat actual = try_adjust_input(in, {1, 3, 16, 24}, CV_32F, dst);
+    CHECK(actual.data == dst.data);
+    CHECK(max_difference(actual, try_adjust_input(in, {1, 3, 16, 24}, CV_32F)) == 0.);
+}
+
+TEST_CASE("try_adjust_input rejects a destination that does not fit")
+{
+    const cv::Mat in = random_image(16, 24, CV_8U, 3);
+
+    // the right number of elements, but floats would be written past the end of the bytes
+    cv::Mat wrong_depth(1, 3 * 16 * 24, CV_8U);
+    CHECK(try_adjust_input(in, {1, 3, 16, 24}, CV_32F, wrong_depth).empty());
+
+    cv::Mat too_small(1, 3 * 16 * 24 - 1, CV_32F);
+    CHECK(try_adjust_input(in, {1, 3, 16, 24}, CV_32F, too_small).empty());
+
+    cv::Mat not_continuous = cv::Mat(3 * 16, 2 * 24, CV_32F)(cv::Rect(0, 0, 24, 3 * 16));
+    CHECK(convert_to_planar(in, CV_32F, 3, 1., 0., not_continuous).empty());
+}
+
+TEST_CASE("try_adjust_input rejects unsupported inputs")
+{
+    const cv::Mat in = random_image(8, 8, CV_8U, 3);
+    CHECK(try_adjust_input(in, {3, 8, 8}, CV_32F).empty());
+    CHECK(try_adjust_input(in, {1, 3, 8, 8}, CV_64F).empty());
+    CHECK(try_adjust_input(in, {1, 2, 8, 8}, CV_32F).empty());
+    CHECK(try_adjust_input(random_image(8, 8, CV_64F, 3), {1, 3, 8, 8}, CV_32F).empty());
+}
@@ -0,0 +1,144 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/slot_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// More threads than slots hammer the pool, every object must only ever be used by one of them.
+
+using namespace eztrt;
+
+namespace
+{
+
+struct object
+{
+    std::atomic<int> users{0};
+    int              counter{0}; //!< only modified by the thread holding the slot
+};
+
+/// Counts the calls of the factory and how many of them overlapped
+struct counting_factory
+{
+    std::unique_ptr<object> operator()()
+    {
+        if (++state->active > 1) state->overlapped = true;
+        // widen the window for concurrent calls
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        ++state->calls;
+        --state->active;
+        return std::make_unique<object>();
+    }
+
+    struct shared
+    {
+        std::atomic<int>  active{0}, calls{0};
+        std::atomic<bool> overlapped{false};
+    };
+    std::shared_ptr<shared> state = std::make_shared<shared>();
+};
+
+constexpr int kThreads    = 16;
+constexpr int kIterations = 500;
+
+} // namespace
+
+TEST_CASE("checked out objects are never shared between threads")
+{
+    counting_factory  factory;
+    slot_pool<object> pool(3, factory);
+
+    std::atomic<int>         violations{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&] {
+            for (int i = 0; i < kIterations; ++i)
+            {
+                auto lease = pool.checkout();
+                if (!lease)
+                {
+                    ++violations;
+                    continue;
+                }
+                if (lease->users.fetch_add(1) != 0) ++violations;
+                if (pool.in_use() > pool.size()) ++violations;
+                // a non-atomic read-modify-write that a second user would corrupt
+                const int before = lease->counter;
+                std::this_thread::yield();
+                lease->counter = before + 1;
+                lease->users.fetch_sub(1);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(violations == 0);
+    CHECK(pool.in_use() == 0);
+    CHECK(pool.statistics().checkouts == kThreads * kIterations);
+
+    int total = 0;
+    CHECK(pool.for_each_idle([&](object& o) { total += o.counter; }) == 0);
+    CHECK(total == kThreads * kIterations);
+}
+
+TEST_CASE("objects are created once per slot and never concurrently")
+{
+    counting_factory  factory;
+    slot_pool<object> pool(8, factory);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 20; ++i)
+                pool.checkout();
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(factory.state->calls <= 8);
+    CHECK(!factory.state->overlapped);
+}
+
+TEST_CASE("a failed creation is retried on the next checkout")
+{
+    int               calls = 0;
+    slot_pool<object> pool(1, [&]() -> std::unique_ptr<object> {
+        return ++calls == 1 ? nullptr : std::make_unique<object>();
+    });
+
+    {
+        auto lease = pool.checkout();
+        CHECK(!lease);
+    }
+    auto lease = pool.checkout();
+    CHECK(lease);
+    CHECK(calls == 2);
+}
+
+TEST_CASE("checkout blocks until a slot is returned")
+{
+    slot_pool<object> pool(1, [] { return std::make_unique<object>(); });
+
+    auto             first = pool.checkout();
+    std::atomic<bool> acquired{false};
+    std::thread       waiter([&] {
+        auto second = pool.checkout();
+        acquired    = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!acquired);
+    first.release();
+    waiter.join();
+    CHECK(acquired);
+    CHECK(pool.statistics().waits == 1);
+}
@@ -0,0 +1,200 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/spsc_queue.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace eztrt;
+
+namespace
+{
+
+/// Enough elements to wrap around a small queue many times
+constexpr size_t kElements = 200000;
+
+/// Gives a thread that is about to block time to actually do so
+void let_block() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+
+} // namespace
+
+TEST_CASE("the capacity is rounded up to a power of two")
+{
+    CHECK(spsc_queue<int>(0).capacity() == 1);
+    CHECK(spsc_queue<int>(1).capacity() == 1);
+    CHECK(spsc_queue<int>(5).capacity() == 8);
+    CHECK(spsc_queue<int>(64).capacity() == 64);
+}
+
+TEST_CASE("try_push and try_pop do not block on a full or empty queue")
+{
+    spsc_queue<std::unique_ptr<int>> queue(4);
+    std::unique_ptr<int>             value;
+    CHECK(!queue.try_pop(value));
+
+    for (int i = 0; i < 4; ++i)
+        REQUIRE(queue.try_push(std::make_unique<int>(i)));
+    CHECK(queue.size() == 4);
+
+    // a rejected value is left untouched
+    auto extra = std::make_unique<int>(4);
+    CHECK(!queue.try_push(std::move(extra)));
+    REQUIRE(extra);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        REQUIRE(queue.try_pop(value));
+        CHECK(*value == i);
+    }
+    CHECK(!queue.try_pop(value));
+    CHECK(queue.size() == 0);
+}
+
+TEST_CASE("popped slots do not keep their elements alive")
+{
+    spsc_queue<std::shared_ptr<int>> queue(2);
+    auto                             shared = std::make_shared<int>(1);
+    REQUIRE(queue.try_push(std::shared_ptr<int>(shared)));
+    CHECK(shared.use_count() == 2);
+
+    std::shared_ptr<int> value;
+    REQUIRE(queue.try_pop(value));
+    value.reset();
+    CHECK(shared.use_count() == 1);
+}
+
+TEST_CASE("one producer and one consumer see the elements in order")
+{
+    for (const size_t capacity : {1, 2, 7, 64})
+    {
+        CAPTURE(capacity);
+        spsc_queue<size_t> queue(capacity);
+
+        std::atomic<size_t> failed{0};
+        std::thread         producer([&] {
+            for (size_t i = 0; i < kElements; ++i)
+                if (!queue.push(size_t(i))) ++failed;
+            queue.close();
+        });
+
+        size_t expected = 0, value = 0, out_of_order = 0;
+        while (queue.pop(value))
+            if (value != expected++) ++out_of_order;
+        producer.join();
+        CHECK(failed == 0);
+        CHECK(out_of_order == 0);
+        CHECK(expected == kElements);
+    }
+}
+
+TEST_CASE("the non-blocking calls keep the order across wrap-arounds")
+{
+    for (const size_t capacity : {1, 2, 7, 64})
+    {
+        CAPTURE(capacity);
+        spsc_queue<size_t> queue(capacity);
+
+        // yields when stuck, the other side may share the core
+        std::thread producer([&] {
+            for (size_t i = 0; i < kElements;)
+                if (queue.try_push(size_t(i)))
+                    ++i;
+                else
+                    std::this_thread::yield();
+        });
+
+        size_t expected = 0, value = 0, out_of_order = 0;
+        while (expected < kElements)
+            if (!queue.try_pop(value))
+                std::this_thread::yield();
+            else if (value != expected++)
+                ++out_of_order;
+        producer.join();
+        CHECK(out_of_order == 0);
+        CHECK(!queue.try_pop(value));
+    }
+}
+
+TEST_CASE("close releases a producer waiting in push")
+{
+    spsc_queue<std::unique_ptr<int>> queue(2);
+    REQUIRE(queue.push(std::make_unique<int>(0)));
+    REQUIRE(queue.push(std::make_unique<int>(1)));
+
+    std::atomic<bool>    returned{false}, pushed{true};
+    std::unique_ptr<int> value = std::make_unique<int>(2);
+    std::thread          producer([&] {
+        pushed   = queue.push(std::move(value));
+        returned = true;
+    });
+    let_block();
+    CHECK(!returned);
+
+    queue.close();
+    producer.join();
+    CHECK(!pushed);
+    // the value that did not fit is still owned by the producer
+    REQUIRE(value);
+    CHECK(*value == 2);
+}
+
+TEST_CASE("close releases a consumer waiting in pop")
+{
+    spsc_queue<int>   queue(4);
+    std::atomic<bool> returned{false}, popped{true};
+    std::thread       consumer([&] {
+        int value = 0;
+        popped    = queue.pop(value);
+        returned  = true;
+    });
+    let_block();
+    CHECK(!returned);
+
+    queue.close();
+    consumer.join();
+    CHECK(!popped);
+}
+
+TEST_CASE("a closed queue is drained before pop fails")
+{
+    spsc_queue<int> queue(8);
+    for (int i = 0; i < 3; ++i)
+        REQUIRE(queue.push(int(i)));
+    queue.close();
+    CHECK(queue.closed());
+    CHECK(!queue.push(3));
+
+    int value = -1;
+    for (int i = 0; i < 3; ++i)
+    {
+        REQUIRE(queue.pop(value));
+        CHECK(value == i);
+    }
+    CHECK(!queue.pop(value));
+}
+
+TEST_CASE("no element pushed right before close is lost")
+{
+    // the consumer races the close, so repeat it a few times
+    for (int round = 0; round < 200; ++round)
+    {
+        CAPTURE(round);
+        spsc_queue<int> queue(4);
+        std::thread     producer([&] {
+            for (int i = 0; i < 64; ++i)
+                queue.push(int(i));
+            queue.close();
+        });
+
+        int value = 0, count = 0, out_of_order = 0;
+        while (queue.pop(value))
+            if (value != count++) ++out_of_order;
+        producer.join();
+        CHECK(out_of_order == 0);
+        CHECK(count == 64);
+    }
+}
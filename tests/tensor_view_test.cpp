@@ -0,0 +1,296 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <eztrt/kernels.h>
+#include <eztrt/tensor_view.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Every way of materializing a view (copy_to, to_mat and permute_in_place on every kernel level)
+// has to give the same bytes as gathering the elements one by one through the strides.
+
+using namespace eztrt;
+
+namespace
+{
+
+/// An element of `N` opaque bytes, copy_strided handles any element size
+template<size_t N>
+struct bytes
+{
+    uint8_t b[N];
+};
+
+/// Views per element size and kernel level
+constexpr int kViews = 60;
+
+/// All kernel levels available on this machine
+std::vector<kernels::isa> available_levels()
+{
+    std::vector<kernels::isa> levels;
+    for (auto level : {kernels::isa::scalar, kernels::isa::sse41, kernels::isa::avx2,
+                       kernels::isa::avx512})
+        if (kernels::table_for(level)) levels.push_back(level);
+    return levels;
+}
+
+/// Runs `f` with every available kernel level selected, then restores the previous level
+template<typename F>
+void for_each_level(F&& f)
+{
+    const kernels::isa previous = kernels::active().level;
+    for (const kernels::isa level : available_levels())
+    {
+        REQUIRE(kernels::select_isa(level));
+        CAPTURE(int(level));
+        f();
+    }
+    kernels::select_isa(previous);
+}
+
+std::vector<uint8_t> random_bytes(size_t n, std::mt19937& rng)
+{
+    std::vector<uint8_t> v(n);
+    for (auto& x : v)
+        x = static_cast<uint8_t>(rng());
+    return v;
+}
+
+/// The row-major elements of `view` as bytes, gathered one by one through its strides
+template<typename T>
+std::vector<uint8_t> reference_gather(const tensor_view<const T>& view)
+{
+    std::vector<uint8_t> res(view.total() * sizeof(T));
+    std::vector<int64_t> idx(view.dims(), 0);
+    for (size_t i = 0; i < view.total(); ++i)
+    {
+        int64_t offset = 0;
+        for (int d = 0; d < view.dims(); ++d)
+            offset += idx[d] * view.stride(d);
+        std::memcpy(&res[i * sizeof(T)], view.data() + offset, sizeof(T));
+        // the next index, the last dimension is the fastest
+        for (int d = view.dims() - 1; d >= 0 && ++idx[d] == view.size(d); --d)
+            idx[d] = 0;
+    }
+    return res;
+}
+
+/// A row-major shape of 1 to 5 dimensions with a longer innermost dimension for the SIMD paths
+std::vector<int64_t> random_shape(std::mt19937& rng)
+{
+    std::vector<int64_t> shape(1 + rng() % 5);
+    for (size_t d = 0; d < shape.size(); ++d)
+        shape[d] = 1 + rng() % (d + 1 == shape.size() ? 70 : 9);
+    return shape;
+}
+
+std::vector<int> random_order(int dims, std::mt19937& rng)
+{
+    std::vector<int> order(dims);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    return order;
+}
+
+/// A random permutation of `view`, optionally sliced with a step and broadcast along a dimension
+template<typename T>
+tensor_view<const T> random_view(tensor_view<const T> view, bool strided, std::mt19937& rng)
+{
+    view = view.permute(random_order(view.dims(), rng));
+    if (!strided) return view;
+
+    if (rng() % 2)
+    {
+        const int     d     = int(rng() % view.dims());
+        const int64_t begin = rng() % view.size(d);
+        const int64_t end   = begin + 1 + rng() % (view.size(d) - begin);
+        view                = view.slice(d, begin, end, 1 + rng() % 3);
+    }
+    if (rng() % 3 == 0)
+    {
+        // a single element of one dimension repeated, and sometimes a new leading dimension
+        const int d = int(rng() % view.dims());
+        view        = view.slice(d, 0, 1);
+        std::vector<int64_t> shape(view.shape(), view.shape() + view.dims());
+        shape[d] = 2 + rng() % 4;
+        if (view.dims() < kMaxTensorDims && rng() % 2) shape.insert(shape.begin(), 3);
+        view = view.broadcast_to(shape);
+    }
+    return view;
+}
+
+/// Copies random views of elements of `N` bytes and permutes them in place, returns the failures
+template<size_t N>
+int check_views(std::mt19937& rng)
+{
+    using T      = bytes<N>;
+    int failures = 0;
+    for (int i = 0; i < kViews; ++i)
+    {
+        const std::vector<int64_t> shape = random_shape(rng);
+        size_t                     total = 1;
+        for (const int64_t s : shape)
+            total *= size_t(s);
+        const std::vector<uint8_t> data = random_bytes(total * N, rng);
+        const tensor_view<const T> base(reinterpret_cast<const T*>(data.data()), int(shape.size()),
+                                        shape.data());
+
+        // permute_in_place only takes permutations of the whole buffer
+        const bool                 in_place = i % 2 == 0;
+        const tensor_view<const T> view     = random_view(base, !in_place, rng);
+        const std::vector<uint8_t> expected = reference_gather(view);
+
+        std::vector<uint8_t> actual;
+        if (in_place)
+        {
+            actual = data;
+            permute_in_place(actual.data(), view.dims(), view.shape(), view.strides(), N);
+        }
+        else
+        {
+            actual.resize(expected.size());
+            view.copy_to(tensor_view<T>(reinterpret_cast<T*>(actual.data()), view.dims(),
+                                        view.shape()));
+        }
+        if (actual != expected) ++failures;
+    }
+    return failures;
+}
+
+template<size_t... N>
+void check_element_sizes(std::mt19937& rng, std::index_sequence<N...>)
+{
+    const int failures[] = {check_views<N + 1>(rng)...};
+    for (size_t n = 0; n < sizeof...(N); ++n)
+    {
+        CAPTURE(n + 1);
+        CHECK(failures[n] == 0);
+    }
+}
+
+/// Checks `to_mat` of random views of `T`: contiguous views are wrapped, all others are copied
+template<typename T>
+void check_to_mat(std::mt19937& rng)
+{
+    CAPTURE(to_str(dtype_of<T>::value));
+    for (int i = 0; i < kViews; ++i)
+    {
+        const std::vector<int64_t> shape = random_shape(rng);
+        size_t                     total = 1;
+        for (const int64_t s : shape)
+            total *= size_t(s);
+        std::vector<uint8_t> data = random_bytes(total * sizeof(T), rng);
+        // only 0 and 1 are valid bools
+        if (std::is_same<T, bool>::value)
+            for (auto& b : data)
+                b &= 1;
+        const tensor_view<const T> base(reinterpret_cast<const T*>(data.data()), int(shape.size()),
+                                        shape.data());
+        const tensor_view<const T> view = random_view(base, i % 2 == 1, rng);
+
+        const cv::Mat m = view.to_mat();
+        REQUIRE(m.type() == CV_MAKETYPE(cv_depth(dtype_of<T>::value), 1));
+        REQUIRE(m.isContinuous());
+        REQUIRE(m.dims == std::max(view.dims(), 2));
+        for (int d = 0; d < view.dims(); ++d)
+            REQUIRE(m.size[d] == view.size(d));
+        if (view.is_contiguous()) CHECK(m.data == reinterpret_cast<const uchar*>(view.data()));
+
+        const std::vector<uint8_t> expected = reference_gather(view);
+        CHECK(std::memcmp(m.data, expected.data(), expected.size()) == 0);
+    }
+}
+
+} // namespace
+
+TEST_CASE("copy_to and permute_in_place match a reference gather for element sizes 1 to 16")
+{
+    std::mt19937 rng(1);
+    for_each_level([&] { check_element_sizes(rng, std::make_index_sequence<16>()); });
+}
+
+TEST_CASE("to_mat matches a reference gather for every element type")
+{
+    std::mt19937 rng(2);
+    for_each_level([&] {
+        check_to_mat<float>(rng);
+        check_to_mat<half_float::half>(rng);
+        check_to_mat<bfloat16>(rng);
+        check_to_mat<int32_t>(rng);
+        check_to_mat<int8_t>(rng);
+        check_to_mat<uint8_t>(rng);
+        check_to_mat<bool>(rng);
+    });
+}
+
+TEST_CASE("view operations only change the shape and strides")
+{
+    float                     data[2 * 3 * 4];
+    const tensor_view<float> v(data, {2, 3, 4});
+    CHECK(v.is_contiguous());
+    CHECK(v.total() == 24);
+    CHECK(&v(1, 2, 3) == data + 23);
+
+    const auto p = v.permute({2, 0, 1});
+    CHECK(p.size(0) == 4);
+    CHECK(p.size(1) == 2);
+    CHECK(p.size(2) == 3);
+    CHECK(&p(3, 1, 2) == &v(1, 2, 3));
+    CHECK(!p.is_contiguous());
+
+    const auto s = v.slice(2, 1, 4, 2);
+    CHECK(s.size(2) == 2);
+    CHECK(&s(1, 2, 1) == &v(1, 2, 3));
+
+    const auto row = v.select(0, 1);
+    CHECK(row.dims() == 2);
+    CHECK(&row(2, 3) == &v(1, 2, 3));
+    CHECK(row.is_contiguous());
+
+    const auto b = v.slice(1, 2, 3).broadcast_to({5, 2, 3, 4});
+    CHECK(b.dims() == 4);
+    CHECK(b.stride(0) == 0);
+    CHECK(b.stride(2) == 0);
+    CHECK(&b(4, 1, 0, 3) == &v(1, 2, 3));
+
+    // size-1 dimensions do not break contiguity
+    CHECK(v.slice(0, 1, 2).is_contiguous());
+    CHECK(v.reshape({6, 4}).size(0) == 6);
+}
+
+TEST_CASE("as_tensor_view keeps the steps of a ROI and puts the channels innermost")
+{
+    cv::Mat m(std::vector<int>{4, 6}, CV_32FC3);
+    for (size_t i = 0; i < m.total() * 3; ++i)
+        m.ptr<float>()[i] = float(i);
+
+    const cv::Mat roi = m(std::vector<cv::Range>{cv::Range(1, 3), cv::Range(2, 5)});
+    const auto    v   = as_tensor_view<const float>(roi);
+    REQUIRE(v.dims() == 3);
+    CHECK(v.size(0) == 2);
+    CHECK(v.size(1) == 3);
+    CHECK(v.size(2) == 3);
+    CHECK(v.stride(0) == 18);
+    CHECK(v.stride(2) == 1);
+    CHECK(v(1, 2, 1) == float((2 * 6 + 4) * 3 + 1));
+
+    // the channels can be moved to the front (HWC -> CHW) and materialized in one go
+    const cv::Mat planar = v.permute({2, 0, 1}).to_mat();
+    REQUIRE(planar.dims == 3);
+    CHECK(planar.ptr<float>()[1 * 6 + 1 * 3 + 2] == v(1, 2, 1));
+
+    CHECK(as_tensor_view<const int32_t>(roi).empty());
+    CHECK(as_tensor_view<const float>(cv::Mat()).empty());
+
+    // a step that splits an element has no stride in elements
+    cv::Mat odd(std::vector<int>{2, 3}, CV_32F);
+    odd.step.p[0] = 13;
+    CHECK(as_tensor_view<const float>(odd).empty());
+}
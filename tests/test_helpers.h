@@ -0,0 +1,181 @@
+#pragma once
+
+#ifdef EZTRT_WITH_TENSORRT
+#include <eztrt/common.h>
+
+#include <NvInfer.h>
+#include <cuda_runtime_api.h>
+#endif
+
+#include <opencv2/core.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Helpers shared by the test executables. `eztrt_add_test` (CMakeLists.txt) defines
+// EZTRT_TEST_DATA_DIR and EZTRT_TEST_NAME for every test.
+
+namespace eztrt::testing
+{
+
+/// The sample models and images of the repository
+inline const std::string kDataDir = EZTRT_TEST_DATA_DIR;
+
+/// `name` in the temporary directory, prefixed with the test name so that tests can run in parallel
+inline std::string temp_path(const std::string& name)
+{
+    const std::string file = "eztrt_" EZTRT_TEST_NAME "_" + name;
+    return (std::filesystem::temp_directory_path() / file).string();
+}
+
+/// A file in the temporary directory that is deleted again when the test ends
+struct temp_file
+{
+    explicit temp_file(const std::string& name, const std::string& content = {})
+        : path{temp_path(name)}
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+    ~temp_file()
+    {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+    temp_file(const temp_file&) = delete;
+    temp_file& operator=(const temp_file&) = delete;
+
+    std::string path;
+};
+
+/// An empty directory in the temporary directory that is deleted again when the test ends
+struct temp_dir
+{
+    explicit temp_dir(const std::string& name) : path{temp_path(name)}
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    ~temp_dir()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    temp_dir(const temp_dir&) = delete;
+    temp_dir& operator=(const temp_dir&) = delete;
+
+    std::string path;
+};
+
+/// The content of `path`, empty if it cannot be read
+inline std::string read_file(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+/// True if `a` and `b` are non-empty model outputs of the same type and size that agree to 1e-5
+inline bool equal_outputs(const cv::Mat& a, const cv::Mat& b)
+{
+    if (a.empty() || b.empty() || a.total() != b.total() || a.type() != b.type()) return false;
+    return cv::norm(a.reshape(1, 1), b.reshape(1, 1), cv::NORM_INF) <= 1e-5;
+}
+
+#ifdef EZTRT_WITH_TENSORRT
+/// Tests that need a GPU skip themselves without one
+inline bool has_cuda_device()
+{
+    int count = 0;
+    return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+}
+
+#if NV_TENSORRT_MAJOR < 8
+// From TensorRT 8 on, ICudaEngine forwards to an internal implementation and cannot be mocked
+
+/// One binding of a `mock_engine`
+struct mock_binding
+{
+    std::string        name;
+    nvinfer1::Dims     dims;
+    nvinfer1::DataType type;
+    bool               input;
+};
+
+/// An engine that only knows its bindings, which is all BindingHandle and BufferManager ask for
+class mock_engine : public nvinfer1::ICudaEngine
+{
+public:
+    explicit mock_engine(std::vector<mock_binding> bindings) : bindings_{std::move(bindings)} {}
+    ~mock_engine() override = default;
+
+    int getNbBindings() const override { return int(bindings_.size()); }
+    int getBindingIndex(const char* name) const override
+    {
+        for (size_t i = 0; i < bindings_.size(); ++i)
+            if (bindings_[i].name == name) return int(i);
+        return -1;
+    }
+    const char*        getBindingName(int i) const override { return bindings_[i].name.c_str(); }
+    bool               bindingIsInput(int i) const override { return bindings_[i].input; }
+    nvinfer1::Dims     getBindingDimensions(int i) const override { return bindings_[i].dims; }
+    nvinfer1::DataType getBindingDataType(int i) const override { return bindings_[i].type; }
+    int                getBindingVectorizedDim(int) const override { return -1; }
+    int                getBindingComponentsPerElement(int) const override { return 1; }
+    int                getBindingBytesPerComponent(int i) const override
+    {
+        return int(samplesCommon::getElementSize(bindings_[i].type));
+    }
+    bool hasImplicitBatchDimension() const override { return false; }
+    int  getMaxBatchSize() const override { return 1; }
+
+    // not used by the buffers
+    int                          getNbLayers() const override { return 0; }
+    size_t                       getWorkspaceSize() const override { return 0; }
+    nvinfer1::IHostMemory*       serialize() const override { return nullptr; }
+    nvinfer1::IExecutionContext* createExecutionContext() override { return nullptr; }
+    void                         destroy() override {}
+    nvinfer1::TensorLocation     getLocation(int) const override
+    {
+        return nvinfer1::TensorLocation::kDEVICE;
+    }
+    nvinfer1::IExecutionContext* createExecutionContextWithoutDeviceMemory() override
+    {
+        return nullptr;
+    }
+    size_t                 getDeviceMemorySize() const override { return 0; }
+    bool                   isRefittable() const override { return false; }
+    nvinfer1::TensorFormat getBindingFormat(int) const override
+    {
+        return nvinfer1::TensorFormat::kLINEAR;
+    }
+    const char*    getBindingFormatDesc(int) const override { return "linear"; }
+    const char*    getName() const override { return "mock_engine"; }
+    int            getNbOptimizationProfiles() const override { return 1; }
+    nvinfer1::Dims getProfileDimensions(int i, int, nvinfer1::OptProfileSelector) const override
+    {
+        return bindings_[i].dims;
+    }
+    const int32_t* getProfileShapeValues(int, int, nvinfer1::OptProfileSelector) const override
+    {
+        return nullptr;
+    }
+    bool                       isShapeBinding(int) const override { return false; }
+    bool                       isExecutionBinding(int) const override { return true; }
+    nvinfer1::EngineCapability getEngineCapability() const override
+    {
+        return nvinfer1::EngineCapability::kDEFAULT;
+    }
+    void                       setErrorRecorder(nvinfer1::IErrorRecorder*) override {}
+    nvinfer1::IErrorRecorder*  getErrorRecorder() const override { return nullptr; }
+
+private:
+    std::vector<mock_binding> bindings_;
+};
+#endif
+#endif
+
+} // namespace eztrt::testing
@@ -0,0 +1,534 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include <eztrt/kernels.h>
+#include <eztrt/util.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace eztrt;
+using namespace eztrt::testing;
+
+namespace
+{
+
+/// Uniformly distributed CV_32F logits in [center - spread, center + spread]
+cv::Mat random_logits(const std::vector<int>& shape, float center, float spread, uint64_t seed)
+{
+    cv::Mat m(int(shape.size()), shape.data(), CV_32F);
+    cv::RNG rng(seed);
+    rng.fill(m, cv::RNG::UNIFORM, cv::Scalar(center - spread), cv::Scalar(center + spread));
+    return m;
+}
+
+/// (log-)softmax along `dim` of a continuous CV_32F tensor, computed in double precision
+std::vector<double> reference_softmax(const cv::Mat& in, int dim, double temperature, bool log)
+{
+    if (dim < 0) dim += in.dims;
+    int outer = 1, inner = 1;
+    for (int d = 0; d < dim; ++d)
+        outer *= in.size[d];
+    for (int d = dim + 1; d < in.dims; ++d)
+        inner *= in.size[d];
+    const int len = in.size[dim];
+
+    const float*        x = in.ptr<float>();
+    std::vector<double> res(in.total());
+    for (int o = 0; o < outer; ++o)
+        for (int i = 0; i < inner; ++i)
+        {
+            const auto at = [&](int c) { return (size_t(o) * len + c) * inner + i; };
+            double     m  = -std::numeric_limits<double>::infinity();
+            for (int c = 0; c < len; ++c)
+                m = std::max(m, double(x[at(c)]));
+            double sum = 0.;
+            for (int c = 0; c < len; ++c)
+                sum += std::exp((x[at(c)] - m) / temperature);
+            for (int c = 0; c < len; ++c)
+            {
+                const double z = (x[at(c)] - m) / temperature;
+                res[at(c)]     = log ? z - std::log(sum) : std::exp(z) / sum;
+            }
+        }
+    return res;
+}
+
+/// Checks a softmax result against the reference, relative to the probability or log-probability
+void check_softmax(const cv::Mat& in, int dim, float temperature, bool log)
+{
+    const cv::Mat res = log ? log_softmax(in, dim, temperature) : softmax(in, dim, temperature);
+    REQUIRE(res.type() == CV_32F);
+    REQUIRE(res.isContinuous());
+    REQUIRE(res.dims == in.dims);
+    for (int d = 0; d < in.dims; ++d)
+        REQUIRE(res.size[d] == in.size[d]);
+
+    const auto   expected = reference_softmax(in, dim, temperature, log);
+    const float* actual   = res.ptr<float>();
+    size_t       wrong    = 0;
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        const double e   = expected[i];
+        const double tol = log ? 1e-5 * (1. + std::abs(e)) : 1e-5 * e + 1e-7;
+        // written to count NaNs as wrong
+        if (!(std::abs(actual[i] - e) <= tol)) ++wrong;
+    }
+    CHECK(wrong == 0);
+}
+
+/// Per-pixel argmax over the channels of a continuous CV_32F [(1,) C, H, W] tensor, the first
+/// maximum wins and NaNs are skipped
+std::vector<int> reference_argmax(const cv::Mat& logits)
+{
+    const int    d      = logits.dims;
+    const int    C      = logits.size[d - 3];
+    const size_t pixels = size_t(logits.size[d - 2]) * logits.size[d - 1];
+    const float* x      = logits.ptr<float>();
+
+    std::vector<int> res(pixels, 0);
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        float best = -std::numeric_limits<float>::infinity();
+        for (int c = 0; c < C; ++c)
+            if (x[c * pixels + i] > best)
+            {
+                best   = x[c * pixels + i];
+                res[i] = c;
+            }
+    }
+    return res;
+}
+
+cv::Mat zeros(const std::vector<int>& shape, int type = CV_32F)
+{
+    return cv::Mat(shape, type, cv::Scalar::all(0));
+}
+
+/// The labels of `argmax_channels` as ints
+std::vector<int> labels_of(const cv::Mat& labels)
+{
+    cv::Mat ints;
+    labels.convertTo(ints, CV_32S);
+    return {ints.begin<int>(), ints.end<int>()};
+}
+
+/// A tensor of random bytes, optionally a ROI inside a larger tensor so that it is not continuous
+cv::Mat random_tensor(const std::vector<int>& shape, int type, bool roi, cv::RNG& rng)
+{
+    std::vector<int>       outer = shape;
+    std::vector<cv::Range> ranges;
+    for (size_t d = 0; d < shape.size() && roi; ++d)
+    {
+        const int begin = rng.uniform(0, 3);
+        outer[d]        = shape[d] + begin + rng.uniform(0, 3);
+        ranges.emplace_back(begin, begin + shape[d]);
+    }
+    cv::Mat m(outer, type);
+    rng.fill(m, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+    return roi ? m(ranges) : m;
+}
+
+/// A random permutation of `n` dimensions
+std::vector<int> random_order(int n, cv::RNG& rng)
+{
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    for (int i = n - 1; i > 0; --i)
+        std::swap(order[i], order[rng.uniform(0, i + 1)]);
+    return order;
+}
+
+/// Number of elements of the continuous `permuted` that differ from `m` permuted to `order`,
+/// compared bytewise by reading `m` through its steps
+size_t permutation_errors(const cv::Mat& m, const std::vector<int>& order, const cv::Mat& permuted)
+{
+    const size_t     esz = m.elemSize();
+    const uchar*     out = permuted.ptr();
+    std::vector<int> idx(m.dims, 0);
+    size_t           wrong = 0;
+    for (size_t i = 0; i < permuted.total(); ++i, out += esz)
+    {
+        const uchar* in = m.data;
+        for (int d = 0; d < m.dims; ++d)
+            in += size_t(idx[d]) * m.step[order[d]];
+        if (std::memcmp(in, out, esz) != 0) ++wrong;
+        // the next output index, the last dimension is the fastest
+        for (int d = m.dims - 1; d >= 0 && ++idx[d] == permuted.size[d]; --d)
+            idx[d] = 0;
+    }
+    return wrong;
+}
+
+} // namespace
+
+TEST_CASE("class labels are indexed by class")
+{
+    temp_file file("labels.json", R"({"2": "two", "0": "zero"})");
+    const auto labels = load_class_labels(file.path);
+    CHECK(labels == std::vector<std::string>{"zero", "", "two"});
+}
+
+TEST_CASE("unreadable class label files give no labels")
+{
+    CHECK(load_class_labels(temp_path("missing"))
+              .empty());
+
+    temp_file malformed("malformed.json", R"({"0": "zero",)");
+    CHECK(load_class_labels(malformed.path).empty());
+
+    temp_file array("array.json", R"(["zero", "one"])");
+    CHECK(load_class_labels(array.path).empty());
+}
+
+TEST_CASE("invalid class label entries are skipped")
+{
+    temp_file file("invalid.json", R"({
+        "0": "zero",
+        "1": 1,
+        "-1": "negative",
+        "1x": "suffix",
+        "": "empty",
+        "18446744073709551616": "overflow",
+        "100000000": "sparse"
+    })");
+    const auto labels = load_class_labels(file.path);
+    CHECK(labels == std::vector<std::string>{"zero"});
+}
+
+TEST_CASE("top_k returns the best scores in order")
+{
+    cv::Mat scores = (cv::Mat_<float>(1, 6) << 0.1f, 0.4f, 0.05f, 0.4f, 0.3f, 0.15f);
+
+    const auto best = top_k(scores, 3, -std::numeric_limits<float>::infinity(), {"a", "b"});
+    REQUIRE(best.size() == 3);
+    // ties are ordered by index
+    CHECK(best[0].index == 1);
+    CHECK(best[0].label == "b");
+    CHECK(best[1].index == 3);
+    CHECK(best[1].label.empty());
+    CHECK(best[2].index == 4);
+    CHECK(best[2].score == 0.3f);
+
+    CHECK(top_k(scores, 10, 0.35f).size() == 2);
+    CHECK(top_k(scores, 0).empty());
+}
+
+TEST_CASE("softmax matches a double precision reference")
+{
+    struct
+    {
+        std::vector<int> shape;
+        int              dim;
+    } cases[] = {
+        // rows, e.g. classifier outputs
+        {{4, 10}, 1},
+        {{4, 10}, -1},
+        {{4, 10}, 0},
+        {{1, 1}, 1},
+        {{2000, 20}, 1}, // large enough to run in parallel
+        {{3, 7, 1}, 1},
+        // planes, e.g. segmentation outputs
+        {{2, 5, 3, 7}, 1},
+        {{2, 5, 3, 7}, -3},
+        {{2, 5, 3, 7}, 0},
+        {{2, 5, 3, 7}, 3},
+        {{1, 21, 40, 40}, 1}, // more than one block per plane, in parallel
+    };
+    for (const auto& c : cases)
+        for (const float center : {0.f, 500.f, -500.f})
+            for (const bool log : {false, true})
+            {
+                CAPTURE(c.shape.size());
+                CAPTURE(c.shape[1]);
+                CAPTURE(c.dim);
+                CAPTURE(center);
+                CAPTURE(log);
+                check_softmax(random_logits(c.shape, center, 20.f, 42), c.dim, 1.f, log);
+            }
+}
+
+TEST_CASE("softmax divides the logits by the temperature")
+{
+    const cv::Mat rows   = random_logits({8, 30}, 0.f, 10.f, 7);
+    const cv::Mat planes = random_logits({1, 6, 9, 11}, 0.f, 10.f, 7);
+    for (const float temperature : {0.1f, 0.5f, 2.f, 10.f})
+        for (const bool log : {false, true})
+        {
+            CAPTURE(temperature);
+            CAPTURE(log);
+            check_softmax(rows, -1, temperature, log);
+            check_softmax(planes, 1, temperature, log);
+        }
+
+    // a higher temperature flattens the distribution
+    const cv::Mat logits = (cv::Mat_<float>(1, 3) << 1.f, 2.f, 3.f);
+    double        cold_max = 0, hot_max = 0;
+    cv::minMaxLoc(softmax(logits, 1, 0.5f), nullptr, &cold_max);
+    cv::minMaxLoc(softmax(logits, 1, 5.f), nullptr, &hot_max);
+    CHECK(cold_max > hot_max);
+    CHECK(hot_max > 1. / 3);
+}
+
+TEST_CASE("softmax of extreme logits stays finite")
+{
+    const cv::Mat logits = (cv::Mat_<float>(2, 3) << 500.f, -500.f, 499.f, -500.f, -500.f, -500.f);
+
+    const cv::Mat p = softmax(logits);
+    CHECK(p.at<float>(0, 0) == doctest::Approx(1. / (1. + std::exp(-1.))));
+    CHECK(p.at<float>(0, 1) == 0.f);
+    CHECK(p.at<float>(1, 2) == doctest::Approx(1. / 3));
+
+    // log_softmax does not go through the (underflowing) probabilities
+    const cv::Mat lp = log_softmax(logits);
+    CHECK(lp.at<float>(0, 1) == doctest::Approx(-1000. - std::log1p(std::exp(-1.))));
+    CHECK(lp.at<float>(1, 0) == doctest::Approx(-std::log(3.)));
+    CHECK(cv::checkRange(lp));
+}
+
+TEST_CASE("softmax converts non-float and non-continuous inputs")
+{
+    const cv::Mat bytes = (cv::Mat_<uchar>(2, 3) << 0, 1, 2, 10, 10, 10);
+    cv::Mat       floats;
+    bytes.convertTo(floats, CV_32F);
+    const cv::Mat converted = softmax(bytes);
+    REQUIRE(converted.type() == CV_32F);
+    CHECK(cv::norm(converted, softmax(floats), cv::NORM_INF) == 0.);
+
+    const cv::Mat wide = random_logits({6, 40}, 0.f, 5.f, 3);
+    const cv::Mat roi  = wide(cv::Rect(3, 1, 20, 4));
+    REQUIRE(!roi.isContinuous());
+    CHECK(cv::norm(softmax(roi), softmax(roi.clone()), cv::NORM_INF) == 0.);
+}
+
+TEST_CASE("softmax rejects invalid arguments with an empty matrix")
+{
+    const cv::Mat logits = random_logits({2, 5}, 0.f, 1.f, 1);
+    for (const bool log : {false, true})
+    {
+        CAPTURE(log);
+        const auto run = [log](const cv::Mat& in, int dim, float temperature) {
+            return log ? log_softmax(in, dim, temperature) : softmax(in, dim, temperature);
+        };
+        CHECK(run(logits, 2, 1.f).empty());
+        CHECK(run(logits, -3, 1.f).empty());
+        CHECK(run(cv::Mat(2, 5, CV_32FC3, cv::Scalar::all(0)), 1, 1.f).empty());
+        CHECK(run(logits, 1, 0.f).empty());
+        CHECK(run(logits, 1, -1.f).empty());
+        CHECK(run(logits, 1, std::numeric_limits<float>::quiet_NaN()).empty());
+        CHECK(run(cv::Mat{}, 1, 1.f).empty());
+    }
+}
+
+TEST_CASE("argmax_channels matches a reference argmax")
+{
+    const std::vector<int> shapes[] = {
+        {1, 1, 5, 7},
+        {1, 3, 5, 7},
+        {3, 5, 7},
+        {1, 21, 1, 37},  // SIMD body and tail in one row
+        {1, 21, 40, 40}, // more than one block, in parallel
+        {1, 256, 3, 9},
+        {1, 257, 3, 9},
+        {300, 4, 4},
+    };
+    for (const auto& shape : shapes)
+    {
+        const int C = shape[shape.size() - 3];
+        CAPTURE(C);
+        CAPTURE(shape.size());
+        const cv::Mat logits = random_logits(shape, 0.f, 10.f, 5);
+
+        cv::Mat       confidence;
+        const cv::Mat labels = argmax_channels(logits, &confidence);
+        REQUIRE(labels.type() == (C <= 256 ? CV_8U : CV_16U));
+        CHECK(labels.rows == shape[shape.size() - 2]);
+        CHECK(labels.cols == shape[shape.size() - 1]);
+        CHECK(labels_of(labels) == reference_argmax(logits));
+        CHECK(labels_of(argmax_channels(logits)) == labels_of(labels));
+
+        // the confidence is the maximum of the softmax over the channels
+        REQUIRE(confidence.type() == CV_32F);
+        REQUIRE(confidence.size() == labels.size());
+        const cv::Mat probabilities = softmax(logits, -3);
+        const size_t  pixels        = labels.total();
+        const float*  p             = probabilities.ptr<float>();
+        size_t        wrong         = 0;
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            float best = 0.f;
+            for (int c = 0; c < C; ++c)
+                best = std::max(best, p[c * pixels + i]);
+            if (!(std::abs(confidence.ptr<float>()[i] - best) <= 1e-5f * best)) ++wrong;
+        }
+        CHECK(wrong == 0);
+    }
+}
+
+TEST_CASE("argmax_channels resolves ties to the lowest channel")
+{
+    // [1, 4, 1, 4], one column per pixel
+    const float   inf     = std::numeric_limits<float>::infinity();
+    const int     shape[] = {1, 4, 1, 4};
+    const float   data[]  = {
+        1.f, 0.f, 0.f, -inf, //
+        1.f, 2.f, 0.f, -inf, //
+        1.f, 0.f, 3.f, -inf, //
+        1.f, 2.f, 3.f, -inf, //
+    };
+    const cv::Mat logits(4, shape, CV_32F, const_cast<float*>(data));
+
+    cv::Mat confidence;
+    // nothing beats -inf either, so the last pixel falls back to channel 0
+    CHECK(labels_of(argmax_channels(logits, &confidence)) == std::vector<int>{0, 1, 2, 0});
+    CHECK(confidence.at<float>(0, 0) == doctest::Approx(0.25));
+    CHECK(confidence.at<float>(0, 2) == doctest::Approx(0.5 / (1. + std::exp(-3.))));
+
+    // integer outputs tie all the time
+    const int     small[] = {1, 3, 1, 2};
+    const uchar   bytes[] = {7, 7, 7, 9, 7, 9};
+    const cv::Mat quantized(4, small, CV_8U, const_cast<uchar*>(bytes));
+    CHECK(labels_of(argmax_channels(quantized)) == std::vector<int>{0, 1});
+}
+
+TEST_CASE("NaNs never win argmax_channels")
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    SUBCASE("single pixels")
+    {
+        const int     shape[] = {1, 3, 1, 3};
+        const float   data[]  = {
+            nan, 0.f, nan, //
+            1.f, nan, nan, //
+            0.f, 2.f, nan, //
+        };
+        const cv::Mat logits(4, shape, CV_32F, const_cast<float*>(data));
+        // an all-NaN pixel falls back to channel 0
+        CHECK(labels_of(argmax_channels(logits)) == std::vector<int>{1, 2, 0});
+    }
+
+    SUBCASE("scattered through a tensor")
+    {
+        cv::Mat logits = random_logits({1, 7, 3, 37}, 0.f, 1.f, 9);
+        cv::RNG rng(11);
+        for (int i = 0; i < 200; ++i)
+            logits.ptr<float>()[rng.uniform(0, int(logits.total()))] = nan;
+        CHECK(labels_of(argmax_channels(logits)) == reference_argmax(logits));
+    }
+}
+
+TEST_CASE("argmax_channels switches to 16 bit labels above 256 channels")
+{
+    for (const int C : {255, 256, 257, 1000, 65536})
+    {
+        CAPTURE(C);
+        cv::Mat logits = zeros({1, C, 1, 2});
+        // the last channel wins in the second pixel
+        logits.ptr<float>()[size_t(C - 1) * 2 + 1] = 1.f;
+
+        const cv::Mat labels = argmax_channels(logits);
+        REQUIRE(labels.type() == (C <= 256 ? CV_8U : CV_16U));
+        CHECK(labels_of(labels) == std::vector<int>{0, C - 1});
+    }
+    CHECK(argmax_channels(zeros({1, 65537, 1, 1})).empty());
+}
+
+TEST_CASE("argmax_channels rejects other shapes with an empty matrix")
+{
+    CHECK(argmax_channels(zeros({4, 4})).empty());
+    CHECK(argmax_channels(zeros({2, 3, 4, 4})).empty());
+    CHECK(argmax_channels(zeros({1, 3, 4, 4, 1})).empty());
+    CHECK(argmax_channels(zeros({3, 4, 4}, CV_32FC2)).empty());
+}
+
+TEST_CASE("permute_dims matches a reference permutation")
+{
+    // element sizes 1, 2, 3, 4, 6, 8, 12 and 16
+    const int types[] = {CV_8UC1,  CV_16UC1, CV_8UC3,  CV_32FC1,
+                         CV_16UC3, CV_64FC1, CV_32FC3, CV_64FC2};
+    const kernels::isa previous = kernels::active().level;
+
+    for (int level = 0; level <= int(kernels::isa::avx512); ++level)
+    {
+        if (!kernels::select_isa(kernels::isa(level))) continue;
+        CAPTURE(level);
+        cv::RNG rng(level + 1);
+        for (int round = 0; round < 700; ++round)
+        {
+            CAPTURE(round);
+            const int        dims = rng.uniform(2, 6);
+            std::vector<int> shape(dims);
+            for (int d = 0; d < dims; ++d)
+                shape[d] = rng.uniform(1, d == dims - 1 ? 40 : 8);
+            const std::vector<int> order = random_order(dims, rng);
+            const int              type  = types[rng.uniform(0, int(std::size(types)))];
+            CAPTURE(type);
+
+            // a new matrix, an explicit destination or in place
+            const int     mode = round % 3;
+            const cv::Mat m    = random_tensor(shape, type, mode != 2 && rng.uniform(0, 2) == 1, rng);
+            cv::Mat       res;
+            CAPTURE(mode);
+            if (mode == 0)
+                res = permute_dims(m, order);
+            else if (mode == 1)
+            {
+                cv::Mat dst(1, int(m.total()), type);
+                res = permute_dims(m, order, dst);
+                CHECK(res.data == dst.data);
+            }
+            else
+            {
+                cv::Mat copy = m.clone();
+                res          = permute_dims_in_place(copy, order);
+                CHECK(res.data == copy.data);
+            }
+
+            REQUIRE(res.type() == type);
+            REQUIRE(res.isContinuous());
+            REQUIRE(res.dims == dims);
+            for (int d = 0; d < dims; ++d)
+                REQUIRE(res.size[d] == shape[order[d]]);
+            CHECK(permutation_errors(m, order, res) == 0);
+        }
+    }
+    kernels::select_isa(previous);
+}
+
+TEST_CASE("permute_dims rejects invalid orders and destinations with an empty matrix")
+{
+    const std::vector<int> order{2, 0, 1};
+    cv::Mat                buffer(1, 48, CV_32F, cv::Scalar::all(1));
+    const cv::Mat          m(std::vector<int>{2, 3, 4}, CV_32F, buffer.ptr());
+
+    CHECK(permute_dims(m, {0, 1}).empty());
+    CHECK(permute_dims(m, {0, 0, 1}).empty());
+    CHECK(permute_dims(m, {0, 1, 3}).empty());
+    CHECK(permute_dims_in_place(m.clone(), {1, 1, 0}).empty());
+
+    // any continuous destination with the right number of elements works, right behind the input
+    CHECK(!permute_dims(m, order, buffer.colRange(24, 48)).empty());
+    CHECK(!permute_dims(m, order, cv::Mat(4, 6, CV_32F)).empty());
+
+    CHECK(permute_dims(m, order, cv::Mat(1, 24, CV_32S)).empty());
+    CHECK(permute_dims(m, order, cv::Mat(1, 23, CV_32F)).empty());
+    CHECK(permute_dims(m, order, cv::Mat(1, 12, CV_32FC2)).empty());
+    CHECK(permute_dims(m, order, cv::Mat(4, 12, CV_32F)(cv::Rect(0, 0, 6, 4))).empty());
+    // permuting into the input itself or a part of it would read overwritten elements
+    CHECK(permute_dims(m, order, m).empty());
+    CHECK(permute_dims(m, order, buffer.colRange(23, 47)).empty());
+    CHECK(permute_dims(m, order, buffer.colRange(20, 44)).empty());
+
+    // only continuous matrices can be permuted in place
+    const cv::Mat roi = cv::Mat(std::vector<int>{2, 3, 8}, CV_32F)(
+        std::vector<cv::Range>{cv::Range::all(), cv::Range::all(), cv::Range(0, 4)});
+    CHECK(permute_dims_in_place(roi, order).empty());
+    CHECK(!permute_dims(roi, order).empty());
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "frame_pipeline.h"
+#include "latency_histogram.h"
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Loads all frames of an image, a video or a directory of images (in file name order) into memory,
+ * so that `--bench` can replay them without measuring the decoder.
+ */
+std::vector<cv::Mat> load_frames(const std::string& path);
+
+/**
+ * Collects the stage and end-to-end latencies of the frames delivered by a `frame_pipeline` into
+ * histograms and reports their percentiles.
+ */
+class bench_recorder
+{
+public:
+    /// Records a frame, called by the sink
+    void record(const frame& f);
+
+    uint64_t frames() const { return end_to_end_.count(); }
+
+    /// Frames per second between the start of the first and the delivery of the last frame
+    double throughput() const;
+
+    /// Logs a table of the percentiles of all stages
+    void log() const;
+
+    /// The full report as JSON, `meta` is added as-is (model, input, ...)
+    std::string json(const std::vector<std::pair<std::string, std::string>>& meta) const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::array<latency_histogram, kStageCount> stages_;
+    latency_histogram                          end_to_end_;
+    clock::time_point                          first_start_{clock::time_point::max()};
+    clock::time_point                          last_end_{};
+};
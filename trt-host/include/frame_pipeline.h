@@ -0,0 +1,83 @@
+#pragma once
+
+#include "eztrt/util.h"
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// Stages of the `frame_pipeline` (before the sink), in processing order
+constexpr int         kStageCount              = 4;
+constexpr const char* kStageNames[kStageCount] = {"capture", "preprocess", "infer", "postprocess"};
+
+/**
+ * One frame on its way through the `frame_pipeline`, every stage fills in its part.
+ */
+struct frame
+{
+    uint64_t                              index{0};   //!< Position in the input, drops leave gaps
+    cv::Mat                               image;      //!< Captured image
+    cv::Mat                               input;      //!< Preprocessed network input
+    cv::Mat                               output;     //!< Raw network output
+    cv::Mat                               labels;     //!< Segmentation: label map
+    cv::Mat                               confidence; //!< Segmentation: confidence of the labels
+    std::vector<eztrt::class_score>       classes;    //!< Classification: best classes
+    std::chrono::steady_clock::time_point start;      //!< Time the capture of the frame started
+    std::array<float, kStageCount>        stage_us{}; //!< Time spent in each stage
+};
+
+/**
+ * Runs capture, preprocessing, inference and postprocessing on one thread each, connected by
+ * bounded SPSC queues, so the throughput is limited by the slowest stage instead of the sum of
+ * all stages. The frames are delivered to the sink on the calling thread (which GUI calls need)
+ * in capture order.
+ *
+ * For live sources, `drop_when_full` drops captured frames while the pipeline is full instead of
+ * letting the capture fall behind the camera. The time spent in every stage is recorded in
+ * `frame::stage_us`.
+ */
+class frame_pipeline
+{
+public:
+    using stage = std::function<bool(frame&)>;
+
+    struct stages
+    {
+        stage capture;     //!< Fills `image`, returns false at the end of the input
+        stage preprocess;  //!< Returns false to discard the frame
+        stage infer;       //!< Returns false to discard the frame
+        stage postprocess; //!< Returns false to discard the frame
+        stage sink;        //!< Returns false to stop the pipeline
+    };
+
+    struct options
+    {
+        size_t queue_depth{4};        //!< Capacity of each queue between two stages
+        bool   drop_when_full{false}; //!< Drop new frames instead of waiting for a free slot
+    };
+
+    struct stats
+    {
+        uint64_t captured{0};  //!< Frames read from the input
+        uint64_t dropped{0};   //!< Frames dropped because the pipeline was full
+        uint64_t discarded{0}; //!< Frames rejected by a stage
+        uint64_t delivered{0}; //!< Frames that reached the sink
+        double   seconds{0.0}; //!< Wall time of `run()`
+    };
+
+    frame_pipeline(stages s, options o);
+
+    /**
+     * Processes the input until `capture` reports its end or `sink` asks to stop, then waits for
+     * all stage threads to finish.
+     */
+    stats run();
+
+private:
+    stages  stages_;
+    options options_;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * Log-linear ("HDR") histogram of latencies: every power of two is split into 64 linear buckets, so
+ * no bucket is wider than 1/64 of its lower bound at any magnitude, with a fixed amount of memory
+ * and O(1) recording. Values are passed in microseconds and bucketed in whole nanoseconds.
+ * Percentiles report the middle of a bucket and are therefore within 1/128 (0.8%) of the exact
+ * value, plus at most 1 ns.
+ */
+class latency_histogram
+{
+public:
+    static constexpr int kSubBucketBits = 6;
+    static constexpr int kSubBuckets    = 1 << kSubBucketBits;
+    static constexpr int kMaxExponent   = 50; //!< Larger values (> 13 days) are clamped
+
+    latency_histogram() : counts_((kMaxExponent - kSubBucketBits + 2) * kSubBuckets, 0) {}
+
+    void record(double us)
+    {
+        const double   ns = std::min(us * 1000., double(1ull << kMaxExponent) - 1.);
+        const uint64_t v  = ns <= 0. ? 0 : uint64_t(ns);
+        ++counts_[bucket(v)];
+        ++count_;
+        sum_ += us;
+        min_ = std::min(min_, us);
+        max_ = std::max(max_, us);
+    }
+
+    uint64_t count() const { return count_; }
+    double   min() const { return count_ ? min_ : 0.; }
+    double   max() const { return count_ ? max_ : 0.; }
+    double   mean() const { return count_ ? sum_ / count_ : 0.; }
+
+    /**
+     * The value below which `p` percent of the recorded values lie, i.e. the middle of the bucket
+     * that holds the value of that rank, clamped to the exact minimum and maximum.
+     */
+    double percentile(double p) const
+    {
+        if (!count_) return 0.;
+        if (p >= 100.) return max_;
+        const double rank   = std::max(1., std::min(p / 100., 1.) * count_);
+        uint64_t     seen   = 0;
+        size_t       bucket = 0;
+        for (; bucket + 1 < counts_.size(); ++bucket)
+        {
+            seen += counts_[bucket];
+            if (seen >= rank) break;
+        }
+        const uint64_t width = bucket < 2 * kSubBuckets ? 1 : 1ull << (bucket / kSubBuckets - 1);
+        const double   mid   = (double(lower_bound(bucket)) + 0.5 * double(width - 1)) / 1000.;
+        return std::max(min_, std::min(max_, mid));
+    }
+
+private:
+    static size_t bucket(uint64_t v)
+    {
+        if (v < kSubBuckets) return size_t(v);
+        int msb = 0;
+        while (v >> (msb + 1))
+            ++msb;
+        const int shift = msb - kSubBucketBits;
+        return size_t(shift + 1) * kSubBuckets + ((v >> shift) & (kSubBuckets - 1));
+    }
+
+    static uint64_t lower_bound(size_t bucket)
+    {
+        const size_t exponent = bucket / kSubBuckets, sub = bucket % kSubBuckets;
+        return exponent == 0 ? sub : uint64_t(kSubBuckets + sub) << (exponent - 1);
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t              count_{0};
+    double                sum_{0.};
+    double                min_{std::numeric_limits<double>::max()};
+    double                max_{0.};
+};
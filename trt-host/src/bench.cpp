@@ -0,0 +1,104 @@
+#include "bench.h"
+
+#include "json.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace
+{
+
+/// Percentiles in the report
+constexpr double kPercentiles[] = {50., 90., 99., 99.9};
+
+nlohmann::json to_json(const latency_histogram& h)
+{
+    nlohmann::json j;
+    j["count"]   = h.count();
+    j["mean_us"] = h.mean();
+    j["min_us"]  = h.min();
+    j["max_us"]  = h.max();
+    for (double p : kPercentiles)
+        j[fmt::format("p{}_us", p)] = h.percentile(p);
+    return j;
+}
+
+} // namespace
+
+std::vector<cv::Mat> load_frames(const std::string& path)
+{
+    namespace fs = std::filesystem;
+
+    std::vector<cv::Mat> frames;
+    std::error_code      ec;
+    if (fs::is_directory(path, ec))
+    {
+        std::vector<fs::path> files;
+        for (const auto& entry : fs::directory_iterator(path, ec))
+            if (entry.is_regular_file()) files.push_back(entry.path());
+        std::sort(files.begin(), files.end());
+        for (const auto& file : files)
+        {
+            cv::Mat img = cv::imread(file.string());
+            if (!img.empty()) frames.push_back(img);
+        }
+    }
+    else
+    {
+        cv::VideoCapture src(path);
+        cv::Mat          img;
+        while (src.read(img))
+            frames.push_back(img.clone());
+    }
+    return frames;
+}
+
+void bench_recorder::record(const frame& f)
+{
+    const auto now = clock::now();
+    for (int s = 0; s < kStageCount; ++s)
+        stages_[s].record(f.stage_us[s]);
+    end_to_end_.record(std::chrono::duration<double, std::micro>(now - f.start).count());
+    first_start_ = std::min(first_start_, f.start);
+    last_end_    = now;
+}
+
+double bench_recorder::throughput() const
+{
+    if (frames() == 0) return 0.;
+    const double seconds = std::chrono::duration<double>(last_end_ - first_start_).count();
+    return seconds > 0. ? frames() / seconds : 0.;
+}
+
+void bench_recorder::log() const
+{
+    spdlog::info("{} frames, {:.1f} frames/s", frames(), throughput());
+    spdlog::info("{:<12} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}", "stage [us]", "mean", "p50",
+                 "p90", "p99", "p99.9", "max");
+    const auto row = [](const char* name, const latency_histogram& h) {
+        spdlog::info("{:<12} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}", name,
+                     h.mean(), h.percentile(50.), h.percentile(90.), h.percentile(99.),
+                     h.percentile(99.9), h.max());
+    };
+    for (int s = 0; s < kStageCount; ++s)
+        row(kStageNames[s], stages_[s]);
+    row("end-to-end", end_to_end_);
+}
+
+std::string bench_recorder::json(
+    const std::vector<std::pair<std::string, std::string>>& meta) const
+{
+    nlohmann::json report;
+    for (const auto& [key, value] : meta)
+        report[key] = value;
+    report["frames"]         = frames();
+    report["throughput_fps"] = throughput();
+    for (int s = 0; s < kStageCount; ++s)
+        report["stages"][kStageNames[s]] = to_json(stages_[s]);
+    report["end_to_end"] = to_json(end_to_end_);
+    return report.dump(2);
+}
@@ -0,0 +1,93 @@
+#include "frame_pipeline.h"
+
+#include "eztrt/common.h"
+#include "eztrt/spsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+frame_pipeline::frame_pipeline(stages s, options o) : stages_{std::move(s)}, options_{o} {}
+
+frame_pipeline::stats frame_pipeline::run()
+{
+    using clock = std::chrono::steady_clock;
+    using queue = eztrt::spsc_queue<frame>;
+
+    const size_t depth = options_.queue_depth ? options_.queue_depth : 1;
+    queue        captured(depth), prepared(depth), inferred(depth), finished(depth);
+
+    std::atomic<bool>     stop{false};
+    std::atomic<uint64_t> dropped{0}, discarded{0};
+    uint64_t              count = 0;
+    const auto            start = clock::now();
+
+    const auto timed = [](int id, const stage& fn, frame& f) {
+        samplesCommon::PreciseCpuTimer timer;
+        timer.start();
+        const bool ok = fn(f);
+        timer.stop();
+        f.stage_us[id] = timer.microseconds();
+        return ok;
+    };
+
+    std::thread capture([&] {
+        for (; !stop; ++count)
+        {
+            frame f;
+            f.index = count;
+            f.start = clock::now();
+            if (!timed(0, stages_.capture, f)) break;
+            if (options_.drop_when_full)
+            {
+                if (!captured.try_push(std::move(f))) ++dropped;
+            }
+            else if (!captured.push(std::move(f)))
+                break;
+        }
+        captured.close();
+    });
+
+    // a stage that ends closes both of its queues: downstream drains and ends as well, upstream
+    // stops waiting for a free slot
+    const auto run_stage = [&](queue& in, queue& out, int id, const stage& fn) {
+        frame f;
+        while (in.pop(f))
+        {
+            if (!timed(id, fn, f))
+                ++discarded;
+            else if (!out.push(std::move(f)))
+                break;
+        }
+        in.close();
+        out.close();
+    };
+    std::thread preprocess([&] { run_stage(captured, prepared, 1, stages_.preprocess); });
+    std::thread infer([&] { run_stage(prepared, inferred, 2, stages_.infer); });
+    std::thread postprocess([&] { run_stage(inferred, finished, 3, stages_.postprocess); });
+
+    // one thread per stage and FIFO queues keep the capture order
+    stats result;
+    frame f;
+    while (finished.pop(f))
+    {
+        ++result.delivered;
+        if (!stages_.sink(f))
+        {
+            stop = true;
+            break;
+        }
+    }
+    finished.close();
+
+    postprocess.join();
+    infer.join();
+    preprocess.join();
+    capture.join();
+
+    result.captured  = count;
+    result.dropped   = dropped;
+    result.discarded = discarded;
+    result.seconds   = std::chrono::duration<double>(clock::now() - start).count();
+    return result;
+}
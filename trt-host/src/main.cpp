@@ -3,11 +3,15 @@
 #include "NvOnnxParser.h"
 
 #include "eztrt/model.h"
+#include "eztrt/onnx_inspector.h"
 #include "eztrt/util.h"
+#include "bench.h"
+#include "frame_pipeline.h"
 
 #include <opencv2/core/utility.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/opencv.hpp>
+#include <fstream>
 #include <string>
 
 template<>
@@ -49,10 +53,20 @@ const char* keys =
     "{output         |      | output image path (optional). Leave a pair of curly "
     "braces in there to output per-channel}"
     "{engine         |      | file to a serialized engine blob}"
+    "{cache          |      | directory to cache built engines in, ignored if --engine is given}"
+    "{cache_mb       |   0  | size limit of the engine cache in MiB, 0 for unlimited}"
     "{classes        |      | json file that contains a index->class label map to use for lookup}"
     "{bs             |   1  | batch size}"
     "{ws             | 2048 | workspace size in MiB}"
     "{preprocess     |      | preprocess string as a list/subset of v,h,r,t,I,C,G }"
+    "{inspect        |      | print the inputs, outputs and operators of the model and exit}"
+    "{cpu            |      | run the model on the CPU reference backend instead of TensorRT}"
+    "{headless       |      | do not open any windows, e.g. for benchmarking}"
+    "{queue          |   4  | capacity of the queues between the pipeline stages}"
+    "{drop           |      | drop frames while the pipeline is full (always on for cameras)}"
+    "{bench          |   0  | replay the input N times after a warmup and report the latencies}"
+    "{warmup         |  10  | number of frames processed before --bench starts recording}"
+    "{report         |      | file to write the JSON report of --bench to}"
     "{v              |      | verbose output}";
 
 int main(int argc, char* argv[])
@@ -74,11 +88,18 @@ int main(int argc, char* argv[])
     bool        verbose            = parser.has("v");
     std::string preprocess         = parser.get<std::string>("preprocess");
     std::string engine_path        = parser.get<std::string>("engine");
+    std::string cache_dir          = parser.get<std::string>("cache");
+    size_t      cache_mb           = parser.get<int>("cache_mb");
     std::string classes_path       = parser.get<std::string>("classes");
+    bool        headless           = parser.has("headless");
+    int         queue_depth        = parser.get<int>("queue");
+    int         bench              = parser.get<int>("bench");
+    int         warmup             = parser.get<int>("warmup");
+    std::string report_path        = parser.get<std::string>("report");
     bool        engine_path_exists = file_exists(engine_path);
     int         camera             = input_path == "CAMERA0" ? 0 : input_path == "CAMERA1" ? 1 : -1;
 
-    auto classes = [&]() -> std::unordered_map<size_t, std::string> {
+    auto classes = [&]() -> std::vector<std::string> {
         if (file_exists(classes_path))
             return load_class_labels(classes_path);
         else
@@ -100,9 +121,19 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    if (parser.has("inspect"))
+    {
+        auto info = inspect_onnx(model_path);
+        spdlog::info("{}", info.summarize(true));
+        return info.valid() ? 0 : 1;
+    }
+
     model::params params;
-    params.batchSize      = bs;
-    params.workspace_size = ws * 1024 * 1024;
+    params.backend                = parser.has("cpu") ? backend_type::cpu : backend_type::tensorrt;
+    params.batchSize              = bs;
+    params.workspace_size         = ws * 1024 * 1024;
+    params.engine_cache_dir       = cache_dir;
+    params.engine_cache_max_bytes = cache_mb * 1024 * 1024;
 
     model m(params, log);
 
@@ -115,54 +146,123 @@ int main(int argc, char* argv[])
     }
 
     // if engine file didn't exist before, serialize the created engine
-    if (!engine_path_exists && !engine_path.empty()) m.serialize_engine(engine_path);
+    if (!engine_path_exists && !engine_path.empty() && !m.backend())
+        m.serialize_engine(engine_path);
 
     spdlog::info("Loaded Network:\n{}", m.summarize());
 
     cv::VideoCapture src;
-
     if (camera >= 0)
-        src = cv::VideoCapture(0);
-    else
+        src = cv::VideoCapture(camera);
+    else if (!bench)
         src = cv::VideoCapture(input_path);
 
-    cv::Mat in_img, in_data;
-
-    while (src.read(in_img))
+    // --bench replays the input from memory: the warmup frames, then the input `bench` times
+    std::vector<cv::Mat> bench_frames;
+    bench_recorder       recorder;
+    if (bench)
     {
-        in_data = apply_preprocess_steps(in_img, preprocess);
-        in_data = try_adjust_input(in_data, 0, m);
-
-        auto result = m.predict(in_data);
-        spdlog::info("Prediction finished!");
+        if (camera < 0) bench_frames = load_frames(input_path);
+        if (bench_frames.empty())
+        {
+            spdlog::error("--bench needs an image, video or directory of images as input");
+            return 1;
+        }
+        headless = true;
+        spdlog::info("Benchmarking {} warmup and {} x {} frames...", warmup, bench,
+                     bench_frames.size());
+    }
+    const uint64_t bench_total = warmup + uint64_t(bench) * bench_frames.size();
 
-        auto softmaxed = softmax(result);
+    preprocess_plan plan(preprocess);
 
-        if (softmaxed.dims == 4)
+    frame_pipeline::stages stages;
+    stages.capture = [&](frame& f) {
+        if (!bench) return src.read(f.image);
+        if (f.index >= bench_total) return false;
+        f.image = bench_frames[f.index % bench_frames.size()].clone();
+        return true;
+    };
+    stages.preprocess = [&](frame& f) {
+        // the model input buffers belong to the inference stage, so this writes a separate Mat
+        f.input = try_adjust_input(plan.apply(f.image), 0, m);
+        if (f.input.empty()) spdlog::error("Could not adapt frame {} to the network!", f.index);
+        return !f.input.empty();
+    };
+    stages.infer = [&](frame& f) {
+        f.output = m.predict(f.input);
+        spdlog::debug("Prediction of frame {} finished!", f.index);
+        return !f.output.empty();
+    };
+    stages.postprocess = [&](frame& f) {
+        if (f.output.dims == 4)
         {
-            show_all_channels(softmaxed);
-            if (!output_path.empty()) save_all_channels(softmaxed, output_path);
+            // segmentation: label map and confidence in one pass, the per-class probabilities are
+            // only materialized if they are saved
+            f.labels = argmax_channels(f.output, &f.confidence);
+            if (!f.labels.empty())
+            {
+                const int classes_count = f.output.size[1];
+                f.labels.convertTo(f.labels, CV_8U, 255. / std::max(classes_count - 1, 1));
+                cv::applyColorMap(f.labels, f.labels, cv::COLORMAP_JET);
+            }
+            if (!output_path.empty()) save_all_channels(softmax(f.output), output_path);
         }
         else
+        {
+            // at most 20 classes can be above the threshold
+            f.classes = top_k(softmax(f.output), 20, 0.05f, classes);
+        }
+        return true;
+    };
+    stages.sink = [&](frame& f) {
+        if (bench)
+        {
+            if (f.index >= uint64_t(warmup)) recorder.record(f);
+            return true;
+        }
+        if (f.output.dims != 4)
         {
             //  display a 1D vector (classification) as a softmaxed "bar" chart
-            spdlog::info("Final Result after softmax, classes with p>0.05:");
-            for (int i = 0; i < softmaxed.total(); ++i)
+            spdlog::info("Frame {}: Final Result after softmax, classes with p>0.05:", f.index);
+            for (const auto& [i, prob, clsname] : f.classes)
             {
-                auto prob = softmaxed.at<float>(i);
-                if (prob < 0.05) continue;
                 std::string stars;
                 for (float cnt = 0.0f; cnt < 1.0f; cnt += 1.f / 19.f)
                     stars += cnt > prob ? " " : "*";
-                auto clsname = classes[i];
                 spdlog::info("{:3}: {} [{:4.1f}%] {}", i, stars, prob * 100.f, clsname);
             }
         }
+        if (headless) return true;
 
-        cv::imshow("input", in_img);
+        if (!f.labels.empty())
+        {
+            cv::imshow("labels", f.labels);
+            cv::imshow("confidence", f.confidence);
+        }
+        cv::imshow("input", f.image);
         int key = cv::waitKey(camera < 0 ? -1 : 1);
-        if ((key & 0xFF) == 27) break;
-        src.read(in_img);
+        return (key & 0xFF) != 27;
+    };
+
+    frame_pipeline::options options;
+    options.queue_depth    = queue_depth;
+    options.drop_when_full = !bench && (parser.has("drop") || camera >= 0);
+
+    auto stats = frame_pipeline(stages, options).run();
+    spdlog::info("{} frames in {:.2f}s ({:.1f} fps), {} dropped, {} discarded", stats.delivered,
+                 stats.seconds, stats.delivered / std::max(stats.seconds, 1e-9), stats.dropped,
+                 stats.discarded);
+    if (bench)
+    {
+        recorder.log();
+        const std::string report = recorder.json({{"model", model_path},
+                                                  {"input", input_path},
+                                                  {"backend", m.backend() ? "cpu" : "tensorrt"},
+                                                  {"preprocess", preprocess}});
+        std::cout << report << std::endl;
+        if (!report_path.empty()) std::ofstream(report_path) << report << std::endl;
+        return 0;
     }
     spdlog::info("No more data to process!");
     return 0;